@@ -0,0 +1,96 @@
+/*
+ * binrec_if.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "binrec_if.h"
+
+static const char *TAG = "BINREC";
+
+static uint8_t file_hdr[BINREC_HDR_MAX_LEN];
+static size_t file_hdr_len = 0;
+
+static const binrec_idx_hdr_t idx_hdr = {
+	.magic = BINREC_IDX_MAGIC,
+	.version = BINREC_VERSION,
+	.entry_len = sizeof(binrec_idx_t),
+};
+
+
+/*
+ * Scale v to an integer the same way enc_fmt_fixed() rounds it, so the
+ * decoded value prints identically. Values that don't fit become 'nan'.
+ */
+static int32_t to_fixed(double v, double scale, int32_t max, int32_t nan)
+{
+	double a;
+
+	if (!isfinite(v)) {
+		return nan;
+	}
+	a = fabs(v) * scale + 0.5;
+	if (a >= max) {
+		return nan;
+	}
+	return (v < 0) ? -(int32_t) a : (int32_t) a;
+}
+
+
+esp_err_t BINREC_Initialize(const char *id, const char *topic)
+{
+	binrec_file_hdr_t *h = (binrec_file_hdr_t *) file_hdr;
+	size_t id_len = strlen(id) + 1;
+	size_t topic_len = strlen(topic) + 1;
+
+	if (sizeof(*h) + id_len + topic_len > sizeof(file_hdr)) {
+		ESP_LOGE(TAG, "Header doesn't fit in %d bytes", BINREC_HDR_MAX_LEN);
+		file_hdr_len = 0;
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	file_hdr_len = sizeof(*h) + id_len + topic_len;
+	h->magic = BINREC_MAGIC;
+	h->version = BINREC_VERSION;
+	h->hdr_len = file_hdr_len;
+	h->rec_len = sizeof(binrec_t);
+	h->index_interval = CONFIG_SD_BIN_INDEX_INTERVAL;
+	memcpy(file_hdr + sizeof(*h), id, id_len);
+	memcpy(file_hdr + sizeof(*h) + id_len, topic, topic_len);
+
+	return ESP_OK;
+}
+
+const void *BINREC_Header(size_t *len)
+{
+	*len = file_hdr_len;
+	return file_hdr;
+}
+
+const binrec_idx_hdr_t *BINREC_IndexHeader(void)
+{
+	return &idx_hdr;
+}
+
+void BINREC_Encode(const airu_sample_t *s, binrec_t *rec)
+{
+	rec->sync   = BINREC_SYNC;
+	rec->valid  = s->valid;
+	rec->uptime = s->ts_us / 1000000;
+	rec->tod    = (s->valid & AIRU_FIELD_DATE) ?
+					(uint32_t) s->hour * 3600 + s->min * 60 + s->sec : BINREC_TOD_NONE;
+	rec->alt    = to_fixed(s->alt,   100,   INT32_MAX, BINREC_NAN);
+	rec->lat    = to_fixed(s->lat,   10000, INT32_MAX, BINREC_NAN);
+	rec->lon    = to_fixed(s->lon,   10000, INT32_MAX, BINREC_NAN);
+	rec->pm1    = to_fixed(s->pm1,   100,   INT32_MAX, BINREC_NAN);
+	rec->pm2_5  = to_fixed(s->pm2_5, 100,   INT32_MAX, BINREC_NAN);
+	rec->pm10   = to_fixed(s->pm10,  100,   INT32_MAX, BINREC_NAN);
+	rec->temp   = to_fixed(s->temp,  100,   INT16_MAX, BINREC_NAN16);
+	rec->hum    = to_fixed(s->hum,   100,   INT16_MAX, BINREC_NAN16);
+	rec->co     = s->co;
+	rec->nox    = s->nox;
+}
@@ -0,0 +1,449 @@
+/*
+ * encoder_if.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "encoder_if.h"
+
+#define ENC_NUM_LEN		24
+#define ENC_TIME_LEN	16
+#define ENC_MAX_DEC		6
+
+#if defined(CONFIG_INFLUX_TIMESTAMP_S)
+#define ENC_TS_DIV		1000	/* utc_ms to the Influx precision */
+#elif defined(CONFIG_INFLUX_TIMESTAMP_MS)
+#define ENC_TS_DIV		1
+#endif
+
+typedef enum {
+	ENC_U64,
+	ENC_INT,
+	ENC_FIXED
+} enc_kind_t;
+
+/*
+ * Field keys are constant and need no escaping. Each key carries its
+ * separator so the field loop is just copy, copy.
+ */
+typedef struct {
+	const char *key;
+	uint8_t key_len;
+	uint8_t kind;
+	uint8_t decimals;
+} enc_field_t;
+
+#define ENC_KEY(k) k, sizeof(k) - 1
+
+enum {
+	F_SEC_ACTIVE, F_ALT, F_LAT, F_LON, F_PM1, F_PM2_5, F_PM10,
+	F_TEMP, F_HUM, F_CO, F_NO, F_COUNT
+};
+
+static const enc_field_t fields[F_COUNT] = {
+	[F_SEC_ACTIVE] 	= { ENC_KEY("SecActive="), 	 ENC_U64,   0 },
+	[F_ALT] 		= { ENC_KEY(",Altitude="), 	 ENC_FIXED, 2 },
+	[F_LAT] 		= { ENC_KEY(",Latitude="), 	 ENC_FIXED, 4 },
+	[F_LON] 		= { ENC_KEY(",Longitude="),  ENC_FIXED, 4 },
+	[F_PM1] 		= { ENC_KEY(",PM1="), 		 ENC_FIXED, 2 },
+	[F_PM2_5] 		= { ENC_KEY(",PM2.5="), 	 ENC_FIXED, 2 },
+	[F_PM10] 		= { ENC_KEY(",PM10="), 		 ENC_FIXED, 2 },
+	[F_TEMP] 		= { ENC_KEY(",Temperature="), ENC_FIXED, 2 },
+	[F_HUM] 		= { ENC_KEY(",Humidity="), 	 ENC_FIXED, 2 },
+	[F_CO] 			= { ENC_KEY(",CO="), 		 ENC_INT,   0 },
+	[F_NO] 			= { ENC_KEY(",NO="), 		 ENC_INT,   0 },
+};
+
+/* PM channels sent only when there were frames behind them */
+enum { P_PM1_ATM, P_PM2_5_ATM, P_PM10_ATM, P_ATM_COUNT = 3 };
+
+static const enc_field_t pm_atm_fields[P_ATM_COUNT] = {
+	[P_PM1_ATM] 	= { ENC_KEY(",PM1_atm="), 	ENC_FIXED, 2 },
+	[P_PM2_5_ATM] 	= { ENC_KEY(",PM2.5_atm="), ENC_FIXED, 2 },
+	[P_PM10_ATM] 	= { ENC_KEY(",PM10_atm="), 	ENC_FIXED, 2 },
+};
+
+static const enc_field_t pn_fields[AIRU_PN_BINS] = {
+	{ ENC_KEY(",PN0.3="), ENC_FIXED, 1 },
+	{ ENC_KEY(",PN0.5="), ENC_FIXED, 1 },
+	{ ENC_KEY(",PN1="),   ENC_FIXED, 1 },
+	{ ENC_KEY(",PN2.5="), ENC_FIXED, 1 },
+	{ ENC_KEY(",PN5="),   ENC_FIXED, 1 },
+	{ ENC_KEY(",PN10="),  ENC_FIXED, 1 },
+};
+
+#ifdef CONFIG_INFLUX_STATS
+/* Window statistics: channel prefix, then one suffix per statistic */
+enum { S_SD, S_MIN, S_MAX, S_P50, S_P95, S_COUNT };
+
+static const enc_field_t stat_fields[AIRU_STAT_COUNT] = {
+	[AIRU_STAT_PM1] 	= { ENC_KEY(",PM1_"), 		   ENC_FIXED, 2 },
+	[AIRU_STAT_PM2_5] 	= { ENC_KEY(",PM2.5_"), 	   ENC_FIXED, 2 },
+	[AIRU_STAT_PM10] 	= { ENC_KEY(",PM10_"), 		   ENC_FIXED, 2 },
+	[AIRU_STAT_TEMP] 	= { ENC_KEY(",Temperature_"), ENC_FIXED, 2 },
+	[AIRU_STAT_HUM] 	= { ENC_KEY(",Humidity_"), 	   ENC_FIXED, 2 },
+	[AIRU_STAT_CO] 		= { ENC_KEY(",CO_"), 		   ENC_FIXED, 1 },
+	[AIRU_STAT_NOX] 	= { ENC_KEY(",NO_"), 		   ENC_FIXED, 1 },
+};
+
+static const enc_field_t stat_suffix[S_COUNT] = {
+	[S_SD]  = { ENC_KEY("sd="),  ENC_FIXED, 0 },
+	[S_MIN] = { ENC_KEY("min="), ENC_FIXED, 0 },
+	[S_MAX] = { ENC_KEY("max="), ENC_FIXED, 0 },
+	[S_P50] = { ENC_KEY("p50="), ENC_FIXED, 0 },
+	[S_P95] = { ENC_KEY("p95="), ENC_FIXED, 0 },
+};
+#endif
+
+static const uint32_t pow10_tbl[ENC_MAX_DEC + 1] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000
+};
+
+static const char *TAG = "ENC";
+
+/* Escaped once by ENC_Initialize() */
+static char line_tags[ENC_TAGS_LEN];		/* "<measurement>,ID=<mac>,SensorModel=H2+<ver>" */
+static size_t line_tags_len;
+static char csv_tags[ENC_TAGS_LEN];			/* ",<mac>,<topic>," */
+static size_t csv_tags_len;
+
+typedef struct {
+	char *p;
+	char *end;			/* last usable byte, reserved for the NUL */
+	bool overflow;
+} enc_out_t;
+
+
+static void out_init(enc_out_t *o, char *buf, size_t size)
+{
+	o->p = buf;
+	o->end = (buf != NULL && size > 0) ? buf + size - 1 : buf;
+	o->overflow = (buf != NULL && size == 0);
+}
+
+static void out_put(enc_out_t *o, const char *src, size_t len)
+{
+	if (o->p == NULL) {
+		return;
+	}
+	if ((size_t)(o->end - o->p) < len) {
+		len = o->end - o->p;
+		o->overflow = true;
+	}
+	memcpy(o->p, src, len);
+	o->p += len;
+}
+
+static void out_finish(enc_out_t *o)
+{
+	if (o->p != NULL) {
+		*o->p = '\0';
+	}
+}
+
+/*
+ * Copy src into dst, backslash escaping every character in 'special'.
+ * Returns the escaped length, or -1 if it doesn't fit.
+ */
+static int escape_into(char *dst, size_t size, const char *src, const char *special)
+{
+	size_t n = 0;
+
+	for (; *src != '\0'; src++) {
+		if (strchr(special, *src) != NULL) {
+			if (n + 1 >= size) return -1;
+			dst[n++] = '\\';
+		}
+		if (n + 1 >= size) return -1;
+		dst[n++] = *src;
+	}
+	dst[n] = '\0';
+	return n;
+}
+
+static size_t fmt_u64(char *dst, uint64_t v)
+{
+	char tmp[20];
+	size_t n = 0, i;
+
+	do {
+		tmp[n++] = '0' + (v % 10);
+		v /= 10;
+	} while (v != 0);
+
+	for (i = 0; i < n; i++) {
+		dst[i] = tmp[n - 1 - i];
+	}
+	return n;
+}
+
+static size_t fmt_int(char *dst, int64_t v)
+{
+	if (v < 0) {
+		*dst = '-';
+		return 1 + fmt_u64(dst + 1, -(uint64_t) v);
+	}
+	return fmt_u64(dst, v);
+}
+
+size_t enc_fmt_fixed(char *dst, double v, unsigned decimals)
+{
+	uint64_t scaled, ip, fp;
+	uint32_t scale;
+	size_t n = 0, k;
+	bool neg;
+
+	if (decimals > ENC_MAX_DEC) {
+		decimals = ENC_MAX_DEC;
+	}
+	scale = pow10_tbl[decimals];
+
+	// Out of the fast path's range: leave it to the C library, in
+	// exponent form where the digits wouldn't fit
+	if (!isfinite(v) || fabs(v) * scale >= 9.0e18) {
+		n = snprintf(dst, ENC_NUM_LEN, "%.*f", decimals, v);
+		if (n >= ENC_NUM_LEN) {
+			n = snprintf(dst, ENC_NUM_LEN, "%.*e", decimals, v);
+		}
+		return n;
+	}
+
+	neg = v < 0;
+	scaled = (uint64_t)((neg ? -v : v) * scale + 0.5);
+	ip = scaled / scale;
+	fp = scaled % scale;
+
+	if (neg && scaled != 0) {
+		dst[n++] = '-';
+	}
+	n += fmt_u64(dst + n, ip);
+
+	if (decimals > 0) {
+		dst[n++] = '.';
+		for (k = decimals; k > 0; k--) {
+			dst[n + k - 1] = '0' + (fp % 10);
+			fp /= 10;
+		}
+		n += decimals;
+	}
+	return n;
+}
+
+
+esp_err_t ENC_Initialize(const char *measurement, const char *id, const char *model, const char *topic)
+{
+	char esc[ENC_TAGS_LEN];
+	int len;
+
+	// Measurement: escape commas and spaces
+	if ((len = escape_into(line_tags, sizeof(line_tags), measurement, ", ")) < 0) {
+		goto too_long;
+	}
+	line_tags_len = len;
+
+	// Tag values: escape commas, equals signs and spaces
+	if (escape_into(esc, sizeof(esc), id, ",= ") < 0) {
+		goto too_long;
+	}
+	len = snprintf(line_tags + line_tags_len, sizeof(line_tags) - line_tags_len, ",ID=%s", esc);
+	if (len < 0 || len >= sizeof(line_tags) - line_tags_len) {
+		goto too_long;
+	}
+	line_tags_len += len;
+
+	if (escape_into(esc, sizeof(esc), model, ",= ") < 0) {
+		goto too_long;
+	}
+	len = snprintf(line_tags + line_tags_len, sizeof(line_tags) - line_tags_len, ",SensorModel=H2+%s", esc);
+	if (len < 0 || len >= sizeof(line_tags) - line_tags_len) {
+		goto too_long;
+	}
+	line_tags_len += len;
+
+	len = snprintf(csv_tags, sizeof(csv_tags), ",%s,%s,", id, topic);
+	if (len < 0 || len >= sizeof(csv_tags)) {
+		goto too_long;
+	}
+	csv_tags_len = len;
+
+	return ESP_OK;
+
+too_long:
+	ESP_LOGE(TAG, "Tags don't fit in %d bytes", ENC_TAGS_LEN);
+	line_tags_len = 0;
+	csv_tags_len = 0;
+	return ESP_ERR_INVALID_SIZE;
+}
+
+
+static void put_fixed(enc_out_t *lo, const enc_field_t *f, double v)
+{
+	char num[ENC_NUM_LEN];
+	size_t n = enc_fmt_fixed(num, v, f->decimals);
+
+	out_put(lo, f->key, f->key_len);
+	out_put(lo, num, n);
+}
+
+/*
+ * Atmospheric PM and particle counts, Influx only
+ */
+static void put_pm_ext(enc_out_t *lo, const airu_sample_t *s)
+{
+	int i;
+
+	if (s->valid & AIRU_FIELD_PM) {
+		put_fixed(lo, &pm_atm_fields[P_PM1_ATM], s->pm1_atm);
+		put_fixed(lo, &pm_atm_fields[P_PM2_5_ATM], s->pm2_5_atm);
+		put_fixed(lo, &pm_atm_fields[P_PM10_ATM], s->pm10_atm);
+	}
+	if (s->valid & AIRU_FIELD_PN) {
+		for (i = 0; i < AIRU_PN_BINS; i++) {
+			put_fixed(lo, &pn_fields[i], s->pn[i]);
+		}
+	}
+}
+
+#ifdef CONFIG_INFLUX_STATS
+/*
+ * Window statistics, Influx only. A channel needs two values for them to
+ * say anything the mean doesn't.
+ */
+static void put_stats(enc_out_t *lo, const airu_sample_t *s)
+{
+	char num[ENC_NUM_LEN];
+	float v[S_COUNT];
+	size_t n;
+	int i, k;
+
+	if (!(s->valid & AIRU_FIELD_STATS)) {
+		return;
+	}
+
+	for (i = 0; i < AIRU_STAT_COUNT; i++) {
+		const stats_summary_t *st = &s->stats[i];
+
+		if (st->n < 2) {
+			continue;
+		}
+		v[S_SD]  = st->sd;
+		v[S_MIN] = st->min;
+		v[S_MAX] = st->max;
+		v[S_P50] = st->p50;
+		v[S_P95] = st->p95;
+
+		for (k = 0; k < S_COUNT; k++) {
+			n = enc_fmt_fixed(num, v[k], stat_fields[i].decimals);
+			out_put(lo, stat_fields[i].key, stat_fields[i].key_len);
+			out_put(lo, stat_suffix[k].key, stat_suffix[k].key_len);
+			out_put(lo, num, n);
+		}
+	}
+}
+#endif
+
+
+esp_err_t ENC_Encode(const airu_sample_t *s, char *line, size_t line_size, char *csv, size_t csv_size)
+{
+	enc_out_t lo, co;
+	char num[ENC_NUM_LEN];
+	size_t n;
+	uint64_t uptime = s->ts_us / 1000000;
+	double fixed[F_COUNT];
+	int64_t ints[F_COUNT];
+	int i;
+
+	fixed[F_ALT]   = s->alt;
+	fixed[F_LAT]   = s->lat;
+	fixed[F_LON]   = s->lon;
+	fixed[F_PM1]   = s->pm1;
+	fixed[F_PM2_5] = s->pm2_5;
+	fixed[F_PM10]  = s->pm10;
+	fixed[F_TEMP]  = s->temp;
+	fixed[F_HUM]   = s->hum;
+	ints[F_CO]     = s->co;
+	ints[F_NO]     = s->nox;
+
+	out_init(&lo, line, line_size);
+	out_init(&co, csv, csv_size);
+
+	out_put(&lo, line_tags, line_tags_len);
+	// Geohash characters need no escaping
+	if ((s->valid & AIRU_FIELD_POS) && s->geohash[0] != '\0') {
+		out_put(&lo, ",Geohash=", 9);
+		out_put(&lo, s->geohash, strnlen(s->geohash, sizeof(s->geohash)));
+	}
+	out_put(&lo, " ", 1);
+
+	// CSV time column: GPS time of day if the date is sane, else uptime
+	if (s->valid & AIRU_FIELD_DATE) {
+		num[0] = '0' + (s->hour / 10) % 10;
+		num[1] = '0' + s->hour % 10;
+		num[2] = ':';
+		num[3] = '0' + (s->min / 10) % 10;
+		num[4] = '0' + s->min % 10;
+		num[5] = ':';
+		num[6] = '0' + (s->sec / 10) % 10;
+		num[7] = '0' + s->sec % 10;
+		n = 8;
+	}
+	else {
+		n = fmt_u64(num, uptime / 3600);
+		num[n++] = ':';
+		num[n++] = '0' + (uptime % 3600) / 600;
+		num[n++] = '0' + ((uptime % 3600) / 60) % 10;
+		num[n++] = ':';
+		num[n++] = '0' + (uptime % 60) / 10;
+		num[n++] = '0' + uptime % 10;
+	}
+	out_put(&co, num, n);
+	out_put(&co, csv_tags, csv_tags_len);
+
+	// Each value is formatted once and copied to both outputs
+	for (i = 0; i < F_COUNT; i++) {
+		switch (fields[i].kind) {
+		case ENC_U64:
+			n = fmt_u64(num, uptime);
+			break;
+		case ENC_INT:
+			n = fmt_int(num, ints[i]);
+			break;
+		default:
+			n = enc_fmt_fixed(num, fixed[i], fields[i].decimals);
+			break;
+		}
+
+		out_put(&lo, fields[i].key, fields[i].key_len);
+		out_put(&lo, num, n);
+
+		if (i != 0) {
+			out_put(&co, ",", 1);
+		}
+		out_put(&co, num, n);
+	}
+	out_put(&co, "\n", 1);
+
+	put_pm_ext(&lo, s);
+#ifdef CONFIG_INFLUX_STATS
+	put_stats(&lo, s);
+#endif
+
+#ifdef ENC_TS_DIV
+	if (s->utc_ms >= 0) {
+		out_put(&lo, " ", 1);
+		n = fmt_u64(num, s->utc_ms / ENC_TS_DIV);
+		out_put(&lo, num, n);
+	}
+#endif
+
+	out_finish(&lo);
+	out_finish(&co);
+
+	return (lo.overflow || co.overflow) ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
@@ -9,42 +9,127 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
 #include "driver/uart.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "seqlock.h"
+#include "nmea.h"
 #include "gps_if.h"
 #include "led_if.h"
-#include "math.h"
+#include "time_if.h"
 
 #define GPS_UART_NUM 		UART_NUM_1
 #define GPS_TX_GPIO 		22
 #define GPS_RX_GPIO 		23
 #define MAX_SENTENCE_LEN 	1024
 #define NMEA_RDY_BIT		BIT0
+#define LAT_E7_MAX			900000000LL
+#define LON_E7_MAX			1800000000LL
+#define GPS_CMD_LEN			64
+#define GPS_ACK_TIMEOUT_MS	1000
+#define GPS_CMD_RETRIES		3
+#define GPS_ACK_QUEUE_LEN	4
+#define GPS_E7_PER_M		90		/* 1e-7 degree of latitude per metre, rounded */
+#define GPS_WAKE_GOOD_FIXES	10		/* good fixes that end a wake check early */
+#define GPS_MOVED_FIXES		5		/* consecutive distant fixes that mean we moved */
+
+/* gps_cfg_task notification bits */
+#define GPS_CFG_APPLY_BIT	BIT0	/* new profile or module restart */
+#define GPS_CFG_STILL_BIT	BIT1	/* averaged position has converged */
+#define GPS_CFG_MOVED_BIT	BIT2	/* wake check: position changed */
+#define GPS_CFG_CHECKED_BIT	BIT3	/* wake check: position confirmed */
+
+/* PMTK001 ack flags */
+#define PMTK_ACK_INVALID	0
+#define PMTK_ACK_UNSUPPORTED 1
+#define PMTK_ACK_FAILED		2
+#define PMTK_ACK_OK			3
+
+typedef struct {
+	uint16_t cmd;
+	uint8_t flag;
+} pmtk_ack_t;
 
 static uint8_t nmea[MAX_SENTENCE_LEN];
 //static EventGroupHandle_t gps_event_group;
 static QueueHandle_t gps_event_queue;
 
+/*
+ * Configuration: GPS_SetProfile() leaves the wanted profile in
+ * gps_profile_queue (length 1, overwritten) and notifies gps_cfg_task.
+ * The UART task forwards PMTK001 acks through gps_ack_queue and notifies
+ * gps_cfg_task on a module restart, and on the stationary / moved
+ * decisions that drive standby. gps_cfg_status.mode is only written by
+ * gps_cfg_task.
+ */
+static TaskHandle_t gps_cfg_task_handle;
+static QueueHandle_t gps_profile_queue;
+static QueueHandle_t gps_ack_queue;
+static gps_cfg_status_t gps_cfg_status;
+
 static const char* TAG = "GPS";
-static esp_err_t parse(char *nmea);
-static uint8_t parseHex(char c);
+static esp_err_t parse(const char *nmea, size_t len);
 
 static esp_gps_t esp_gps = {
 		.lat 	= -1,
 		.lon 	= -1,
 		.alt 	= -1,
+		.lat_e7	= -10000000,
+		.lon_e7	= -10000000,
 		.year 	= 0,
 		.month 	= 0,
 		.day 	= 0,
 		.hour 	= 0,
 		.min 	= 0,
-		.sec 	= 0
+		.sec 	= 0,
+		.ts_us	= 0,
+		.source = GPS_SRC_NONE
 };
 
+/*
+ * esp_gps is only touched by the UART task. After every sentence that
+ * parses, it is published whole through gps_snap, so GPS_Poll() can never
+ * see half of a GGA and half of an RMC update.
+ */
+SEQLOCK_DEFINE(gps_snap, esp_gps_t);
+/*
+ * Rolling window of good GGA fixes, UART task only. Running sums keep the
+ * mean O(1) per fix.
+ */
+static struct {
+	int32_t lat[CONFIG_GPS_AVG_WINDOW];
+	int32_t lon[CONFIG_GPS_AVG_WINDOW];
+	int32_t alt[CONFIG_GPS_AVG_WINDOW];	/* mm */
+	uint16_t head;
+	uint16_t n;
+	int64_t sum_lat, sum_lon, sum_alt;
+} gps_win;
+
+/* Bounds of the cell behind esp_gps.smooth.geohash, for hysteresis */
+static int64_t tag_lat_lo, tag_lat_hi, tag_lon_lo, tag_lon_hi;
+
+#ifdef CONFIG_GPS_DUTY_CYCLE
+/*
+ * Stationary detection, UART task only. While tracking, the mean of each
+ * full window is compared with the mean of the window before; if they
+ * agree the unit is still and that mean is the reference. During a wake
+ * check each good fix is compared with the reference instead.
+ */
+static struct {
+	int32_t ref_lat, ref_lon;
+	bool have_ref;
+	uint16_t count;		/* fixes since ref was taken */
+	uint8_t far;		/* wake check: consecutive fixes outside the radius */
+	uint8_t near;		/* wake check: fixes inside it */
+	gps_mode_t mode;	/* mode at the previous fix */
+} still;
+#endif
+
 static void uart_gps_event_mgr(void *pvParameters)
 {
     uart_event_t event;
@@ -54,7 +139,6 @@ static void uart_gps_event_mgr(void *pvParameters)
     for(;;) {
         //Waiting for UART event.
         if(xQueueReceive(gps_event_queue, (void * )&event, (portTickType)portMAX_DELAY)) {
-            bzero(nmea, MAX_SENTENCE_LEN);
             switch(event.type) {
 
                 case UART_DATA:
@@ -87,10 +171,18 @@ static void uart_gps_event_mgr(void *pvParameters)
 				case UART_PATTERN_DET:
 					uart_get_buffered_data_len(GPS_UART_NUM, &buffered_size);
 					int pos = uart_pattern_pop_pos(GPS_UART_NUM);
-					if (pos != -1) {
+					if (pos != -1 && pos < MAX_SENTENCE_LEN) {
 						int read_len = uart_read_bytes(GPS_UART_NUM, nmea, pos + 1, 100 / portTICK_PERIOD_MS);
-						nmea[read_len] = '\0';
-						parse((char*)nmea);
+						if (read_len > 0 && parse((char*)nmea, read_len) == ESP_OK) {
+							esp_gps.ts_us = esp_timer_get_time();
+							if (esp_gps.source == GPS_SRC_GGA) {
+								esp_gps.pos_ts_us = esp_gps.ts_us;
+							}
+							else {
+								esp_gps.date_ts_us = esp_gps.ts_us;
+							}
+							seqlock_write(&gps_snap, &esp_gps);
+						}
 					}
 					else {
 						uart_flush_input(GPS_UART_NUM);
@@ -105,8 +197,176 @@ static void uart_gps_event_mgr(void *pvParameters)
     vTaskDelete(NULL);
 }
 
+/*
+ * Send "$PMTK<type><args>*hh" and wait for its ack, resending on timeout
+ * or a failure ack.
+ */
+static esp_err_t pmtk_cmd(uint16_t type, const char *args)
+{
+	char line[GPS_CMD_LEN];
+	const char *c;
+	uint8_t sum = 0, attempt;
+	int len;
+	pmtk_ack_t ack;
+	TickType_t start, waited;
+
+	len = snprintf(line, sizeof(line) - 5, "$PMTK%03u%s", type, args);
+	if (len < 0 || len >= (int)sizeof(line) - 5) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	for (c = line + 1; *c; c++) {
+		sum ^= *c;
+	}
+	snprintf(line + len, 6, "*%02X\r\n", sum);
+
+	for (attempt = 0; attempt <= GPS_CMD_RETRIES; attempt++) {
+		if (attempt > 0) {
+			gps_cfg_status.retries++;
+		}
+		xQueueReset(gps_ack_queue);
+		uart_write_bytes(GPS_UART_NUM, line, len + 5);
+
+		start = xTaskGetTickCount();
+		waited = 0;
+		while (waited < pdMS_TO_TICKS(GPS_ACK_TIMEOUT_MS) &&
+			   xQueueReceive(gps_ack_queue, &ack, pdMS_TO_TICKS(GPS_ACK_TIMEOUT_MS) - waited) == pdTRUE) {
+			waited = xTaskGetTickCount() - start;
+			if (ack.cmd != type) {
+				continue;
+			}
+			if (ack.flag == PMTK_ACK_OK) {
+				return ESP_OK;
+			}
+			if (ack.flag == PMTK_ACK_UNSUPPORTED) {
+				ESP_LOGW(TAG, "PMTK%03u not supported", type);
+				gps_cfg_status.failures++;
+				return ESP_ERR_NOT_SUPPORTED;
+			}
+			break;
+		}
+	}
+
+	ESP_LOGW(TAG, "PMTK%03u: no ack", type);
+	gps_cfg_status.failures++;
+	return ESP_ERR_TIMEOUT;
+}
+
+static bool apply_profile(const gps_profile_t *p)
+{
+	char args[24];
+	bool ok = true;
+
+	ok &= pmtk_cmd(314, ",0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0") == ESP_OK;
+
+	snprintf(args, sizeof(args), ",%u", p->fix_ms);
+	ok &= pmtk_cmd(220, args) == ESP_OK;
+
+	snprintf(args, sizeof(args), ",%u,0,0,0,0", p->fix_ms);
+	ok &= pmtk_cmd(300, args) == ESP_OK;
+
+	ok &= pmtk_cmd(313, (p->sbas && p->fix_ms <= 1000) ? ",1" : ",0") == ESP_OK;
+
+	return ok;
+}
+
+#ifdef CONFIG_GPS_DUTY_CYCLE
+static void enter_standby(void)
+{
+	if (pmtk_cmd(161, ",0") != ESP_OK) {
+		gps_cfg_status.mode = GPS_MODE_TRACKING;
+		gps_cfg_status.next_wake_us = 0;
+		return;
+	}
+	gps_cfg_status.mode = GPS_MODE_STANDBY;
+	gps_cfg_status.next_wake_us = esp_timer_get_time() + CONFIG_GPS_WAKE_INTERVAL_S * 1000000LL;
+	ESP_LOGI(TAG, "standby, wake in %d s", CONFIG_GPS_WAKE_INTERVAL_S);
+}
+
+static void enter_wake(void)
+{
+	// Any byte wakes the module from standby
+	uart_write_bytes(GPS_UART_NUM, PMTK_AWAKE, strlen(PMTK_AWAKE));
+	gps_cfg_status.mode = GPS_MODE_WAKE;
+	gps_cfg_status.next_wake_us = esp_timer_get_time() + CONFIG_GPS_WAKE_TIMEOUT_S * 1000000LL;
+	gps_cfg_status.wakes++;
+}
+#endif
+
+/*
+ * Applies the newest requested profile whenever notified: by
+ * GPS_SetProfile(), or by the UART task after the module restarted.
+ *
+ * With CONFIG_GPS_DUTY_CYCLE it also runs the power modes:
+ *   TRACKING --still--> STANDBY --interval--> WAKE --checked/timeout--> STANDBY
+ *                                              WAKE --moved--> TRACKING
+ */
+static void gps_cfg_task(void *pvParameters)
+{
+	gps_profile_t want = { 0 };
+	bool have = false;
+	uint32_t bits;
+	TickType_t wait;
+	int64_t now;
+
+	for (;;) {
+		wait = portMAX_DELAY;
+		if (gps_cfg_status.mode != GPS_MODE_TRACKING) {
+			now = esp_timer_get_time();
+			wait = (gps_cfg_status.next_wake_us > now) ?
+					pdMS_TO_TICKS((gps_cfg_status.next_wake_us - now) / 1000) : 0;
+		}
+		bits = 0;
+		xTaskNotifyWait(0, UINT32_MAX, &bits, wait);
+
+		if (bits & GPS_CFG_APPLY_BIT) {
+			if (xQueueReceive(gps_profile_queue, &want, 0) == pdTRUE) {
+				have = true;
+			}
+			if (have) {
+				gps_cfg_status.profile = want;
+				gps_cfg_status.applied = apply_profile(&want);
+				ESP_LOGI(TAG, "profile %u ms%s %s", want.fix_ms, want.sbas ? " SBAS" : "",
+						 gps_cfg_status.applied ? "applied" : "partly applied");
+			}
+		}
+
+#ifdef CONFIG_GPS_DUTY_CYCLE
+		now = esp_timer_get_time();
+		switch (gps_cfg_status.mode) {
+		case GPS_MODE_TRACKING:
+			if (bits & GPS_CFG_STILL_BIT) {
+				enter_standby();
+			}
+			break;
+
+		case GPS_MODE_STANDBY:
+			if (now >= gps_cfg_status.next_wake_us) {
+				enter_wake();
+			}
+			break;
+
+		case GPS_MODE_WAKE:
+			if (bits & GPS_CFG_MOVED_BIT) {
+				ESP_LOGW(TAG, "unit has moved, tracking");
+				gps_cfg_status.mode = GPS_MODE_TRACKING;
+				gps_cfg_status.next_wake_us = 0;
+			}
+			else if ((bits & GPS_CFG_CHECKED_BIT) || now >= gps_cfg_status.next_wake_us) {
+				enter_standby();
+			}
+			break;
+		}
+#endif
+	}
+}
+
 esp_err_t GPS_Initialize()
 {
+	const gps_profile_t profile = {
+		.fix_ms = CONFIG_GPS_FIX_INTERVAL_MS,
+		.sbas = true
+	};
+
 	esp_err_t err = ESP_FAIL;
 
 	/* Configure parameters of an UART driver,
@@ -127,6 +387,8 @@ esp_err_t GPS_Initialize()
 	if(err != ESP_OK)
 		return err;
 
+	seqlock_write(&gps_snap, &esp_gps);
+
 	err = uart_driver_install(GPS_UART_NUM, MAX_SENTENCE_LEN * 2, 0, 20, &gps_event_queue, 0);
 	if(err != ESP_OK)
 		return err;
@@ -137,262 +399,377 @@ esp_err_t GPS_Initialize()
     uart_pattern_queue_reset(GPS_UART_NUM, 20);
     uart_flush(GPS_UART_NUM);
 
+	gps_profile_queue = xQueueCreate(1, sizeof(gps_profile_t));
+	gps_ack_queue = xQueueCreate(GPS_ACK_QUEUE_LEN, sizeof(pmtk_ack_t));
+	xTaskCreate(gps_cfg_task, "gps_cfg_task", 2560, NULL, 5, &gps_cfg_task_handle);
+
 	xTaskCreate(uart_gps_event_mgr, "uart_pms_event_task", 2048, NULL, 12, NULL);
+	GPS_SetProfile(&profile);
 
 	ESP_LOGE(TAG, "Setting GPS NOT SET Bit...");
 	LED_SetEventBit(LED_EVENT_GPS_RTC_NOT_SET_BIT);
 
-//	GPS_Tx(PMTK_SET_NMEA_OUTPUT_ALLDATA);
-//	GPS_Tx(PMTK_SET_NMEA_UPDATE_1HZ);
-
 	return err;
 }
 
 
 
 /*
- *	This function was taken from Limor Fried/Ladyada,
- * 	from the Adafruit GPS library for Adafruit Industries.
+ * Position fields shared by GGA and RMC: lat, N/S, lon, E/W from field i.
+ * An empty coordinate reads as 0, like the Adafruit parser this replaced.
  */
-esp_err_t parse(char *nmea) {
-	uint8_t hour = 0;
-	uint8_t minute = 0;
-	uint8_t seconds = 0;
-	uint8_t year = 0;
-	uint8_t month = 0;
-	uint8_t day = 0;
-	uint16_t milliseconds;
-	float latitude, longitude;
-	int32_t latitude_fixed, longitude_fixed;
-	float latitudeDegrees = 0;
-	float longitudeDegrees = 0;
-	float altitude = 0;
-	float geoidheight;
-	float speed, angle, magvariation, HDOP;
-	char lat, lon, mag;
-	bool fix;
-	uint8_t fixquality, satellites;
-
-	// first look if we even have one
-	if (nmea[strlen(nmea)-4] == '*') {
-		uint16_t sum = parseHex(nmea[strlen(nmea)-3]) * 16;
-		sum += parseHex(nmea[strlen(nmea)-2]);
-
-		// check checksum
-		for (uint8_t i=2; i < (strlen(nmea)-4); i++) {
-			sum ^= nmea[i];
-		}
-		if (sum != 0) {
-		  // bad checksum :(
-		  return false;
-		}
+static esp_err_t parse_position(const nmea_sentence_t *s, uint8_t i, int32_t *lat_e7, int32_t *lon_e7)
+{
+	esp_err_t err;
+
+	err = nmea_parse_coord(nmea_field(s, i), nmea_field(s, i + 1), 2, lat_e7);
+	if (err == ESP_ERR_NOT_FOUND) {
+		*lat_e7 = 0;
+	}
+	else if (err != ESP_OK) {
+		return ESP_FAIL;
 	}
-	int32_t degree;
-	long minutes;
-	char degreebuff[10];
-
-	if (strstr(nmea, "$GPGGA")) {
-		char *p = nmea;
-		// get time
-		p = strchr(p, ',')+1;
-		float timef = atof(p);
-		uint32_t time = timef;
-		hour = time / 10000;
-		minute = (time % 10000) / 100;
-		seconds = (time % 100);
-		milliseconds = (uint16_t)(fmod(timef, 1.0) * 1000);
-
-		// parse out latitude
-		p = strchr(p, ',')+1;
-		if (',' != *p) {
-			strncpy(degreebuff, p, 2);
-			p += 2;
-			degreebuff[2] = '\0';
-			degree = atol(degreebuff) * 10000000;
-			strncpy(degreebuff, p, 2); // minutes
-			p += 3; // skip decimal point
-			strncpy(degreebuff + 2, p, 4);
-			degreebuff[6] = '\0';
-			minutes = 50 * atol(degreebuff) / 3;
-			latitude_fixed = degree + minutes;
-			latitude = degree / 100000 + minutes * 0.000006F;
-			latitudeDegrees = (latitude - 100 * (int)(latitude / 100)) / 60.0;
-			latitudeDegrees += (int)(latitude / 100);
-		}
 
-		p = strchr(p, ',')+1;
-		if (',' != *p) {
-			if (p[0] == 'S') latitudeDegrees *= -1.0;
-			if (p[0] == 'N') lat = 'N';
-			else if (p[0] == 'S') lat = 'S';
-			else if (p[0] == ',') lat = 0;
-			else return ESP_FAIL;
-		}
+	err = nmea_parse_coord(nmea_field(s, i + 2), nmea_field(s, i + 3), 3, lon_e7);
+	if (err == ESP_ERR_NOT_FOUND) {
+		*lon_e7 = 0;
+	}
+	else if (err != ESP_OK) {
+		return ESP_FAIL;
+	}
+	return ESP_OK;
+}
 
-		// parse out longitude
-		p = strchr(p, ',')+1;
-		if (',' != *p) {
-			strncpy(degreebuff, p, 3);
-			p += 3;
-			degreebuff[3] = '\0';
-			degree = atol(degreebuff) * 10000000;
-			strncpy(degreebuff, p, 2); // minutes
-			p += 3; // skip decimal point
-			strncpy(degreebuff + 2, p, 4);
-			degreebuff[6] = '\0';
-			minutes = 50 * atol(degreebuff) / 3;
-			longitude_fixed = degree + minutes;
-			longitude = degree / 100000 + minutes * 0.000006F;
-			longitudeDegrees = (longitude - 100 * (int)(longitude / 100)) / 60.0;
-			longitudeDegrees += (int)(longitude / 100);
-		}
+/*
+ * Geohash by integer bisection of the 1e-7 degree ranges. If the bounds
+ * pointers are given they receive the final cell.
+ */
+static void geohash(int32_t lat_e7, int32_t lon_e7, uint8_t len, char *out,
+					int64_t *lat_lo_out, int64_t *lat_hi_out, int64_t *lon_lo_out, int64_t *lon_hi_out)
+{
+	static const char base32[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+	int64_t lat_lo = -LAT_E7_MAX, lat_hi = LAT_E7_MAX;
+	int64_t lon_lo = -LON_E7_MAX, lon_hi = LON_E7_MAX;
+	int64_t mid;
+	uint8_t i, b, ch;
+	bool even = true;
+
+	if (len > GPS_GEOHASH_MAX_LEN) {
+		len = GPS_GEOHASH_MAX_LEN;
+	}
 
-		p = strchr(p, ',')+1;
-		if (',' != *p) {
-			if (p[0] == 'W') longitudeDegrees *= -1.0;
-			if (p[0] == 'W') lon = 'W';
-			else if (p[0] == 'E') lon = 'E';
-			else if (p[0] == ',') lon = 0;
-			else return ESP_FAIL;
+	for (i = 0; i < len; i++) {
+		ch = 0;
+		for (b = 0; b < 5; b++) {
+			ch <<= 1;
+			if (even) {
+				mid = (lon_lo + lon_hi) / 2;
+				if (lon_e7 >= mid) { ch |= 1; lon_lo = mid; } else { lon_hi = mid; }
+			}
+			else {
+				mid = (lat_lo + lat_hi) / 2;
+				if (lat_e7 >= mid) { ch |= 1; lat_lo = mid; } else { lat_hi = mid; }
+			}
+			even = !even;
 		}
+		out[i] = base32[ch];
+	}
+	out[len] = '\0';
 
-		p = strchr(p, ',')+1;
-		if (',' != *p) fixquality = atoi(p);
-		p = strchr(p, ',')+1;
-		if (',' != *p) satellites = atoi(p);
-		p = strchr(p, ',')+1;
-		if (',' != *p) HDOP = atof(p);
-		p = strchr(p, ',')+1;
-		if (',' != *p) altitude = atof(p);
-		p = strchr(p, ',')+1;
-		p = strchr(p, ',')+1;
-		if (',' != *p) geoidheight = atof(p);
-
-		esp_gps.alt 	= altitude;
-		esp_gps.lat 	= latitudeDegrees;
-		esp_gps.lon 	= longitudeDegrees;
-		esp_gps.hour 	= hour;
-		esp_gps.min 	= minute;
-		esp_gps.sec 	= seconds;
-
-		return ESP_OK;
-	}
-
-	if (strstr(nmea, "$GPRMC")) {
-		// found RMC
-		char *p = nmea;
-
-		// get time
-		p = strchr(p, ',')+1;
-		float timef = atof(p);
-		uint32_t time = timef;
-		hour = time / 10000;
-		minute = (time % 10000) / 100;
-		seconds = (time % 100);
-		milliseconds = fmod(timef, 1.0) * 1000;
-
-		p = strchr(p, ',')+1;
-		if (p[0] == 'A') fix = true;
-		else if (p[0] == 'V') fix = false;
-		else return ESP_FAIL;
-
-		// parse out latitude
-		p = strchr(p, ',')+1;
-		if (',' != *p) {
-			strncpy(degreebuff, p, 2);
-			p += 2;
-			degreebuff[2] = '\0';
-			long degree = atol(degreebuff) * 10000000;
-			strncpy(degreebuff, p, 2); // minutes
-			p += 3; // skip decimal point
-			strncpy(degreebuff + 2, p, 4);
-			degreebuff[6] = '\0';
-			long minutes = 50 * atol(degreebuff) / 3;
-			latitude_fixed = degree + minutes;
-			latitude = degree / 100000 + minutes * 0.000006F;
-			latitudeDegrees = (latitude - 100 * (int)(latitude / 100)) / 60.0;
-			latitudeDegrees += (int)(latitude / 100);
-		}
+	if (lat_lo_out != NULL) {
+		*lat_lo_out = lat_lo;
+		*lat_hi_out = lat_hi;
+		*lon_lo_out = lon_lo;
+		*lon_hi_out = lon_hi;
+	}
+}
 
-		p = strchr(p, ',')+1;
-		if (',' != *p) {
-		  if (p[0] == 'S') latitudeDegrees *= -1.0;
-		  if (p[0] == 'N') lat = 'N';
-		  else if (p[0] == 'S') lat = 'S';
-		  else if (p[0] == ',') lat = 0;
-		  else return ESP_FAIL;
-		}
+void GPS_Geohash(int32_t lat_e7, int32_t lon_e7, uint8_t len, char *out)
+{
+	geohash(lat_e7, lon_e7, len, out, NULL, NULL, NULL, NULL);
+}
 
-		// parse out longitude
-		p = strchr(p, ',')+1;
-		if (',' != *p) {
-			strncpy(degreebuff, p, 3);
-			p += 3;
-			degreebuff[3] = '\0';
-			degree = atol(degreebuff) * 10000000;
-			strncpy(degreebuff, p, 2); // minutes
-			p += 3; // skip decimal point
-			strncpy(degreebuff + 2, p, 4);
-			degreebuff[6] = '\0';
-			minutes = 50 * atol(degreebuff) / 3;
-			longitude_fixed = degree + minutes;
-			longitude = degree / 100000 + minutes * 0.000006F;
-			longitudeDegrees = (longitude - 100 * (int)(longitude / 100)) / 60.0;
-			longitudeDegrees += (int)(longitude / 100);
+#ifdef CONFIG_GPS_DUTY_CYCLE
+static bool within_radius(int32_t lat_a, int32_t lon_a, int32_t lat_b, int32_t lon_b)
+{
+	const int64_t r = CONFIG_GPS_STILL_RADIUS_M * GPS_E7_PER_M;
+
+	// Longitude degrees are shorter than latitude ones, so this errs towards "moved"
+	return llabs((int64_t)lat_a - lat_b) <= r && llabs((int64_t)lon_a - lon_b) <= r;
+}
+
+static void still_update(int32_t lat_e7, int32_t lon_e7, int32_t mean_lat, int32_t mean_lon)
+{
+	gps_mode_t mode = gps_cfg_status.mode;
+
+	if (mode != still.mode) {
+		still.mode = mode;
+		still.far = 0;
+		still.near = 0;
+		if (mode == GPS_MODE_TRACKING) {
+			still.have_ref = false;
+			still.count = 0;
 		}
+	}
 
-		p = strchr(p, ',')+1;
-		if (',' != *p) {
-			if (p[0] == 'W') longitudeDegrees *= -1.0;
-			if (p[0] == 'W') lon = 'W';
-			else if (p[0] == 'E') lon = 'E';
-			else if (p[0] == ',') lon = 0;
-			else return ESP_FAIL;
+	switch (mode) {
+	case GPS_MODE_TRACKING:
+		if (++still.count < CONFIG_GPS_AVG_WINDOW || gps_win.n < CONFIG_GPS_AVG_WINDOW) {
+			break;
+		}
+		if (still.have_ref && within_radius(mean_lat, mean_lon, still.ref_lat, still.ref_lon)) {
+			xTaskNotify(gps_cfg_task_handle, GPS_CFG_STILL_BIT, eSetBits);
 		}
-		// speed
-		p = strchr(p, ',')+1;
-		if (',' != *p) speed = atof(p);
-
-		// angle
-		p = strchr(p, ',')+1;
-		if (',' != *p) angle = atof(p);
-
-		p = strchr(p, ',')+1;
-		if (',' != *p) {
-		  uint32_t fulldate = atof(p);
-		  day = fulldate / 10000;
-		  month = (fulldate % 10000) / 100;
-		  year = (fulldate % 100);
+		still.ref_lat = mean_lat;
+		still.ref_lon = mean_lon;
+		still.have_ref = true;
+		still.count = 0;
+		break;
+
+	case GPS_MODE_WAKE:
+		if (!within_radius(lat_e7, lon_e7, still.ref_lat, still.ref_lon)) {
+			if (++still.far == GPS_MOVED_FIXES) {
+				xTaskNotify(gps_cfg_task_handle, GPS_CFG_MOVED_BIT, eSetBits);
+			}
 		}
+		else {
+			still.far = 0;
+			if (++still.near == GPS_WAKE_GOOD_FIXES) {
+				xTaskNotify(gps_cfg_task_handle, GPS_CFG_CHECKED_BIT, eSetBits);
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+#endif
+
+/*
+ * Add a fix to the window and refresh esp_gps.smooth. Fixes without a
+ * position solution or with a poor HDOP are left out.
+ */
+static void smooth_update(int32_t lat_e7, int32_t lon_e7, int32_t alt_mm)
+{
+	gps_smooth_t *sm = &esp_gps.smooth;
+	int32_t lat, lon;
+	int64_t m_lat, m_lon;
+
+	if (esp_gps.fix_quality == 0 || esp_gps.hdop > CONFIG_GPS_MAX_HDOP * 10) {
+		return;
+	}
+
+	if (gps_win.n == CONFIG_GPS_AVG_WINDOW) {
+		gps_win.sum_lat -= gps_win.lat[gps_win.head];
+		gps_win.sum_lon -= gps_win.lon[gps_win.head];
+		gps_win.sum_alt -= gps_win.alt[gps_win.head];
+	}
+	else {
+		gps_win.n++;
+	}
+	gps_win.lat[gps_win.head] = lat_e7;
+	gps_win.lon[gps_win.head] = lon_e7;
+	gps_win.alt[gps_win.head] = alt_mm;
+	gps_win.sum_lat += lat_e7;
+	gps_win.sum_lon += lon_e7;
+	gps_win.sum_alt += alt_mm;
+	gps_win.head = (gps_win.head + 1) % CONFIG_GPS_AVG_WINDOW;
+
+	lat = gps_win.sum_lat / gps_win.n;
+	lon = gps_win.sum_lon / gps_win.n;
+	sm->lat = lat / 1e7f;
+	sm->lon = lon / 1e7f;
+	sm->alt = (int32_t)(gps_win.sum_alt / gps_win.n) / 1e3f;
+	sm->n = gps_win.n;
+
+	// Keep the current tag while the mean is within a quarter cell of it
+	m_lat = (tag_lat_hi - tag_lat_lo) / 4;
+	m_lon = (tag_lon_hi - tag_lon_lo) / 4;
+	if (sm->geohash[0] == '\0' ||
+		lat < tag_lat_lo - m_lat || lat > tag_lat_hi + m_lat ||
+		lon < tag_lon_lo - m_lon || lon > tag_lon_hi + m_lon) {
+		geohash(lat, lon, CONFIG_GPS_GEOHASH_PRECISION, sm->geohash,
+				&tag_lat_lo, &tag_lat_hi, &tag_lon_lo, &tag_lon_hi);
+	}
+
+#ifdef CONFIG_GPS_DUTY_CYCLE
+	still_update(lat_e7, lon_e7, lat, lon);
+#endif
+}
+
+/*
+ * $--GGA,hhmmss.sss,ddmm.mmmm,N,dddmm.mmmm,W,fix,sats,hdop,alt,M,geoid,M,,*hh
+ */
+static esp_err_t parse_gga(const nmea_sentence_t *s)
+{
+	uint8_t hour = 0, min = 0, sec = 0;
+	uint16_t ms;
+	int32_t lat_e7, lon_e7, alt_mm = 0, quality = 0, sats = 0, hdop = 9999;
 
-		esp_gps.day   = day;
-		esp_gps.month = month;
-		esp_gps.year  = year;
-		esp_gps.hour  = hour;
-		esp_gps.min   = minute;
-		esp_gps.sec   = seconds;
+	nmea_parse_time(nmea_field(s, 1), &hour, &min, &sec, &ms);
+	if (parse_position(s, 2, &lat_e7, &lon_e7) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	nmea_parse_fixed(nmea_field(s, 6), 0, &quality);
+	nmea_parse_fixed(nmea_field(s, 7), 0, &sats);
+	nmea_parse_fixed(nmea_field(s, 8), 2, &hdop);
+	nmea_parse_fixed(nmea_field(s, 9), 3, &alt_mm);
+
+	esp_gps.lat_e7 	= lat_e7;
+	esp_gps.lon_e7 	= lon_e7;
+	esp_gps.lat 	= lat_e7 / 1e7f;
+	esp_gps.lon 	= lon_e7 / 1e7f;
+	esp_gps.alt 	= alt_mm / 1e3f;
+	esp_gps.hour 	= hour;
+	esp_gps.min 	= min;
+	esp_gps.sec 	= sec;
+	esp_gps.fix_quality = (quality > 0 && quality < 256) ? quality : 0;
+	esp_gps.sats 	= (sats > 0 && sats < 256) ? sats : 0;
+	esp_gps.hdop 	= (hdop >= 0 && hdop < 9999) ? hdop : 9999;
+	esp_gps.source 	= GPS_SRC_GGA;
+
+	smooth_update(lat_e7, lon_e7, alt_mm);
+	return ESP_OK;
+}
 
-		if (year < 80) {
-			LED_SetEventBit(LED_EVENT_GPS_RTC_SET_BIT);
+/*
+ * $--RMC,hhmmss.sss,A,ddmm.mmmm,N,dddmm.mmmm,W,speed,course,ddmmyy,,,A*hh
+ * Only the date and time are taken from RMC, position comes from GGA.
+ * With a valid fix (status A) the time also disciplines the device clock.
+ */
+static esp_err_t parse_rmc(const nmea_sentence_t *s)
+{
+	const nmea_field_t *status = nmea_field(s, 2);
+	uint8_t hour = 0, min = 0, sec = 0, day = 0, month = 0, year = 0;
+	uint16_t ms = 0;
+	int32_t lat_e7, lon_e7;
+	int64_t now_us = esp_timer_get_time(), utc_ms;
+	esp_err_t time_err;
+
+	time_err = nmea_parse_time(nmea_field(s, 1), &hour, &min, &sec, &ms);
+	if (status->len == 0 || (status->p[0] != 'A' && status->p[0] != 'V')) {
+		return ESP_FAIL;
+	}
+	if (parse_position(s, 3, &lat_e7, &lon_e7) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	if (nmea_parse_date(nmea_field(s, 9), &day, &month, &year) == ESP_OK &&
+		time_err == ESP_OK && status->p[0] == 'A' && year < 80) {
+		utc_ms = TIME_EpochMs(2000 + year, month, day, hour, min, sec, ms);
+		if (utc_ms >= 0) {
+			TIME_Discipline(utc_ms, now_us, TIME_SRC_GPS);
 		}
+	}
+
+	esp_gps.day   = day;
+	esp_gps.month = month;
+	esp_gps.year  = year;
+	esp_gps.hour  = hour;
+	esp_gps.min   = min;
+	esp_gps.sec   = sec;
+	esp_gps.source = GPS_SRC_RMC;
 
-		return ESP_OK;
+	if (year < 80) {
+		LED_SetEventBit(LED_EVENT_GPS_RTC_SET_BIT);
 	}
 
-	return ESP_FAIL;
+	return ESP_OK;
 }
 
+/*
+ * $PMTK001,cmd,flag	ack, passed to the configuration task
+ * $PMTK010,001		the module has (re)started with default settings
+ */
+static esp_err_t parse_pmtk(const nmea_sentence_t *s)
+{
+	const nmea_field_t *addr = nmea_field(s, 0);
+	nmea_field_t type = { addr->p + 4, 3 };
+	int32_t t, a, b;
+	pmtk_ack_t ack;
+
+	if (nmea_parse_fixed(&type, 0, &t) != ESP_OK ||
+		nmea_parse_fixed(nmea_field(s, 1), 0, &a) != ESP_OK) {
+		return ESP_FAIL;
+	}
 
+	if (t == 1 && nmea_parse_fixed(nmea_field(s, 2), 0, &b) == ESP_OK) {
+		ack.cmd = a;
+		ack.flag = b;
+		xQueueSend(gps_ack_queue, &ack, 0);
+	}
+	else if (t == 10 && a == 1) {
+		ESP_LOGW(TAG, "module restarted");
+		gps_cfg_status.resets++;
+		xTaskNotify(gps_cfg_task_handle, GPS_CFG_APPLY_BIT, eSetBits);
+	}
+	return ESP_ERR_NOT_FOUND;
+}
 
 /*
- * Read a Hex value and return the decimal equivalent
+ * Tokenize and check one sentence, then hand it to the GGA, RMC or PMTK parser.
+ * Any talker ID is accepted ($GP, $GN, ...).
  */
-uint8_t parseHex(char c) {
-	if (c <  '0') return 0;
-	if (c <= '9') return c - '0';
-	if (c <  'A') return 0;
-	if (c <= 'F') return (c - 'A') + 10;
-	return 0;
+static esp_err_t parse(const char *nmea, size_t len)
+{
+	static nmea_sentence_t s;
+
+	if (nmea_tokenize(nmea, len, &s) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	if (nmea_is(&s, "GGA")) {
+		return parse_gga(&s);
+	}
+	if (nmea_is(&s, "RMC")) {
+		return parse_rmc(&s);
+	}
+	if (s.f[0].len == 7 && memcmp(s.f[0].p, "PMTK", 4) == 0) {
+		return parse_pmtk(&s);
+	}
+	return ESP_FAIL;
+}
+
+esp_err_t GPS_SetProfile(const gps_profile_t *profile)
+{
+	if (profile == NULL || profile->fix_ms < 100 || profile->fix_ms > 10000) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (gps_cfg_task_handle == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	xQueueOverwrite(gps_profile_queue, profile);
+	xTaskNotify(gps_cfg_task_handle, GPS_CFG_APPLY_BIT, eSetBits);
+	return ESP_OK;
+}
+
+void GPS_ConfigStatus(gps_cfg_status_t *status)
+{
+	*status = gps_cfg_status;
+}
+
+int GPS_StatusJson(char *buf, size_t len)
+{
+	static const char *modes[] = { "tracking", "standby", "wake" };
+	gps_cfg_status_t st;
+	esp_gps_t gps;
+	int64_t next_s = 0;
+
+	GPS_ConfigStatus(&st);
+	GPS_Poll(&gps);
+	if (st.next_wake_us != 0) {
+		next_s = (st.next_wake_us - esp_timer_get_time()) / 1000000;
+		if (next_s < 0) {
+			next_s = 0;
+		}
+	}
+
+	return snprintf(buf, len,
+			"\"gps\":{\"mode\":\"%s\",\"next_s\":%lld,\"wakes\":%u,\"fix_ms\":%u,\"applied\":%s,"
+			"\"fix\":%u,\"sats\":%u,\"hdop\":%u.%02u,\"age_s\":%d}",
+			modes[st.mode], next_s, st.wakes, st.profile.fix_ms, st.applied ? "true" : "false",
+			gps.fix_quality, gps.sats, gps.hdop / 100, gps.hdop % 100,
+			(gps.age_ms == UINT32_MAX) ? -1 : (int)(gps.age_ms / 1000));
 }
 
 void GPS_Tx(const char *pmtk)
@@ -401,15 +778,14 @@ void GPS_Tx(const char *pmtk)
 	ESP_LOGI(TAG, "Wrote packet to GPS");
 }
 
+/*
+ * Consistent copy of the newest fix, with age_ms filled in. If nothing
+ * new arrived the previous fix is returned again, older.
+ */
 void GPS_Poll(esp_gps_t* gps)
 {
-	gps->alt   = esp_gps.alt;
-	gps->lat   = esp_gps.lat;
-	gps->lon   = esp_gps.lon;
-	gps->year  = esp_gps.year;
-	gps->month = esp_gps.month;
-	gps->day   = esp_gps.day;
-	gps->hour  = esp_gps.hour;
-	gps->min   = esp_gps.min;
-	gps->sec   = esp_gps.sec;
+	seqlock_read(&gps_snap, gps);
+
+	gps->age_ms = (gps->pos_ts_us != 0) ?
+					(esp_timer_get_time() - gps->pos_ts_us) / 1000 : UINT32_MAX;
 }
@@ -3,16 +3,149 @@
  *
  *  Created on: Nov 13, 2018
  *      Author: Thomas Becnel
+ *
+ *  Measurements run in the background: a periodic timer triggers a
+ *  conversion, a one-shot timer reads it back once the conversion time has
+ *  passed, and HDC1080_Poll() returns the newest result without touching
+ *  the bus. The timer callbacks only notify hdc_task, which does the
+ *  transfers through the shared bus (i2cbus_if.h) and is the single writer
+ *  of hdc_snap, so the timer service task never waits on the bus.
  */
 
 #include <stdlib.h>
 #include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "hdc1080_if.h"
-#include "driver/i2c.h"
+#include "i2cbus_if.h"
+#include "seqlock.h"
+
+#define HDC1080_I2C_TIMEOUT_MS	50
+
+#if defined(CONFIG_HDC1080_RES_11)
+#define HDC1080_CONF_RES		(HDC1080_CONF_TRES_11 | HDC1080_CONF_HRES_11)
+#define HDC1080_CONV_US			(3650 + 3850)
+#else
+#define HDC1080_CONF_RES		0
+#define HDC1080_CONV_US			(6350 + 6500)
+#endif
+
+/* A result older than this many periods is reported as stale */
+#define HDC1080_STALE_PERIODS	3
+
+#define HDC_START_BIT			BIT0	/* period elapsed: start a conversion */
+#define HDC_READ_BIT			BIT1	/* conversion time elapsed: read it */
+
+typedef struct {
+	int16_t temp_c100;		/* 0.01 degC */
+	uint16_t hum_p100;		/* 0.01 %RH */
+	int64_t ts_us;			/* esp_timer time of the read, 0 if none yet */
+	esp_err_t err;			/* outcome of the last attempt */
+	uint32_t errors;		/* failed attempts since boot */
+} hdc1080_result_t;
 
 static const char *TAG = "HDC1080";
 
+SEQLOCK_DEFINE(hdc_snap, hdc1080_result_t);
+static hdc1080_result_t hdc_last;		/* hdc_task's working copy */
+static TaskHandle_t hdc_task_handle;
+static TimerHandle_t hdc_start_timer;
+static TimerHandle_t hdc_read_timer;
+static i2cbus_dev_t *hdc_dev;
+
+static void hdc_publish(esp_err_t err)
+{
+	hdc_last.err = err;
+	if (err != ESP_OK) {
+		hdc_last.errors++;
+	}
+	seqlock_write(&hdc_snap, &hdc_last);
+}
+
+/*
+ * Datasheet conversion in integer math:
+ *   T = raw / 2^16 * 165 - 40 degC,  RH = raw / 2^16 * 100 %
+ * in hundredths, rounded to nearest.
+ */
+void HDC1080_Convert(uint16_t raw_t, uint16_t raw_h, int16_t *temp_c100, uint16_t *hum_p100)
+{
+	*temp_c100 = (int16_t)((((uint32_t) raw_t * 16500 + 0x8000) >> 16) - 4000);
+	*hum_p100  = (uint16_t)(((uint32_t) raw_h * 10000 + 0x8000) >> 16);
+}
+
+/*
+ * The conversion is done, read temperature then humidity
+ */
+static void hdc_read(void)
+{
+	uint8_t data[4];
+	esp_err_t ret;
+
+	ret = I2CBUS_Transfer(hdc_dev, NULL, 0, data, sizeof(data));
+	if (ret != ESP_OK) {
+		ESP_LOGW(TAG, "Couldn't read measurement");
+		hdc_publish(ret);
+		return;
+	}
+
+	HDC1080_Convert((data[0] << 8) | data[1], (data[2] << 8) | data[3],
+					&hdc_last.temp_c100, &hdc_last.hum_p100);
+	hdc_last.ts_us = esp_timer_get_time();
+	hdc_publish(ESP_OK);
+}
+
+/*
+ * Point at the temperature register, which starts a combined temperature
+ * and humidity conversion, and schedule the read.
+ */
+static void hdc_start(void)
+{
+	const uint8_t reg = HDC1080_TEMP_REG;
+	esp_err_t ret;
+
+	ret = I2CBUS_Transfer(hdc_dev, &reg, 1, NULL, 0);
+	if (ret != ESP_OK) {
+		ESP_LOGW(TAG, "Couldn't start measurement");
+		hdc_publish(ret);
+		return;
+	}
+	xTimerStart(hdc_read_timer, 0);
+}
+
+static void hdc_task(void *pvParameters)
+{
+	uint32_t bits;
+
+	for (;;) {
+		bits = 0;
+		xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+
+		// A read still pending goes first so its conversion isn't restarted
+		if (bits & HDC_READ_BIT) {
+			hdc_read();
+		}
+		if (bits & HDC_START_BIT) {
+			hdc_start();
+		}
+	}
+}
+
+/*
+ * Timer callbacks run in the timer service task: hand off, never block
+ */
+static void hdc_read_callback(TimerHandle_t xTimer)
+{
+	xTaskNotify(hdc_task_handle, HDC_READ_BIT, eSetBits);
+}
+
+static void hdc_start_callback(TimerHandle_t xTimer)
+{
+	xTaskNotify(hdc_task_handle, HDC_START_BIT, eSetBits);
+}
+
 /*
  *
  */
@@ -20,78 +153,62 @@ esp_err_t HDC1080_Initialize(void)
 {
 	esp_err_t ret;
 	uint16_t hdc1080_conf = 0;
+	uint8_t buf[3];
 
-	i2c_config_t conf;
-    conf.mode = I2C_MODE_MASTER;
-    conf.sda_io_num = I2C_MASTER_SDA_GPIO;
-    conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.scl_io_num = I2C_MASTER_SCL_GPIO;
-    conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.master.clk_speed = I2C_MASTER_FREQ_HZ;
     hdc1080_conf |= HDC1080_CONF_COMB;				// Configure HDC1080 to read both T&H in one go
+    hdc1080_conf |= HDC1080_CONF_RES;
 
-    i2c_param_config(I2C_NUM_1, &conf);
-    i2c_driver_install(I2C_NUM_1, conf.mode, 0, 0, 0);
+    ret = I2CBUS_Initialize();
+    if (ret != ESP_OK) {
+    	return ret;
+    }
+    hdc_dev = I2CBUS_AddDevice(HDC1080_DEV_ADDR, TAG, I2CBUS_PRIO_LOW, HDC1080_I2C_TIMEOUT_MS);
+    if (hdc_dev == NULL) {
+    	return ESP_ERR_NO_MEM;
+    }
 
     // Write the initial configuration
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, (HDC1080_DEV_ADDR << 1) | I2C_MASTER_WRITE, ACK_CHECK_EN);
-	i2c_master_write_byte(cmd, HDC1080_CONF_ADDR, ACK_CHECK_EN);
-	i2c_master_write_byte(cmd, (hdc1080_conf >> 8), ACK_CHECK_EN);		// Send MSB
-	i2c_master_write_byte(cmd, (hdc1080_conf & 0xff), ACK_CHECK_EN);	// Send LSB
-	i2c_master_stop(cmd);
-	ret = i2c_master_cmd_begin(I2C_NUM_1, cmd, 1000 / portTICK_RATE_MS);
-	i2c_cmd_link_delete(cmd);
+    buf[0] = HDC1080_CONF_ADDR;
+    buf[1] = hdc1080_conf >> 8;						// MSB
+    buf[2] = hdc1080_conf & 0xff;					// LSB
+    ret = I2CBUS_Transfer(hdc_dev, buf, sizeof(buf), NULL, 0);
 	if (ret != ESP_OK) {
 		ESP_LOGI(TAG, "Couldn't configure HDC1080");
 	}else {
 		ESP_LOGI(TAG, "HDC1080 was properly configured");
 	}
+
+	// The read fires one tick late at worst, never early
+	hdc_read_timer = xTimerCreate("hdc_read", pdMS_TO_TICKS(HDC1080_CONV_US / 1000) + 1,
+								  pdFALSE, NULL, hdc_read_callback);
+	hdc_start_timer = xTimerCreate("hdc_start", pdMS_TO_TICKS(CONFIG_HDC1080_PERIOD_S * 1000),
+								   pdTRUE, NULL, hdc_start_callback);
+	if (hdc_read_timer == NULL || hdc_start_timer == NULL ||
+		xTaskCreate(hdc_task, "hdc_task", 2048, NULL, 5, &hdc_task_handle) != pdPASS) {
+		return ESP_ERR_NO_MEM;
+	}
+	xTimerStart(hdc_start_timer, 0);
+
 	return ret;
 }
 
 /*
- *
+ * Newest background measurement; never waits on the bus
  */
 esp_err_t HDC1080_Poll(double *temp, double *hum)
 {
-	uint8_t data[4];
-    esp_err_t ret;
-
-    // 1. Start measurement by writing Temperature Address (0x00) into Pointer Register (0x02)
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, HDC1080_DEV_ADDR << 1 | I2C_MASTER_WRITE, ACK_CHECK_EN); 	// 7-bit Serial Bus Address Byte (0x40) + WRITE BIT (0)
-    i2c_master_write_byte(cmd, HDC1080_TEMP_REG, ACK_CHECK_EN);					 			// Send Temp Addr to Pointer Register Byte
-    i2c_master_stop(cmd);																	// Send the Stop Bit
-    ret = i2c_master_cmd_begin(I2C_NUM_1, cmd, 1000 / portTICK_RATE_MS);
-    if (ret != ESP_OK) {
-		ESP_LOGW(TAG, "Couldn't start measurement");
-		return ret;
+	hdc1080_result_t r;
+
+	seqlock_read(&hdc_snap, &r);
+
+	if (r.ts_us == 0) {
+		return (r.err != ESP_OK) ? r.err : ESP_ERR_NOT_FOUND;
 	}
-    i2c_cmd_link_delete(cmd);
-
-    // 2. Wait for the measurement to complete
-    vTaskDelay(100 / portTICK_RATE_MS);
-
-    // 3. Read the data from Temperature (0x00) then Humidity (0x01)
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (HDC1080_DEV_ADDR << 1) | I2C_MASTER_READ, ACK_CHECK_EN);	// 7-bit Serial Bus Address Byte (0x40) + READ BIT (1)
-    i2c_master_read_byte(cmd, &data[0], ACK_VAL);	// Read Temperature MSB and Master ACK
-    i2c_master_read_byte(cmd, &data[1], ACK_VAL);	// Read Temperature LSB and Master ACK
-    i2c_master_read_byte(cmd, &data[2], ACK_VAL);	// Read Humidity MSB and Master ACK
-    i2c_master_read_byte(cmd, &data[3], NACK_VAL);	// Read Humidity LSB and Master NACK
-    i2c_master_stop(cmd);							// Send the Stop Bit
-    ret = i2c_master_cmd_begin(I2C_NUM_1, cmd, 1000 / portTICK_RATE_MS); // Send the commands
-    i2c_cmd_link_delete(cmd);
-    if (ret != ESP_OK) {
-		ESP_LOGW(TAG, "Couldn't read measurement");
-		return ret;
+	if (esp_timer_get_time() - r.ts_us > HDC1080_STALE_PERIODS * CONFIG_HDC1080_PERIOD_S * 1000000LL) {
+		return ESP_ERR_TIMEOUT;
 	}
-    *temp = ((double)(data[0] * 256 + data[1]) / 0x10000) * 165 - 40;
-    *hum  = ((double)(data[2] * 256 + data[3]) / 0x10000) * 100;
 
-    return ret;
+	*temp = r.temp_c100 / 100.0;
+	*hum  = r.hum_p100 / 100.0;
+	return ESP_OK;
 }
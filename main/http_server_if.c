@@ -59,6 +59,8 @@ function to process requests, decode URLs, serve files, etc. etc.
 
 #include "http_server_if.h"
 #include "wifi_manager.h"
+#include "gps_if.h"
+#include "pm_if.h"
 
 
 EventGroupHandle_t http_server_event_group;
@@ -198,9 +200,22 @@ void http_server_netconn_serve(struct netconn *conn) {
 			else if(strstr(line, "GET /status.json ")){
 				if(wifi_manager_lock_json_buffer(( TickType_t ) 10)){
 					char *buff = wifi_manager_get_ip_info_json();
-					if(buff){
+					char *end = buff ? strrchr(buff, '}') : NULL;
+					if(end){
+						/* the wifi object, with the GPS and PM status added as its last members */
+						char gps_json[GPS_STATUS_JSON_SIZE];
+						char pm_json[PM_STATUS_JSON_SIZE];
+						GPS_StatusJson(gps_json, sizeof(gps_json));
+						PMS_StatusJson(pm_json, sizeof(pm_json));
 						netconn_write(conn, http_ok_json_no_cache_hdr, sizeof(http_ok_json_no_cache_hdr) - 1, NETCONN_NOCOPY);
-						netconn_write(conn, buff, strlen(buff), NETCONN_NOCOPY);
+						netconn_write(conn, buff, end - buff, NETCONN_NOCOPY);
+						if (end - buff > 1) {
+							netconn_write(conn, ",", 1, NETCONN_NOCOPY);
+						}
+						netconn_write(conn, gps_json, strlen(gps_json), NETCONN_COPY);
+						netconn_write(conn, ",", 1, NETCONN_NOCOPY);
+						netconn_write(conn, pm_json, strlen(pm_json), NETCONN_COPY);
+						netconn_write(conn, "}\n", 2, NETCONN_NOCOPY);
 						wifi_manager_unlock_json_buffer();
 					}
 					else{
@@ -231,6 +246,16 @@ void http_server_netconn_serve(struct netconn *conn) {
 				wifi_manager_unlock_json_buffer();
 			}
 
+			else if(strstr(line, "POST /measure.json ")) {
+				/* wake a sleeping PM sensor for a measurement window now */
+				if(PMS_Measure() == ESP_OK){
+					netconn_write(conn, http_ok_json_no_cache_hdr, sizeof(http_ok_json_no_cache_hdr) - 1, NETCONN_NOCOPY); /* 200 ok */
+				}
+				else{
+					netconn_write(conn, http_503_hdr, sizeof(http_503_hdr) - 1, NETCONN_NOCOPY);
+				}
+			}
+
 			else if(strstr(line, "DELETE /connect.json ")) {
 				/* request a disconnection from wifi and forget about it */
 				wifi_manager_disconnect_async();
@@ -0,0 +1,267 @@
+/*
+ * i2cbus_if.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "driver/i2c.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "i2cbus_if.h"
+
+#define I2CBUS_PORT			I2C_NUM_1
+
+struct i2cbus_dev {
+	uint8_t addr;
+	const char *name;
+	i2cbus_prio_t prio;
+	int64_t timeout_us;
+	SemaphoreHandle_t lock;		/* one transfer per device at a time */
+	SemaphoreHandle_t done;		/* given by the bus task when the slot is finished */
+	bool busy;					/* slot still owned by the bus task, under lock */
+
+	/* transfer slot, owned by the bus task between submit and done */
+	uint8_t wr[I2CBUS_MAX_XFER];
+	size_t wr_len;
+	uint8_t rd[I2CBUS_MAX_XFER];
+	size_t rd_len;
+	int64_t submit_us;
+	esp_err_t result;
+
+	/* bus task only */
+	uint64_t lat_sum_us;
+	i2cbus_stats_t stats;
+};
+
+static const char *TAG = "I2CBUS";
+
+static i2cbus_dev_t devices[I2CBUS_MAX_DEVICES];
+static uint8_t n_devices;
+static SemaphoreHandle_t devices_lock;
+
+static QueueHandle_t bus_queue[I2CBUS_PRIO_HIGH + 1];
+static SemaphoreHandle_t bus_work;			/* one count per queued transfer */
+
+
+/*
+ * Device timeout in ticks, rounded up
+ */
+static TickType_t dev_ticks(const i2cbus_dev_t *dev)
+{
+	return dev->timeout_us / 1000 / portTICK_RATE_MS + 1;
+}
+
+static esp_err_t bus_run(i2cbus_dev_t *dev)
+{
+	esp_err_t ret;
+	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+
+	if (cmd == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	if (dev->wr_len > 0) {
+		i2c_master_start(cmd);
+		i2c_master_write_byte(cmd, (dev->addr << 1) | I2C_MASTER_WRITE, ACK_CHECK_EN);
+		i2c_master_write(cmd, dev->wr, dev->wr_len, ACK_CHECK_EN);
+	}
+	if (dev->rd_len > 0) {
+		i2c_master_start(cmd);
+		i2c_master_write_byte(cmd, (dev->addr << 1) | I2C_MASTER_READ, ACK_CHECK_EN);
+		if (dev->rd_len > 1) {
+			i2c_master_read(cmd, dev->rd, dev->rd_len - 1, ACK_VAL);
+		}
+		i2c_master_read_byte(cmd, dev->rd + dev->rd_len - 1, NACK_VAL);
+	}
+	i2c_master_stop(cmd);
+
+	ret = i2c_master_cmd_begin(I2CBUS_PORT, cmd, dev_ticks(dev));
+	i2c_cmd_link_delete(cmd);
+	return ret;
+}
+
+static void i2cbus_task(void *pvParameters)
+{
+	i2cbus_dev_t *dev;
+	int64_t lat;
+
+	for (;;) {
+		xSemaphoreTake(bus_work, portMAX_DELAY);
+
+		if (xQueueReceive(bus_queue[I2CBUS_PRIO_HIGH], &dev, 0) != pdTRUE &&
+			xQueueReceive(bus_queue[I2CBUS_PRIO_LOW], &dev, 0) != pdTRUE) {
+			continue;
+		}
+
+		if (esp_timer_get_time() - dev->submit_us > dev->timeout_us) {
+			dev->result = ESP_ERR_TIMEOUT;
+			dev->stats.timeouts++;
+		}
+		else {
+			dev->result = bus_run(dev);
+			dev->stats.transfers++;
+			if (dev->result != ESP_OK) {
+				dev->stats.errors++;
+			}
+		}
+
+		lat = esp_timer_get_time() - dev->submit_us;
+		dev->lat_sum_us += lat;
+		if (lat > dev->stats.lat_max_us) {
+			dev->stats.lat_max_us = lat;
+		}
+		dev->stats.lat_avg_us = dev->lat_sum_us / (dev->stats.transfers + dev->stats.timeouts);
+
+		xSemaphoreGive(dev->done);
+	}
+}
+
+/*
+ * Ticks left of limit since start, 0 once it has passed
+ */
+static TickType_t remaining(TickType_t start, TickType_t limit)
+{
+	TickType_t spent = xTaskGetTickCount() - start;
+
+	return (spent < limit) ? limit - spent : 0;
+}
+
+esp_err_t I2CBUS_Initialize(void)
+{
+	esp_err_t err;
+	i2c_config_t conf;
+
+	if (bus_work != NULL) {
+		return ESP_OK;
+	}
+
+	conf.mode = I2C_MODE_MASTER;
+	conf.sda_io_num = I2C_MASTER_SDA_GPIO;
+	conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
+	conf.scl_io_num = I2C_MASTER_SCL_GPIO;
+	conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
+	conf.master.clk_speed = I2C_MASTER_FREQ_HZ;
+
+	err = i2c_param_config(I2CBUS_PORT, &conf);
+	if (err != ESP_OK) {
+		return err;
+	}
+	err = i2c_driver_install(I2CBUS_PORT, conf.mode, 0, 0, 0);
+	if (err != ESP_OK) {
+		return err;
+	}
+
+	// Each device has at most one transfer queued, so the queues never fill
+	bus_queue[I2CBUS_PRIO_LOW] = xQueueCreate(I2CBUS_MAX_DEVICES, sizeof(i2cbus_dev_t *));
+	bus_queue[I2CBUS_PRIO_HIGH] = xQueueCreate(I2CBUS_MAX_DEVICES, sizeof(i2cbus_dev_t *));
+	devices_lock = xSemaphoreCreateMutex();
+	bus_work = xSemaphoreCreateCounting(I2CBUS_MAX_DEVICES, 0);
+	if (bus_queue[I2CBUS_PRIO_LOW] == NULL || bus_queue[I2CBUS_PRIO_HIGH] == NULL ||
+		devices_lock == NULL || bus_work == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	xTaskCreate(i2cbus_task, "i2cbus_task", 2048, NULL, 11, NULL);
+	return ESP_OK;
+}
+
+i2cbus_dev_t *I2CBUS_AddDevice(uint8_t addr, const char *name, i2cbus_prio_t prio, uint32_t timeout_ms)
+{
+	i2cbus_dev_t *dev = NULL;
+
+	if (devices_lock == NULL) {
+		return NULL;
+	}
+
+	xSemaphoreTake(devices_lock, portMAX_DELAY);
+	if (n_devices < I2CBUS_MAX_DEVICES) {
+		dev = &devices[n_devices];
+		memset(dev, 0, sizeof(*dev));
+		dev->addr = addr;
+		dev->name = name;
+		dev->prio = (prio == I2CBUS_PRIO_HIGH) ? I2CBUS_PRIO_HIGH : I2CBUS_PRIO_LOW;
+		dev->timeout_us = timeout_ms * 1000LL;
+		dev->lock = xSemaphoreCreateMutex();
+		dev->done = xSemaphoreCreateBinary();
+		if (dev->lock == NULL || dev->done == NULL) {
+			dev = NULL;
+		}
+		else {
+			n_devices++;
+		}
+	}
+	xSemaphoreGive(devices_lock);
+
+	if (dev == NULL) {
+		ESP_LOGE(TAG, "Couldn't add %s (0x%02x)", name, addr);
+	}
+	return dev;
+}
+
+esp_err_t I2CBUS_Transfer(i2cbus_dev_t *dev, const uint8_t *wr, size_t wr_len, uint8_t *rd, size_t rd_len)
+{
+	TickType_t start = xTaskGetTickCount(), limit;
+	esp_err_t ret;
+
+	if (dev == NULL || (wr_len == 0 && rd_len == 0)) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (wr_len > I2CBUS_MAX_XFER || rd_len > I2CBUS_MAX_XFER) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	// Queue wait plus the transfer itself, each bounded by the device timeout
+	limit = 2 * dev_ticks(dev) + 1;
+
+	if (xSemaphoreTake(dev->lock, limit) != pdTRUE) {
+		return ESP_ERR_TIMEOUT;
+	}
+
+	// A transfer given up on earlier may still be with the bus task
+	if (dev->busy) {
+		if (xSemaphoreTake(dev->done, remaining(start, limit)) != pdTRUE) {
+			xSemaphoreGive(dev->lock);
+			return ESP_ERR_TIMEOUT;
+		}
+		dev->busy = false;
+	}
+
+	memcpy(dev->wr, wr, wr_len);
+	dev->wr_len = wr_len;
+	dev->rd_len = rd_len;
+	dev->submit_us = esp_timer_get_time();
+	dev->busy = true;
+	// Never full: a device has at most one transfer queued
+	xQueueSend(bus_queue[dev->prio], &dev, 0);
+	xSemaphoreGive(bus_work);
+
+	if (xSemaphoreTake(dev->done, remaining(start, limit)) == pdTRUE) {
+		dev->busy = false;
+		ret = dev->result;
+		if (ret == ESP_OK) {
+			memcpy(rd, dev->rd, rd_len);
+		}
+	}
+	else {
+		// The slot stays busy; the buffers are the device's own, so the bus
+		// task can still finish it after we're gone
+		ret = ESP_ERR_TIMEOUT;
+	}
+
+	xSemaphoreGive(dev->lock);
+
+	if (ret != ESP_OK) {
+		ESP_LOGD(TAG, "%s: %s", dev->name, esp_err_to_name(ret));
+	}
+	return ret;
+}
+
+void I2CBUS_GetStats(const i2cbus_dev_t *dev, i2cbus_stats_t *stats)
+{
+	*stats = dev->stats;
+}
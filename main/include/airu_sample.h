@@ -0,0 +1,92 @@
+/*
+ * airu_sample.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  One timestamped measurement from every sensor on the board. This is the
+ *  record that travels between the acquisition, aggregation, serialization
+ *  and sink stages in pipeline_if.c.
+ */
+
+#ifndef MAIN_INCLUDE_AIRU_SAMPLE_H_
+#define MAIN_INCLUDE_AIRU_SAMPLE_H_
+
+#include <stdint.h>
+#include "stats.h"
+
+#define AIRU_GEOHASH_LEN	13		/* geohash tag incl. NUL */
+#define AIRU_PN_BINS		6		/* particle count bins, as PM_PN_BINS */
+
+/*
+ * Validity bitmap. A field whose bit is clear holds whatever the driver
+ * returned on failure and must not be trusted.
+ */
+typedef enum {
+	AIRU_FIELD_POS		= (1 << 0),		/*!< alt, lat, lon */
+	AIRU_FIELD_DATE		= (1 << 1),		/*!< year, month, day (UTC, from utc_ms) */
+	AIRU_FIELD_TIME		= (1 << 2),		/*!< hour, min, sec (UTC, from utc_ms) */
+	AIRU_FIELD_PM		= (1 << 3),		/*!< pm1, pm2_5, pm10 and their _atm */
+	AIRU_FIELD_TEMP		= (1 << 4),		/*!< temp */
+	AIRU_FIELD_HUM		= (1 << 5),		/*!< hum */
+	AIRU_FIELD_CO		= (1 << 6),		/*!< co */
+	AIRU_FIELD_NOX		= (1 << 7),		/*!< nox */
+	AIRU_FIELD_STATS	= (1 << 8),		/*!< stats; also closes the publish window */
+	AIRU_FIELD_PN		= (1 << 9),		/*!< pn, PMS5003/7003 only */
+} airu_field_t;
+
+/*
+ * Channels with window statistics. PM is summarized over every frame in
+ * the window, the others over the samples.
+ */
+typedef enum {
+	AIRU_STAT_PM1 = 0,
+	AIRU_STAT_PM2_5,
+	AIRU_STAT_PM10,
+	AIRU_STAT_TEMP,
+	AIRU_STAT_HUM,
+	AIRU_STAT_CO,
+	AIRU_STAT_NOX,
+	AIRU_STAT_COUNT
+} airu_stat_t;
+
+typedef struct {
+	int64_t ts_us;			/*!< monotonic esp_timer time of acquisition */
+	int64_t utc_ms;			/*!< UTC epoch ms of ts_us from the device clock, -1 if unset */
+	uint32_t valid;			/*!< airu_field_t bitmap */
+
+	/* GPS */
+	float alt;
+	float lat;
+	float lon;
+	uint8_t year;
+	uint8_t month;
+	uint8_t day;
+	uint8_t hour;
+	uint8_t min;
+	uint8_t sec;
+	char geohash[AIRU_GEOHASH_LEN];	/*!< location tag, "" if unknown */
+
+	/* PMS */
+	uint32_t pm_count;		/*!< number of PM frames behind pm1/pm2_5/pm10 */
+	float pm1;				/*!< CF=1 (standard particle) */
+	float pm2_5;
+	float pm10;
+	float pm1_atm;			/*!< atmospheric environment */
+	float pm2_5_atm;
+	float pm10_atm;
+	uint32_t pn_count;		/*!< number of PM frames behind pn */
+	float pn[AIRU_PN_BINS];	/*!< particles > 0.3, 0.5, 1, 2.5, 5, 10 um per 0.1 L */
+
+	/* HDC1080 */
+	double temp;
+	double hum;
+
+	/* MICS-4514 */
+	int co;
+	int nox;
+
+	/* Publish window, only on the sample that closes it */
+	stats_summary_t stats[AIRU_STAT_COUNT];
+} airu_sample_t;
+
+#endif /* MAIN_INCLUDE_AIRU_SAMPLE_H_ */
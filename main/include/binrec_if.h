@@ -0,0 +1,112 @@
+/*
+ * binrec_if.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Compact binary form of the SD card data rows. All fields are little
+ *  endian. Every value is stored as an integer at the resolution the CSV
+ *  row prints it with, so tools/bin2csv.py reproduces SD_HDR rows exactly.
+ *
+ *  Daily data file YY-MM-DD.bin:
+ *    binrec_file_hdr_t, device ID (NUL terminated), topic (NUL terminated),
+ *    then binrec_t records back to back.
+ *
+ *  Daily index file YY-MM-DD.idx:
+ *    binrec_idx_hdr_t, then one binrec_idx_t for every
+ *    CONFIG_SD_BIN_INDEX_INTERVAL records. Keys only grow within a dated
+ *    file, so a time range lookup is a binary search over the index
+ *    followed by a short scan.
+ */
+
+#ifndef MAIN_INCLUDE_BINREC_IF_H_
+#define MAIN_INCLUDE_BINREC_IF_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "airu_sample.h"
+
+#define BINREC_MAGIC			0x42524941	/* "AIRB" */
+#define BINREC_IDX_MAGIC		0x49524941	/* "AIRI" */
+#define BINREC_VERSION			1
+#define BINREC_SYNC				0xA55A
+#define BINREC_TOD_NONE			0xFFFFFFFF	/* no GPS date, CSV falls back to uptime */
+#define BINREC_NAN				INT32_MIN	/* value the CSV would not print as a number */
+#define BINREC_NAN16			INT16_MIN
+#define BINREC_HDR_MAX_LEN		128
+
+typedef struct __attribute__((packed)) {
+	uint32_t magic;				/*!< BINREC_MAGIC */
+	uint16_t version;			/*!< BINREC_VERSION */
+	uint16_t hdr_len;			/*!< bytes before the first record */
+	uint16_t rec_len;			/*!< sizeof(binrec_t) */
+	uint16_t index_interval;	/*!< records per index entry */
+} binrec_file_hdr_t;
+
+typedef struct __attribute__((packed)) {
+	uint16_t sync;				/*!< BINREC_SYNC */
+	uint16_t valid;				/*!< airu_field_t bitmap */
+	uint32_t uptime;			/*!< SecActive, s */
+	uint32_t tod;				/*!< GPS time of day, s, or BINREC_TOD_NONE */
+	int32_t alt;				/*!< 0.01 m */
+	int32_t lat;				/*!< 0.0001 deg */
+	int32_t lon;				/*!< 0.0001 deg */
+	int32_t pm1;				/*!< 0.01 ug/m3 */
+	int32_t pm2_5;				/*!< 0.01 ug/m3 */
+	int32_t pm10;				/*!< 0.01 ug/m3 */
+	int16_t temp;				/*!< 0.01 C */
+	int16_t hum;				/*!< 0.01 % */
+	int32_t co;
+	int32_t nox;
+} binrec_t;
+
+typedef struct __attribute__((packed)) {
+	uint32_t magic;				/*!< BINREC_IDX_MAGIC */
+	uint16_t version;			/*!< BINREC_VERSION */
+	uint16_t entry_len;			/*!< sizeof(binrec_idx_t) */
+} binrec_idx_hdr_t;
+
+typedef struct __attribute__((packed)) {
+	uint32_t key;				/*!< tod of the record, or uptime if it has none */
+	uint32_t offset;			/*!< byte offset of the record in the .bin file */
+} binrec_idx_t;
+
+/*
+* @brief	Build the data file header. Must be called before
+* 			BINREC_Header().
+*
+* @param	id: 	device ID (MAC)
+* @param	topic: 	MQTT topic, kept for the CSV topic column
+*
+* @return	ESP_OK, or ESP_ERR_INVALID_SIZE if the strings don't fit
+*/
+esp_err_t BINREC_Initialize(const char *id, const char *topic);
+
+/*
+* @brief	Data file header built by BINREC_Initialize()
+*
+* @param	len: set to the header length
+*
+* @return	the header bytes
+*/
+const void *BINREC_Header(size_t *len);
+
+/*
+* @brief	Index file header
+*/
+const binrec_idx_hdr_t *BINREC_IndexHeader(void);
+
+/*
+* @brief	Convert a record to its binary form
+*/
+void BINREC_Encode(const airu_sample_t *s, binrec_t *rec);
+
+/*
+* @brief	Index key of a record: GPS time of day if known, else uptime
+*/
+static inline uint32_t BINREC_Key(const binrec_t *rec)
+{
+	return (rec->tod != BINREC_TOD_NONE) ? rec->tod : rec->uptime;
+}
+
+#endif /* MAIN_INCLUDE_BINREC_IF_H_ */
@@ -0,0 +1,76 @@
+/*
+ * encoder_if.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Formats an airu_sample_t as an InfluxDB line and an SD card CSV row in
+ *  a single pass, into caller provided buffers. No heap, no printf on the
+ *  normal path.
+ *
+ *  Influx line:
+ *    <measurement>,ID=<mac>,SensorModel=H2+<version>[,Geohash=<tag>] SecActive=<u>,Altitude=<.2f>,
+ *    Latitude=<.4f>,Longitude=<.4f>,PM1=<.2f>,PM2.5=<.2f>,PM10=<.2f>,
+ *    Temperature=<.2f>,Humidity=<.2f>,CO=<d>,NO=<d>[,<pm>][,<stats>][ <timestamp>]
+ *
+ *  The Geohash tag is only sent with a valid position (AIRU_FIELD_POS).
+ *  The timestamp is utc_ms in CONFIG_INFLUX_TIMESTAMP_* precision, left
+ *  out while the device clock is unset.
+ *
+ *  PM1/PM2.5/PM10 are the CF=1 values. With valid PM, <pm> adds the
+ *  atmospheric environment values PM1_atm, PM2.5_atm and PM10_atm (.2f),
+ *  and on a PMS5003/7003 the particle counts per 0.1 L PN0.3, PN0.5,
+ *  PN1, PN2.5, PN5 and PN10 (.1f).
+ *
+ *  With CONFIG_INFLUX_STATS each channel with at least two values in the
+ *  publish window adds <field>_sd, _min, _max, _p50 and _p95, e.g.
+ *  PM2.5_sd=1.25,...,PM2.5_p95=14.00. The CSV row doesn't change.
+ *
+ *  CSV row (columns as in SD_HDR):
+ *    <time>,<mac>,<topic>,<SecActive>,<Altitude>,...,<CO>,<NO>\n
+ */
+
+#ifndef MAIN_INCLUDE_ENCODER_IF_H_
+#define MAIN_INCLUDE_ENCODER_IF_H_
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "airu_sample.h"
+
+#define ENC_TAGS_LEN	128		/* escaped measurement + tag set */
+#define ENC_CSV_LEN		256		/* longest CSV row */
+
+/*
+* @brief	Escape the measurement name and tag values once and keep them for
+* 			every later call to ENC_Encode(). Must be called before encoding.
+*
+* @param	measurement: Influx measurement name
+* @param	id: 		 device ID tag (MAC)
+* @param	model: 		 firmware version, appended to "H2+"
+* @param	topic: 		 MQTT topic, written into the CSV row
+*
+* @return	ESP_OK, or ESP_ERR_INVALID_SIZE if the escaped tags don't fit
+*/
+esp_err_t ENC_Initialize(const char *measurement, const char *id, const char *model, const char *topic);
+
+/*
+* @brief	Encode one record. Either output may be NULL.
+*
+* @param	s: 			the record
+* @param	line: 		Influx line destination, NUL terminated, no newline
+* @param	line_size: 	size of line
+* @param	csv: 		CSV row destination, NUL terminated, newline included
+* @param	csv_size: 	size of csv
+*
+* @return	ESP_OK, or ESP_ERR_INVALID_SIZE if an output was truncated
+*/
+esp_err_t ENC_Encode(const airu_sample_t *s, char *line, size_t line_size, char *csv, size_t csv_size);
+
+/*
+* @brief	Write v with exactly 'decimals' digits after the point, rounding
+* 			half away from zero. dst needs room for 24 characters.
+*
+* @return	number of characters written (no NUL)
+*/
+size_t enc_fmt_fixed(char *dst, double v, unsigned decimals);
+
+#endif /* MAIN_INCLUDE_ENCODER_IF_H_ */
@@ -8,6 +8,10 @@
 #ifndef MAIN_INCLUDE_GPS_IF_H_
 #define MAIN_INCLUDE_GPS_IF_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
 /**************************************************************************/
 /**
  Different commands to set the update rate from once a second (1 Hz) to 10 times a second (10Hz)
@@ -61,21 +65,121 @@
 
 /**************************************************************************/
 
+#define GPS_GEOHASH_MAX_LEN		12
+
+/*
+ * Mean of the last CONFIG_GPS_AVG_WINDOW good fixes (fix quality > 0 and
+ * HDOP within CONFIG_GPS_MAX_HDOP), and a geohash of it for use as a tag.
+ * The geohash only changes once the mean moves a quarter cell beyond the
+ * current cell, so a unit sitting on a cell edge doesn't flip between two.
+ */
+typedef struct {
+	float lat;
+	float lon;
+	float alt;
+	uint16_t n;			/* fixes in the window, 0 if there has been no good fix */
+	char geohash[GPS_GEOHASH_MAX_LEN + 1];
+} gps_smooth_t;
+
+/* Sentence that last updated an esp_gps_t */
+typedef enum {
+	GPS_SRC_NONE = 0,
+	GPS_SRC_GGA,		/* position, altitude, time, fix quality */
+	GPS_SRC_RMC,		/* date and time */
+} gps_source_t;
+
 typedef struct {
 	float lat;
 	float lon;
 	float alt;
+	int32_t lat_e7;		/* lat in 1e-7 degree, lat is derived from this */
+	int32_t lon_e7;		/* lon in 1e-7 degree */
+	uint8_t fix_quality;	/* GGA fix quality, 0 = no fix */
+	uint8_t sats;
+	uint16_t hdop;		/* HDOP * 100 */
+	gps_smooth_t smooth;
 	uint8_t year;
 	uint8_t month;
 	uint8_t day;
 	uint8_t hour;
 	uint8_t min;
 	uint8_t sec;
+	int64_t ts_us;		/* esp_timer time of the sentence that produced this fix */
+	int64_t pos_ts_us;	/* esp_timer time of the last GGA, 0 if none yet */
+	int64_t date_ts_us;	/* esp_timer time of the last RMC, 0 if none yet */
+	uint8_t source;		/* gps_source_t of the last sentence */
+	uint32_t age_ms;	/* set by GPS_Poll(): time since the last GGA, UINT32_MAX if none */
 } esp_gps_t;
 
+/*
+ * Receiver settings applied by the configuration task. Output is always
+ * limited to RMC and GGA, the only sentences parsed.
+ */
+typedef struct {
+	uint16_t fix_ms;	/* fix and output interval, 100..10000 */
+	bool sbas;			/* SBAS search; the module only honours it at 1 Hz or faster */
+} gps_profile_t;
+
+typedef enum {
+	GPS_MODE_TRACKING = 0,	/* running continuously */
+	GPS_MODE_STANDBY,		/* stationary, module in standby until next_wake_us */
+	GPS_MODE_WAKE,			/* stationary, awake to check time and position */
+} gps_mode_t;
+
+#define GPS_STATUS_JSON_SIZE	192
+
+typedef struct {
+	gps_profile_t profile;	/* last profile sent */
+	gps_mode_t mode;
+	int64_t next_wake_us;	/* esp_timer time of the next wake (standby) or of
+							   the wake timeout (wake), 0 when tracking */
+	uint32_t wakes;			/* wake checks started */
+	bool applied;			/* every command of it was acknowledged */
+	uint32_t retries;		/* commands resent after a timeout or failure ack */
+	uint32_t failures;		/* commands given up on */
+	uint32_t resets;		/* module restarts seen ($PMTK010,001) */
+} gps_cfg_status_t;
+
 esp_err_t GPS_Initialize(void);
+
+/*
+* @brief	Ask the configuration task to apply a profile. Returns at once;
+* 			the task sends each command, waits for its PMTK001 ack and
+* 			retries, and applies the profile again if the module resets.
+*
+* @return	ESP_OK, ESP_ERR_INVALID_ARG, or ESP_ERR_INVALID_STATE before
+* 			GPS_Initialize()
+*/
+esp_err_t GPS_SetProfile(const gps_profile_t *profile);
+
+/*
+* @brief	Profile state and ack counters
+*/
+void GPS_ConfigStatus(gps_cfg_status_t *status);
+
+/*
+* @brief	Power mode, wake schedule and fix status as one JSON object
+* 			member: "gps":{...}
+*
+* @return	length written, as snprintf
+*/
+int GPS_StatusJson(char *buf, size_t len);
+
+/*
+* @brief	Copy the newest fix. Safe against the UART task updating it
+* 			at the same time: the copy is always one coherent fix.
+*/
 void GPS_Poll(esp_gps_t* gps);
 void GPS_Tx(const char*);
 
+/*
+* @brief	Geohash of a position
+*
+* @param	lat_e7, lon_e7: position in 1e-7 degree
+* @param	len: 			number of characters, 1..GPS_GEOHASH_MAX_LEN
+* @param	out: 			len + 1 bytes
+*/
+void GPS_Geohash(int32_t lat_e7, int32_t lon_e7, uint8_t len, char *out);
+
 
 #endif /* MAIN_INCLUDE_GPS_IF_H_ */
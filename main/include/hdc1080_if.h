@@ -9,21 +9,34 @@
 #define MAIN_HDC1080_IF_H_
 
 #include "esp_system.h"
+#include "i2cbus_if.h"
 
-#define I2C_MASTER_SCL_GPIO		27			/*!< gpio number for I2C master clock */
-#define I2C_MASTER_SDA_GPIO		26			/*!< gpio number for I2C master data  */
-#define I2C_MASTER_FREQ_HZ		100000		/*!< I2C master clock frequency */
 #define HDC1080_CONF_COMB		(1<<12)		/*!< HDC Configure Read Temp & Hum in one shot */
+#define HDC1080_CONF_TRES_11	(1<<10)		/*!< Temperature resolution 11 bit (default 14) */
+#define HDC1080_CONF_HRES_11	(1<<8)		/*!< Humidity resolution 11 bit (default 14) */
 #define HDC1080_DEV_ADDR		0x40        /*!< slave address for HDC1080 sensor */
 #define HDC1080_CONF_ADDR		0x02        /*!< HDC1080 configuration register */
 #define HDC1080_TEMP_REG		0x00		/*!< HDC1080 Temperature Register */
 #define HDC1080_HUM_REG			0x01		/*!< HDC1080 Humidity Register */
-#define ACK_CHECK_EN			0x1			/*!< I2C master will check ack from slave*/
-#define ACK_CHECK_DIS			0x0			/*!< I2C master will not check ack from slave */
-#define ACK_VAL					0x0			/*!< I2C ack value */
-#define NACK_VAL				0x1			/*!< I2C nack value */
 
+/*
+* @brief	Configure the sensor and start measuring every
+* 			CONFIG_HDC1080_PERIOD_S in the background
+*/
 esp_err_t HDC1080_Initialize(void);
+
+/*
+* @brief	Newest background measurement. Doesn't block.
+*
+* @return	ESP_OK, ESP_ERR_NOT_FOUND before the first measurement, the bus
+* 			error if there has never been a good one, or ESP_ERR_TIMEOUT if
+* 			the newest is older than 3 periods
+*/
 esp_err_t HDC1080_Poll(double *temp, double *hum);
 
+/*
+* @brief	Raw register values to 0.01 degC and 0.01 %RH
+*/
+void HDC1080_Convert(uint16_t raw_t, uint16_t raw_h, int16_t *temp_c100, uint16_t *hum_p100);
+
 #endif /* MAIN_HDC1080_IF_H_ */
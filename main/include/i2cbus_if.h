@@ -0,0 +1,89 @@
+/*
+ * i2cbus_if.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Owner of the I2C port. Drivers register their device once and then
+ *  call I2CBUS_Transfer(); a single bus task runs the transfers one at a
+ *  time, high priority devices first. A transfer that waited in the queue
+ *  longer than its device's timeout is dropped with ESP_ERR_TIMEOUT
+ *  instead of being run late.
+ *
+ *  Each device has one transfer slot, so a device never has more than one
+ *  transfer queued and nothing is allocated per transfer on this side. The
+ *  slot holds its own copy of the data, so a caller that gave up waiting
+ *  leaves nothing behind that the bus task could still write to.
+ *  The IDF v3.3 command link is still built per transfer: the driver
+ *  consumes it while running, so it can't be replayed.
+ */
+
+#ifndef MAIN_INCLUDE_I2CBUS_IF_H_
+#define MAIN_INCLUDE_I2CBUS_IF_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define I2C_MASTER_SCL_GPIO		27			/*!< gpio number for I2C master clock */
+#define I2C_MASTER_SDA_GPIO		26			/*!< gpio number for I2C master data  */
+#define I2C_MASTER_FREQ_HZ		100000		/*!< I2C master clock frequency */
+#define ACK_CHECK_EN			0x1			/*!< I2C master will check ack from slave*/
+#define ACK_CHECK_DIS			0x0			/*!< I2C master will not check ack from slave */
+#define ACK_VAL					0x0			/*!< I2C ack value */
+#define NACK_VAL				0x1			/*!< I2C nack value */
+
+#define I2CBUS_MAX_DEVICES		8
+#define I2CBUS_MAX_XFER			8			/*!< bytes per direction in one transfer */
+
+typedef enum {
+	I2CBUS_PRIO_LOW = 0,
+	I2CBUS_PRIO_HIGH,
+} i2cbus_prio_t;
+
+typedef struct {
+	uint32_t transfers;		/*!< transfers run */
+	uint32_t errors;		/*!< transfers the bus or device failed */
+	uint32_t timeouts;		/*!< transfers dropped after waiting too long */
+	uint32_t lat_avg_us;	/*!< mean submit to completion time */
+	uint32_t lat_max_us;	/*!< worst submit to completion time */
+} i2cbus_stats_t;
+
+typedef struct i2cbus_dev i2cbus_dev_t;
+
+/*
+* @brief	Install the I2C driver on I2C_NUM_1 and start the bus task.
+* 			Safe to call more than once.
+*/
+esp_err_t I2CBUS_Initialize(void);
+
+/*
+* @brief	Register a device
+*
+* @param	addr: 		7 bit address
+* @param	name: 		for logs, not copied
+* @param	prio: 		queue priority of its transfers
+* @param	timeout_ms: longest a transfer may wait for the bus, and the
+* 						limit on the transfer itself
+*
+* @return	the device, or NULL if the table is full or the bus isn't up
+*/
+i2cbus_dev_t *I2CBUS_AddDevice(uint8_t addr, const char *name, i2cbus_prio_t prio, uint32_t timeout_ms);
+
+/*
+* @brief	Write wr, then read rd after a repeated start, in one
+* 			transaction. Either part may be empty, neither longer than
+* 			I2CBUS_MAX_XFER. Blocks for at most twice the device timeout
+* 			plus a tick; not for use from an ISR.
+*
+* @return	ESP_OK, ESP_ERR_TIMEOUT if it waited too long for the bus or
+* 			the bus task, ESP_ERR_INVALID_SIZE, or the driver's error
+*/
+esp_err_t I2CBUS_Transfer(i2cbus_dev_t *dev, const uint8_t *wr, size_t wr_len, uint8_t *rd, size_t rd_len);
+
+/*
+* @brief	Counters for one device. Each counter is read atomically, the
+* 			set as a whole may straddle a transfer.
+*/
+void I2CBUS_GetStats(const i2cbus_dev_t *dev, i2cbus_stats_t *stats);
+
+#endif /* MAIN_INCLUDE_I2CBUS_IF_H_ */
@@ -0,0 +1,89 @@
+/*
+ * log_ring.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Lock-free multi-producer / single-consumer ring of variable length
+ *  records. Any number of tasks may reserve space, fill it in place and
+ *  commit it; one task drains committed records in order.
+ *
+ *  Producers claim space by a compare-and-swap on head and never wait on
+ *  each other. Each record starts with a header whose seq word is stored
+ *  last, with release semantics; the consumer only accepts a record once
+ *  seq equals its ring position, so stale bytes from an earlier lap are
+ *  never mistaken for a finished record. A producer that is preempted
+ *  between reserve and commit only holds back the consumer, not the other
+ *  producers.
+ */
+
+#ifndef MAIN_INCLUDE_LOG_RING_H_
+#define MAIN_INCLUDE_LOG_RING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define LOG_RING_ALIGN		8
+#define LOG_RING_MAX_LEN	0xFFF0		/* longest single record */
+
+typedef struct {
+	uint8_t *buf;				/*!< storage, size bytes, LOG_RING_ALIGN aligned */
+	uint32_t size;				/*!< power of two */
+	volatile uint32_t head;		/*!< free running reserve index (producers) */
+	volatile uint32_t tail;		/*!< free running read index (consumer) */
+	volatile uint32_t dropped;	/*!< reservations refused because the ring was full */
+} log_ring_t;
+
+/* A reservation, filled in by log_ring_reserve() */
+typedef struct {
+	void *data;					/*!< where to write the record */
+	size_t len;					/*!< bytes reserved at data */
+	void *hdr;
+	uint32_t pos;
+} log_ring_slot_t;
+
+/*
+* @brief	Initialize a ring over caller provided storage
+*
+* @param	r: 			ring descriptor
+* @param	storage: 	size bytes, aligned to LOG_RING_ALIGN
+* @param	size: 		power of two, 64 to 65536
+*
+* @return	ESP_OK, or ESP_ERR_INVALID_ARG
+*/
+esp_err_t log_ring_init(log_ring_t *r, void *storage, uint32_t size);
+
+/*
+* @brief	Claim room for a len byte record. Never blocks.
+*
+* @param	r: 		ring descriptor
+* @param	len: 	record length
+* @param	slot: 	filled in on success
+*
+* @return	true on success, false (and dropped++) if the ring is full
+*/
+bool log_ring_reserve(log_ring_t *r, size_t len, log_ring_slot_t *slot);
+
+/*
+* @brief	Hand a filled reservation to the consumer
+*
+* @param	slot: 	from log_ring_reserve()
+* @param	len: 	bytes actually written, at most slot->len
+*/
+void log_ring_commit(log_ring_t *r, const log_ring_slot_t *slot, size_t len);
+
+/*
+* @brief	Copy committed records, back to back, into dst. Consumer only.
+* 			Stops at the first uncommitted record or when the next record
+* 			doesn't fit.
+*
+* @param	r: 		ring descriptor
+* @param	dst: 	destination
+* @param	size: 	size of dst
+*
+* @return	bytes copied
+*/
+size_t log_ring_drain(log_ring_t *r, void *dst, size_t size);
+
+#endif /* MAIN_INCLUDE_LOG_RING_H_ */
@@ -0,0 +1,85 @@
+/*
+ * log_rotate.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Size capped ring of log files. Files are named from a printf format
+ *  with the slot number (e.g. "/sdcard/LOGGING-%02d.log"); a small pointer
+ *  file records which slot is current. Rotating truncates the next slot
+ *  and moves the pointer: the same two small file operations whatever
+ *  the file count, and no renames.
+ *
+ *  Crash safety: the next slot is emptied before the pointer moves, and
+ *  the pointer file holds two checksummed copies written alternately.
+ *  A crash at any point leaves either the old or the new slot current,
+ *  never a slot with someone else's data.
+ *
+ *  Disk use is bounded by count * (max_size + the largest single write).
+ *
+ *  Not thread safe: one task owns the log_rotate_t.
+ */
+
+#ifndef MAIN_INCLUDE_LOG_ROTATE_H_
+#define MAIN_INCLUDE_LOG_ROTATE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define LOG_ROTATE_NAME_LEN		40
+
+typedef struct {
+	const char *fmt;			/*!< file name format, one %d for the slot */
+	const char *ptr_path;		/*!< pointer file */
+	uint8_t count;				/*!< number of slots */
+	uint32_t max_size;			/*!< bytes per slot before rotating */
+
+	uint8_t slot;				/*!< current slot */
+	uint32_t seq;				/*!< pointer write sequence */
+	uint32_t size;				/*!< bytes in the current slot */
+	uint32_t rotations;			/*!< rotations since init */
+	FILE *f;
+	char name[LOG_ROTATE_NAME_LEN];
+} log_rotate_t;
+
+/*
+* @brief	Load the current slot from the pointer file (slot 0 if there is
+* 			none) and measure it. Doesn't open anything.
+*
+* @param	lr: 		state
+* @param	fmt: 		file name format with one integer conversion
+* @param	ptr_path: 	pointer file path
+* @param	count: 		number of files, 2..100
+* @param	max_size: 	bytes per file
+*
+* @return	ESP_OK, or ESP_ERR_INVALID_ARG
+*/
+esp_err_t log_rotate_init(log_rotate_t *lr, const char *fmt, const char *ptr_path,
+							uint8_t count, uint32_t max_size);
+
+/*
+* @brief	Append to the current file, rotating first if the data would
+* 			take it past max_size. A single write larger than max_size
+* 			still goes into one file.
+*
+* @return	ESP_OK, or ESP_FAIL if the file couldn't be opened or written
+*/
+esp_err_t log_rotate_write(log_rotate_t *lr, const void *data, size_t len);
+
+/*
+* @brief	Move to the next slot now
+*/
+esp_err_t log_rotate_next(log_rotate_t *lr);
+
+/*
+* @brief	Push buffered data to the card
+*/
+void log_rotate_flush(log_rotate_t *lr);
+
+/*
+* @brief	Flush and close the current file. The next write reopens it.
+*/
+void log_rotate_close(log_rotate_t *lr);
+
+#endif /* MAIN_INCLUDE_LOG_ROTATE_H_ */
@@ -8,9 +8,67 @@
 #ifndef MAIN_INCLUDE_MICS4514_IF_H_
 #define MAIN_INCLUDE_MICS4514_IF_H_
 
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+	MICS_PHASE_OFF = 0,		/*!< sensor and heater off */
+	MICS_PHASE_PREHEAT,		/*!< heater on, readings not yet stable */
+	MICS_PHASE_SAMPLE,		/*!< heater on, ADC sampling window open */
+} mics4514_phase_t;
+
+/*
+ * Heater schedule. Each period_s starts with preheat_s of heating, then
+ * sample_s of sampling; the heater is off for the rest. period_s 0 keeps
+ * the heater on after the first preheat.
+ */
+typedef struct {
+	uint32_t period_s;
+	uint32_t preheat_s;
+	uint32_t sample_s;
+} mics4514_profile_t;
+
+typedef struct {
+	uint32_t ox_mv;			/*!< filtered OX (NOx) channel voltage */
+	uint32_t red_mv;		/*!< filtered RED (CO) channel voltage */
+	uint32_t ox_ohms;		/*!< OX sensing resistance, UINT32_MAX at 0 mV */
+	uint32_t red_ohms;		/*!< RED sensing resistance */
+	int64_t ts_us;			/*!< esp_timer time of the last filter update */
+	uint32_t updates;		/*!< filter updates since boot */
+	uint32_t window;		/*!< sampling window the values come from */
+	mics4514_phase_t phase;	/*!< heater phase now; not SAMPLE means the values are held */
+} mics4514_data_t;
+
 void MICS4514_GPIOEnable(void);
+
+/*
+* @brief	Set up the ADC and start the heater schedule and the background
+* 			sampling of both channels
+*/
 void MICS4514_Initialize(void);
-void MICS4514_Poll(int *ox_val, int *red_val);
+
+/*
+* @brief	Newest filtered values. Doesn't block or touch the ADC.
+*
+* @return	ESP_OK, ESP_ERR_NOT_FOUND before the first sampling window, or
+* 			ESP_ERR_TIMEOUT if the sampler has stalled
+*/
+esp_err_t MICS4514_Read(mics4514_data_t *data);
+
+/*
+* @brief	Heater phase at t_us into a schedule
+*
+* @param	p: 			the schedule
+* @param	t_us: 		time since the schedule started
+* @param	next_us: 	set to the time of the next phase change,
+* 						INT64_MAX if there is none
+*/
+mics4514_phase_t MICS4514_Phase(const mics4514_profile_t *p, int64_t t_us, int64_t *next_us);
+
+/*
+* @brief	MICS4514_Read() reduced to the two voltages in mV
+*/
+esp_err_t MICS4514_Poll(int *ox_val, int *red_val);
 void MICS4514_Enable(void);
 void MICS4514_Disable(void);
 void MICS4514_HeaterEnable(void);
@@ -8,17 +8,20 @@
 #ifndef MAIN_INCLUDE_MQTT_IF_H_
 #define MAIN_INCLUDE_MQTT_IF_H_
 
-#define MQTT_PKT_LEN 			256
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+#ifdef CONFIG_INFLUX_STATS
+#define MQTT_PKT_LEN 			1024	/* room for the window statistics */
+#else
+#define MQTT_PKT_LEN 			512
+#endif
 #define DATA_WRITE_PERIOD_SEC	60
 
 #define MQTT_DATA_PUB_TOPIC 	CONFIG_MQTT_ROOT_TOPIC "/" CONFIG_MQTT_DATA_PUB_TOPIC	/* I don't know how to concatonate these in kconfig file" */
 #define MQTT_SUB_ALL_TOPIC		CONFIG_MQTT_ROOT_TOPIC "/" CONFIG_MQTT_SUB_ALL_TOPIC
 #define MQTT_ACK_TOPIC_TMPLT	CONFIG_MQTT_ROOT_TOPIC "/ack/%s"
 
-#define MQTT_PKT CONFIG_INFLUX_MEASUREMENT_NAME "\,ID\=%s\,SensorModel\=H2+%s\ SecActive\=%llu\,"\
-				 "Altitude\=%.2f\,Latitude\=%.4f\,Longitude\=%.4f\,PM1\=%.2f\,"\
-				 "PM2.5\=%.2f\,PM10\=%.2f\,Temperature\=%.2f\,Humidity\=%.2f\,CO\=%zu\,NO\=%zu"
-
 /*
 * @brief
 *
@@ -67,6 +70,16 @@ int MQTT_Publish_General(const char* topic, const char* msg, int qos);
 */
 int MQTT_Publish_Data(const char* msg);
 
+bool MQTT_Is_Connected(void);
+
+/*
+* @brief	Batch data records into one publish. See mqtt_if.c. These must
+* 			all be called from the same task.
+*/
+int MQTT_Batch_Add(const char* line);
+int MQTT_Batch_Poll(void);
+int MQTT_Batch_Flush(void);
+
 /*
 * @brief: Prepare data in MQTT format
 *
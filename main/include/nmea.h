@@ -0,0 +1,89 @@
+/*
+ * nmea.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Single pass NMEA 0183 tokenizer. The checksum is accumulated while the
+ *  sentence is split, and fields are returned as slices into the caller's
+ *  buffer, nothing is copied. The field parsers work on those slices with
+ *  integer arithmetic only.
+ *
+ *  Coordinates come out as int32 in 1e-7 degree, computed the same way as
+ *  the Adafruit GPS library's latitude_fixed: whole degrees * 1e7 plus
+ *  the minutes, to 4 decimals, * 50 / 3.
+ */
+
+#ifndef MAIN_INCLUDE_NMEA_H_
+#define MAIN_INCLUDE_NMEA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define NMEA_MAX_FIELDS		24		/* address field included */
+
+typedef struct {
+	const char *p;			/*!< first character, not NUL terminated */
+	uint8_t len;			/*!< 0 for an empty field */
+} nmea_field_t;
+
+typedef struct {
+	uint8_t n;				/*!< number of fields, f[0] is the address ("GPGGA") */
+	nmea_field_t f[NMEA_MAX_FIELDS];
+} nmea_sentence_t;
+
+/*
+* @brief	Split a sentence into fields and check it.
+*
+* @param	s: 		sentence, starting at '$'; trailing "\r\n" optional
+* @param	len: 	length of s
+* @param	out: 	fields, pointing into s
+*
+* @return	ESP_OK, ESP_ERR_INVALID_CRC on a checksum mismatch, or ESP_FAIL
+* 			if it isn't a well formed sentence with a checksum
+*/
+esp_err_t nmea_tokenize(const char *s, size_t len, nmea_sentence_t *out);
+
+/*
+* @brief	True if the sentence type (address without the talker ID)
+* 			is 'type', e.g. nmea_is(&s, "GGA") for both $GPGGA and $GNGGA
+*/
+bool nmea_is(const nmea_sentence_t *s, const char *type);
+
+/*
+* @brief	Field i, or an empty field if the sentence is shorter
+*/
+const nmea_field_t *nmea_field(const nmea_sentence_t *s, uint8_t i);
+
+/*
+* @brief	Parse a [d]ddmm.mmmm coordinate and its hemisphere field.
+*
+* @param	val: 		 the coordinate
+* @param	hemi: 		 N/S/E/W, may be empty
+* @param	deg_digits:  2 for latitude, 3 for longitude
+* @param	e7: 		 result in 1e-7 degree, negative for S and W
+*
+* @return	ESP_OK, ESP_ERR_NOT_FOUND if val is empty, ESP_FAIL if malformed
+*/
+esp_err_t nmea_parse_coord(const nmea_field_t *val, const nmea_field_t *hemi, uint8_t deg_digits, int32_t *e7);
+
+/*
+* @brief	Parse hhmmss[.sss]
+*/
+esp_err_t nmea_parse_time(const nmea_field_t *f, uint8_t *hour, uint8_t *min, uint8_t *sec, uint16_t *ms);
+
+/*
+* @brief	Parse ddmmyy
+*/
+esp_err_t nmea_parse_date(const nmea_field_t *f, uint8_t *day, uint8_t *month, uint8_t *year);
+
+/*
+* @brief	Parse a signed decimal into an integer scaled by 10^decimals.
+* 			Extra digits are truncated.
+*
+* @return	ESP_OK, ESP_ERR_NOT_FOUND if empty, ESP_FAIL if malformed
+*/
+esp_err_t nmea_parse_fixed(const nmea_field_t *f, uint8_t decimals, int32_t *out);
+
+#endif /* MAIN_INCLUDE_NMEA_H_ */
@@ -0,0 +1,53 @@
+/*
+ * outbox_if.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Store-and-forward queue for data records that couldn't be published.
+ *  Records are appended to a file on the SD card and replayed, oldest
+ *  first, once the MQTT client is connected again. The read position is
+ *  kept in a separate cursor file so nothing is replayed twice across a
+ *  reboot, short of a crash between a publish and the cursor update.
+ */
+
+#ifndef MAIN_INCLUDE_OUTBOX_IF_H_
+#define MAIN_INCLUDE_OUTBOX_IF_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define OUTBOX_DATA_FILE	"/sdcard/outbox.txt"
+#define OUTBOX_CURSOR_FILE	"/sdcard/outbox.cur"
+
+typedef struct {
+	uint32_t size;			/*!< bytes in the data file */
+	uint32_t cursor;		/*!< offset of the first unsent record */
+	uint32_t appended;		/*!< records appended since boot */
+	uint32_t replayed;		/*!< records replayed since boot */
+	uint32_t rejected;		/*!< records refused because the outbox was full */
+} outbox_stats_t;
+
+/*
+* @brief	Load the cursor and start the replay task. Call after
+* 			SD_Initialize() and MQTT_Initialize().
+*
+* @return	ESP_OK, or ESP_FAIL if the SD card isn't usable: the cursor
+* 			file can't be created or the data file can't be stat'ed. The
+* 			outbox then stays off and OUTBOX_Append() fails.
+*/
+esp_err_t OUTBOX_Initialize(void);
+
+/*
+* @brief	Append newline separated records to the outbox.
+*
+* @param	records: one or more records, separated (not terminated) by '\n'
+* @param	len: 	 length of records
+*
+* @return	ESP_OK, ESP_ERR_NO_MEM if the outbox is full, or ESP_FAIL
+*/
+esp_err_t OUTBOX_Append(const char *records, size_t len);
+
+void OUTBOX_GetStats(outbox_stats_t *stats);
+
+#endif /* MAIN_INCLUDE_OUTBOX_IF_H_ */
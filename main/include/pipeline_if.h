@@ -0,0 +1,96 @@
+/*
+ * pipeline_if.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Data path from the sensors to MQTT and the SD card:
+ *
+ *    data_task --> [sample_q] --> aggregate --> [agg_q] --> serialize --+--> [mqtt_q] --> MQTT sink
+ *                                                                      +--> [sd_q]   --> SD sink
+ *
+ *  Every stage runs in its own task. Hand-offs never block the producer,
+ *  so a slow SD write or a stalled MQTT publish can't delay sampling.
+ */
+
+#ifndef MAIN_INCLUDE_PIPELINE_IF_H_
+#define MAIN_INCLUDE_PIPELINE_IF_H_
+
+#include "esp_err.h"
+#include "airu_sample.h"
+#include "mqtt_if.h"
+#include "binrec_if.h"
+#include "encoder_if.h"
+
+#define PIPELINE_SAMPLE_Q_LEN	8
+#define PIPELINE_AGG_Q_LEN		4
+#define PIPELINE_SINK_Q_LEN		4
+
+/* Number of acquisitions folded into each published record */
+#define PIPELINE_SAMPLES_PER_PUBLISH \
+	((CONFIG_DATA_UPLOAD_PERIOD / CONFIG_DATA_SAMPLE_PERIOD) > 0 ? \
+	 (CONFIG_DATA_UPLOAD_PERIOD / CONFIG_DATA_SAMPLE_PERIOD) : 1)
+
+typedef struct {
+	char line[MQTT_PKT_LEN];
+} pipeline_mqtt_pkt_t;
+
+typedef struct {
+#ifdef CONFIG_SD_DATA_BINARY
+	binrec_t rec;
+#else
+	char row[ENC_CSV_LEN];
+#endif
+	uint8_t year;
+	uint8_t month;
+	uint8_t day;
+} pipeline_sd_pkt_t;
+
+/* Running sums for the aggregation stage */
+typedef struct {
+	uint32_t n;
+	airu_sample_t last;
+	uint32_t valid;
+	uint32_t pm_count;
+	double pm1, pm2_5, pm10;
+	double pm1_atm, pm2_5_atm, pm10_atm;
+	uint32_t pn_count;
+	double pn[AIRU_PN_BINS];
+	uint32_t n_temp, n_hum, n_co, n_nox;
+	double temp, hum;
+	int64_t co, nox;
+} pipeline_agg_t;
+
+typedef struct {
+	uint32_t samples_dropped;	/*!< acquisitions lost because the aggregator fell behind */
+	uint32_t records_dropped;	/*!< aggregated records lost before serialization */
+	uint32_t mqtt_dropped;		/*!< packets lost because the MQTT sink fell behind */
+	uint32_t sd_dropped;		/*!< packets lost because the SD sink fell behind */
+} pipeline_stats_t;
+
+/*
+* @brief	Create the stage queues and tasks. Call before PIPELINE_Submit().
+*
+* @return	ESP_OK, or ESP_ERR_NO_MEM
+*/
+esp_err_t PIPELINE_Initialize(void);
+
+/*
+* @brief	Hand a fresh acquisition to the pipeline. Never blocks.
+*
+* @param	sample: the acquisition, copied into the queue
+*
+* @return	ESP_OK, or ESP_FAIL if the sample queue is full
+*/
+esp_err_t PIPELINE_Submit(const airu_sample_t *sample);
+
+void PIPELINE_GetStats(pipeline_stats_t *stats);
+
+/*
+ * Stage bodies, callable without the tasks (e.g. for benchmarking).
+ */
+void pipeline_agg_reset(pipeline_agg_t *agg);
+void pipeline_agg_add(pipeline_agg_t *agg, const airu_sample_t *s);
+void pipeline_agg_result(const pipeline_agg_t *agg, airu_sample_t *out);
+void pipeline_serialize(const airu_sample_t *s, pipeline_mqtt_pkt_t *mqtt, pipeline_sd_pkt_t *sd);
+
+#endif /* MAIN_INCLUDE_PIPELINE_IF_H_ */
@@ -9,13 +9,21 @@
 #define _PM_IF_H
 
 #include "freertos/queue.h"
+#include <stddef.h>
+#include <stdbool.h>
 #include "esp_err.h"
+#include "stats.h"
 
 #define PM_UART_CH   UART_NUM_2
 #define PM_RXD_PIN   16
 #define PM_TXD_PIN   17
 #define BUF_SIZE     144 // NOTE: Rx_buffer_size should be greater than UART_FIFO_LEN (128 bytes)
-#define PM_PKT_LEN   24
+#define PM_PKT_LEN   24   // PMS3003 frame
+#define PM_PKT_LEN_5003 32   // PMS5003 / PMS7003 frame
+#define PM_HDR_LEN   4    // "BM" + 16 bit frame length
+#define PM_FRAME_MIN_LEN  PM_PKT_LEN
+#define PM_FRAME_MAX_LEN  PM_PKT_LEN_5003
+#define PM_RING_SIZE 256  // Must be a power of two
 #define MAX_PKTS_IN_BUFFER 6
 #define MAX_NUM_PKT  5
 #define TIMEOUT      50
@@ -25,6 +33,11 @@
 #define PKT_PM2_5_LOW   7
 #define PKT_PM10_HIGH   8
 #define PKT_PM10_LOW    9
+#define PKT_ATM_PM1_HIGH   10   // Atmospheric environment, same order
+#define PKT_PN_HIGH        16   // PMS5003/7003: first of the particle count bins
+#define PM_PN_BINS   6    // Particles > 0.3, 0.5, 1.0, 2.5, 5.0, 10 um per 0.1 L
+#define PM_HAMPEL_WIN   9    // Frames in the outlier window, odd
+#define PM_STATUS_JSON_SIZE 224
 //#define PM_SET_PIN    X
 //#define PM_RESET_PIN  X
 
@@ -36,14 +49,22 @@
 * represensted as PM1, PM2.5, PM10 in the documentaion.
 * PM sensor data packets are defined as follows:
 *
-* PM Data is transmitted over UART in 24 byte packets. The first two 
-* bytes are the packet header [0x42 0x4D] or [“BM”] in ASCII. Each piece 
-* of the packet is 2 bytes, with the Most Significant Byte transmitted 
-* first. The final two bytes are the packet checksum and represent a 16 
-* bit (2 byte) number. This number should equal the sum of the first 22 
-* bytes in the packet.
+* PM Data is transmitted over UART in 24 byte (PMS3003) or 32 byte
+* (PMS5003, PMS7003) packets. The first two bytes are the packet header
+* [0x42 0x4D] or [“BM”] in ASCII, followed by the number of bytes left.
+* Each piece of the packet is 2 bytes, with the Most Significant Byte
+* transmitted first:
 *
-* Refer to PMS3003 documentation for more details.
+*   4-9    PM1, PM2.5, PM10, CF=1 (standard particle)
+*   10-15  PM1, PM2.5, PM10, atmospheric environment
+*   16-27  PMS5003/7003 only: particle counts in 0.1 L of air, > 0.3,
+*          0.5, 1.0, 2.5, 5.0 and 10 um
+*
+* The final two bytes are the packet checksum and represent a 16 
+* bit (2 byte) number. This number should equal the sum of every byte
+* before it.
+*
+* Refer to the PMS3003 and PMS5003 documentation for more details.
 */
 typedef struct 
 {
@@ -51,8 +72,67 @@ typedef struct
   float pm1;             // Most recent PM1 samples
   float pm2_5;           // Most recent PM2.5 samples
   float pm10;            // Most recent PM10 samples
+  float pm1_atm;         // Atmospheric environment means
+  float pm2_5_atm;
+  float pm10_atm;
+  uint32_t pn_count;     // Frames behind pn, 0 if the model has no counts
+  float pn[PM_PN_BINS];  // Particle count means
 } pm_data_t;
 
+typedef enum
+{
+  PM_MODEL_UNKNOWN = 0,  // No frame yet
+  PM_MODEL_PMS3003,
+  PM_MODEL_PMS5003,      // Also PMS7003; the frames are the same
+} pm_model_t;
+
+/*
+* @brief  One decoded PM frame, as queued from the UART task to data_task
+*/
+typedef struct
+{
+  int64_t ts_us;         // esp_timer time the frame was decoded
+  uint16_t pm1;
+  uint16_t pm2_5;
+  uint16_t pm10;
+  uint16_t pm1_atm;
+  uint16_t pm2_5_atm;
+  uint16_t pm10_atm;
+  uint16_t pn[PM_PN_BINS];
+  bool has_pn;           // pn was in the frame
+} pm_sample_t;
+
+typedef enum
+{
+  PM_POWER_ON = 0,       // Not duty cycled, always running
+  PM_POWER_SLEEP,        // SET low, fan and laser off
+  PM_POWER_SPINUP,       // Awake, frames discarded while the fan settles
+  PM_POWER_MEASURE,      // Awake, frames accumulated
+} pm_power_t;
+
+typedef enum
+{
+  PM_FRAME_OK = 0,
+  PM_FRAME_OUTLIER,      // Too far from the median of the frames before it
+  PM_FRAME_STUCK,        // Same values for longer than the stuck limit
+} pm_verdict_t;
+
+/*
+* @brief  State of the frame filter that sits between decode and the
+*         sample ring. The window holds the last PM_HAMPEL_WIN frames,
+*         rejected ones included, so a real step change is accepted once
+*         it fills half the window.
+*/
+typedef struct
+{
+  uint16_t win[3][PM_HAMPEL_WIN];   // pm1, pm2_5, pm10, oldest overwritten
+  uint8_t win_len;
+  uint8_t win_next;
+  pm_sample_t run;                  // First frame of the current identical run
+  int64_t stuck_us;                 // Run length that counts as stuck, 0 = never
+  bool stuck;
+} pm_filter_t;
+
 
 /*
 * @brief
@@ -76,6 +156,71 @@ esp_err_t PMS_Initialize();
 
 esp_err_t PMS_Poll(pm_data_t *dat);
 
+/*
+* @brief  Summarize every frame PMS_Poll() has taken in since the last
+*         call and start a new window. Unlike the mean, the window isn't
+*         cut short by data gaps. Call from the same task as PMS_Poll().
+*
+* @param  pm1, pm2_5, pm10 - destinations
+*/
+void PMS_WindowStats(stats_summary_t *pm1, stats_summary_t *pm2_5, stats_summary_t *pm10);
+
+/*
+* @brief  Counters kept by the PM stream parser. Frames are counted once
+*         they pass the header, length and checksum checks.
+*/
+typedef struct
+{
+  uint32_t frames_ok;       // Frames that passed the header, length and checksum checks
+  uint32_t frames_bad;      // Headers found whose checksum didn't match
+  uint32_t bytes_dropped;   // Bytes discarded while hunting for a header
+  uint32_t samples_lost;    // Frames dropped because data_task fell behind
+  uint32_t frames_outlier;  // Good frames rejected by the outlier filter
+  uint32_t frames_stuck;    // Good frames rejected while the sensor looked stuck
+  uint32_t frames_spinup;   // Good frames discarded outside a measurement window
+  bool stuck;               // The sensor is repeating itself right now
+} pm_parse_stats_t;
+
+void PMS_GetParseStats(pm_parse_stats_t *stats);
+
+/*
+* @brief  Sensor model, from the length of the last good frame
+*/
+pm_model_t PMS_Model(void);
+
+/*
+* @brief  Wake a duty cycled sensor now for a measurement window, after
+*         the usual spin-up
+*
+* @return ESP_OK, or ESP_ERR_INVALID_STATE if it isn't asleep
+*/
+esp_err_t PMS_Measure(void);
+
+pm_power_t PMS_PowerState(void);
+
+/*
+* @brief  Parser and filter counters as a JSON member, "pm":{...}
+*
+* @return snprintf() result
+*/
+int PMS_StatusJson(char *buf, size_t len);
+
+/*
+* @brief  Start a frame filter
+*
+* @param  f - the filter
+* @param  stuck_us - identical frames for longer than this are rejected, 0 never
+*/
+void PMS_FilterInit(pm_filter_t *f, int64_t stuck_us);
+
+/*
+* @brief  Judge one decoded frame. Only depends on the frames given to it
+*         before, so it can be run over a recorded trace.
+*
+* @return PM_FRAME_OK if the frame should be accumulated
+*/
+pm_verdict_t PMS_FilterFrame(pm_filter_t *f, const pm_sample_t *s);
+
 void PMS_RESET(uint32_t level);
 void PMS_GPIOEnable();
 void PMS_SET(uint32_t level);
@@ -8,21 +8,54 @@
 #ifndef MAIN_INCLUDE_SD_IF_H_
 #define MAIN_INCLUDE_SD_IF_H_
 
+#include <stdio.h>
+#include <stdbool.h>
 #include "esp_err.h"
 #include "esp_log.h"
+#include "binrec_if.h"
 
+#ifndef SD_MOUNT_POINT
+#define SD_MOUNT_POINT "/sdcard"
+#endif
 #define SD_FILENAME_LENGTH 25
+#define SD_DATA_FILENAME_LEN 32
 #define SD_HDR "time,ID,topic,SecActive,Altitude,Latitude,Longitude,PM1,PM2.5,PM10,Temperature,Humidity,CO,NO\n"
-#define SD_PKT "%s,%s,%s,%llu,%.2f,%.4f,%.4f,%.2f,%.2f,%.2f,%.2f,%.2f,%d,%d\n"
 
 
+/*
+ * Daily data file writer. Keeps the current day's file open, collects
+ * records in RAM and writes them out in one go when the buffer fills,
+ * when the oldest buffered record is CONFIG_SD_WRITE_FLUSH_PERIOD old, or
+ * when the date changes. Not thread safe: use one writer per task.
+ */
+typedef struct {
+	FILE *f;
+	const char *ext;				/* filename extension, e.g. "csv" */
+	const void *hdr;				/* written at the top of new files */
+	size_t hdr_len;
+	uint8_t year, month, day;		/* date of the open file */
+	uint32_t offset;				/* file offset the next record lands at */
+	char name[SD_DATA_FILENAME_LEN];
+	char buf[CONFIG_SD_WRITE_BUFFER_SIZE];
+	size_t len;
+	int64_t first_us;				/* esp_timer time of the oldest buffered record */
+	uint32_t records;				/* records accepted */
+	uint32_t writes;				/* buffer flushes that reached the card */
+} sd_writer_t;
+
+void sd_writer_init(sd_writer_t *w, const char *ext, const void *hdr, size_t hdr_len);
+esp_err_t sd_writer_append(sd_writer_t *w, const void *rec, size_t len, uint8_t year, uint8_t month, uint8_t day);
+esp_err_t sd_writer_poll(sd_writer_t *w);
+esp_err_t sd_writer_flush(sd_writer_t *w);
+void sd_writer_close(sd_writer_t *w);
+
 esp_err_t SD_Initialize(void);
 esp_err_t sd_deinit(void);
 esp_err_t sd_write_data(char* pkt, uint8_t year, uint8_t month, uint8_t day);
-vprintf_like_t esp_sd_log_write(const char* format, va_list ap);
-void periodic_timer_callback(void* arg);
-FILE *getLogFileInstance();
-void releaseLogFileInstance();
+esp_err_t sd_write_bin(const binrec_t *rec, uint8_t year, uint8_t month, uint8_t day);
+esp_err_t sd_flush_data(bool force);
+int esp_sd_log_write(const char* format, va_list ap);
+uint32_t sd_log_dropped(void);
 FILE* sd_fopen(const char* filename);
 
 #endif /* MAIN_INCLUDE_SD_IF_H_ */
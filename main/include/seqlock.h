@@ -0,0 +1,63 @@
+/*
+ * seqlock.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Sequence lock around a fixed size record: one writer task publishes
+ *  whole records, any number of readers take consistent copies. The
+ *  writer never waits. A reader retries if the writer was active during
+ *  its copy, so it always gets one complete record and never a mix of
+ *  two updates.
+ *
+ *  The sequence counter is odd while a write is in progress. A reader
+ *  that keeps colliding with the writer (e.g. a lower priority writer
+ *  preempted mid-copy on the same core) sleeps a tick between attempts
+ *  so the writer can finish.
+ */
+
+#ifndef MAIN_INCLUDE_SEQLOCK_H_
+#define MAIN_INCLUDE_SEQLOCK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SEQLOCK_SPINS		8		/* retries before sleeping */
+
+typedef struct {
+	volatile uint32_t seq;		/*!< even: stable, odd: write in progress */
+	void *data;					/*!< the protected record */
+	size_t size;				/*!< sizeof the record */
+} seqlock_t;
+
+/*
+ * @brief	Define a record and its seqlock in one go
+ *
+ * @param	name: 	name of the seqlock_t variable
+ * @param	type: 	record type
+ */
+#define SEQLOCK_DEFINE(name, type)										\
+	static type name##_data;											\
+	static seqlock_t name = {											\
+		.seq = 0,														\
+		.data = &name##_data,											\
+		.size = sizeof(type)											\
+	}
+
+/*
+* @brief	Publish a new record. Single writer only; never blocks.
+*/
+void seqlock_write(seqlock_t *sl, const void *src);
+
+/*
+* @brief	Copy out a consistent record
+*
+* @return	number of times the copy had to be retried
+*/
+uint32_t seqlock_read(const seqlock_t *sl, void *dst);
+
+/*
+* @brief	Number of records published so far
+*/
+uint32_t seqlock_version(const seqlock_t *sl);
+
+#endif /* MAIN_INCLUDE_SEQLOCK_H_ */
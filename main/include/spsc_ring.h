@@ -0,0 +1,83 @@
+/*
+ * spsc_ring.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Lock-free single-producer / single-consumer ring of fixed size items.
+ *  One task (or ISR) may push and one other task may pop without any
+ *  mutex or critical section. The producer only ever writes head, the
+ *  consumer only ever writes tail, and each index is published with
+ *  release semantics so the item copy is visible before the index moves.
+ */
+
+#ifndef MAIN_INCLUDE_SPSC_RING_H_
+#define MAIN_INCLUDE_SPSC_RING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef struct {
+	uint8_t *buf;				/*!< item storage, capacity * item_size bytes */
+	size_t item_size;			/*!< size of a single item in bytes */
+	uint32_t mask;				/*!< capacity - 1, capacity is a power of two */
+	volatile uint32_t head;		/*!< free running write index (producer) */
+	volatile uint32_t tail;		/*!< free running read index (consumer) */
+	volatile uint32_t dropped;	/*!< pushes refused because the ring was full (producer) */
+} spsc_ring_t;
+
+/*
+ * @brief	Define static storage and a ring descriptor in one go.
+ *
+ * @param	name: 	 name of the spsc_ring_t variable
+ * @param	type: 	 item type
+ * @param	capacity: number of items, must be a power of two
+ */
+#define SPSC_RING_DEFINE(name, type, capacity)							\
+	static type name##_storage[(capacity)];								\
+	static spsc_ring_t name = {											\
+		.buf = (uint8_t *) name##_storage,								\
+		.item_size = sizeof(type),										\
+		.mask = (capacity) - 1											\
+	}
+
+/*
+* @brief	Initialize a ring over caller provided storage
+*
+* @param	r: 			ring descriptor
+* @param	storage:	capacity * item_size bytes
+* @param	item_size:	size of one item
+* @param	capacity:	number of items, must be a power of two
+*
+* @return	ESP_OK, or ESP_ERR_INVALID_ARG if capacity isn't a power of two
+*/
+esp_err_t spsc_ring_init(spsc_ring_t *r, void *storage, size_t item_size, uint32_t capacity);
+
+/*
+* @brief	Copy an item into the ring. Producer side only.
+*
+* @param	r: 		ring descriptor
+* @param	item: 	item to copy in
+*
+* @return	true on success, false (and dropped++) if the ring is full
+*/
+bool spsc_ring_push(spsc_ring_t *r, const void *item);
+
+/*
+* @brief	Copy the oldest item out of the ring. Consumer side only.
+*
+* @param	r: 		ring descriptor
+* @param	item: 	destination, may be NULL to discard
+*
+* @return	true if an item was returned, false if the ring is empty
+*/
+bool spsc_ring_pop(spsc_ring_t *r, void *item);
+
+/*
+* @brief	Number of items waiting. Exact from the consumer side, a lower
+* 			bound from the producer side.
+*/
+uint32_t spsc_ring_count(const spsc_ring_t *r);
+
+#endif /* MAIN_INCLUDE_SPSC_RING_H_ */
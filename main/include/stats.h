@@ -0,0 +1,71 @@
+/*
+ * stats.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Streaming summary of one channel over a window: count, mean and
+ *  variance (Welford), min, max, and the median and 95th percentile
+ *  estimated with the P-square algorithm (Jain & Chlamtac, 1985). Memory
+ *  and update cost are fixed no matter how many values are added.
+ *
+ *  The first STATS_EXACT values are kept sorted and the percentiles are
+ *  exact up to there. The markers are then seeded from those values at
+ *  their quantile positions instead of from the first five, which keeps
+ *  the tail estimate usable in short windows.
+ *
+ *  Not thread safe: a stats_t belongs to one task.
+ */
+
+#ifndef MAIN_INCLUDE_STATS_H_
+#define MAIN_INCLUDE_STATS_H_
+
+#include <stdint.h>
+
+#define STATS_P2_MARKERS	5
+#define STATS_EXACT			16		/* values kept before switching to estimates */
+
+/* One P-square quantile estimator */
+typedef struct {
+	float p;							/*!< quantile, 0..1 */
+	float q[STATS_P2_MARKERS];			/*!< marker heights */
+	int32_t pos[STATS_P2_MARKERS];		/*!< marker positions, 1 based */
+	float want[STATS_P2_MARKERS];		/*!< desired marker positions */
+} stats_p2_t;
+
+typedef struct {
+	uint32_t n;
+	float mean;
+	float m2;				/*!< sum of squared deviations from the mean */
+	float min;
+	float max;
+	float first[STATS_EXACT];	/*!< the first values, sorted */
+	stats_p2_t p50;
+	stats_p2_t p95;
+} stats_t;
+
+typedef struct {
+	uint32_t n;				/*!< values in the window, the rest is 0 if none */
+	float mean;
+	float sd;				/*!< sample standard deviation, 0 below two values */
+	float min;
+	float max;
+	float p50;
+	float p95;
+} stats_summary_t;
+
+/*
+* @brief	Start a new, empty window
+*/
+void stats_reset(stats_t *s);
+
+/*
+* @brief	Add one value to the window
+*/
+void stats_add(stats_t *s, float x);
+
+/*
+* @brief	Summarize the window. Doesn't change it.
+*/
+void stats_get(const stats_t *s, stats_summary_t *out);
+
+#endif /* MAIN_INCLUDE_STATS_H_ */
@@ -6,17 +6,81 @@
  */
 #include <time.h>
 #include <sys/time.h>
+#include <stdint.h>
 
 #ifndef MAIN_INCLUDE_TIME_IF_H_
 #define MAIN_INCLUDE_TIME_IF_H_
 
+/*
+ * Disciplined clock: one UTC clock for the whole device, driven by
+ * esp_timer and corrected from GPS RMC time and from SNTP. GPS wins while
+ * it has reported within CONFIG_TIME_HOLDOVER_S; SNTP is used otherwise.
+ *
+ * The clock never runs backwards. A reference ahead of it is stepped to,
+ * one behind it by less than 30 s is slewed out at 1% of the elapsed time.
+ * Successive references at least 10 minutes apart give a drift estimate
+ * that keeps the clock on time between them (holdover).
+ */
+typedef enum {
+	TIME_SRC_NONE = 0,
+	TIME_SRC_SNTP,
+	TIME_SRC_GPS,
+} time_src_t;
+
+typedef enum {
+	TIME_UNSET = 0,			/* no reference yet */
+	TIME_LOCKED,			/* referenced within CONFIG_TIME_HOLDOVER_S */
+	TIME_HOLDOVER,			/* running on the drift estimate */
+} time_state_t;
+
+typedef struct {
+	time_state_t state;
+	time_src_t src;			/* source of the last reference */
+	int64_t last_sync_us;	/* esp_timer time of the last reference */
+	int32_t last_err_ms;	/* reference minus clock at the last reference */
+	int32_t drift_ppb;		/* esp_timer rate error corrected for */
+	uint32_t syncs;			/* references applied */
+} time_status_t;
 
 /*
-* @brief
+* @brief	Create the clock lock and start following SNTP updates of the
+* 			system time. Call before GPS_Initialize().
+*/
+void TIME_Initialize(void);
+
+/*
+* @brief	Feed a reference: the UTC time that was true at esp_timer time
+* 			mono_us. References closer than a minute to the previous one
+* 			from the same source are ignored.
+*/
+void TIME_Discipline(int64_t utc_ms, int64_t mono_us, time_src_t src);
+
+/*
+* @brief	UTC epoch milliseconds at esp_timer time mono_us
 *
-* @param
+* @return	epoch ms, or -1 if the clock has never been set
+*/
+int64_t TIME_FromMono(int64_t mono_us);
+
+/*
+* @brief	UTC epoch milliseconds now, or -1 if the clock is unset
+*/
+int64_t TIME_NowMs(void);
+
+/*
+* @brief	Epoch milliseconds of a UTC calendar time
 *
-* @return
+* @return	epoch ms, or -1 if a field is out of range
+*/
+int64_t TIME_EpochMs(uint16_t year, uint8_t month, uint8_t day,
+					 uint8_t hour, uint8_t min, uint8_t sec, uint16_t ms);
+
+void TIME_Status(time_status_t *status);
+
+
+/*
+* @brief	Seconds since the UNIX Epoch, from the disciplined clock once
+* 			it is set, else from SNTP
 */
 time_t time_gmtime(void);
 
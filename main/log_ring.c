@@ -0,0 +1,116 @@
+/*
+ * log_ring.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "log_ring.h"
+
+#define RING_LOAD_ACQ(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RING_STORE_REL(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+#define REC_PAD			0xFFFF		/* len of the filler record before a wrap */
+
+typedef struct {
+	volatile uint32_t seq;		/* ring position of this record once committed */
+	uint16_t size;				/* reserved bytes after the header */
+	uint16_t len;				/* bytes used, or REC_PAD */
+} rec_hdr_t;
+
+#define REC_SPAN(n)		((sizeof(rec_hdr_t) + (n) + LOG_RING_ALIGN - 1) & ~(LOG_RING_ALIGN - 1))
+
+esp_err_t log_ring_init(log_ring_t *r, void *storage, uint32_t size)
+{
+	if (r == NULL || storage == NULL || size < 64 || size > 0x10000 || (size & (size - 1)) != 0 ||
+		((uintptr_t) storage & (LOG_RING_ALIGN - 1)) != 0) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	r->buf = storage;
+	r->size = size;
+	r->head = 0;
+	r->tail = 0;
+	r->dropped = 0;
+
+	// No stale header may look committed at position 0
+	((rec_hdr_t *) storage)->seq = ~0u;
+	return ESP_OK;
+}
+
+bool log_ring_reserve(log_ring_t *r, size_t len, log_ring_slot_t *slot)
+{
+	uint32_t pos, off, span, pad;
+	rec_hdr_t *h;
+
+	if (len > LOG_RING_MAX_LEN) {
+		len = LOG_RING_MAX_LEN;
+	}
+	span = REC_SPAN(len);
+
+	pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+	do {
+		off = pos & (r->size - 1);
+		// Records never wrap: fill the end of the buffer and start over
+		pad = (off + span > r->size) ? r->size - off : 0;
+
+		if (pos + pad + span - RING_LOAD_ACQ(&r->tail) > r->size) {
+			__atomic_fetch_add(&r->dropped, 1, __ATOMIC_RELAXED);
+			return false;
+		}
+	} while (!__atomic_compare_exchange_n(&r->head, &pos, pos + pad + span, true,
+											__ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	if (pad > 0) {
+		h = (rec_hdr_t *) &r->buf[off];
+		h->size = pad - sizeof(rec_hdr_t);
+		h->len = REC_PAD;
+		RING_STORE_REL(&h->seq, pos);
+		pos += pad;
+		off = 0;
+	}
+
+	h = (rec_hdr_t *) &r->buf[off];
+	h->size = span - sizeof(rec_hdr_t);
+
+	slot->hdr = h;
+	slot->pos = pos;
+	slot->data = h + 1;
+	slot->len = len;
+	return true;
+}
+
+void log_ring_commit(log_ring_t *r, const log_ring_slot_t *slot, size_t len)
+{
+	rec_hdr_t *h = slot->hdr;
+
+	h->len = (len < slot->len) ? len : slot->len;
+	RING_STORE_REL(&h->seq, slot->pos);
+}
+
+size_t log_ring_drain(log_ring_t *r, void *dst, size_t size)
+{
+	uint32_t tail = r->tail;
+	uint32_t head = RING_LOAD_ACQ(&r->head);
+	size_t n = 0;
+	rec_hdr_t *h;
+
+	while (tail != head) {
+		h = (rec_hdr_t *) &r->buf[tail & (r->size - 1)];
+		if (RING_LOAD_ACQ(&h->seq) != tail) {
+			break;		// still being written
+		}
+		if (h->len != REC_PAD) {
+			if (n + h->len > size) {
+				break;
+			}
+			memcpy((uint8_t *) dst + n, h + 1, h->len);
+			n += h->len;
+		}
+		tail += sizeof(rec_hdr_t) + h->size;
+	}
+
+	// Hand the space back only after it has been copied out
+	RING_STORE_REL(&r->tail, tail);
+	return n;
+}
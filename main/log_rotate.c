@@ -0,0 +1,172 @@
+/*
+ * log_rotate.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include <sys/unistd.h>
+#include <sys/stat.h>
+#include "log_rotate.h"
+
+#define PTR_MAGIC		0x544F524C	/* "LROT" */
+
+typedef struct {
+	uint32_t magic;
+	uint32_t seq;
+	uint32_t slot;
+	uint32_t check;
+} log_ptr_t;
+
+
+static uint32_t ptr_check(const log_ptr_t *p)
+{
+	return ~(p->magic ^ p->seq ^ p->slot);
+}
+
+static void slot_name(log_rotate_t *lr, uint8_t slot, char *dst)
+{
+	snprintf(dst, LOG_ROTATE_NAME_LEN, lr->fmt, slot);
+}
+
+/*
+ * Newest valid pointer copy wins, slot 0 if neither is usable
+ */
+static void ptr_load(log_rotate_t *lr)
+{
+	log_ptr_t p[2];
+	FILE *f;
+	int i, n;
+
+	lr->slot = 0;
+	lr->seq = 0;
+	if ((f = fopen(lr->ptr_path, "r")) == NULL) {
+		return;
+	}
+	n = fread(p, sizeof(log_ptr_t), 2, f);
+	fclose(f);
+
+	for (i = 0; i < n; i++) {
+		if (p[i].magic != PTR_MAGIC || p[i].check != ptr_check(&p[i]) || p[i].slot >= lr->count) {
+			continue;
+		}
+		if (p[i].seq >= lr->seq) {
+			lr->seq = p[i].seq;
+			lr->slot = p[i].slot;
+		}
+	}
+}
+
+/*
+ * Write the next sequence number into the copy the last store didn't use
+ */
+static esp_err_t ptr_store(log_rotate_t *lr, uint8_t slot)
+{
+	log_ptr_t p;
+	FILE *f;
+
+	p.magic = PTR_MAGIC;
+	p.seq = lr->seq + 1;
+	p.slot = slot;
+	p.check = ptr_check(&p);
+
+	if ((f = fopen(lr->ptr_path, "r+")) == NULL &&
+		(f = fopen(lr->ptr_path, "w+")) == NULL) {
+		return ESP_FAIL;
+	}
+	if (fseek(f, (p.seq & 1) * sizeof(p), SEEK_SET) != 0 ||
+		fwrite(&p, sizeof(p), 1, f) != 1) {
+		fclose(f);
+		return ESP_FAIL;
+	}
+	fflush(f);
+	fsync(fileno(f));
+	fclose(f);
+
+	lr->seq = p.seq;
+	return ESP_OK;
+}
+
+
+esp_err_t log_rotate_init(log_rotate_t *lr, const char *fmt, const char *ptr_path,
+							uint8_t count, uint32_t max_size)
+{
+	struct stat st;
+
+	if (count < 2 || count > 100 || max_size == 0) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	memset(lr, 0, sizeof(*lr));
+	lr->fmt = fmt;
+	lr->ptr_path = ptr_path;
+	lr->count = count;
+	lr->max_size = max_size;
+
+	ptr_load(lr);
+	slot_name(lr, lr->slot, lr->name);
+	lr->size = (stat(lr->name, &st) == 0) ? st.st_size : 0;
+	return ESP_OK;
+}
+
+esp_err_t log_rotate_next(log_rotate_t *lr)
+{
+	uint8_t next = (lr->slot + 1) % lr->count;
+	char name[LOG_ROTATE_NAME_LEN];
+	FILE *f;
+
+	log_rotate_close(lr);
+
+	// Empty the next slot before pointing at it
+	slot_name(lr, next, name);
+	if ((f = fopen(name, "w")) == NULL) {
+		return ESP_FAIL;
+	}
+	fsync(fileno(f));
+	fclose(f);
+
+	if (ptr_store(lr, next) != ESP_OK) {
+		return ESP_FAIL;
+	}
+
+	lr->slot = next;
+	lr->size = 0;
+	lr->rotations++;
+	memcpy(lr->name, name, sizeof(name));
+	return ESP_OK;
+}
+
+esp_err_t log_rotate_write(log_rotate_t *lr, const void *data, size_t len)
+{
+	size_t n;
+
+	if (lr->size > 0 && lr->size + len > lr->max_size) {
+		// On failure keep appending to the old file rather than lose data
+		log_rotate_next(lr);
+	}
+
+	if (lr->f == NULL && (lr->f = fopen(lr->name, "a")) == NULL) {
+		return ESP_FAIL;
+	}
+
+	n = fwrite(data, 1, len, lr->f);
+	lr->size += n;
+	return (n == len) ? ESP_OK : ESP_FAIL;
+}
+
+void log_rotate_flush(log_rotate_t *lr)
+{
+	if (lr->f != NULL) {
+		fflush(lr->f);
+		fsync(fileno(lr->f));
+	}
+}
+
+void log_rotate_close(log_rotate_t *lr)
+{
+	if (lr->f != NULL) {
+		log_rotate_flush(lr);
+		fclose(lr->f);
+		lr->f = NULL;
+	}
+}
@@ -59,6 +59,7 @@ Notes:
 #ifdef CONFIG_USE_SD
 #include "sd_if.h"
 #endif
+#include "i2cbus_if.h"
 #include "hdc1080_if.h"
 #include "mics4514_if.h"
 #include "gps_if.h"
@@ -77,6 +78,12 @@ Notes:
 #include "mqtt_if.h"
 #include "time_if.h"
 #include "ota_if.h"
+#include "airu_sample.h"
+#include "stats.h"
+#include "pipeline_if.h"
+#ifdef CONFIG_OUTBOX_ENABLE
+#include "outbox_if.h"
+#endif
 
 
 /* GPIO */
@@ -104,7 +111,6 @@ static const char *TAG_OFFLINE_TRACKER = "OFFLINE";
 static const char *TAG_UPLOAD = "UPLOAD";
 
 const char file_upload_nvs_namespace[] = "fileupload";
-const char* earliest_missed_data_ts = "offline";
 const char* last_upload_ts = "lastup";
 time_t last_publish = 0;
 
@@ -140,117 +146,123 @@ void panic_task(void *pvParameters)
 }
 
 /*
- * Data gather task
+ * Publish window statistics of the channels sampled here; PM frames are
+ * summarized by pm_if. data_task only.
+ */
+static stats_t win_temp, win_hum, win_co, win_nox;
+
+static void window_close(stats_t *s, stats_summary_t *out)
+{
+	stats_get(s, out);
+	stats_reset(s);
+}
+
+/*
+ * Data gather task. Only acquires: everything downstream of the sensor polls
+ * runs in the pipeline tasks (see pipeline_if.h).
  */
 void data_task()
 {
 	esp_err_t err;
 	pm_data_t pm_dat;
-	double temp, hum;
-	int co, nox;
 	esp_gps_t gps;
-	char *pkt;
-	uint64_t uptime = 0;
-	uint64_t hr, rm;
-	time_t now;
-	struct tm tm;
-	char strftime_buf[64];
-	uint8_t min, sec, system_time;
+	airu_sample_t sample;
 	int ping_cntr = 0;
-
-	// only need to get it once
-	esp_app_desc_t *app_desc = esp_ota_get_app_description();
+	int win_cntr = 0;
+	struct tm tm;
+	time_t t;
 
 	while (1) {
 
-        vTaskDelay(CONFIG_DATA_UPLOAD_PERIOD * 1000 / portTICK_PERIOD_MS);
-		PMS_Poll(&pm_dat);
-		HDC1080_Poll(&temp, &hum);
-		MICS4514_Poll(&nox, &co);
-		GPS_Poll(&gps);
+        vTaskDelay(CONFIG_DATA_SAMPLE_PERIOD * 1000 / portTICK_PERIOD_MS);
 
-		uptime = esp_timer_get_time() / 1000000;
-
-		pkt = malloc(MQTT_PKT_LEN);
-
-		//
-		// Send data over MQTT
-		//
-		sprintf(pkt, MQTT_PKT, DEVICE_MAC,			/* ID 			*/
-							   app_desc->version,	/* SensorModel 	*/
-							   uptime, 				/* secActive 	*/
-							   gps.alt,				/* Altitude 	*/
-							   gps.lat, 			/* Latitude 	*/
-							   gps.lon, 			/* Longitude 	*/
-							   pm_dat.pm1,			/* PM1 			*/
-							   pm_dat.pm2_5,		/* PM2.5 		*/
-							   pm_dat.pm10, 		/* PM10 		*/
-							   temp,				/* Temperature 	*/
-							   hum,					/* Humidity 	*/
-							   co,					/* CO 			*/
-							   nox);				/* NOx 			*/
-
-		ESP_LOGI(TAG, "MQTT PACKET:\n\r%s", pkt);
-		err = MQTT_Publish_Data(pkt);
-		if(err >= ESP_OK){
-			ESP_LOGI(TAG, "MQTT publish success %d", err);
-			last_publish = uptime;
+		memset(&sample, 0, sizeof(sample));
+		sample.ts_us = esp_timer_get_time();
+		sample.utc_ms = TIME_FromMono(sample.ts_us);
+
+		if (PMS_Poll(&pm_dat) == ESP_OK) {
+			sample.valid |= AIRU_FIELD_PM;
 		}
-		else{
-			ESP_LOGI(TAG, "MQTT publish fail %d", err);
-			wifi_manager_check_connection_async();
+		sample.pm_count = pm_dat.sample_count;
+		sample.pm1   = pm_dat.pm1;
+		sample.pm2_5 = pm_dat.pm2_5;
+		sample.pm10  = pm_dat.pm10;
+		sample.pm1_atm   = pm_dat.pm1_atm;
+		sample.pm2_5_atm = pm_dat.pm2_5_atm;
+		sample.pm10_atm  = pm_dat.pm10_atm;
+		if (pm_dat.pn_count > 0) {
+			sample.valid |= AIRU_FIELD_PN;
 		}
+		sample.pn_count = pm_dat.pn_count;
+		memcpy(sample.pn, pm_dat.pn, sizeof(sample.pn));
 
-#ifdef CONFIG_SD_DATA_STORE
-		/************************************
-		 * Save to SD Card
-		 *************************************/
-		time(&now);
-		localtime_r(&now, &tm);
-		strftime(strftime_buf, sizeof(strftime_buf), "%c", &tm);
-		ESP_LOGI(TAG, "SD card datetime: %s", strftime_buf);
-
-		if (gps.year <= 18 || gps.year >= 80){
-			hr = uptime / 3600;
-			rm = uptime % 3600;
-			min = rm / 60;
-			sec = rm % 60;
-
-			sprintf(strftime_buf, "%llu:%02d:%02d", hr, min, sec);
-			system_time = 1;	// Using system time
+		if (HDC1080_Poll(&sample.temp, &sample.hum) == ESP_OK) {
+			sample.valid |= AIRU_FIELD_TEMP | AIRU_FIELD_HUM;
+			stats_add(&win_temp, sample.temp);
+			stats_add(&win_hum, sample.hum);
 		}
-		else {
-			sprintf(strftime_buf, "%02d:%02d:%02d", gps.hour, gps.min, gps.sec);
-			system_time = 0;	// Using GPS time
+
+		if (MICS4514_Poll(&sample.nox, &sample.co) == ESP_OK) {
+			sample.valid |= AIRU_FIELD_CO | AIRU_FIELD_NOX;
+			stats_add(&win_co, sample.co);
+			stats_add(&win_nox, sample.nox);
 		}
 
-		sprintf(pkt, SD_PKT, strftime_buf,
-							 DEVICE_MAC,
-							 MQTT_DATA_PUB_TOPIC,
-							 uptime,
-							 gps.alt,
-							 gps.lat,
-							 gps.lon,
-							 pm_dat.pm1,
-							 pm_dat.pm2_5,
-							 pm_dat.pm10,
-							 temp,
-							 hum,
-							 co,
-							 nox);
-
-		sd_write_data(pkt, gps.year, gps.month, gps.day);
-		periodic_timer_callback(NULL);
-#endif
+		// The last sample of each publish window carries its statistics.
+		// Counting here rather than in the aggregator keeps the windows
+		// on the sample clock even if a sample is dropped on the way.
+		if (++win_cntr >= PIPELINE_SAMPLES_PER_PUBLISH) {
+			PMS_WindowStats(&sample.stats[AIRU_STAT_PM1], &sample.stats[AIRU_STAT_PM2_5],
+							&sample.stats[AIRU_STAT_PM10]);
+			window_close(&win_temp, &sample.stats[AIRU_STAT_TEMP]);
+			window_close(&win_hum, &sample.stats[AIRU_STAT_HUM]);
+			window_close(&win_co, &sample.stats[AIRU_STAT_CO]);
+			window_close(&win_nox, &sample.stats[AIRU_STAT_NOX]);
+			sample.valid |= AIRU_FIELD_STATS;
+			win_cntr = 0;
+		}
 
-		free(pkt);
+		// A parsed sentence without a fix carries 0,0; only a fix is a position
+		GPS_Poll(&gps);
+		if (gps.smooth.n > 0) {
+			sample.alt = gps.smooth.alt;
+			sample.lat = gps.smooth.lat;
+			sample.lon = gps.smooth.lon;
+			strcpy(sample.geohash, gps.smooth.geohash);
+			sample.valid |= AIRU_FIELD_POS;
+		}
+		else if (gps.fix_quality > 0) {
+			sample.alt = gps.alt;
+			sample.lat = gps.lat;
+			sample.lon = gps.lon;
+			sample.valid |= AIRU_FIELD_POS;
+		}
+
+		// Date and time come from the device clock only, so file names,
+		// CSV/binary times and Influx timestamps all agree
+		if (sample.utc_ms >= 0) {
+			t = sample.utc_ms / 1000;
+			gmtime_r(&t, &tm);
+			sample.year  = tm.tm_year - 100;
+			sample.month = tm.tm_mon + 1;
+			sample.day   = tm.tm_mday;
+			sample.hour  = tm.tm_hour;
+			sample.min   = tm.tm_min;
+			sample.sec   = tm.tm_sec;
+			sample.valid |= AIRU_FIELD_DATE | AIRU_FIELD_TIME;
+		}
+
+		err = PIPELINE_Submit(&sample);
+		if (err != ESP_OK) {
+			ESP_LOGW(TAG, "Pipeline full, sample dropped");
+		}
 
 		/* this is a good place to do a ping test (no more often than 15 minutes)*/
-		if(++ping_cntr * CONFIG_DATA_UPLOAD_PERIOD >= 900){
+		if(++ping_cntr * CONFIG_DATA_SAMPLE_PERIOD >= 900){
 			wifi_manager_check_connection_async();
 			ping_cntr = 0;
 		}
-		ESP_LOGI(TAG, "Ping count: %d * %d = %d", ping_cntr, CONFIG_DATA_UPLOAD_PERIOD, CONFIG_DATA_UPLOAD_PERIOD * ping_cntr);
+		ESP_LOGI(TAG, "Ping count: %d * %d = %d", ping_cntr, CONFIG_DATA_SAMPLE_PERIOD, CONFIG_DATA_SAMPLE_PERIOD * ping_cntr);
 	}
 }
 
@@ -265,13 +277,17 @@ void app_main()
 	/* Initialize the LED Driver */
 	LED_Initialize();
 
+	/* Start the device clock before its GPS and SNTP references */
+	TIME_Initialize();
+
 	/* Initialize the GPS Driver */
 	GPS_Initialize();
 
 	/* Initialize the PM Driver */
 	PMS_Initialize();
 
-	/* Initialize the HDC1080 Driver */
+	/* Initialize the shared I2C bus, then the HDC1080 Driver on it */
+	I2CBUS_Initialize();
 	HDC1080_Initialize();
 
 	/* Initialize the MICS Driver */
@@ -280,6 +296,9 @@ void app_main()
 	/* Initialize the SD Card Driver */
 	SD_Initialize();
 
+	/* start the acquisition -> MQTT/SD pipeline */
+	PIPELINE_Initialize();
+
 	/* start the led task */
 	xTaskCreate(&led_task, "led_task", 2048, NULL, 3, &task_led);
 
@@ -310,6 +329,11 @@ void app_main()
 	/* Initialize MQTT */
 	MQTT_Initialize();
 
+#ifdef CONFIG_OUTBOX_ENABLE
+	/* Replay data that couldn't be sent before */
+	OUTBOX_Initialize();
+#endif
+
 //	/* In debug mode we create a simple task on core 2 that monitors free heap memory */
 //#if WIFI_MANAGER_DEBUG
 //	xTaskCreatePinnedToCore(&monitoring_task, "monitoring_task", 2048, NULL, 1, NULL, 1);
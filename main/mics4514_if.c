@@ -3,24 +3,68 @@
  *
  *  Created on: Nov 13, 2018
  *      Author: tombo
+ *
+ *  Both channels are sampled continuously by mics_task:
+ *    - every MICS_PERIOD_MS, a burst of MICS_BURST raw reads per channel
+ *    - MICS_DECIMATE bursts are summed into one decimated value (boxcar)
+ *    - the decimated values go through a one pole low pass,
+ *      y += (x - y) >> MICS_IIR_SHIFT, kept with MICS_FRAC_BITS of fraction
+ *  The filtered values are converted to mV and sensor resistance and
+ *  published through a seqlock, so MICS4514_Read() never touches the ADC.
+ *
+ *  The same task runs the heater schedule (MICS4514_Phase()). Each cycle
+ *  the sensor is powered and heated for preheat_s, sampled for sample_s
+ *  with the heater still on, then switched off for the rest of the
+ *  period. The ADC is only read inside the sampling window and the filter
+ *  restarts with each window, so a reading never mixes a cold sensor into
+ *  a warm one. Between windows the last window's values are held and
+ *  tagged with the current phase.
  */
 
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "driver/gpio.h"
 #include "driver/adc.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_adc_cal.h"
+#include "esp_timer.h"
+#include "seqlock.h"
 #include "mics4514_if.h"
 
 #define GPIO_MICS_ENABLE	33
 #define GPIO_MICS_HEATER	32
 #define GPIO_OUTPUT_PIN_SEL ((1ULL << GPIO_MICS_ENABLE) | (1ULL << GPIO_MICS_HEATER))
-#define NO_OF_SAMPLES		64
 #define DEFAULT_VREF		1100 	// Use adc2_vref_to_gpio() to obtain a better estimate
 
+#define MICS_CH_OX			ADC_CHANNEL_6	// WROOM Pin 6 - GPIO 34 - OX - NOx
+#define MICS_CH_RED			ADC_CHANNEL_7	// WROOM Pin 7 - GPIO 35 - RE - CO
+#define MICS_PERIOD_MS		20		/* burst period, 50 Hz */
+#define MICS_BURST			4		/* reads per channel per burst */
+#define MICS_DECIMATE		25		/* bursts per filtered update, 2 Hz */
+#define MICS_IIR_SHIFT		3		/* time constant 8 updates, 4 s */
+#define MICS_FRAC_BITS		4
+#define MICS_ADC_MAX		4095
+
+/* Stale after this long without an update, on top of any heater off time */
+#define MICS_STALE_US		(5 * 1000000LL)
+
+typedef struct {
+	uint32_t acc;			/* sum of raw reads in the current decimation */
+	int32_t y;				/* filtered raw, MICS_FRAC_BITS fraction bits */
+	bool primed;			/* y holds a value */
+} mics_filter_t;
+
 static const char* TAG = "MICS4514";
 static esp_adc_cal_characteristics_t *adc_chars;
 
+SEQLOCK_DEFINE(mics_snap, mics4514_data_t);
+static mics4514_profile_t mics_profile;
+static int64_t mics_stale_us;
+
 static void check_efuse(void);
 static void print_char_val_type(esp_adc_cal_value_t val_type);
 
@@ -70,6 +114,174 @@ void MICS4514_GPIOEnable()
 	gpio_config(&io_conf);
 }
 
+/*
+ * Decimated sum in, filtered raw out (with fraction bits). The sum of
+ * MICS_BURST * MICS_DECIMATE reads is scaled to one read in Q format,
+ * then smoothed.
+ */
+static int32_t mics_filter_step(mics_filter_t *f)
+{
+	int32_t x = ((int64_t) f->acc << MICS_FRAC_BITS) / (MICS_BURST * MICS_DECIMATE);
+
+	f->acc = 0;
+	if (!f->primed) {
+		f->y = x;
+		f->primed = true;
+	}
+	else {
+		f->y += (x - f->y) >> MICS_IIR_SHIFT;
+	}
+	return f->y;
+}
+
+/*
+ * Calibrated mV of a raw value with fraction bits, interpolating between
+ * the two neighbouring codes
+ */
+static uint32_t mics_to_mv(int32_t q)
+{
+	uint32_t raw = q >> MICS_FRAC_BITS;
+	uint32_t frac = q & ((1 << MICS_FRAC_BITS) - 1);
+	uint32_t lo, hi;
+
+	if (raw >= MICS_ADC_MAX) {
+		return esp_adc_cal_raw_to_voltage(MICS_ADC_MAX, adc_chars);
+	}
+	lo = esp_adc_cal_raw_to_voltage(raw, adc_chars);
+	hi = esp_adc_cal_raw_to_voltage(raw + 1, adc_chars);
+	return lo + (((hi - lo) * frac + (1 << (MICS_FRAC_BITS - 1))) >> MICS_FRAC_BITS);
+}
+
+/*
+ * Sensing element in series with a load resistor across the supply, the
+ * ADC measuring across the load: Rs = RL * (Vcc - V) / V
+ */
+static uint32_t mics_to_ohms(uint32_t mv, uint32_t load_ohms)
+{
+	if (mv == 0) {
+		return UINT32_MAX;
+	}
+	if (mv >= CONFIG_MICS_SUPPLY_MV) {
+		return 0;
+	}
+	return (uint64_t) load_ohms * (CONFIG_MICS_SUPPLY_MV - mv) / mv;
+}
+
+/*
+ * Pure function of the schedule time, so it can be stepped through with a
+ * simulated clock. A cycle is preheat, sample, off; a period of 0 means
+ * one preheat after start and then sampling for good.
+ */
+mics4514_phase_t MICS4514_Phase(const mics4514_profile_t *p, int64_t t_us, int64_t *next_us)
+{
+	int64_t preheat = p->preheat_s * 1000000LL;
+	int64_t sample = p->sample_s * 1000000LL;
+	int64_t period = p->period_s * 1000000LL;
+	int64_t start;
+
+	if (t_us < 0) {
+		t_us = 0;
+	}
+
+	if (period == 0) {
+		if (t_us < preheat) {
+			*next_us = preheat;
+			return MICS_PHASE_PREHEAT;
+		}
+		*next_us = INT64_MAX;
+		return MICS_PHASE_SAMPLE;
+	}
+
+	start = t_us - t_us % period;
+	if (t_us < start + preheat) {
+		*next_us = start + preheat;
+		return MICS_PHASE_PREHEAT;
+	}
+	if (t_us < start + preheat + sample) {
+		*next_us = start + preheat + sample;
+		return MICS_PHASE_SAMPLE;
+	}
+	*next_us = start + period;
+	return MICS_PHASE_OFF;
+}
+
+/*
+ * Sensor supply and heater on for preheat and sampling, both off otherwise
+ */
+static void mics_apply_phase(mics4514_phase_t phase)
+{
+	if (phase == MICS_PHASE_OFF) {
+		MICS4514_HeaterDisable();
+		MICS4514_Disable();
+	}
+	else {
+		MICS4514_Enable();
+		MICS4514_HeaterEnable();
+	}
+}
+
+static void mics_task(void *pvParameters)
+{
+	mics_filter_t ox = { 0 }, red = { 0 };
+	mics4514_data_t d = { 0 };
+	TickType_t last_wake = xTaskGetTickCount();
+	int64_t t0 = esp_timer_get_time(), t, next_us;
+	mics4514_phase_t phase;
+	bool applied = false;
+	int burst = 0, i;
+
+	for (;;) {
+		t = esp_timer_get_time() - t0;
+		phase = MICS4514_Phase(&mics_profile, t, &next_us);
+
+		if (!applied || phase != d.phase) {
+			mics_apply_phase(phase);
+			applied = true;
+			ESP_LOGD(TAG, "Heater phase %d", phase);
+
+			if (phase == MICS_PHASE_SAMPLE) {
+				memset(&ox, 0, sizeof(ox));
+				memset(&red, 0, sizeof(red));
+				burst = 0;
+				d.window++;
+				last_wake = xTaskGetTickCount();
+			}
+			d.phase = phase;
+			seqlock_write(&mics_snap, &d);
+		}
+
+		// Nothing to read until the next window opens
+		if (phase != MICS_PHASE_SAMPLE) {
+			vTaskDelay(pdMS_TO_TICKS((next_us - t) / 1000) + 1);
+			continue;
+		}
+
+		vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(MICS_PERIOD_MS));
+
+		// The window may have closed during the wait
+		if (esp_timer_get_time() - t0 >= next_us) {
+			continue;
+		}
+
+		for (i = 0; i < MICS_BURST; i++) {
+			ox.acc  += adc1_get_raw(MICS_CH_OX);
+			red.acc += adc1_get_raw(MICS_CH_RED);
+		}
+		if (++burst < MICS_DECIMATE) {
+			continue;
+		}
+		burst = 0;
+
+		d.ox_mv   = mics_to_mv(mics_filter_step(&ox));
+		d.red_mv  = mics_to_mv(mics_filter_step(&red));
+		d.ox_ohms  = mics_to_ohms(d.ox_mv, CONFIG_MICS_OX_LOAD_OHMS);
+		d.red_ohms = mics_to_ohms(d.red_mv, CONFIG_MICS_RED_LOAD_OHMS);
+		d.ts_us = esp_timer_get_time();
+		d.updates++;
+		seqlock_write(&mics_snap, &d);
+	}
+}
+
 /*
  *
  */
@@ -81,8 +293,8 @@ void MICS4514_Initialize(void)
 	check_efuse();
 
 	adc1_config_width(ADC_WIDTH_BIT_12);
-	adc1_config_channel_atten(ADC_CHANNEL_6, ADC_ATTEN_DB_11); 	// WROOM Pin 6 - GPIO 34 - OX - NOx
-	adc1_config_channel_atten(ADC_CHANNEL_7, ADC_ATTEN_DB_11);	// WROOM Pin 7 - GPIO 35 - RE - CO
+	adc1_config_channel_atten(MICS_CH_OX, ADC_ATTEN_DB_11);
+	adc1_config_channel_atten(MICS_CH_RED, ADC_ATTEN_DB_11);
 
 	//Characterize ADC
 	adc_chars = calloc(1, sizeof(esp_adc_cal_characteristics_t));
@@ -95,32 +307,56 @@ void MICS4514_Initialize(void)
 
 	MICS4514_GPIOEnable();
 
+	MICS4514_HeaterDisable();
 	MICS4514_Disable();
 
+#ifdef CONFIG_MICS_DUTY_CYCLE
+	mics_profile.period_s = CONFIG_MICS_CYCLE_S;
+	mics_profile.sample_s = CONFIG_MICS_SAMPLE_S;
+#endif
+	mics_profile.preheat_s = CONFIG_MICS_PREHEAT_S;
+	if (mics_profile.period_s != 0 &&
+		mics_profile.preheat_s + mics_profile.sample_s >= mics_profile.period_s) {
+		ESP_LOGW(TAG, "Preheat and sampling don't fit in %us, heater left on", mics_profile.period_s);
+		mics_profile.period_s = 0;
+	}
+
+	// A held reading is good until the next window has had time to update it
+	mics_stale_us = MICS_STALE_US;
+	if (mics_profile.period_s != 0) {
+		mics_stale_us += (mics_profile.period_s - mics_profile.sample_s) * 1000000LL;
+	}
+
+	xTaskCreate(mics_task, "mics_task", 2048, NULL, 2, NULL);
 	return;
 }
 
+esp_err_t MICS4514_Read(mics4514_data_t *data)
+{
+	seqlock_read(&mics_snap, data);
+
+	if (data->updates == 0) {
+		return ESP_ERR_NOT_FOUND;
+	}
+	if (esp_timer_get_time() - data->ts_us > mics_stale_us) {
+		return ESP_ERR_TIMEOUT;
+	}
+	return ESP_OK;
+}
+
 /*
- *
+ * Filtered OX and RED voltages in mV, live or held from the last window
  */
-void MICS4514_Poll(int *ox_val, int *red_val)
+esp_err_t MICS4514_Poll(int *ox_val, int *red_val)
 {
-	int64_t ch6 = 0;
-	int64_t ch7 = 0;
+	mics4514_data_t d;
+	esp_err_t err = MICS4514_Read(&d);
 
-	for (int i = 0; i < NO_OF_SAMPLES; i++) {
-		ch6 += adc1_get_raw(ADC_CHANNEL_6);
-		ch7 += adc1_get_raw(ADC_CHANNEL_7);
+	if (err == ESP_OK) {
+		*ox_val  = d.ox_mv;
+		*red_val = d.red_mv;
 	}
-	ch6 /= NO_OF_SAMPLES;
-	ch7 /= NO_OF_SAMPLES;
-
-	//Convert adc_reading to voltage in mV
-	*ox_val  = (int) ch6;
-	*red_val = (int) ch7;
-//	*ox_val  = esp_adc_cal_raw_to_voltage(ch6, adc_chars);
-//	*red_val = esp_adc_cal_raw_to_voltage(ch7, adc_chars);
-	return;
+	return err;
 }
 
 //#define GPIO_MICS_ENABLE	33
@@ -7,6 +7,7 @@
 
 #include <string.h>
 #include "esp_err.h"
+#include "esp_timer.h"
 #include "esp_system.h"
 #include "esp_log.h"
 #include "mqtt_client.h"
@@ -25,6 +26,9 @@
 #include "led_if.h"
 #include "sd_if.h"
 #include "wifi_manager.h"
+#ifdef CONFIG_OUTBOX_ENABLE
+#include "outbox_if.h"
+#endif
 
 #define WIFI_CONNECTED_BIT 		BIT0
 #define THIRTY_SECONDS_COUNT 30
@@ -38,8 +42,31 @@ static volatile bool client_connected;
 static esp_mqtt_client_handle_t client = NULL;
 static TaskHandle_t task_mqtt = NULL;
 
+#if CONFIG_MQTT_BATCH_MAX_BYTES < MQTT_PKT_LEN
+#error "CONFIG_MQTT_BATCH_MAX_BYTES must hold at least one record (MQTT_PKT_LEN)"
+#endif
+
+/*
+ * Data batch. Only the pipeline's MQTT sink task touches these, so they
+ * need no lock.
+ */
+static char batch_buf[CONFIG_MQTT_BATCH_MAX_BYTES];
+static size_t batch_len = 0;
+static int batch_records = 0;
+static int64_t batch_first_us = 0;
+
+/*
+ * Influx ingests fastest when a batch is grouped by series, oldest point
+ * first within each. Records arrive in time order, so only a series that
+ * comes back after another (e.g. the Geohash tag flipping) needs a sort.
+ */
+static uint16_t batch_off[CONFIG_MQTT_BATCH_MAX_RECORDS + 1];	/* record starts */
+static bool batch_grouped = true;
+static char batch_tmp[CONFIG_MQTT_BATCH_MAX_BYTES];
+
 
 static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event);
+static void batch_group(void);
  /*
  * This exact configuration was what works. Won't work
  * without the "transport" parameter set.
@@ -91,14 +118,14 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
 		   client_connected = true;
 
 		   // Subscribe to "all" topic
-		   msg_id = esp_mqtt_client_subscribe(this_client, MQTT_SUB_ALL_TOPIC, 2);
+		   msg_id = esp_mqtt_client_subscribe(this_client, MQTT_SUB_ALL_TOPIC, CONFIG_MQTT_SUB_QOS);
 		   ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
 
 		   // Subscribe to "device" topic
 		   sprintf(tmp, "%s/%s", CONFIG_MQTT_ROOT_TOPIC, DEVICE_MAC);
 
 		   ESP_LOGI(TAG, "Subscribing to: %s", tmp);
-		   msg_id = esp_mqtt_client_subscribe(this_client, (const char*) tmp, 2);
+		   msg_id = esp_mqtt_client_subscribe(this_client, (const char*) tmp, CONFIG_MQTT_SUB_QOS);
 		   ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
 
 		   // Respond to "ack" topic that we're online
@@ -107,7 +134,7 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
 		   json_buf = malloc(512);
 		   json_buf[0] = '\0';
 		   esp_err_t err = http_get_isp_info(json_buf, 512);
-		   MQTT_Publish_General((const char*) tpc, json_buf, 2);
+		   MQTT_Publish_General((const char*) tpc, json_buf, CONFIG_MQTT_ACK_QOS);
 		   free(json_buf);
 		   break;
 
@@ -152,7 +179,7 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
 
 		        	// Notify ota starting over MQTT
 		        	sprintf(tmp, MQTT_ACK_TOPIC_TMPLT, DEVICE_MAC);
-		        	MQTT_Publish_General(tmp, "ota", 2);
+		        	MQTT_Publish_General(tmp, "ota", CONFIG_MQTT_ACK_QOS);
 
 		        	ota_set_filename(tok);
 		        	ota_trigger();
@@ -165,7 +192,7 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
 		   else if (strcmp(tok, "ping") == 0){
 
 			   sprintf(tmp, MQTT_ACK_TOPIC_TMPLT, DEVICE_MAC);
-			   MQTT_Publish_General(tmp, "pong", 2);
+			   MQTT_Publish_General(tmp, "pong", CONFIG_MQTT_ACK_QOS);
 
 			   ESP_LOGI(TAG, "response: \"pong\" on \"%s\"", tmp);
 		   }
@@ -258,6 +285,14 @@ int MQTT_Publish_General(const char* topic, const char* msg, int qos)
 	}
 }
 
+/*
+* @brief	Is the client connected to the broker right now?
+*/
+bool MQTT_Is_Connected(void)
+{
+	return client_connected;
+}
+
 /*
 * @brief
 *
@@ -267,6 +302,183 @@ int MQTT_Publish_General(const char* topic, const char* msg, int qos)
 */
 int MQTT_Publish_Data(const char* msg)
 {
-	return MQTT_Publish_General(MQTT_DATA_PUB_TOPIC, msg, 2);
+	return MQTT_Publish_General(MQTT_DATA_PUB_TOPIC, msg, CONFIG_MQTT_DATA_QOS);
+}
+
+/*
+* @brief	Publish the pending batch as one newline separated payload.
+* 			The batch is emptied whether or not the publish succeeds; a
+* 			failed batch goes to the outbox when CONFIG_OUTBOX_ENABLE is set.
+*
+* @param	N/A
+*
+* @return	msg_id of the publish, 0 if there was nothing to send, or
+* 			ESP_FAIL if the client isn't connected
+*/
+int MQTT_Batch_Flush(void)
+{
+	int ret;
+
+	if (batch_records == 0) {
+		return 0;
+	}
+
+	ESP_LOGI(TAG, "Flushing batch: %d records, %d bytes", batch_records, batch_len);
+	if (!batch_grouped) {
+		batch_off[batch_records] = batch_len + 1;
+		batch_group();
+	}
+	ret = MQTT_Publish_Data(batch_buf);
+
+#ifdef CONFIG_OUTBOX_ENABLE
+	// Park the batch on the SD card, it is replayed once we're back online
+	if (ret < 0 && OUTBOX_Append(batch_buf, batch_len) == ESP_OK) {
+		ESP_LOGI(TAG, "Batch stored in outbox");
+	}
+#endif
+
+	batch_len = 0;
+	batch_records = 0;
+	batch_grouped = true;
+	batch_buf[0] = '\0';
+	return ret;
+}
+
+/*
+ * Length of the series key (measurement and tag set): up to the first
+ * space that isn't escaped.
+ */
+static size_t series_len(const char *line, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len && line[i] != '\n'; i++) {
+		if (line[i] == '\\') {
+			i++;
+		}
+		else if (line[i] == ' ') {
+			break;
+		}
+	}
+	return (i < len) ? i : len;
+}
+
+static bool same_series(int a, int b)
+{
+	const char *pa = batch_buf + batch_off[a], *pb = batch_buf + batch_off[b];
+	size_t la = series_len(pa, batch_off[a + 1] - batch_off[a]);
+	size_t lb = series_len(pb, batch_off[b + 1] - batch_off[b]);
+
+	return la == lb && memcmp(pa, pb, la) == 0;
+}
+
+/*
+ * Regroup the batch by series, keeping time order inside each series.
+ * Called only when a series reappeared, so the quadratic scan is over a
+ * handful of records at most.
+ */
+static void batch_group(void)
+{
+	bool done[CONFIG_MQTT_BATCH_MAX_RECORDS] = { false };
+	size_t len = 0, n;
+	int i, j;
+
+	for (i = 0; i < batch_records; i++) {
+		if (done[i]) {
+			continue;
+		}
+		for (j = i; j < batch_records; j++) {
+			if (done[j] || !same_series(i, j)) {
+				continue;
+			}
+			done[j] = true;
+			// Every record is followed by a separator, real or (last) assumed
+			n = batch_off[j + 1] - batch_off[j] - 1;
+			if (len > 0) {
+				batch_tmp[len++] = '\n';
+			}
+			memcpy(batch_tmp + len, batch_buf + batch_off[j], n);
+			len += n;
+		}
+	}
+	memcpy(batch_buf, batch_tmp, len);
+	batch_buf[len] = '\0';
+}
+
+/*
+* @brief	Add one line protocol record to the batch. The batch is flushed
+* 			first if the record wouldn't fit, and afterwards once it reaches
+* 			CONFIG_MQTT_BATCH_MAX_RECORDS or CONFIG_MQTT_BATCH_MAX_AGE.
+*
+* @param	line: a single record, no trailing newline
+*
+* @return	msg_id of a flush, 0 if the record was only buffered, or
+* 			ESP_FAIL if a flush failed or the record can never fit
+*/
+int MQTT_Batch_Add(const char* line)
+{
+	size_t len = strlen(line);
+	size_t need = len + (batch_records > 0 ? 1 : 0);
+	int ret = 0, poll, i;
+
+	if (len + 1 > sizeof(batch_buf)) {
+		ESP_LOGE(TAG, "Record of %d bytes can't fit a batch", len);
+		return ESP_FAIL;
+	}
+
+	if (batch_len + need + 1 > sizeof(batch_buf)) {
+		ret = MQTT_Batch_Flush();
+		need = len;
+	}
+
+	if (batch_records == 0) {
+		batch_first_us = esp_timer_get_time();
+	}
+	else {
+		batch_buf[batch_len++] = '\n';
+	}
+	batch_off[batch_records] = batch_len;
+	memcpy(batch_buf + batch_len, line, len + 1);
+	batch_len += len;
+	batch_records++;
+
+	// A series that isn't the previous record's but appeared earlier
+	if (batch_grouped && batch_records > 2) {
+		batch_off[batch_records] = batch_len + 1;
+		if (!same_series(batch_records - 1, batch_records - 2)) {
+			for (i = 0; i < batch_records - 2; i++) {
+				if (same_series(i, batch_records - 1)) {
+					batch_grouped = false;
+					break;
+				}
+			}
+		}
+	}
+
+	// Report the earlier flush unless this one sends too, and a failure
+	// either way
+	poll = MQTT_Batch_Poll();
+	return (ret < 0 || poll == 0) ? ret : poll;
+}
+
+/*
+* @brief	Flush the batch if it has reached its record count or age limit.
+* 			Call periodically so a slow trickle of records still goes out.
+*
+* @param	N/A
+*
+* @return	msg_id of a flush, 0 if nothing was sent, or ESP_FAIL
+*/
+int MQTT_Batch_Poll(void)
+{
+	if (batch_records == 0) {
+		return 0;
+	}
+
+	if (batch_records >= CONFIG_MQTT_BATCH_MAX_RECORDS ||
+		esp_timer_get_time() - batch_first_us >= CONFIG_MQTT_BATCH_MAX_AGE * 1000000LL) {
+		return MQTT_Batch_Flush();
+	}
+	return 0;
 }
 
@@ -0,0 +1,237 @@
+/*
+ * nmea.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "nmea.h"
+
+#define IS_DIGIT(c)		((unsigned)((c) - '0') < 10)
+
+static const nmea_field_t empty_field = { "", 0 };
+
+static int hex_val(char c)
+{
+	if (IS_DIGIT(c)) return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+/*
+ * Parse exactly n digits at p
+ */
+static bool digits(const char *p, uint8_t n, uint32_t *out)
+{
+	uint32_t v = 0;
+
+	while (n--) {
+		if (!IS_DIGIT(*p)) {
+			return false;
+		}
+		v = v * 10 + (*p++ - '0');
+	}
+	*out = v;
+	return true;
+}
+
+
+esp_err_t nmea_tokenize(const char *s, size_t len, nmea_sentence_t *out)
+{
+	const char *p = s + 1, *end = s + len, *start = p;
+	uint8_t sum = 0;
+	int hi, lo;
+
+	out->n = 0;
+	if (len < 6 || *s != '$') {
+		return ESP_FAIL;
+	}
+
+	for (; p < end && *p != '*'; p++) {
+		if (*p == ',') {
+			if (out->n == NMEA_MAX_FIELDS) {
+				return ESP_FAIL;
+			}
+			out->f[out->n].p = start;
+			out->f[out->n].len = p - start;
+			out->n++;
+			start = p + 1;
+		}
+		else if (*p == '\r' || *p == '\n' || *p == '$') {
+			return ESP_FAIL;
+		}
+		sum ^= *p;
+	}
+
+	if (p + 3 > end || out->n == NMEA_MAX_FIELDS) {
+		return ESP_FAIL;	// no checksum
+	}
+	out->f[out->n].p = start;
+	out->f[out->n].len = p - start;
+	out->n++;
+
+	hi = hex_val(p[1]);
+	lo = hex_val(p[2]);
+	if (hi < 0 || lo < 0) {
+		return ESP_FAIL;
+	}
+	return (sum == ((hi << 4) | lo)) ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+bool nmea_is(const nmea_sentence_t *s, const char *type)
+{
+	const nmea_field_t *a = &s->f[0];
+
+	return s->n > 0 && a->len == 5 &&
+			a->p[2] == type[0] && a->p[3] == type[1] && a->p[4] == type[2];
+}
+
+const nmea_field_t *nmea_field(const nmea_sentence_t *s, uint8_t i)
+{
+	return (i < s->n) ? &s->f[i] : &empty_field;
+}
+
+esp_err_t nmea_parse_coord(const nmea_field_t *val, const nmea_field_t *hemi, uint8_t deg_digits, int32_t *e7)
+{
+	const char *p = val->p;
+	uint32_t deg, min, frac = 0;
+	uint8_t i, n;
+
+	if (val->len == 0) {
+		return ESP_ERR_NOT_FOUND;
+	}
+	if (val->len < deg_digits + 2 ||
+		!digits(p, deg_digits, &deg) || !digits(p + deg_digits, 2, &min) ||
+		deg > ((deg_digits == 2) ? 90 : 180) || min > 59) {
+		return ESP_FAIL;
+	}
+
+	// Minutes to 4 decimals; shorter fractions are padded, longer truncated
+	p += deg_digits + 2;
+	n = val->len - deg_digits - 2;
+	if (n > 0) {
+		if (*p != '.') {
+			return ESP_FAIL;
+		}
+		p++;
+		n--;
+	}
+	for (i = 0; i < 4; i++) {
+		if (i < n) {
+			if (!IS_DIGIT(p[i])) {
+				return ESP_FAIL;
+			}
+			frac = frac * 10 + (p[i] - '0');
+		}
+		else {
+			frac *= 10;
+		}
+	}
+
+	// 90 and 180 degrees only with zero minutes
+	if (deg == ((deg_digits == 2) ? 90 : 180) && (min | frac) != 0) {
+		return ESP_FAIL;
+	}
+	*e7 = deg * 10000000 + 50 * (min * 10000 + frac) / 3;
+
+	if (hemi->len > 0) {
+		switch (hemi->p[0]) {
+		case 'S':
+		case 'W':
+			*e7 = -*e7;
+			break;
+		case 'N':
+		case 'E':
+			break;
+		default:
+			return ESP_FAIL;
+		}
+	}
+	return ESP_OK;
+}
+
+esp_err_t nmea_parse_time(const nmea_field_t *f, uint8_t *hour, uint8_t *min, uint8_t *sec, uint16_t *ms)
+{
+	uint32_t h, m, s, frac = 0;
+	uint8_t i;
+
+	if (f->len < 6 || !digits(f->p, 2, &h) || !digits(f->p + 2, 2, &m) || !digits(f->p + 4, 2, &s)) {
+		return ESP_FAIL;
+	}
+	if (f->len > 7 && f->p[6] == '.') {
+		for (i = 0; i < 3; i++) {
+			frac *= 10;
+			if (7 + i < f->len && IS_DIGIT(f->p[7 + i])) {
+				frac += f->p[7 + i] - '0';
+			}
+		}
+	}
+
+	*hour = h;
+	*min = m;
+	*sec = s;
+	*ms = frac;
+	return ESP_OK;
+}
+
+esp_err_t nmea_parse_date(const nmea_field_t *f, uint8_t *day, uint8_t *month, uint8_t *year)
+{
+	uint32_t d, m, y;
+
+	if (f->len != 6 || !digits(f->p, 2, &d) || !digits(f->p + 2, 2, &m) || !digits(f->p + 4, 2, &y)) {
+		return ESP_FAIL;
+	}
+	*day = d;
+	*month = m;
+	*year = y;
+	return ESP_OK;
+}
+
+esp_err_t nmea_parse_fixed(const nmea_field_t *f, uint8_t decimals, int32_t *out)
+{
+	const char *p = f->p, *end = f->p + f->len;
+	bool neg = false, point = false, any = false;
+	int32_t v = 0;
+	uint8_t dec = 0;
+
+	if (f->len == 0) {
+		return ESP_ERR_NOT_FOUND;
+	}
+	if (*p == '-' || *p == '+') {
+		neg = (*p++ == '-');
+	}
+
+	for (; p < end; p++) {
+		if (*p == '.' && !point) {
+			point = true;
+		}
+		else if (IS_DIGIT(*p)) {
+			any = true;
+			if (point && dec == decimals) {
+				continue;
+			}
+			if (v > (INT32_MAX - (*p - '0')) / 10) {
+				return ESP_FAIL;
+			}
+			v = v * 10 + (*p - '0');
+			if (point) {
+				dec++;
+			}
+		}
+		else {
+			return ESP_FAIL;
+		}
+	}
+	if (!any) {
+		return ESP_FAIL;
+	}
+
+	for (; dec < decimals; dec++) {
+		if (v > INT32_MAX / 10) {
+			return ESP_FAIL;
+		}
+		v *= 10;
+	}
+	*out = neg ? -v : v;
+	return ESP_OK;
+}
@@ -0,0 +1,337 @@
+/*
+ * outbox_if.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Files:
+ *  	OUTBOX_DATA_FILE 	records, each terminated by '\n', append only
+ *  	OUTBOX_CURSOR_FILE 	two outbox_cursor_t slots written alternately,
+ *  						so a torn write always leaves the other slot
+ *  						intact. The valid slot with the higher sequence
+ *  						number wins.
+ *
+ *  Once every record has been replayed the data file is deleted and the
+ *  cursor goes back to zero.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/unistd.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+#include "app_utils.h"
+#include "mqtt_if.h"
+#include "wifi_manager.h"
+#include "outbox_if.h"
+
+#define OUTBOX_CURSOR_MAGIC		0x584F4255	/* "UBOX" */
+#define OUTBOX_IDLE_DELAY		(5 * ONE_SECOND_DELAY)
+#define OUTBOX_MUTEX_WAIT		(5 * ONE_SECOND_DELAY)
+
+typedef struct {
+	uint32_t magic;
+	uint32_t seq;
+	uint32_t offset;
+	uint32_t check;
+} outbox_cursor_t;
+
+static const char *TAG = "OUTBOX";
+
+static SemaphoreHandle_t outbox_mutex = NULL;
+static uint32_t cursor_seq = 0;
+static outbox_stats_t stats;
+static char replay_buf[CONFIG_MQTT_BATCH_MAX_BYTES];
+static bool tail_dirty = false;		/* last append may have left a partial line */
+
+static void outbox_task(void *pvParameters);
+
+
+static uint32_t cursor_check(const outbox_cursor_t *c)
+{
+	return ~(c->magic ^ c->seq ^ c->offset);
+}
+
+/*
+ * Read both slots and return the newest valid offset, 0 if there is none
+ */
+static uint32_t cursor_load(void)
+{
+	outbox_cursor_t slot[2];
+	uint32_t offset = 0;
+	FILE *f;
+	int i, n;
+
+	cursor_seq = 0;
+	if ((f = fopen(OUTBOX_CURSOR_FILE, "r")) == NULL) {
+		return 0;
+	}
+	n = fread(slot, sizeof(outbox_cursor_t), 2, f);
+	fclose(f);
+
+	for (i = 0; i < n; i++) {
+		if (slot[i].magic != OUTBOX_CURSOR_MAGIC || slot[i].check != cursor_check(&slot[i])) {
+			continue;
+		}
+		if (slot[i].seq >= cursor_seq) {
+			cursor_seq = slot[i].seq;
+			offset = slot[i].offset;
+		}
+	}
+	return offset;
+}
+
+/*
+ * Write the next sequence number into the slot the previous write didn't use
+ */
+static esp_err_t cursor_store(uint32_t offset)
+{
+	outbox_cursor_t c;
+	FILE *f;
+
+	c.magic = OUTBOX_CURSOR_MAGIC;
+	c.seq = cursor_seq + 1;
+	c.offset = offset;
+	c.check = cursor_check(&c);
+
+	if ((f = fopen(OUTBOX_CURSOR_FILE, "r+")) == NULL &&
+		(f = fopen(OUTBOX_CURSOR_FILE, "w+")) == NULL) {
+		ESP_LOGE(TAG, "Can't open %s", OUTBOX_CURSOR_FILE);
+		return ESP_FAIL;
+	}
+
+	if (fseek(f, (c.seq & 1) * sizeof(c), SEEK_SET) != 0 ||
+		fwrite(&c, sizeof(c), 1, f) != 1) {
+		fclose(f);
+		ESP_LOGE(TAG, "Can't write %s", OUTBOX_CURSOR_FILE);
+		return ESP_FAIL;
+	}
+	fflush(f);
+	fsync(fileno(f));
+	fclose(f);
+
+	cursor_seq = c.seq;
+	stats.cursor = offset;
+	return ESP_OK;
+}
+
+static uint32_t data_size(void)
+{
+	struct stat st;
+	return (stat(OUTBOX_DATA_FILE, &st) == 0) ? st.st_size : 0;
+}
+
+/*
+ * Whether the data file ends part way through a record, e.g. when power
+ * was lost during an append
+ */
+static bool data_torn(uint32_t size)
+{
+	FILE *f;
+	int c = '\n';
+
+	if (size == 0 || (f = fopen(OUTBOX_DATA_FILE, "r")) == NULL) {
+		return false;
+	}
+	if (fseek(f, size - 1, SEEK_SET) == 0) {
+		c = fgetc(f);
+	}
+	fclose(f);
+	return c != '\n';
+}
+
+/*
+ * Read up to CONFIG_OUTBOX_REPLAY_RECORDS whole records starting at the
+ * cursor into replay_buf, newline separated. Returns the number of bytes
+ * consumed from the file (0 if there's nothing to send) and the record
+ * count in *records.
+ */
+static size_t read_chunk(uint32_t cursor, int *records)
+{
+	FILE *f;
+	size_t n, i, end = 0;
+
+	*records = 0;
+	if ((f = fopen(OUTBOX_DATA_FILE, "r")) == NULL) {
+		return 0;
+	}
+	if (fseek(f, cursor, SEEK_SET) != 0) {
+		fclose(f);
+		return 0;
+	}
+	n = fread(replay_buf, 1, sizeof(replay_buf) - 1, f);
+	fclose(f);
+
+	for (i = 0; i < n && *records < CONFIG_OUTBOX_REPLAY_RECORDS; i++) {
+		if (replay_buf[i] == '\n') {
+			end = i + 1;
+			(*records)++;
+		}
+	}
+
+	if (end == 0 && n == sizeof(replay_buf) - 1) {
+		// A record longer than the buffer can never be sent: skip it
+		ESP_LOGE(TAG, "Oversized record at %u, skipping", cursor);
+		for (i = 0; i < n && replay_buf[i] != '\n'; i++);
+		return (i < n) ? i + 1 : n;
+	}
+
+	// Drop the final newline, MQTT_Publish_Data() wants separators only
+	if (end > 0) {
+		replay_buf[end - 1] = '\0';
+	}
+	return end;
+}
+
+/*
+ * Replay task: while MQTT is up, send the oldest records at a bounded rate
+ * so live publishing always gets its share of the link.
+ */
+static void outbox_task(void *pvParameters)
+{
+	uint32_t cursor;
+	size_t consumed;
+	int records, msg_id;
+
+	for (;;) {
+		wifi_manager_wait_internet_access();
+
+		if (!MQTT_Is_Connected() || stats.cursor >= stats.size) {
+			vTaskDelay(OUTBOX_IDLE_DELAY);
+			continue;
+		}
+
+		if (xSemaphoreTake(outbox_mutex, OUTBOX_MUTEX_WAIT) != pdTRUE) {
+			continue;
+		}
+
+		cursor = stats.cursor;
+		consumed = read_chunk(cursor, &records);
+		if (consumed == 0) {
+			// Cursor is past the last complete record
+			stats.size = data_size();
+			if (stats.cursor >= stats.size) {
+				xSemaphoreGive(outbox_mutex);
+				continue;
+			}
+			ESP_LOGW(TAG, "Partial record at %u, dropping tail", cursor);
+			cursor_store(stats.size);
+		}
+		else if (records == 0) {
+			cursor_store(cursor + consumed);
+		}
+		else {
+			msg_id = MQTT_Publish_Data(replay_buf);
+			if (msg_id >= 0) {
+				cursor_store(cursor + consumed);
+				stats.replayed += records;
+				ESP_LOGI(TAG, "Replayed %d records, %u/%u bytes", records, stats.cursor, stats.size);
+			}
+		}
+
+		// Everything sent: start over with an empty file
+		if (stats.cursor >= stats.size) {
+			remove(OUTBOX_DATA_FILE);
+			stats.size = 0;
+			tail_dirty = false;
+			cursor_store(0);
+			ESP_LOGI(TAG, "Outbox drained");
+		}
+
+		xSemaphoreGive(outbox_mutex);
+		vTaskDelay(CONFIG_OUTBOX_REPLAY_INTERVAL_MS / portTICK_PERIOD_MS);
+	}
+}
+
+
+esp_err_t OUTBOX_Initialize(void)
+{
+	struct stat st;
+	FILE *f;
+
+	// No card: leave the outbox off, OUTBOX_Append() refuses everything
+	if ((f = fopen(OUTBOX_CURSOR_FILE, "a")) == NULL) {
+		ESP_LOGE(TAG, "Can't open %s", OUTBOX_CURSOR_FILE);
+		return ESP_FAIL;
+	}
+	fclose(f);
+	if (stat(OUTBOX_DATA_FILE, &st) != 0 && errno != ENOENT) {
+		ESP_LOGE(TAG, "Can't stat %s", OUTBOX_DATA_FILE);
+		return ESP_FAIL;
+	}
+
+	if (outbox_mutex == NULL) {
+		outbox_mutex = xSemaphoreCreateMutex();
+	}
+
+	stats.size = data_size();
+	stats.cursor = cursor_load();
+	tail_dirty = data_torn(stats.size);
+	if (stats.cursor > stats.size) {
+		// Data file was removed but the cursor reset never made it
+		cursor_store(0);
+	}
+
+	ESP_LOGI(TAG, "Outbox holds %u unsent bytes", stats.size - stats.cursor);
+	xTaskCreate(&outbox_task, "outbox_task", 4096, NULL, 1, NULL);
+	return ESP_OK;
+}
+
+
+esp_err_t OUTBOX_Append(const char *records, size_t len)
+{
+	esp_err_t err = ESP_OK;
+	size_t i;
+	FILE *f;
+
+	if (outbox_mutex == NULL || len == 0) {
+		return ESP_FAIL;
+	}
+
+	if (xSemaphoreTake(outbox_mutex, OUTBOX_MUTEX_WAIT) != pdTRUE) {
+		return ESP_FAIL;
+	}
+
+	if (stats.size + len + 1 > CONFIG_OUTBOX_MAX_SIZE_KB * 1024) {
+		for (i = 0; i < len; i++) {
+			if (records[i] == '\n') stats.rejected++;
+		}
+		stats.rejected++;
+		err = ESP_ERR_NO_MEM;
+	}
+	else if ((f = fopen(OUTBOX_DATA_FILE, "a")) == NULL) {
+		ESP_LOGE(TAG, "Can't open %s", OUTBOX_DATA_FILE);
+		err = ESP_FAIL;
+	}
+	else {
+		// Keep whatever a failed write left behind on a line of its own
+		if (tail_dirty && fputc('\n', f) != EOF) {
+			tail_dirty = false;
+		}
+		if (fwrite(records, 1, len, f) != len || fputc('\n', f) == EOF) {
+			tail_dirty = true;
+			err = ESP_FAIL;
+		}
+		fclose(f);
+
+		stats.size = data_size();
+		if (err == ESP_OK) {
+			for (i = 0; i < len; i++) {
+				if (records[i] == '\n') stats.appended++;
+			}
+			stats.appended++;
+		}
+	}
+
+	xSemaphoreGive(outbox_mutex);
+	return err;
+}
+
+void OUTBOX_GetStats(outbox_stats_t *out)
+{
+	*out = stats;
+}
@@ -0,0 +1,367 @@
+/*
+ * pipeline_if.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
+
+#include "app_utils.h"
+#include "mqtt_if.h"
+#include "wifi_manager.h"
+#include "sd_if.h"
+#include "encoder_if.h"
+#include "pipeline_if.h"
+
+static const char *TAG = "PIPELINE";
+
+extern time_t last_publish;
+
+static QueueHandle_t sample_q = NULL;
+static QueueHandle_t agg_q = NULL;
+static QueueHandle_t mqtt_q = NULL;
+#ifdef CONFIG_SD_DATA_STORE
+static QueueHandle_t sd_q = NULL;
+#endif
+static pipeline_stats_t stats;
+
+static void aggregate_task(void *pvParameters);
+static void serialize_task(void *pvParameters);
+static void mqtt_sink_task(void *pvParameters);
+#ifdef CONFIG_SD_DATA_STORE
+static void sd_sink_task(void *pvParameters);
+#endif
+
+
+/*
+* @brief	Clear the running sums
+*/
+void pipeline_agg_reset(pipeline_agg_t *agg)
+{
+	memset(agg, 0, sizeof(*agg));
+}
+
+/*
+* @brief	Fold one acquisition into the running sums. PM and the
+* 			particle counts are weighted by the number of frames behind
+* 			them, every other averaged field counts once per valid
+* 			sample. Position and time are taken
+* 			from the newest sample that has them, window statistics from
+* 			the sample that closes the window.
+*/
+void pipeline_agg_add(pipeline_agg_t *agg, const airu_sample_t *s)
+{
+	int i;
+
+	if (agg->n == 0) {
+		agg->last = *s;
+	}
+	agg->n++;
+	agg->last.ts_us = s->ts_us;
+	agg->last.utc_ms = s->utc_ms;
+
+	if (s->valid & AIRU_FIELD_POS) {
+		agg->last.alt = s->alt;
+		agg->last.lat = s->lat;
+		agg->last.lon = s->lon;
+		memcpy(agg->last.geohash, s->geohash, sizeof(s->geohash));
+	}
+	if (s->valid & (AIRU_FIELD_DATE | AIRU_FIELD_TIME)) {
+		agg->last.year  = s->year;
+		agg->last.month = s->month;
+		agg->last.day   = s->day;
+		agg->last.hour  = s->hour;
+		agg->last.min   = s->min;
+		agg->last.sec   = s->sec;
+	}
+	if ((s->valid & AIRU_FIELD_PM) && s->pm_count > 0) {
+		agg->pm1   += (double) s->pm1   * s->pm_count;
+		agg->pm2_5 += (double) s->pm2_5 * s->pm_count;
+		agg->pm10  += (double) s->pm10  * s->pm_count;
+		agg->pm1_atm   += (double) s->pm1_atm   * s->pm_count;
+		agg->pm2_5_atm += (double) s->pm2_5_atm * s->pm_count;
+		agg->pm10_atm  += (double) s->pm10_atm  * s->pm_count;
+		agg->pm_count += s->pm_count;
+	}
+	if ((s->valid & AIRU_FIELD_PN) && s->pn_count > 0) {
+		for (i = 0; i < AIRU_PN_BINS; i++) {
+			agg->pn[i] += (double) s->pn[i] * s->pn_count;
+		}
+		agg->pn_count += s->pn_count;
+	}
+	if (s->valid & AIRU_FIELD_TEMP) {
+		agg->temp += s->temp;
+		agg->n_temp++;
+	}
+	if (s->valid & AIRU_FIELD_HUM) {
+		agg->hum += s->hum;
+		agg->n_hum++;
+	}
+	if (s->valid & AIRU_FIELD_CO) {
+		agg->co += s->co;
+		agg->n_co++;
+	}
+	if (s->valid & AIRU_FIELD_NOX) {
+		agg->nox += s->nox;
+		agg->n_nox++;
+	}
+	if (s->valid & AIRU_FIELD_STATS) {
+		memcpy(agg->last.stats, s->stats, sizeof(s->stats));
+	}
+	agg->valid |= s->valid;
+}
+
+/*
+* @brief	Produce the aggregated record. Fields with no valid samples in
+* 			the window keep the driver's failure value and lose their bit.
+*/
+void pipeline_agg_result(const pipeline_agg_t *agg, airu_sample_t *out)
+{
+	int i;
+
+	*out = agg->last;
+	out->valid = agg->valid;
+
+	if (agg->pm_count > 0) {
+		out->pm_count = agg->pm_count;
+		out->pm1   = agg->pm1   / agg->pm_count;
+		out->pm2_5 = agg->pm2_5 / agg->pm_count;
+		out->pm10  = agg->pm10  / agg->pm_count;
+		out->pm1_atm   = agg->pm1_atm   / agg->pm_count;
+		out->pm2_5_atm = agg->pm2_5_atm / agg->pm_count;
+		out->pm10_atm  = agg->pm10_atm  / agg->pm_count;
+	}
+	else {
+		out->valid &= ~AIRU_FIELD_PM;
+		out->pm_count = 0;
+		out->pm1 = out->pm2_5 = out->pm10 = -1;
+		out->pm1_atm = out->pm2_5_atm = out->pm10_atm = -1;
+	}
+	if (agg->pn_count > 0) {
+		out->pn_count = agg->pn_count;
+		for (i = 0; i < AIRU_PN_BINS; i++) {
+			out->pn[i] = agg->pn[i] / agg->pn_count;
+		}
+	}
+	else {
+		out->valid &= ~AIRU_FIELD_PN;
+		out->pn_count = 0;
+	}
+	if (agg->n_temp > 0) out->temp = agg->temp / agg->n_temp;
+	if (agg->n_hum > 0)  out->hum  = agg->hum  / agg->n_hum;
+	if (agg->n_co > 0)   out->co   = agg->co   / agg->n_co;
+	if (agg->n_nox > 0)  out->nox  = agg->nox  / agg->n_nox;
+}
+
+/*
+* @brief	Format the record for MQTT (Influx line protocol) and the SD card
+* 			(CSV row or binary record) in one pass. Either output may be NULL.
+*/
+void pipeline_serialize(const airu_sample_t *s, pipeline_mqtt_pkt_t *mqtt, pipeline_sd_pkt_t *sd)
+{
+	esp_err_t err;
+
+#ifdef CONFIG_SD_DATA_BINARY
+	err = ENC_Encode(s, mqtt ? mqtt->line : NULL, sizeof(mqtt->line), NULL, 0);
+	if (sd != NULL) {
+		BINREC_Encode(s, &sd->rec);
+	}
+#else
+	err = ENC_Encode(s, mqtt ? mqtt->line : NULL, sizeof(mqtt->line),
+						sd ? sd->row : NULL, sizeof(sd->row));
+#endif
+	if (err != ESP_OK) {
+		ESP_LOGW(TAG, "Packet truncated");
+	}
+
+	if (sd != NULL) {
+		sd->year  = s->year;
+		sd->month = s->month;
+		sd->day   = s->day;
+	}
+}
+
+
+/*
+ * Aggregation stage: fold PIPELINE_SAMPLES_PER_PUBLISH acquisitions into
+ * one record. A sample carrying window statistics closes the record
+ * early, so a dropped sample doesn't shift every later window.
+ */
+static void aggregate_task(void *pvParameters)
+{
+	pipeline_agg_t agg;
+	airu_sample_t s;
+
+	pipeline_agg_reset(&agg);
+
+	for (;;) {
+		if (xQueueReceive(sample_q, &s, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+
+		pipeline_agg_add(&agg, &s);
+		if (agg.n < PIPELINE_SAMPLES_PER_PUBLISH && !(s.valid & AIRU_FIELD_STATS)) {
+			continue;
+		}
+
+		pipeline_agg_result(&agg, &s);
+		pipeline_agg_reset(&agg);
+
+		if (xQueueSend(agg_q, &s, 0) != pdTRUE) {
+			stats.records_dropped++;
+			ESP_LOGW(TAG, "Serializer behind, record dropped");
+		}
+	}
+}
+
+/*
+ * Serialization stage: format once, fan out to every sink
+ */
+static void serialize_task(void *pvParameters)
+{
+	static pipeline_mqtt_pkt_t mqtt_pkt;
+#ifdef CONFIG_SD_DATA_STORE
+	static pipeline_sd_pkt_t sd_pkt;
+#endif
+	airu_sample_t s;
+
+	for (;;) {
+		if (xQueueReceive(agg_q, &s, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+
+#ifdef CONFIG_SD_DATA_STORE
+		pipeline_serialize(&s, &mqtt_pkt, &sd_pkt);
+		if (xQueueSend(sd_q, &sd_pkt, 0) != pdTRUE) {
+			stats.sd_dropped++;
+			ESP_LOGW(TAG, "SD sink behind, packet dropped");
+		}
+#else
+		pipeline_serialize(&s, &mqtt_pkt, NULL);
+#endif
+		if (xQueueSend(mqtt_q, &mqtt_pkt, 0) != pdTRUE) {
+			stats.mqtt_dropped++;
+			ESP_LOGW(TAG, "MQTT sink behind, packet dropped");
+		}
+	}
+}
+
+/*
+ * MQTT sink. Records are batched according to the CONFIG_MQTT_BATCH_*
+ * limits before they are published.
+ */
+static void mqtt_sink_task(void *pvParameters)
+{
+	static pipeline_mqtt_pkt_t pkt;
+	int err;
+
+	for (;;) {
+		// Wake up at least once a second to flush batches that got old
+		if (xQueueReceive(mqtt_q, &pkt, ONE_SECOND_DELAY) == pdTRUE) {
+			ESP_LOGI(TAG, "MQTT PACKET:\n\r%s", pkt.line);
+			err = MQTT_Batch_Add(pkt.line);
+		}
+		else {
+			err = MQTT_Batch_Poll();
+		}
+
+		if (err > 0) {
+			ESP_LOGI(TAG, "MQTT publish success %d", err);
+			last_publish = esp_timer_get_time() / 1000000;
+		}
+		else if (err < 0) {
+			ESP_LOGI(TAG, "MQTT publish fail %d", err);
+			wifi_manager_check_connection_async();
+		}
+	}
+}
+
+#ifdef CONFIG_SD_DATA_STORE
+/*
+ * SD sink. Rows are buffered by sd_write_data() / sd_write_bin(), see
+ * sd_writer_t.
+ */
+static void sd_sink_task(void *pvParameters)
+{
+	static pipeline_sd_pkt_t pkt;
+
+	for (;;) {
+		// Wake up at least once a second so buffered rows don't sit forever
+		if (xQueueReceive(sd_q, &pkt, ONE_SECOND_DELAY) != pdTRUE) {
+			sd_flush_data(false);
+			continue;
+		}
+
+#ifdef CONFIG_SD_DATA_BINARY
+		sd_write_bin(&pkt.rec, pkt.year, pkt.month, pkt.day);
+#else
+		sd_write_data(pkt.row, pkt.year, pkt.month, pkt.day);
+#endif
+	}
+}
+#endif
+
+
+esp_err_t PIPELINE_Initialize(void)
+{
+	const esp_app_desc_t *app_desc = esp_ota_get_app_description();
+	esp_err_t err;
+
+	err = ENC_Initialize(CONFIG_INFLUX_MEASUREMENT_NAME, DEVICE_MAC, app_desc->version, MQTT_DATA_PUB_TOPIC);
+	if (err != ESP_OK) {
+		return err;
+	}
+#ifdef CONFIG_SD_DATA_BINARY
+	err = BINREC_Initialize(DEVICE_MAC, MQTT_DATA_PUB_TOPIC);
+	if (err != ESP_OK) {
+		return err;
+	}
+#endif
+
+	sample_q = xQueueCreate(PIPELINE_SAMPLE_Q_LEN, sizeof(airu_sample_t));
+	agg_q    = xQueueCreate(PIPELINE_AGG_Q_LEN, sizeof(airu_sample_t));
+	mqtt_q   = xQueueCreate(PIPELINE_SINK_Q_LEN, sizeof(pipeline_mqtt_pkt_t));
+	if (sample_q == NULL || agg_q == NULL || mqtt_q == NULL) {
+		ESP_LOGE(TAG, "Couldn't create pipeline queues");
+		return ESP_ERR_NO_MEM;
+	}
+#ifdef CONFIG_SD_DATA_STORE
+	sd_q = xQueueCreate(PIPELINE_SINK_Q_LEN, sizeof(pipeline_sd_pkt_t));
+	if (sd_q == NULL) {
+		ESP_LOGE(TAG, "Couldn't create SD queue");
+		return ESP_ERR_NO_MEM;
+	}
+#endif
+
+	xTaskCreate(&aggregate_task, "pipe_agg", 3072, NULL, 2, NULL);
+	xTaskCreate(&serialize_task, "pipe_ser", 3072, NULL, 2, NULL);
+	xTaskCreate(&mqtt_sink_task, "pipe_mqtt", 4096, NULL, 1, NULL);
+#ifdef CONFIG_SD_DATA_STORE
+	xTaskCreate(&sd_sink_task, "pipe_sd", 4096, NULL, 1, NULL);
+#endif
+
+	ESP_LOGI(TAG, "Pipeline up, %d sample(s) per publish", PIPELINE_SAMPLES_PER_PUBLISH);
+	return ESP_OK;
+}
+
+esp_err_t PIPELINE_Submit(const airu_sample_t *sample)
+{
+	if (sample_q == NULL || xQueueSend(sample_q, sample, 0) != pdTRUE) {
+		stats.samples_dropped++;
+		return ESP_FAIL;
+	}
+	return ESP_OK;
+}
+
+void PIPELINE_GetStats(pipeline_stats_t *out)
+{
+	*out = stats;
+}
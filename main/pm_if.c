@@ -13,6 +13,7 @@
 * -  finish reset function (need gpios set up)
 */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -20,43 +21,71 @@
 #include "driver/gpio.h"
 #include "driver/uart.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "spsc_ring.h"
 #include "pm_if.h"
 
 #define GPIO_PM_RESET	17
 #define GPIO_PM_SET		5
 #define GPIO_OUTPUT_PIN_SEL ((1ULL << GPIO_PM_RESET) | (1ULL << GPIO_PM_SET))
-#define PM_TIMER_TIMEOUT_MS 5000
+#define PM_STALE_TIMEOUT_US (5000 * 1000LL)
+#define PM_SAMPLE_RING_LEN  128   // Must be a power of two
+#define PM_HAMPEL_K         3     // Allowed deviation, in robust standard deviations
+#define PM_HAMPEL_MIN_DEV   10    // ug/m3; floor so integer steps in clean air pass
+#define PM_STUCK_FLOOR      1     // ug/m3; clean air reads this for hours on end
 
 static const char* TAG_PM = "PM";
 
+#define PM_RING_MASK   (PM_RING_SIZE - 1)
+#define PM_RING_COUNT  ((uint16_t)(pm_ring_head - pm_ring_tail))
+#define PM_RING_AT(i)  (pm_ring[(uint16_t)(pm_ring_tail + (i)) & PM_RING_MASK])
+
 static void _pm_accum_rst(void);
-static esp_err_t get_packet_from_buffer(void);
-static esp_err_t get_data_from_packet(uint8_t *packet);
-static uint8_t pm_checksum();
+static size_t pm_ring_fill(size_t len);
+static void pm_parse_stream(void);
+static esp_err_t get_packet_from_buffer(uint16_t len);
+static uint8_t pm_checksum(uint16_t len);
 static void uart_pm_event_mgr(void *pvParameters);
-static void vTimerCallback(TimerHandle_t xTimer);
 
 /* Global variables */
 static QueueHandle_t pm_event_queue;
-static TimerHandle_t pm_timer;
 static pm_data_t pm_accum;
-static uint8_t pm_buf[BUF_SIZE];
+static int64_t pm_accum_last_us;
+static uint8_t pm_buf[PM_FRAME_MAX_LEN];
+static pm_parse_stats_t pm_stats;
+static stats_t pm_win_pm1, pm_win_pm2_5, pm_win_pm10;	/* data_task only, like pm_accum */
+static pm_filter_t pm_filter;                           /* vPM_task only */
+static pm_model_t pm_model;
 
 /*
- * @brief 	PM data timer callback. If no valid PM data is received
- * 			for PM_TIMER_TIMEOUT_MS then we clear out the pm data accumulator
- * 			to ensure we don't use old stagnant data.
- *
- * @param 	xTimer - the timer handle
- *
- * @return 	N/A
+ * Power manager. With CONFIG_PM_DUTY_CYCLE the sensor sleeps (SET low,
+ * fan and laser off) between measurement windows. Each cycle it is woken,
+ * given CONFIG_PM_SPINUP_S for the fan to settle, and its frames are kept
+ * for CONFIG_PM_MEASURE_S. Frames during spin-up still go through the
+ * filter, so its window describes the air of this wake and not the last
+ * one, but they never reach the accumulator. pm_power is only written by
+ * the timer task.
  */
-static void vTimerCallback(TimerHandle_t xTimer)
-{
-	ESP_LOGI(TAG_PM, "PM Timer Timeout -- Resetting PM Sample Accumulator");
-	xTimerStop(xTimer, 0);
-	_pm_accum_rst();
-}
+static volatile pm_power_t pm_power = PM_POWER_ON;
+static TimerHandle_t pm_power_timer;
+static int64_t pm_stale_us = PM_STALE_TIMEOUT_US;
+
+/*
+ * Bytes from the UART driver are appended at pm_ring_head and consumed from
+ * pm_ring_tail. Both are free running and only ever masked on access, so the
+ * fill level is always (head - tail). The ring survives between UART events,
+ * which lets a frame be split across (or share) any number of events.
+ */
+static uint8_t pm_ring[PM_RING_SIZE];
+static uint16_t pm_ring_head;
+static uint16_t pm_ring_tail;
+
+/*
+ * Decoded frames travel from vPM_task to data_task through this ring.
+ * vPM_task is the only producer and PMS_Poll() the only consumer, so
+ * pm_accum is now private to data_task and needs no locking.
+ */
+SPSC_RING_DEFINE(pm_sample_ring, pm_sample_t, PM_SAMPLE_RING_LEN);
 
 /*
  * @brief	Reset the pm accumulator struct
@@ -67,10 +96,57 @@ static void vTimerCallback(TimerHandle_t xTimer)
  */
 static void _pm_accum_rst()
 {
-	pm_accum.pm1   = 0;
-	pm_accum.pm2_5 = 0;
-	pm_accum.pm10  = 0;
-	pm_accum.sample_count = 0;
+	memset(&pm_accum, 0, sizeof(pm_accum));
+}
+
+/*
+* @brief  Timer callback: advance to the next power state and arm the
+*         timer for its length
+*
+* @param  xTimer - pm_power_timer
+*
+* @return N/A
+*
+*/
+static void pm_power_step(TimerHandle_t xTimer)
+{
+	uint32_t next_s;
+
+	switch(pm_power) {
+	case PM_POWER_SLEEP:
+		PMS_SET(1);
+		pm_power = PM_POWER_SPINUP;
+		next_s = CONFIG_PM_SPINUP_S;
+		break;
+	case PM_POWER_SPINUP:
+		pm_power = PM_POWER_MEASURE;
+		next_s = CONFIG_PM_MEASURE_S;
+		break;
+	default:
+		PMS_SET(0);
+		pm_power = PM_POWER_SLEEP;
+		next_s = CONFIG_PM_CYCLE_S - CONFIG_PM_SPINUP_S - CONFIG_PM_MEASURE_S;
+		break;
+	}
+	ESP_LOGD(TAG_PM, "Power state %d for %us", pm_power, next_s);
+
+	xTimerChangePeriod(xTimer, pdMS_TO_TICKS(next_s * 1000), 0);
+}
+
+/*
+* @brief  Pended by PMS_Measure(), runs in the timer task. The state is
+*         checked again here: the sensor may have woken since the request,
+*         and stepping it then would cut its spin-up short.
+*
+* @param  N/A
+*
+* @return N/A
+*
+*/
+static void pm_power_wake(void *pvParameter1, uint32_t ulParameter2)
+{
+	if(pm_power == PM_POWER_SLEEP)
+		pm_power_step(pm_power_timer);
 }
 
 /*
@@ -108,28 +184,71 @@ esp_err_t PMS_Initialize()
   if(err != ESP_OK)
   		return err;
 
+  PMS_FilterInit(&pm_filter, CONFIG_PM_STUCK_S * 1000000LL);
+
   // create a task to handler UART event from ISR for the PM sensor
   xTaskCreate(uart_pm_event_mgr, "vPM_task", 2048, NULL, 12, NULL);
 
-  // create the timer to determine validity of pm data
-  pm_timer = xTimerCreate("pm_timer",
-						  (PM_TIMER_TIMEOUT_MS / portTICK_PERIOD_MS),
-						  pdFALSE, (void *)NULL,
-						  vTimerCallback);
-
   // clear out the pm data accumulator
   _pm_accum_rst();
+  stats_reset(&pm_win_pm1);
+  stats_reset(&pm_win_pm2_5);
+  stats_reset(&pm_win_pm10);
 
   PMS_GPIOEnable();
   PMS_SET(1);
   PMS_RESET(1);
 
-  // start the first timer
-  xTimerStart(pm_timer, 0);
+#ifdef CONFIG_PM_DUTY_CYCLE
+  if(CONFIG_PM_SPINUP_S + CONFIG_PM_MEASURE_S >= CONFIG_PM_CYCLE_S) {
+    ESP_LOGW(TAG_PM, "Spin-up and measuring don't fit in %us, sensor left on", CONFIG_PM_CYCLE_S);
+  }
+  else {
+    // Starts awake, in its first spin-up
+    pm_power = PM_POWER_SPINUP;
+    pm_power_timer = xTimerCreate("pm_power", pdMS_TO_TICKS(CONFIG_PM_SPINUP_S * 1000),
+                                  pdFALSE, NULL, pm_power_step);
+    if(pm_power_timer == NULL) {
+      pm_power = PM_POWER_ON;
+      return ESP_ERR_NO_MEM;
+    }
+    xTimerStart(pm_power_timer, 0);
+
+    // The newest frames may be a whole sleep old when they are polled
+    pm_stale_us += (CONFIG_PM_CYCLE_S - CONFIG_PM_MEASURE_S) * 1000000LL;
+  }
+#endif
 
   return err;
 }
 
+/*
+* @brief  Start a measurement window now instead of at the end of the
+*         current sleep. The next cycle counts from this wake. A request
+*         that finds the sensor already awake by the time the timer task
+*         runs it has nothing left to do and is dropped.
+*
+* @param  N/A
+*
+* @return ESP_OK, ESP_ERR_INVALID_STATE if the sensor isn't duty
+*         cycled or is already awake, or ESP_FAIL if the timer task's
+*         queue is full
+*
+*/
+esp_err_t PMS_Measure(void)
+{
+	if(pm_power_timer == NULL || pm_power != PM_POWER_SLEEP)
+		return ESP_ERR_INVALID_STATE;
+
+	// Let the timer task run the wake so it stays the only writer
+	return (xTimerPendFunctionCall(pm_power_wake, NULL, 0, 0) == pdPASS) ? ESP_OK : ESP_FAIL;
+}
+
+pm_power_t PMS_PowerState(void)
+{
+	return pm_power;
+}
+
 void PMS_GPIOEnable()
 {
   // SET and RESET GPIOs
@@ -142,24 +261,90 @@ void PMS_GPIOEnable()
   gpio_config(&io_conf);
 }
 
+/*
+* @brief  Drain the sample ring into the accumulator and report the mean.
+*         If no frame arrives for PM_STALE_TIMEOUT_US (plus the sleep
+*         time when duty cycled) the samples before the gap are thrown
+*         away, so we never report old stagnant data.
+*
+* @param  dat - mean PM values and the number of frames they cover
+*
+* @return ESP_OK, or ESP_FAIL if there are no fresh samples
+*
+*/
 esp_err_t PMS_Poll(pm_data_t *dat)
 {
+	pm_sample_t s;
+	int i;
+
+	while(spsc_ring_pop(&pm_sample_ring, &s)) {
+		if(pm_accum.sample_count != 0 && s.ts_us - pm_accum_last_us > pm_stale_us) {
+			ESP_LOGI(TAG_PM, "PM data gap -- Resetting PM Sample Accumulator");
+			_pm_accum_rst();
+		}
+		pm_accum.pm1   += s.pm1;
+		pm_accum.pm2_5 += s.pm2_5;
+		pm_accum.pm10  += s.pm10;
+		pm_accum.pm1_atm   += s.pm1_atm;
+		pm_accum.pm2_5_atm += s.pm2_5_atm;
+		pm_accum.pm10_atm  += s.pm10_atm;
+		if(s.has_pn) {
+			for(i = 0; i < PM_PN_BINS; i++)
+				pm_accum.pn[i] += s.pn[i];
+			pm_accum.pn_count++;
+		}
+		pm_accum.sample_count++;
+		pm_accum_last_us = s.ts_us;
+
+		stats_add(&pm_win_pm1, s.pm1);
+		stats_add(&pm_win_pm2_5, s.pm2_5);
+		stats_add(&pm_win_pm10, s.pm10);
+	}
+
+	if(pm_accum.sample_count != 0 && esp_timer_get_time() - pm_accum_last_us > pm_stale_us) {
+		ESP_LOGI(TAG_PM, "PM data stale -- Resetting PM Sample Accumulator");
+		_pm_accum_rst();
+	}
+
 	if(pm_accum.sample_count == 0) {
+		memset(dat, 0, sizeof(*dat));
 		dat->pm1   = -1;
 		dat->pm2_5 = -1;
 		dat->pm10  = -1;
+		dat->pm1_atm   = -1;
+		dat->pm2_5_atm = -1;
+		dat->pm10_atm  = -1;
 		return ESP_FAIL;
 	}
 
+	dat->sample_count = pm_accum.sample_count;
 	dat->pm1   = pm_accum.pm1   / pm_accum.sample_count;
 	dat->pm2_5 = pm_accum.pm2_5 / pm_accum.sample_count;
 	dat->pm10  = pm_accum.pm10  / pm_accum.sample_count;
+	dat->pm1_atm   = pm_accum.pm1_atm   / pm_accum.sample_count;
+	dat->pm2_5_atm = pm_accum.pm2_5_atm / pm_accum.sample_count;
+	dat->pm10_atm  = pm_accum.pm10_atm  / pm_accum.sample_count;
+
+	dat->pn_count = pm_accum.pn_count;
+	for(i = 0; i < PM_PN_BINS; i++)
+		dat->pn[i] = pm_accum.pn_count ? pm_accum.pn[i] / pm_accum.pn_count : -1;
 
 	_pm_accum_rst();
 
 	return ESP_OK;
 }
 
+void PMS_WindowStats(stats_summary_t *pm1, stats_summary_t *pm2_5, stats_summary_t *pm10)
+{
+	stats_get(&pm_win_pm1, pm1);
+	stats_get(&pm_win_pm2_5, pm2_5);
+	stats_get(&pm_win_pm10, pm10);
+
+	stats_reset(&pm_win_pm1);
+	stats_reset(&pm_win_pm2_5);
+	stats_reset(&pm_win_pm10);
+}
+
 void PMS_RESET(uint32_t level)
 {
   gpio_set_level(GPIO_PM_RESET, level);
@@ -200,24 +385,22 @@ static void uart_pm_event_mgr(void *pvParameters)
       switch(event.type) 
       {
         case UART_DATA:
-          if(event.size == 24) 
-          {
-            uart_read_bytes(PM_UART_CH, pm_buf, event.size, portMAX_DELAY);
-            get_packet_from_buffer();
-          }
-          uart_flush_input(PM_UART_CH);
+          pm_ring_fill(event.size);
+          pm_parse_stream();
           break;
 
         case UART_FIFO_OVF:
           ESP_LOGI(TAG_PM, "hw fifo overflow");
           uart_flush_input(PM_UART_CH);
           xQueueReset(pm_event_queue);
+          pm_ring_tail = pm_ring_head;
           break;
                 
         case UART_BUFFER_FULL:
           ESP_LOGI(TAG_PM, "ring buffer full");
           uart_flush_input(PM_UART_CH);
           xQueueReset(pm_event_queue);
+          pm_ring_tail = pm_ring_head;
           break;
             
         case UART_BREAK:
@@ -244,90 +427,314 @@ static void uart_pm_event_mgr(void *pvParameters)
 
 
 /*
-* @brief
+* @brief  Move up to len bytes from the UART driver into the parse ring.
+*         Whatever doesn't fit stays in the driver buffer and is picked
+*         up with the next event.
 *
-* @param
+* @param  len - number of bytes the driver reported
 *
-* @return
+* @return number of bytes copied into the ring
 *
 */
-static esp_err_t get_packet_from_buffer(){
-  if(pm_buf[0] == 'B' && pm_buf[1] == 'M'){
-	  if(pm_checksum()){
-		  pm_accum.pm1   += (float)((pm_buf[PKT_PM1_HIGH]   << 8) | pm_buf[PKT_PM1_LOW]);
-		  pm_accum.pm2_5 += (float)((pm_buf[PKT_PM2_5_HIGH] << 8) | pm_buf[PKT_PM2_5_LOW]);
-		  pm_accum.pm10  += (float)((pm_buf[PKT_PM10_HIGH]  << 8) | pm_buf[PKT_PM10_LOW]);
-		  pm_accum.sample_count++;
-		  xTimerReset(pm_timer, 0);
-		  return ESP_OK;
-	  }
-  }
-  return ESP_FAIL;
+static size_t pm_ring_fill(size_t len)
+{
+	size_t space, chunk, total = 0;
+	int n;
+
+	space = PM_RING_SIZE - PM_RING_COUNT;
+	if(len > space)
+		len = space;
+
+	while(len > 0) {
+		// Read straight into the ring, at most up to the wrap point
+		chunk = PM_RING_SIZE - (pm_ring_head & PM_RING_MASK);
+		if(chunk > len)
+			chunk = len;
+
+		n = uart_read_bytes(PM_UART_CH, &pm_ring[pm_ring_head & PM_RING_MASK], chunk, 0);
+		if(n <= 0)
+			break;
+
+		pm_ring_head += n;
+		total += n;
+		len -= n;
+	}
+	return total;
 }
 
 
 /*
-* @brief
+* @brief  Consume every complete frame in the ring. The parser hunts for
+*         the "BM" header, sanity checks the length field and checksum
+*         and, on any failure, slides forward a single byte so a header
+*         hiding inside a corrupt frame is not lost. Incomplete frames
+*         are left in the ring for the next call.
 *
-* @param
+* @param  N/A
 *
-* @return
+* @return N/A
 *
 */
-static esp_err_t get_data_from_packet(uint8_t *packet)
+static void pm_parse_stream(void)
 {
-  uint16_t tmp;
-  uint8_t tmp2;
+	uint16_t flen, i;
+
+	while(PM_RING_COUNT >= PM_HDR_LEN) {
+		if(PM_RING_AT(0) != 'B' || PM_RING_AT(1) != 'M') {
+			pm_ring_tail++;
+			pm_stats.bytes_dropped++;
+			continue;
+		}
+
+		// Length field counts the bytes after itself, checksum included.
+		// Only the two frame sizes the sensors send are believed.
+		flen = ((PM_RING_AT(2) << 8) | PM_RING_AT(3)) + PM_HDR_LEN;
+		if(flen != PM_PKT_LEN && flen != PM_PKT_LEN_5003) {
+			pm_ring_tail++;
+			pm_stats.bytes_dropped++;
+			continue;
+		}
+
+		// Wait for the rest of the frame
+		if(PM_RING_COUNT < flen)
+			break;
+
+		for(i = 0; i < flen; i++)
+			pm_buf[i] = PM_RING_AT(i);
+
+		if(pm_checksum(flen)) {
+			get_packet_from_buffer(flen);
+			pm_ring_tail += flen;
+			pm_stats.frames_ok++;
+		}
+		else {
+			pm_ring_tail++;
+			pm_stats.frames_bad++;
+			pm_stats.bytes_dropped++;
+		}
+	}
+}
 
-    
-  if(packet == NULL)
-    return ESP_FAIL;
-
-  // PM1 data
-  tmp = packet[PKT_PM1_HIGH];
-  tmp2 = packet[PKT_PM1_LOW];
-  tmp = tmp << sizeof(uint8_t);
-  tmp = tmp | tmp2;
-  pm_accum.pm1 += tmp;
-
-  // PM2.5 data
-  tmp = packet[PKT_PM2_5_HIGH];
-  tmp2 = packet[PKT_PM2_5_LOW];
-  tmp = tmp << sizeof(uint8_t);
-  tmp = tmp | tmp2;
-  pm_accum.pm2_5 += tmp;
-
-  // PM10 data
-  tmp = packet[PKT_PM10_HIGH] << 8 ;
-  tmp2 = packet[PKT_PM10_LOW];
-  tmp = tmp << sizeof(uint8_t);
-  tmp = tmp | tmp2;
-  pm_accum.pm10 += tmp;
-
-  pm_accum.sample_count++;
-
-  return ESP_OK;
+
+/*
+* @brief  Copy out the parser counters
+*
+* @param  stats - destination
+*
+* @return N/A
+*
+*/
+void PMS_GetParseStats(pm_parse_stats_t *stats)
+{
+	*stats = pm_stats;
+	stats->samples_lost = pm_sample_ring.dropped;
+	stats->stuck = pm_filter.stuck;
+}
+
+
+pm_model_t PMS_Model(void)
+{
+	return pm_model;
+}
+
+
+int PMS_StatusJson(char *buf, size_t len)
+{
+	static const char *models[] = { "unknown", "PMS3003", "PMS5003" };
+	static const char *power[] = { "on", "sleep", "spinup", "measure" };
+	pm_parse_stats_t st;
+
+	PMS_GetParseStats(&st);
+	return snprintf(buf, len,
+			"\"pm\":{\"model\":\"%s\",\"power\":\"%s\",\"spinup_frames\":%u,\"ok\":%u,\"bad\":%u,\"outliers\":%u,\"stuck_frames\":%u,"
+			"\"stuck\":%s,\"lost\":%u}",
+			models[pm_model], power[pm_power], st.frames_spinup, st.frames_ok, st.frames_bad, st.frames_outlier, st.frames_stuck,
+			st.stuck ? "true" : "false", st.samples_lost);
 }
 
 
 /*
-* @brief
+* @brief  Median of n values, n odd and at most PM_HAMPEL_WIN
+*/
+static uint16_t pm_median(const uint16_t *v, int n)
+{
+	uint16_t s[PM_HAMPEL_WIN], x;
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		x = v[i];
+		for (j = i; j > 0 && s[j - 1] > x; j--)
+			s[j] = s[j - 1];
+		s[j] = x;
+	}
+	return s[n / 2];
+}
+
+
+/*
+* @brief  Hampel test of x against one channel's window: an outlier is
+*         more than PM_HAMPEL_K robust standard deviations (1.4826 MAD)
+*         from the median, and at least PM_HAMPEL_MIN_DEV plus a quarter
+*         of the median away.
+*/
+static bool pm_hampel(const uint16_t *win, uint16_t x)
+{
+	uint16_t dev[PM_HAMPEL_WIN];
+	uint32_t med, mad, limit, floor;
+	int i;
+
+	med = pm_median(win, PM_HAMPEL_WIN);
+	for (i = 0; i < PM_HAMPEL_WIN; i++)
+		dev[i] = abs((int) win[i] - (int) med);
+	mad = pm_median(dev, PM_HAMPEL_WIN);
+
+	// k * 1.4826 * MAD, in integers
+	limit = (PM_HAMPEL_K * 14826 * mad + 5000) / 10000;
+	floor = PM_HAMPEL_MIN_DEV + med / 4;
+	if (limit < floor)
+		limit = floor;
+
+	return (uint32_t) abs((int) x - (int) med) > limit;
+}
+
+
+/*
+* @brief  Whether s repeats the first frame of the current run. Particle
+*         counts keep moving in clean air that reads 0 ug/m3 for hours,
+*         so frames that carry them are compared on them too. Without
+*         counts a run at or below PM_STUCK_FLOOR is never a repeat: it
+*         can't be told from clean air.
+*/
+static bool pm_same_run(const pm_filter_t *f, const pm_sample_t *s)
+{
+	const pm_sample_t *r = &f->run;
+
+	if (r->ts_us == 0 || s->pm1 != r->pm1 || s->pm2_5 != r->pm2_5 || s->pm10 != r->pm10 || s->has_pn != r->has_pn)
+		return false;
+	if (s->has_pn)
+		return memcmp(s->pn, r->pn, sizeof(s->pn)) == 0;
+	return s->pm1 > PM_STUCK_FLOOR || s->pm2_5 > PM_STUCK_FLOOR || s->pm10 > PM_STUCK_FLOOR;
+}
+
+
+void PMS_FilterInit(pm_filter_t *f, int64_t stuck_us)
+{
+	memset(f, 0, sizeof(*f));
+	f->stuck_us = stuck_us;
+}
+
+
+pm_verdict_t PMS_FilterFrame(pm_filter_t *f, const pm_sample_t *s)
+{
+	const uint16_t v[3] = { s->pm1, s->pm2_5, s->pm10 };
+	bool outlier = false;
+	int i;
+
+	// Stuck: every value identical to the first frame of the run, for too long
+	if (!pm_same_run(f, s)) {
+		if (f->stuck)
+			ESP_LOGI(TAG_PM, "PM sensor values changing again");
+		f->run = *s;
+		f->stuck = false;
+	}
+	else if (!f->stuck && f->stuck_us > 0 && s->ts_us - f->run.ts_us > f->stuck_us) {
+		ESP_LOGW(TAG_PM, "PM sensor stuck at %u/%u/%u", s->pm1, s->pm2_5, s->pm10);
+		f->stuck = true;
+	}
+	if (f->stuck)
+		return PM_FRAME_STUCK;
+
+	// Outliers are judged against the frames before, once there are enough
+	if (f->win_len == PM_HAMPEL_WIN) {
+		for (i = 0; i < 3; i++)
+			outlier |= pm_hampel(f->win[i], v[i]);
+	}
+	else {
+		f->win_len++;
+	}
+
+	for (i = 0; i < 3; i++)
+		f->win[i][f->win_next] = v[i];
+	f->win_next = (f->win_next + 1) % PM_HAMPEL_WIN;
+
+	return outlier ? PM_FRAME_OUTLIER : PM_FRAME_OK;
+}
+
+
+/*
+* @brief  Decode the frame in pm_buf and, if the filter keeps it, hand it
+*         to data_task. The frame has already been validated by
+*         pm_parse_stream(). The frame length tells the model apart.
 *
-* @param
+* @param  len - frame length, PM_PKT_LEN or PM_PKT_LEN_5003
 *
-* @return
+* @return ESP_OK, or ESP_FAIL if the frame was rejected or the sample
+*         ring is full
+*
+*/
+static esp_err_t get_packet_from_buffer(uint16_t len){
+	pm_sample_t s;
+	pm_model_t model = (len == PM_PKT_LEN_5003) ? PM_MODEL_PMS5003 : PM_MODEL_PMS3003;
+	int i;
+
+	if(model != pm_model) {
+		ESP_LOGI(TAG_PM, "%s frames", (model == PM_MODEL_PMS5003) ? "PMS5003/7003" : "PMS3003");
+		pm_model = model;
+	}
+
+	s.ts_us = esp_timer_get_time();
+	s.pm1   = (pm_buf[PKT_PM1_HIGH]   << 8) | pm_buf[PKT_PM1_LOW];
+	s.pm2_5 = (pm_buf[PKT_PM2_5_HIGH] << 8) | pm_buf[PKT_PM2_5_LOW];
+	s.pm10  = (pm_buf[PKT_PM10_HIGH]  << 8) | pm_buf[PKT_PM10_LOW];
+	s.pm1_atm   = (pm_buf[PKT_ATM_PM1_HIGH]     << 8) | pm_buf[PKT_ATM_PM1_HIGH + 1];
+	s.pm2_5_atm = (pm_buf[PKT_ATM_PM1_HIGH + 2] << 8) | pm_buf[PKT_ATM_PM1_HIGH + 3];
+	s.pm10_atm  = (pm_buf[PKT_ATM_PM1_HIGH + 4] << 8) | pm_buf[PKT_ATM_PM1_HIGH + 5];
+
+	// The PMS3003 has reserved words where the counts would be
+	s.has_pn = (model == PM_MODEL_PMS5003);
+	for(i = 0; i < PM_PN_BINS; i++)
+		s.pn[i] = s.has_pn ? (pm_buf[PKT_PN_HIGH + 2 * i] << 8) | pm_buf[PKT_PN_HIGH + 2 * i + 1] : 0;
+
+	switch(PMS_FilterFrame(&pm_filter, &s)) {
+	case PM_FRAME_OUTLIER:
+		pm_stats.frames_outlier++;
+		return ESP_FAIL;
+	case PM_FRAME_STUCK:
+		pm_stats.frames_stuck++;
+		return ESP_FAIL;
+	default:
+		break;
+	}
+
+	// Fan still settling, or frames that were in flight as it went to sleep
+	if(pm_power != PM_POWER_ON && pm_power != PM_POWER_MEASURE) {
+		pm_stats.frames_spinup++;
+		return ESP_FAIL;
+	}
+
+	return spsc_ring_push(&pm_sample_ring, &s) ? ESP_OK : ESP_FAIL;
+}
+
+
+/*
+* @brief  Verify the frame checksum: the last two bytes hold the 16 bit
+*         sum of every byte before them.
+*
+* @param  len - full frame length, header and checksum included
+*
+* @return 1 if the checksum matches, 0 otherwise
 *
 */
-static uint8_t pm_checksum()
+static uint8_t pm_checksum(uint16_t len)
 {
 	uint16_t checksum;
 	uint16_t sum = 0;
 	uint16_t i;
 
-	checksum = ((uint16_t) pm_buf[PM_PKT_LEN-2]) << 8;
-	checksum += (uint16_t) pm_buf[PM_PKT_LEN-1];
+	checksum = ((uint16_t) pm_buf[len-2]) << 8;
+	checksum += (uint16_t) pm_buf[len-1];
 
-	for(i = 0; i < PM_PKT_LEN-2 ; i++)
+	for(i = 0; i < len-2 ; i++)
 		sum += pm_buf[i];
 
 	return (sum == checksum);
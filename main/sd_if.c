@@ -13,34 +13,42 @@
 #include <sys/stat.h>
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_vfs_fat.h"
 #include "driver/sdmmc_host.h"
 #include "driver/sdspi_host.h"
 #include "sdmmc_cmd.h"
 #include "sd_if.h"
 #include "gps_if.h"
+#include "log_ring.h"
+#include "log_rotate.h"
 
-#define SD_LOG_FILE_NAME 				"/sdcard/LOGGING-0.log"
-#define SD_LOG_FILE_MOST_RECENT_NAME 	"/sdcard/LOGGING-15.log"
-#define SD_LOG_FILE_FORMAT 				"/sdcard/LOGGING-%02d.log"
+#define SD_LOG_FILE_FORMAT 				SD_MOUNT_POINT "/LOGGING-%02d.log"
+#define SD_LOG_POINTER_FILE 			SD_MOUNT_POINT "/LOGGING.ptr"
 #define MOUNT_CONFIG_MAXFILE 			20
-#define MOUNT_CONFIG_MAXLOGFILE 		15
 #define MAX_FILE_SIZE_MB 				1
 #define MAX_LOG_PKG_LENGTH 				256
 //#define SD_LOG 							0	/* moved to menuconfig */
 
-// Maximum time to wait for the mutex in a logging statement.
-#define MAX_MUTEX_WAIT_MS 30
-#define MAX_MUTEX_WAIT_TICKS ((MAX_MUTEX_WAIT_MS + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS)
+#define SD_LOG_BLOCK_SIZE 				4096
 
 static const char *TAG = "SD";
 static sdmmc_card_t* card = NULL;
-SemaphoreHandle_t s_log_mutex = NULL;
-// Share object, need synchronization
-static FILE *_semaphoreLogFileInstance;
 
 static bool fs_mounted = false;
 
+#ifdef CONFIG_SD_CARD_DEBUG
+#if (CONFIG_SD_LOG_RING_SIZE & (CONFIG_SD_LOG_RING_SIZE - 1)) != 0
+#error "CONFIG_SD_LOG_RING_SIZE must be a power of two"
+#endif
+static uint64_t log_ring_storage[CONFIG_SD_LOG_RING_SIZE / sizeof(uint64_t)];
+static log_ring_t log_ring;
+static log_rotate_t log_files;
+static void sd_log_task(void *pvParameters);
+#endif
+
 //int lineCount(char* filename);
 //int deleteLineInFile(char* filename, int deleteLine);
 
@@ -115,7 +123,7 @@ esp_err_t SD_Initialize(void)
     // Please check its source code and implement error recovery when developing
     // production applications.
 
-    esp_err_t ret = esp_vfs_fat_sdmmc_mount("/sdcard", &host, &slot_config, &mount_config, &card);
+    esp_err_t ret = esp_vfs_fat_sdmmc_mount(SD_MOUNT_POINT, &host, &slot_config, &mount_config, &card);
 
     if (ret != ESP_OK) {
         if (ret == ESP_FAIL) {
@@ -132,9 +140,18 @@ esp_err_t SD_Initialize(void)
     sdmmc_card_print_info(stdout, card);
 
 #ifdef CONFIG_SD_CARD_DEBUG
-	printf("Setting sd card as logger...\n\r");
-	esp_log_set_vprintf(esp_sd_log_write);
-	periodic_timer_callback(NULL);
+	if (log_ring.buf == NULL) {
+		printf("Setting sd card as logger...\n\r");
+		log_rotate_init(&log_files, SD_LOG_FILE_FORMAT, SD_LOG_POINTER_FILE,
+						CONFIG_SD_LOG_FILE_COUNT, CONFIG_SD_LOG_FILE_SIZE_KB * 1024);
+		if (log_ring_init(&log_ring, log_ring_storage, sizeof(log_ring_storage)) == ESP_OK) {
+			xTaskCreate(&sd_log_task, "sd_log_task", 3072, NULL, 1, NULL);
+			esp_log_set_vprintf(esp_sd_log_write);
+		}
+		else {
+			printf("Couldn't set up the SD log buffer, logging to stdout\n\r");
+		}
+	}
 #endif
     fs_mounted = true;
     return ret;
@@ -147,174 +164,321 @@ esp_err_t sd_deinit(void)
 }
 
 /*
- * Currently the date comes exclusively from the GPS module. I'm doing this
- * because I don't want the date and time to jump between NTP and GPS, and I
- * believe GPS is a local time. GPS should always be correct as long as there's
- * a battery, so I don't think it will be a big deal.
+ * Open (or create) the daily file for the given date. The header is only
+ * written when the file is new; after that the writer remembers it.
  */
-esp_err_t sd_write_data(char* pkt, uint8_t year, uint8_t month, uint8_t day)
+static esp_err_t sd_writer_open(sd_writer_t *w, uint8_t year, uint8_t month, uint8_t day)
 {
-//	esp_err_t err = ESP_FAIL;
-//	time_t now; /* time_t == long */
-//	struct tm timeinfo;
-    struct stat st;
-    char filename[64];
-
-    ESP_LOGI(TAG, "SD Packet:\n%s", pkt);
-
-	// Files are created daily. Filename is YYYY-MM-DD.csv
-//    time(&now);
-//    localtime_r(&now, &timeinfo);
-//    strftime(filename, sizeof(filename), "/sdcard/%y-%m-%d.csv", &timeinfo);
+	struct stat st;
+	bool exists;
+
+	w->year = year;
+	w->month = month;
+	w->day = day;
+	snprintf(w->name, sizeof(w->name), SD_MOUNT_POINT "/%02d-%02d-%02d.%s", year, month, day, w->ext);
+
+	exists = stat(w->name, &st) == 0 && st.st_size > 0;
+	w->offset = exists ? st.st_size : w->hdr_len;
+	w->f = fopen(w->name, "a");
+	if (w->f == NULL) {
+		ESP_LOGE(TAG, "Failed to open %s...", w->name);
+		return ESP_FAIL;
+	}
+	ESP_LOGI(TAG, "Opened %s (%s)", w->name, exists ? "exists" : "new");
 
-	sprintf(filename, "/sdcard/%02d-%02d-%02d.csv", year, month, day);
+	if (!exists && w->hdr_len > 0) {
+		fwrite(w->hdr, 1, w->hdr_len, w->f);
+	}
+	return ESP_OK;
+}
 
-    ESP_LOGI(TAG, "Filename: %s", filename);
+void sd_writer_init(sd_writer_t *w, const char *ext, const void *hdr, size_t hdr_len)
+{
+	memset(w, 0, sizeof(*w));
+	w->ext = ext;
+	w->hdr = hdr;
+	w->hdr_len = hdr_len;
+}
 
-    // If file doesn't exist, need to add header
-    bool exists = stat(filename, &st) == 0;
-    ESP_LOGI(TAG, "File %s", exists ? "exists" : "does not exist.");
+/*
+ * Write the buffer to the open file and commit it to the card
+ */
+esp_err_t sd_writer_flush(sd_writer_t *w)
+{
+	esp_err_t err = ESP_OK;
 
-    FILE* f = fopen(filename, "a");
-    if (f == NULL) {
-    	ESP_LOGE(TAG, "Failed to open %s...", filename);
-    	return ESP_FAIL;
-    }
+	if (w->len == 0) {
+		return ESP_OK;
+	}
+	if (w->f == NULL) {
+		if (sd_writer_open(w, w->year, w->month, w->day) != ESP_OK) {
+			return ESP_FAIL;
+		}
+		w->offset += w->len;
+	}
 
-    // Write the header if it's a new file
-    if (!exists) {
-    	fprintf(f, "%s", SD_HDR);
-    }
+	if (fwrite(w->buf, 1, w->len, w->f) != w->len || fflush(w->f) != 0) {
+		ESP_LOGE(TAG, "Write to %s failed", w->name);
+		err = ESP_FAIL;
+		// Reopen next time in case the card went away
+		fclose(w->f);
+		w->f = NULL;
+	}
+	else {
+		fsync(fileno(w->f));
+		w->writes++;
+	}
 
-    // Write the data
-    fprintf(f, "%s", pkt);
-    fclose(f);
-    return ESP_OK;
+	w->len = 0;
+	return err;
 }
 
-vprintf_like_t esp_sd_log_write(const char* format, va_list ap)
+void sd_writer_close(sd_writer_t *w)
 {
-	esp_err_t err = ESP_FAIL;
-	FILE *loggingInstance;
-
-	loggingInstance = getLogFileInstance();
-    if (loggingInstance == NULL) {
-    	printf("esp_sd_log_write Failed to retrieve %s...\n", SD_LOG_FILE_NAME);
-        return err;
-    } else {
-
-		vfprintf(_semaphoreLogFileInstance, format, ap);
-		fflush(_semaphoreLogFileInstance);
-		releaseLogFileInstance();
-		err = ESP_OK;
-    }
-	return err;
+	if (sd_writer_flush(w) != ESP_OK && w->len > 0) {
+		ESP_LOGE(TAG, "Dropping %u buffered bytes for %s", w->len, w->name);
+	}
+	w->len = 0;
+	if (w->f != NULL) {
+		fclose(w->f);
+		w->f = NULL;
+	}
 }
 
-// Call back for updating and checking log file name
-void periodic_timer_callback(void* arg)
+esp_err_t sd_writer_append(sd_writer_t *w, const void *rec, size_t len, uint8_t year, uint8_t month, uint8_t day)
 {
-#ifdef CONFIG_SD_CARD_DEBUG
-    bool exists;
-    char SDLogfileName[SD_FILENAME_LENGTH];
-    FILE* logFileInstance = NULL;
-    static bool firstTime = true;
-    static uint8_t logFileCounting = 1;
-    struct stat st;
-    int ret =0 ;
-
-    printf("periodic_timer_callback ENTERRED\n");
-	/*
-		Check for current file size and existence
-		Create new file if size > 2Mb or not exist
-		New file name will be stored in loggingList.txt
-	*/
-    printf("First time: %d\n\r", firstTime);
-	if(!firstTime) {
-		logFileInstance = getLogFileInstance();
+	esp_err_t err = ESP_OK;
+
+	// Date rollover: finish the old file before buffering for the new one.
+	// With the file not open and records waiting, leave the open to the
+	// flush; closing here would drop them.
+	if ((w->f == NULL && w->len == 0) || w->year != year || w->month != month || w->day != day) {
+		sd_writer_close(w);
+		if (sd_writer_open(w, year, month, day) != ESP_OK) {
+			// Keep buffering, the flush will retry the open
+			w->offset = w->hdr_len;
+			err = ESP_FAIL;
+		}
 	}
 
-    exists = stat(SD_LOG_FILE_NAME, &st) == 0;
-	if (st.st_size > MAX_FILE_SIZE_MB * 1024 * 1024) {	// 2 Mb max or Not Exist
-		if (_semaphoreLogFileInstance) {
-			if(!firstTime) {
-				fclose(_semaphoreLogFileInstance);
-				_semaphoreLogFileInstance = NULL;
-				sprintf(SDLogfileName, SD_LOG_FILE_FORMAT, logFileCounting);
-				logFileCounting++;
-				if ((ret = remove(SDLogfileName)) != 0) {
-					printf("%s: ERR cannot REMOVE file [%s]\n", __func__, SDLogfileName);
-				}
-				if ((ret = rename(SD_LOG_FILE_NAME, SDLogfileName)) != 0) {
-					printf("%s: ERR cannot RENAME file [%s]\n", __func__, SDLogfileName);
-				}
-			}
+	if (w->len + len > sizeof(w->buf)) {
+		err = sd_writer_flush(w);
+		if (err != ESP_OK && len <= sizeof(w->buf)) {
+			// Still no card and no room: the oldest records have to go
+			ESP_LOGE(TAG, "Dropping %u buffered bytes for %s", w->len, w->name);
+			w->offset -= w->len;
+			w->len = 0;
 		}
 	}
 
-	if (logFileCounting > MOUNT_CONFIG_MAXLOGFILE) {
-		char oldLogFileName[SD_FILENAME_LENGTH];
-		for (uint8_t i = 1; i > MOUNT_CONFIG_MAXLOGFILE-1; i++) {
-	    	sprintf(SDLogfileName, SD_LOG_FILE_FORMAT, i);
-	    	// Make sure the furthest file get removed
-			if ((ret = remove(SDLogfileName)) != 0) {
-				printf("%s: ERR cannot REMOVE file [%s]\n", __func__, SDLogfileName);
-			}
-	    	sprintf(oldLogFileName, SD_LOG_FILE_FORMAT, i+1);
-	    	// Rename file_i+1 into file_i
-			rename(oldLogFileName, SDLogfileName);
-			if ((ret = rename(SD_LOG_FILE_NAME, SDLogfileName)) != 0) {
-				printf("%s: ERR cannot RENAME file [%s]\n", __func__, SDLogfileName);
-			}
+	if (len > sizeof(w->buf)) {
+		// Too big to buffer at all, write it straight through
+		if (w->f == NULL && sd_writer_open(w, year, month, day) != ESP_OK) {
+			return ESP_FAIL;
 		}
-		// Remove the LOGGING-15.log since its content is copied into LOGGING-14.log previously
-		remove(SD_LOG_FILE_MOST_RECENT_NAME);
-		logFileCounting = 15;
+		fwrite(rec, 1, len, w->f);
+		fflush(w->f);
+		w->offset += len;
+		w->records++;
+		return err;
 	}
 
-    if(firstTime) {
-    	firstTime = false;
-    }
-    else if (logFileInstance != NULL) {
-    	releaseLogFileInstance();
-    }
-    _semaphoreLogFileInstance = logFileInstance;
+	if (w->len == 0) {
+		w->first_us = esp_timer_get_time();
+	}
+	memcpy(w->buf + w->len, rec, len);
+	w->len += len;
+	w->offset += len;
+	w->records++;
+
+	if (sd_writer_poll(w) != ESP_OK) {
+		err = ESP_FAIL;
+	}
+	return err;
+}
+
+/*
+ * Flush if the oldest buffered record has waited long enough
+ */
+esp_err_t sd_writer_poll(sd_writer_t *w)
+{
+	if (w->len > 0 && esp_timer_get_time() - w->first_us >= CONFIG_SD_WRITE_FLUSH_PERIOD * 1000000LL) {
+		return sd_writer_flush(w);
+	}
+	return ESP_OK;
+}
+
+
+/*
+ * The date comes from the sample's UTC time, taken from the device clock
+ * that GPS and SNTP discipline (time_if.h), so it doesn't jump when the
+ * clock switches source.
+ *
+ * Files are created daily. Filename is YY-MM-DD.csv. Rows are buffered by
+ * csv_writer, see sd_writer_t; only the SD sink task may call this.
+ */
+static sd_writer_t csv_writer;
+static bool csv_writer_ready = false;
+
+esp_err_t sd_write_data(char* pkt, uint8_t year, uint8_t month, uint8_t day)
+{
+	if (!csv_writer_ready) {
+		sd_writer_init(&csv_writer, "csv", SD_HDR, strlen(SD_HDR));
+		csv_writer_ready = true;
+	}
+	return sd_writer_append(&csv_writer, pkt, strlen(pkt), year, month, day);
+}
+
+#ifdef CONFIG_SD_DATA_BINARY
+/*
+ * Binary data files (see binrec_if.h). The index writer gets an entry for
+ * every CONFIG_SD_BIN_INDEX_INTERVAL records, counted per file, so the
+ * first record of each day is always indexed.
+ */
+static sd_writer_t bin_writer;
+static sd_writer_t idx_writer;
+static bool bin_writer_ready = false;
+static uint32_t bin_day_records = 0;
+
+esp_err_t sd_write_bin(const binrec_t *rec, uint8_t year, uint8_t month, uint8_t day)
+{
+	binrec_idx_t entry;
+	const void *hdr;
+	size_t hdr_len;
+	esp_err_t err;
+
+	if (!bin_writer_ready) {
+		hdr = BINREC_Header(&hdr_len);
+		sd_writer_init(&bin_writer, "bin", hdr, hdr_len);
+		sd_writer_init(&idx_writer, "idx", BINREC_IndexHeader(), sizeof(binrec_idx_hdr_t));
+		bin_writer_ready = true;
+	}
+
+	if (bin_writer.year != year || bin_writer.month != month || bin_writer.day != day) {
+		bin_day_records = 0;
+	}
+
+	err = sd_writer_append(&bin_writer, rec, sizeof(*rec), year, month, day);
+
+	// Index from where the record landed, the open may have moved it
+	if (bin_day_records++ % CONFIG_SD_BIN_INDEX_INTERVAL == 0) {
+		entry.key = BINREC_Key(rec);
+		entry.offset = bin_writer.offset - sizeof(*rec);
+		sd_writer_append(&idx_writer, &entry, sizeof(entry), year, month, day);
+	}
+	return err;
+}
 #endif
+
+/*
+ * Push buffered rows to the card: all of them if force, otherwise only
+ * once they're CONFIG_SD_WRITE_FLUSH_PERIOD old.
+ */
+esp_err_t sd_flush_data(bool force)
+{
+	esp_err_t err = ESP_OK;
+
+	if (csv_writer_ready) {
+		err = force ? sd_writer_flush(&csv_writer) : sd_writer_poll(&csv_writer);
+	}
+#ifdef CONFIG_SD_DATA_BINARY
+	if (bin_writer_ready) {
+		// Data first, so the index seldom runs ahead of the data on the card
+		if ((force ? sd_writer_flush(&bin_writer) : sd_writer_poll(&bin_writer)) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+		if ((force ? sd_writer_flush(&idx_writer) : sd_writer_poll(&idx_writer)) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+	}
+#endif
+	return err;
 }
 
-FILE *getLogFileInstance() {
-    if (!s_log_mutex) {
-        s_log_mutex = xSemaphoreCreateMutex();
-    }
-    if (xSemaphoreTake(s_log_mutex, MAX_MUTEX_WAIT_TICKS) == pdFALSE) {
-        return NULL;
-    }
+#ifdef CONFIG_SD_CARD_DEBUG
+/*
+ * Log hook, runs on the calling task. Formats the line straight into the
+ * log ring and returns; sd_log_task does the SD card work. Never blocks:
+ * if the ring is full the line is counted as dropped.
+ */
+int esp_sd_log_write(const char* format, va_list ap)
+{
+	log_ring_slot_t slot;
+	va_list ap2;
+	bool cut = false;
+	int len;
+
+	va_copy(ap2, ap);
+	len = vsnprintf(NULL, 0, format, ap2);
+	va_end(ap2);
+	if (len <= 0) {
+		return len;
+	}
+	if (len > MAX_LOG_PKG_LENGTH) {
+		len = MAX_LOG_PKG_LENGTH;
+		cut = true;
+	}
 
-    if(_semaphoreLogFileInstance != NULL) {
-    	return _semaphoreLogFileInstance;
-    } else {
-		_semaphoreLogFileInstance = fopen(SD_LOG_FILE_NAME, "a");
-    	if (_semaphoreLogFileInstance == NULL) {
-    		printf("ERROR opening Log file %s\n", SD_LOG_FILE_NAME);
-    		releaseLogFileInstance();
-    		return NULL;
-    	} else
-    		return _semaphoreLogFileInstance;
-    }
+	// One extra byte for the terminator vsnprintf insists on writing
+	if (!log_ring_reserve(&log_ring, len + 1, &slot)) {
+		return 0;
+	}
+	vsnprintf(slot.data, len + 1, format, ap);
+	// A cut line keeps its end of line, or the next one is glued to it
+	if (cut) {
+		((char *) slot.data)[len - 1] = '\n';
+	}
+	log_ring_commit(&log_ring, &slot, len);
+	return len;
 }
 
-void releaseLogFileInstance() {
-    if( s_log_mutex != NULL ) {
-    	if (_semaphoreLogFileInstance) {
-			fclose(_semaphoreLogFileInstance);
-			_semaphoreLogFileInstance = NULL;
-    	}
-		if(xSemaphoreGive(s_log_mutex) != pdTRUE) {
-			return;
+/*
+ * Log writer. Drains the ring in blocks of up to SD_LOG_BLOCK_SIZE into
+ * the rotating log files (see log_rotate.h).
+ */
+static void sd_log_task(void *pvParameters)
+{
+	static char block[SD_LOG_BLOCK_SIZE];
+	uint32_t reported = 0, dropped;
+	size_t n;
+	int len;
+
+	for (;;) {
+		vTaskDelay(CONFIG_SD_LOG_FLUSH_PERIOD_MS / portTICK_PERIOD_MS);
+
+		while ((n = log_ring_drain(&log_ring, block, sizeof(block))) > 0) {
+			if (log_rotate_write(&log_files, block, n) != ESP_OK) {
+				printf("ERROR writing Log file %s\n", log_files.name);
+			}
+		}
+
+		dropped = log_ring.dropped;
+		if (dropped != reported) {
+			len = snprintf(block, sizeof(block), "[SD log] %u lines dropped (%u total)\n",
+							dropped - reported, dropped);
+			log_rotate_write(&log_files, block, len);
+			reported = dropped;
 		}
-    }
+
+		log_rotate_flush(&log_files);
+	}
+}
+
+uint32_t sd_log_dropped(void)
+{
+	return log_ring.dropped;
+}
+#else
+int esp_sd_log_write(const char* format, va_list ap)
+{
+	return vprintf(format, ap);
 }
 
+uint32_t sd_log_dropped(void)
+{
+	return 0;
+}
+#endif
 
 FILE* sd_fopen(const char* filename)
 {
@@ -329,7 +493,7 @@ FILE* sd_fopen(const char* filename)
 		}
 	}
 
-	if(snprintf(fn_full, SD_FILENAME_LENGTH, "/sdcard/%s", filename) > SD_FILENAME_LENGTH){
+	if(snprintf(fn_full, SD_FILENAME_LENGTH, SD_MOUNT_POINT "/%s", filename) > SD_FILENAME_LENGTH){
 		ESP_LOGE(TAG, "Filename too long: %s", fn_full);
 		return NULL;
 	}
@@ -0,0 +1,50 @@
+/*
+ * seqlock.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "seqlock.h"
+
+void seqlock_write(seqlock_t *sl, const void *src)
+{
+	uint32_t seq = sl->seq;
+
+	__atomic_store_n(&sl->seq, seq + 1, __ATOMIC_RELAXED);
+	// Readers must see the odd count before any of the new bytes
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(sl->data, src, sl->size);
+
+	__atomic_store_n(&sl->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+uint32_t seqlock_read(const seqlock_t *sl, void *dst)
+{
+	uint32_t s1, s2, retries = 0;
+
+	for (;;) {
+		s1 = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE);
+		if ((s1 & 1) == 0) {
+			memcpy(dst, sl->data, sl->size);
+			// The copy must be complete before the count is checked again
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			s2 = __atomic_load_n(&sl->seq, __ATOMIC_RELAXED);
+			if (s1 == s2) {
+				return retries;
+			}
+		}
+
+		if (++retries % SEQLOCK_SPINS == 0) {
+			vTaskDelay(1);
+		}
+	}
+}
+
+uint32_t seqlock_version(const seqlock_t *sl)
+{
+	return __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE) / 2;
+}
@@ -0,0 +1,67 @@
+/*
+ * spsc_ring.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "spsc_ring.h"
+
+#define RING_LOAD_ACQ(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RING_STORE_REL(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+esp_err_t spsc_ring_init(spsc_ring_t *r, void *storage, size_t item_size, uint32_t capacity)
+{
+	if (r == NULL || storage == NULL || item_size == 0 ||
+		capacity == 0 || (capacity & (capacity - 1)) != 0) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	r->buf = storage;
+	r->item_size = item_size;
+	r->mask = capacity - 1;
+	r->head = 0;
+	r->tail = 0;
+	r->dropped = 0;
+	return ESP_OK;
+}
+
+bool spsc_ring_push(spsc_ring_t *r, const void *item)
+{
+	uint32_t head = r->head;
+	uint32_t tail = RING_LOAD_ACQ(&r->tail);
+
+	if (head - tail > r->mask) {
+		r->dropped++;
+		return false;
+	}
+
+	memcpy(&r->buf[(head & r->mask) * r->item_size], item, r->item_size);
+
+	// Publish the item only after it is fully written
+	RING_STORE_REL(&r->head, head + 1);
+	return true;
+}
+
+bool spsc_ring_pop(spsc_ring_t *r, void *item)
+{
+	uint32_t tail = r->tail;
+	uint32_t head = RING_LOAD_ACQ(&r->head);
+
+	if (head == tail) {
+		return false;
+	}
+
+	if (item != NULL) {
+		memcpy(item, &r->buf[(tail & r->mask) * r->item_size], r->item_size);
+	}
+
+	// Hand the slot back only after it has been copied out
+	RING_STORE_REL(&r->tail, tail + 1);
+	return true;
+}
+
+uint32_t spsc_ring_count(const spsc_ring_t *r)
+{
+	return RING_LOAD_ACQ(&r->head) - RING_LOAD_ACQ(&r->tail);
+}
@@ -0,0 +1,169 @@
+/*
+ * stats.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include <math.h>
+#include "stats.h"
+
+/*
+ * Quantile p of the n sorted values in v, interpolating between neighbours
+ */
+static float sorted_quantile(const float *v, uint32_t n, float p)
+{
+	float r = p * (n - 1);
+	uint32_t i = (uint32_t) r;
+
+	if (i + 1 >= n) {
+		return v[n - 1];
+	}
+	return v[i] + (r - i) * (v[i + 1] - v[i]);
+}
+
+/*
+ * Seed the markers from the n sorted first values: ends at min and max,
+ * the middle three as near their desired positions as strict ordering
+ * allows.
+ */
+static void p2_seed(stats_p2_t *e, float p, const float *v, uint32_t n)
+{
+	const float inc[STATS_P2_MARKERS] = { 0, p / 2, p, (1 + p) / 2, 1 };
+	int32_t lo, hi;
+	int i;
+
+	e->p = p;
+	for (i = 0; i < STATS_P2_MARKERS; i++) {
+		e->want[i] = 1 + (n - 1) * inc[i];
+
+		lo = (i == 0) ? 1 : e->pos[i - 1] + 1;
+		hi = n - (STATS_P2_MARKERS - 1 - i);
+		e->pos[i] = (int32_t) lroundf(e->want[i]);
+		if (e->pos[i] < lo) e->pos[i] = lo;
+		if (e->pos[i] > hi) e->pos[i] = hi;
+
+		e->q[i] = v[e->pos[i] - 1];
+	}
+}
+
+/*
+ * Piecewise parabolic prediction of marker i moved by d (+1 or -1)
+ */
+static float p2_parabolic(const stats_p2_t *e, int i, int d)
+{
+	float n0 = e->pos[i - 1], n1 = e->pos[i], n2 = e->pos[i + 1];
+
+	return e->q[i] + d / (n2 - n0) *
+		((n1 - n0 + d) * (e->q[i + 1] - e->q[i]) / (n2 - n1) +
+		 (n2 - n1 - d) * (e->q[i] - e->q[i - 1]) / (n1 - n0));
+}
+
+static void p2_add(stats_p2_t *e, float x)
+{
+	const float inc[STATS_P2_MARKERS] = { 0, e->p / 2, e->p, (1 + e->p) / 2, 1 };
+	float d, qp;
+	int i, k, s;
+
+	// Cell the value falls in, stretching the end markers if needed
+	if (x < e->q[0]) {
+		e->q[0] = x;
+		k = 0;
+	}
+	else if (x >= e->q[4]) {
+		e->q[4] = x;
+		k = 3;
+	}
+	else {
+		for (k = 0; k < 3 && x >= e->q[k + 1]; k++);
+	}
+
+	for (i = k + 1; i < STATS_P2_MARKERS; i++) {
+		e->pos[i]++;
+	}
+	for (i = 0; i < STATS_P2_MARKERS; i++) {
+		e->want[i] += inc[i];
+	}
+
+	// Move each middle marker at most one position toward where it should be
+	for (i = 1; i < STATS_P2_MARKERS - 1; i++) {
+		d = e->want[i] - e->pos[i];
+		if ((d >= 1 && e->pos[i + 1] - e->pos[i] > 1) ||
+			(d <= -1 && e->pos[i - 1] - e->pos[i] < -1)) {
+			s = (d > 0) ? 1 : -1;
+			qp = p2_parabolic(e, i, s);
+			if (e->q[i - 1] < qp && qp < e->q[i + 1]) {
+				e->q[i] = qp;
+			}
+			else {
+				e->q[i] += s * (e->q[i + s] - e->q[i]) / (e->pos[i + s] - e->pos[i]);
+			}
+			e->pos[i] += s;
+		}
+	}
+}
+
+
+void stats_reset(stats_t *s)
+{
+	memset(s, 0, sizeof(*s));
+}
+
+void stats_add(stats_t *s, float x)
+{
+	float d;
+	int i;
+
+	s->n++;
+	if (s->n == 1) {
+		s->min = s->max = x;
+	}
+	else if (x < s->min) {
+		s->min = x;
+	}
+	else if (x > s->max) {
+		s->max = x;
+	}
+
+	d = x - s->mean;
+	s->mean += d / s->n;
+	s->m2 += d * (x - s->mean);
+
+	if (s->n > STATS_EXACT) {
+		p2_add(&s->p50, x);
+		p2_add(&s->p95, x);
+		return;
+	}
+
+	// Insertion into the sorted head
+	for (i = s->n - 1; i > 0 && s->first[i - 1] > x; i--) {
+		s->first[i] = s->first[i - 1];
+	}
+	s->first[i] = x;
+
+	if (s->n == STATS_EXACT) {
+		p2_seed(&s->p50, 0.50f, s->first, STATS_EXACT);
+		p2_seed(&s->p95, 0.95f, s->first, STATS_EXACT);
+	}
+}
+
+void stats_get(const stats_t *s, stats_summary_t *out)
+{
+	out->n = s->n;
+	out->mean = s->mean;
+	out->sd = (s->n > 1) ? sqrtf(s->m2 / (s->n - 1)) : 0;
+	out->min = s->min;
+	out->max = s->max;
+
+	if (s->n == 0) {
+		out->p50 = out->p95 = 0;
+	}
+	else if (s->n <= STATS_EXACT) {
+		out->p50 = sorted_quantile(s->first, s->n, 0.50f);
+		out->p95 = sorted_quantile(s->first, s->n, 0.95f);
+	}
+	else {
+		out->p50 = s->p50.q[2];
+		out->p95 = s->p95.q[2];
+	}
+}
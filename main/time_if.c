@@ -6,12 +6,16 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include <time.h>
 #include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "esp_event_loop.h"
 #include "esp_log.h"
@@ -26,6 +30,15 @@
 #define WIFI_CONNECTED_BIT 	BIT0
 #define GOT_TS_BIT			BIT1
 
+#define TIME_STEP_BACK_MS	30000	/* a clock further ahead than this is stepped back */
+#define TIME_SLEW_PPM		10000	/* backward corrections are absorbed at 1% */
+#define TIME_MIN_SYNC_US	(60 * 1000000LL)
+#define TIME_DRIFT_MIN_US	(600 * 1000000LL)	/* shortest baseline for a drift measurement */
+#define TIME_DRIFT_MAX_PPB	500000
+#define TIME_HOLDOVER_US	(CONFIG_TIME_HOLDOVER_S * 1000000LL)
+#define TIME_SNTP_POLL_MS	60000
+#define TIME_SNTP_JUMP_US	20000	/* system time offset change that means SNTP updated it */
+
 static const unsigned long MS_BETWEEN_NTP_UPDATE = 600000;
 static const unsigned long SEC_JAN1_2018 = 1514764800;
 static const char *TAG = "TIME";
@@ -34,6 +47,24 @@ static clock_t ms_active = 0;
 
 static EventGroupHandle_t ntp_event_group;
 
+/*
+ * UTC(t) = base_ms + (t - base_us) * (1 + drift) + max(slew_ms, -(t - base_us) * 1%)
+ */
+static struct {
+	int64_t base_ms;		/* UTC at base_us */
+	int64_t base_us;		/* esp_timer time of the last correction */
+	int64_t slew_ms;		/* backward correction being absorbed, <= 0 */
+	int32_t drift_ppb;
+	int64_t anchor_ms;		/* earlier reference from the same source, for drift */
+	int64_t anchor_us;
+	time_src_t anchor_src;
+	int64_t last_us[TIME_SRC_GPS + 1];	/* last reference per source */
+	time_status_t st;
+} clk;
+
+static SemaphoreHandle_t clk_mutex = NULL;
+static int64_t sys_off_us;			/* system time - esp_timer at the last SNTP check */
+
 static time_t _sntp_obtain_time(int);
 static void sntp_task(void *pvParameters);
 
@@ -87,6 +118,11 @@ static time_t _sntp_obtain_time(int wait_seconds)
 time_t time_gmtime(void){
 	ESP_LOGI(TAG, "time_gmtime()");
 	clock_t current_ms = clock();
+	int64_t now_ms = TIME_NowMs();
+
+	if (now_ms >= 0) {
+		return now_ms / 1000;
+	}
 
 	// must update using SNTP if over 10 minutes
 	if ((current_ms - ms_active > MS_BETWEEN_NTP_UPDATE) || utc_time < SEC_JAN1_2018){
@@ -106,6 +142,224 @@ time_t time_gmtime(void){
 }
 
 
+static int64_t clk_model(int64_t mono_us)
+{
+	int64_t dt = mono_us - clk.base_us;
+	int64_t ms = clk.base_ms + (dt + dt * clk.drift_ppb / 1000000000LL) / 1000;
+	int64_t slew;
+
+	if (dt > 0 && clk.slew_ms < 0) {
+		slew = -dt * TIME_SLEW_PPM / 1000000000LL;
+		ms += (slew > clk.slew_ms) ? slew : clk.slew_ms;
+	}
+	return ms;
+}
+
+static void clk_drift(int64_t utc_ms, int64_t mono_us, time_src_t src)
+{
+	int64_t dt, ppb;
+
+	if (clk.anchor_src != src) {
+		clk.anchor_src = src;
+		clk.anchor_ms = utc_ms;
+		clk.anchor_us = mono_us;
+		return;
+	}
+
+	dt = mono_us - clk.anchor_us;
+	if (dt < TIME_DRIFT_MIN_US) {
+		return;
+	}
+	ppb = ((utc_ms - clk.anchor_ms) * 1000 - dt) * 1000000000LL / dt;
+	clk.anchor_ms = utc_ms;
+	clk.anchor_us = mono_us;
+
+	if (llabs(ppb) > TIME_DRIFT_MAX_PPB) {
+		ESP_LOGW(TAG, "drift %lld ppb out of range, ignored", ppb);
+		return;
+	}
+	// The first measurement is taken as is, later ones are averaged in
+	clk.drift_ppb = (clk.drift_ppb == 0) ? ppb : clk.drift_ppb + (ppb - clk.drift_ppb) / 4;
+}
+
+/*
+ * TIME_Discipline() waiting at most wait for the clock.
+ * Returns false if it couldn't get it, true if the sync was handled.
+ */
+static bool clk_discipline(int64_t utc_ms, int64_t mono_us, time_src_t src, TickType_t wait)
+{
+	int64_t pred, err;
+
+	if (clk_mutex == NULL || xSemaphoreTake(clk_mutex, wait) != pdTRUE) {
+		return false;
+	}
+
+	if ((clk.last_us[src] != 0 && mono_us - clk.last_us[src] < TIME_MIN_SYNC_US) ||
+		(src == TIME_SRC_SNTP && clk.last_us[TIME_SRC_GPS] != 0 &&
+		 mono_us - clk.last_us[TIME_SRC_GPS] < TIME_HOLDOVER_US)) {
+		xSemaphoreGive(clk_mutex);
+		return true;
+	}
+	clk.last_us[src] = mono_us;
+
+	if (clk.st.syncs == 0) {
+		err = 0;
+		clk.base_ms = utc_ms;
+		clk.slew_ms = 0;
+		ESP_LOGI(TAG, "clock set from %s", (src == TIME_SRC_GPS) ? "GPS" : "SNTP");
+	}
+	else {
+		pred = clk_model(mono_us);
+		err = utc_ms - pred;
+		clk_drift(utc_ms, mono_us, src);
+
+		if (err >= 0 || err < -TIME_STEP_BACK_MS) {
+			if (err < 0) {
+				ESP_LOGW(TAG, "clock %lld ms ahead, stepped back", -err);
+			}
+			clk.base_ms = utc_ms;
+			clk.slew_ms = 0;
+		}
+		else {
+			// Continue from where the clock is and absorb the difference
+			clk.base_ms = pred;
+			clk.slew_ms = err;
+		}
+	}
+	clk.base_us = mono_us;
+
+	clk.st.src = src;
+	clk.st.last_sync_us = mono_us;
+	clk.st.last_err_ms = (err > INT32_MAX) ? INT32_MAX : (err < INT32_MIN) ? INT32_MIN : err;
+	clk.st.drift_ppb = clk.drift_ppb;
+	clk.st.syncs++;
+
+	xSemaphoreGive(clk_mutex);
+	return true;
+}
+
+void TIME_Discipline(int64_t utc_ms, int64_t mono_us, time_src_t src)
+{
+	clk_discipline(utc_ms, mono_us, src, portMAX_DELAY);
+}
+
+/*
+ * TIME_FromMono() waiting at most wait for the clock; -1 if it couldn't
+ * get it either.
+ */
+static int64_t clk_from_mono(int64_t mono_us, TickType_t wait)
+{
+	int64_t ms = -1;
+
+	if (clk_mutex == NULL || xSemaphoreTake(clk_mutex, wait) != pdTRUE) {
+		return -1;
+	}
+	if (clk.st.syncs > 0) {
+		ms = clk_model(mono_us);
+	}
+	xSemaphoreGive(clk_mutex);
+	return ms;
+}
+
+int64_t TIME_FromMono(int64_t mono_us)
+{
+	return clk_from_mono(mono_us, portMAX_DELAY);
+}
+
+int64_t TIME_NowMs(void)
+{
+	return TIME_FromMono(esp_timer_get_time());
+}
+
+int64_t TIME_EpochMs(uint16_t year, uint8_t month, uint8_t day,
+					 uint8_t hour, uint8_t min, uint8_t sec, uint16_t ms)
+{
+	int32_t y = year - (month <= 2);
+	int32_t era, yoe, doy, doe;
+
+	if (year < 1970 || month < 1 || month > 12 || day < 1 || day > 31 ||
+		hour > 23 || min > 59 || sec > 60 || ms > 999) {
+		return -1;
+	}
+
+	// Days from civil, proleptic Gregorian (H. Hinnant)
+	era = y / 400;
+	yoe = y - era * 400;
+	doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return ((((int64_t) era * 146097 + doe - 719468) * 24 + hour) * 60 + min) * 60000LL
+			+ sec * 1000 + ms;
+}
+
+void TIME_Status(time_status_t *status)
+{
+	int64_t now = esp_timer_get_time();
+
+	if (clk_mutex == NULL || xSemaphoreTake(clk_mutex, portMAX_DELAY) != pdTRUE) {
+		memset(status, 0, sizeof(*status));
+		return;
+	}
+	*status = clk.st;
+	xSemaphoreGive(clk_mutex);
+
+	if (status->syncs == 0) {
+		status->state = TIME_UNSET;
+	}
+	else {
+		status->state = (now - status->last_sync_us < TIME_HOLDOVER_US) ? TIME_LOCKED : TIME_HOLDOVER;
+	}
+}
+
+/*
+ * SNTP sets the system time without telling anyone, so watch the offset
+ * between the system time and esp_timer: a jump means SNTP updated it.
+ * If SNTP hasn't set it yet but GPS has set the clock, set it from that.
+ *
+ * Runs in the timer service task, so the clock is only tried, never
+ * waited for; if it's busy the next poll sees the same state and retries.
+ */
+static void sntp_poll_callback(TimerHandle_t xTimer)
+{
+	struct timeval tv;
+	int64_t mono, off, ms;
+
+	mono = esp_timer_get_time();
+	gettimeofday(&tv, NULL);
+	off = (int64_t) tv.tv_sec * 1000000 + tv.tv_usec - mono;
+
+	if (tv.tv_sec < SEC_JAN1_2018) {
+		ms = clk_from_mono(mono, 0);
+		if (ms >= 0) {
+			tv.tv_sec = ms / 1000;
+			tv.tv_usec = (ms % 1000) * 1000;
+			settimeofday(&tv, NULL);
+			sys_off_us = ms * 1000 - mono;
+		}
+		return;
+	}
+
+	if ((sys_off_us == 0 || llabs(off - sys_off_us) > TIME_SNTP_JUMP_US) &&
+		clk_discipline((off + mono) / 1000, mono, TIME_SRC_SNTP, 0)) {
+		sys_off_us = off;
+	}
+}
+
+void TIME_Initialize(void)
+{
+	TimerHandle_t t;
+
+	if (clk_mutex != NULL) {
+		return;
+	}
+	clk_mutex = xSemaphoreCreateMutex();
+
+	t = xTimerCreate("sntp_poll", pdMS_TO_TICKS(TIME_SNTP_POLL_MS), pdTRUE, NULL, sntp_poll_callback);
+	if (t != NULL) {
+		xTimerStart(t, 0);
+	}
+}
+
 void sntp_wifi_connected()
 {
 	xEventGroupSetBits(ntp_event_group, WIFI_CONNECTED_BIT);
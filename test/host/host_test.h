@@ -0,0 +1,67 @@
+/*
+ * host_test.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Checks and timing for the host tests. A failed check prints where it
+ *  is and the test carries on; host_test_done() turns the tally into the
+ *  exit status.
+ */
+
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+static int host_checks;
+static int host_failures;
+
+#define CHECK(cond)																\
+	do {																		\
+		host_checks++;															\
+		if (!(cond)) {															\
+			host_failures++;													\
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);	\
+		}																		\
+	} while (0)
+
+#define CHECK_EQ(a, b)															\
+	do {																		\
+		long long _a = (long long) (a), _b = (long long) (b);					\
+		host_checks++;															\
+		if (_a != _b) {															\
+			host_failures++;													\
+			fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n",	\
+					__FILE__, __LINE__, #a, #b, _a, _b);						\
+		}																		\
+	} while (0)
+
+#define CHECK_NEAR(a, b, tol)													\
+	do {																		\
+		double _a = (a), _b = (b);												\
+		host_checks++;															\
+		if (!(fabs(_a - _b) <= (tol))) {										\
+			host_failures++;													\
+			fprintf(stderr, "%s:%d: check failed: %s ~ %s (%g vs %g, tol %g)\n",	\
+					__FILE__, __LINE__, #a, #b, _a, _b, (double) (tol));		\
+		}																		\
+	} while (0)
+
+/* Monotonic wall time in seconds, for throughput figures */
+static inline double host_seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline int host_test_done(const char *name)
+{
+	printf("%s: %d checks, %d failed\n", name, host_checks, host_failures);
+	return host_failures != 0;
+}
+
+#endif /* HOST_TEST_H_ */
@@ -0,0 +1,31 @@
+/*
+ * sdmmc_host.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in: the SD card is a directory, see esp_vfs_fat.h.
+ */
+
+#ifndef HOST_DRIVER_SDMMC_HOST_H_
+#define HOST_DRIVER_SDMMC_HOST_H_
+
+#include "driver/gpio.h"
+
+typedef struct {
+	int slot;
+} sdmmc_host_t;
+
+typedef struct {
+	int width;
+	gpio_num_t gpio_cd;
+	gpio_num_t gpio_wp;
+} sdmmc_slot_config_t;
+
+#define SDMMC_HOST_DEFAULT()		{ .slot = 1 }
+#define SDMMC_SLOT_CONFIG_DEFAULT()	{ .width = 4, .gpio_cd = -1, .gpio_wp = -1 }
+
+typedef struct {
+	int csd_capacity;
+} sdmmc_card_t;
+
+#endif /* HOST_DRIVER_SDMMC_HOST_H_ */
@@ -0,0 +1,14 @@
+/*
+ * sdspi_host.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in; SPI mode isn't built.
+ */
+
+#ifndef HOST_DRIVER_SDSPI_HOST_H_
+#define HOST_DRIVER_SDSPI_HOST_H_
+
+#include "driver/sdmmc_host.h"
+
+#endif /* HOST_DRIVER_SDSPI_HOST_H_ */
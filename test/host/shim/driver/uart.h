@@ -0,0 +1,72 @@
+/*
+ * uart.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in: each port has a receive buffer that tests fill with
+ *  host_uart_feed(), and a record of what was written to it.
+ */
+
+#ifndef HOST_DRIVER_UART_H_
+#define HOST_DRIVER_UART_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#define UART_PIN_NO_CHANGE	(-1)
+
+typedef enum {
+	UART_NUM_0 = 0,
+	UART_NUM_1,
+	UART_NUM_2,
+	UART_NUM_MAX
+} uart_port_t;
+
+typedef enum { UART_DATA_5_BITS, UART_DATA_6_BITS, UART_DATA_7_BITS, UART_DATA_8_BITS } uart_word_length_t;
+typedef enum { UART_PARITY_DISABLE = 0, UART_PARITY_EVEN = 2, UART_PARITY_ODD = 3 } uart_parity_t;
+typedef enum { UART_STOP_BITS_1 = 1, UART_STOP_BITS_1_5, UART_STOP_BITS_2 } uart_stop_bits_t;
+typedef enum { UART_HW_FLOWCTRL_DISABLE = 0, UART_HW_FLOWCTRL_RTS, UART_HW_FLOWCTRL_CTS } uart_hw_flowcontrol_t;
+
+typedef struct {
+	int baud_rate;
+	uart_word_length_t data_bits;
+	uart_parity_t parity;
+	uart_stop_bits_t stop_bits;
+	uart_hw_flowcontrol_t flow_ctrl;
+	uint8_t rx_flow_ctrl_thresh;
+} uart_config_t;
+
+typedef enum {
+	UART_DATA,
+	UART_BREAK,
+	UART_BUFFER_FULL,
+	UART_FIFO_OVF,
+	UART_FRAME_ERR,
+	UART_PARITY_ERR,
+	UART_DATA_BREAK,
+	UART_PATTERN_DET,
+	UART_EVENT_MAX
+} uart_event_type_t;
+
+typedef struct {
+	uart_event_type_t type;
+	size_t size;
+} uart_event_t;
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t *conf);
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts);
+esp_err_t uart_driver_install(uart_port_t port, int rx_size, int tx_size, int queue_size,
+							  QueueHandle_t *queue, int flags);
+int uart_read_bytes(uart_port_t port, uint8_t *buf, uint32_t len, TickType_t wait);
+int uart_write_bytes(uart_port_t port, const char *src, size_t len);
+esp_err_t uart_flush(uart_port_t port);
+esp_err_t uart_flush_input(uart_port_t port);
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t *size);
+esp_err_t uart_enable_pattern_det_intr(uart_port_t port, char c, uint8_t num, int gap, int post, int pre);
+esp_err_t uart_pattern_queue_reset(uart_port_t port, int len);
+int uart_pattern_pop_pos(uart_port_t port);
+
+#endif /* HOST_DRIVER_UART_H_ */
@@ -0,0 +1,39 @@
+/*
+ * esp_adc_cal.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in: no eFuse values, and a straight calibration line from
+ *  HOST_ADC_CAL_MIN_MV at code 0 to HOST_ADC_CAL_MAX_MV at code 4095,
+ *  truncated to whole mV as the real curve is.
+ */
+
+#ifndef HOST_ESP_ADC_CAL_H_
+#define HOST_ESP_ADC_CAL_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/adc.h"
+
+#define HOST_ADC_CAL_MIN_MV		142
+#define HOST_ADC_CAL_MAX_MV		3150
+
+typedef enum {
+	ESP_ADC_CAL_VAL_EFUSE_VREF = 0,
+	ESP_ADC_CAL_VAL_EFUSE_TP,
+	ESP_ADC_CAL_VAL_DEFAULT_VREF
+} esp_adc_cal_value_t;
+
+typedef struct {
+	adc_unit_t adc_num;
+	adc_atten_t atten;
+	adc_bits_width_t bit_width;
+	uint32_t vref;
+} esp_adc_cal_characteristics_t;
+
+esp_err_t esp_adc_cal_check_efuse(esp_adc_cal_value_t value_type);
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t adc_num, adc_atten_t atten, adc_bits_width_t bit_width,
+											 uint32_t default_vref, esp_adc_cal_characteristics_t *chars);
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t adc_reading, const esp_adc_cal_characteristics_t *chars);
+
+#endif /* HOST_ESP_ADC_CAL_H_ */
@@ -0,0 +1,16 @@
+/*
+ * esp_attr.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in for the ESP-IDF header of the same name.
+ */
+
+#ifndef HOST_ESP_ATTR_H_
+#define HOST_ESP_ATTR_H_
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+
+#endif /* HOST_ESP_ATTR_H_ */
@@ -0,0 +1,18 @@
+/*
+ * esp_event_legacy.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in: just the types wifi_manager.h names.
+ */
+
+#ifndef HOST_ESP_EVENT_LEGACY_H_
+#define HOST_ESP_EVENT_LEGACY_H_
+
+#include <stdint.h>
+
+typedef struct {
+	uint32_t event_id;
+} system_event_t;
+
+#endif /* HOST_ESP_EVENT_LEGACY_H_ */
@@ -0,0 +1,15 @@
+/*
+ * esp_event_loop.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in for the ESP-IDF header of the same name.
+ */
+
+#ifndef HOST_ESP_EVENT_LOOP_H_
+#define HOST_ESP_EVENT_LOOP_H_
+
+#include "esp_err.h"
+#include "esp_event_legacy.h"
+
+#endif /* HOST_ESP_EVENT_LOOP_H_ */
@@ -0,0 +1,39 @@
+/*
+ * esp_log.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in: log lines go to stderr when HOST_LOG is set in the
+ *  environment, and are dropped otherwise.
+ */
+
+#ifndef HOST_ESP_LOG_H_
+#define HOST_ESP_LOG_H_
+
+#include <stdarg.h>
+#include <stdint.h>
+
+typedef enum {
+	ESP_LOG_NONE,
+	ESP_LOG_ERROR,
+	ESP_LOG_WARN,
+	ESP_LOG_INFO,
+	ESP_LOG_DEBUG,
+	ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+typedef int (*vprintf_like_t)(const char *, va_list);
+
+void host_log(char level, const char *tag, const char *format, ...)
+	__attribute__((format(printf, 3, 4)));
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func);
+uint32_t esp_log_timestamp(void);
+
+#define ESP_LOGE(tag, format, ...)	host_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)	host_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)	host_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)	host_log('D', tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)	host_log('V', tag, format, ##__VA_ARGS__)
+
+#endif /* HOST_ESP_LOG_H_ */
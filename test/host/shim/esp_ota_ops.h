@@ -0,0 +1,21 @@
+/*
+ * esp_ota_ops.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in for the ESP-IDF header of the same name.
+ */
+
+#ifndef HOST_ESP_OTA_OPS_H_
+#define HOST_ESP_OTA_OPS_H_
+
+#include "esp_err.h"
+
+typedef struct {
+	char version[32];
+	char project_name[32];
+} esp_app_desc_t;
+
+const esp_app_desc_t *esp_ota_get_app_description(void);
+
+#endif /* HOST_ESP_OTA_OPS_H_ */
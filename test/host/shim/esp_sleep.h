@@ -0,0 +1,14 @@
+/*
+ * esp_sleep.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in for the ESP-IDF header of the same name.
+ */
+
+#ifndef HOST_ESP_SLEEP_H_
+#define HOST_ESP_SLEEP_H_
+
+#include "esp_err.h"
+
+#endif /* HOST_ESP_SLEEP_H_ */
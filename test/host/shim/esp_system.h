@@ -0,0 +1,21 @@
+/*
+ * esp_system.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in for the ESP-IDF header of the same name.
+ */
+
+#ifndef HOST_ESP_SYSTEM_H_
+#define HOST_ESP_SYSTEM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+void esp_restart(void);
+uint32_t esp_get_free_heap_size(void);
+
+#endif /* HOST_ESP_SYSTEM_H_ */
@@ -0,0 +1,16 @@
+/*
+ * esp_timer.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in: the time is the simulated clock in host_shim.h.
+ */
+
+#ifndef HOST_ESP_TIMER_H_
+#define HOST_ESP_TIMER_H_
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
+
+#endif /* HOST_ESP_TIMER_H_ */
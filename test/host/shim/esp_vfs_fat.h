@@ -0,0 +1,28 @@
+/*
+ * esp_vfs_fat.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in. Mounting always succeeds: a test points the mount point
+ *  (SD_MOUNT_POINT) at a directory and the host file system is the card.
+ */
+
+#ifndef HOST_ESP_VFS_FAT_H_
+#define HOST_ESP_VFS_FAT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/sdmmc_host.h"
+
+typedef struct {
+	bool format_if_mount_failed;
+	int max_files;
+	size_t allocation_unit_size;
+} esp_vfs_fat_sdmmc_mount_config_t;
+
+esp_err_t esp_vfs_fat_sdmmc_mount(const char *base_path, const sdmmc_host_t *host, const void *slot_config,
+								  const esp_vfs_fat_sdmmc_mount_config_t *mount_config, sdmmc_card_t **out_card);
+esp_err_t esp_vfs_fat_sdmmc_unmount(void);
+
+#endif /* HOST_ESP_VFS_FAT_H_ */
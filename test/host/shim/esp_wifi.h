@@ -0,0 +1,15 @@
+/*
+ * esp_wifi.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in for the ESP-IDF header of the same name.
+ */
+
+#ifndef HOST_ESP_WIFI_H_
+#define HOST_ESP_WIFI_H_
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#endif /* HOST_ESP_WIFI_H_ */
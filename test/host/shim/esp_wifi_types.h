@@ -0,0 +1,54 @@
+/*
+ * esp_wifi_types.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in: just the types wifi_manager.h names.
+ */
+
+#ifndef HOST_ESP_WIFI_TYPES_H_
+#define HOST_ESP_WIFI_TYPES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+	WIFI_AUTH_OPEN = 0,
+	WIFI_AUTH_WEP,
+	WIFI_AUTH_WPA_PSK,
+	WIFI_AUTH_WPA2_PSK,
+	WIFI_AUTH_WPA_WPA2_PSK,
+	WIFI_AUTH_WPA2_ENTERPRISE
+} wifi_auth_mode_t;
+
+typedef enum {
+	WIFI_BW_HT20 = 1,
+	WIFI_BW_HT40
+} wifi_bandwidth_t;
+
+typedef enum {
+	WIFI_PS_NONE,
+	WIFI_PS_MIN_MODEM,
+	WIFI_PS_MAX_MODEM
+} wifi_ps_type_t;
+
+#define WIFI_PS_MODEM	WIFI_PS_MIN_MODEM
+
+typedef struct {
+	uint8_t bssid[6];
+	uint8_t ssid[33];
+	uint8_t primary;
+	int8_t rssi;
+	wifi_auth_mode_t authmode;
+} wifi_ap_record_t;
+
+typedef struct {
+	uint8_t ssid[32];
+	uint8_t password[64];
+} wifi_sta_config_t;
+
+typedef union {
+	wifi_sta_config_t sta;
+} wifi_config_t;
+
+#endif /* HOST_ESP_WIFI_TYPES_H_ */
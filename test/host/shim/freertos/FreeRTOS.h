@@ -0,0 +1,80 @@
+/*
+ * FreeRTOS.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in for the FreeRTOS types and macros the firmware uses, at
+ *  the ESP-IDF default tick rate of 100 Hz. The kernel objects themselves
+ *  are in host_shim.c.
+ */
+
+#ifndef HOST_FREERTOS_H_
+#define HOST_FREERTOS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef int portMUX_TYPE;
+
+#define portTickType				TickType_t
+#define configTICK_RATE_HZ			100
+#define portTICK_PERIOD_MS			(1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS			portTICK_PERIOD_MS
+#define portMAX_DELAY				((TickType_t) 0xffffffffUL)
+#define pdMS_TO_TICKS(ms)			((TickType_t) (((TickType_t) (ms) * configTICK_RATE_HZ) / 1000))
+
+#define pdFALSE						0
+#define pdTRUE						1
+#define pdFAIL						pdFALSE
+#define pdPASS						pdTRUE
+
+#define portMUX_INITIALIZER_UNLOCKED	0
+#define portENTER_CRITICAL(mux)		((void) (mux))
+#define portEXIT_CRITICAL(mux)		((void) (mux))
+
+#ifndef BIT0
+#define BIT31	0x80000000
+#define BIT30	0x40000000
+#define BIT29	0x20000000
+#define BIT28	0x10000000
+#define BIT27	0x08000000
+#define BIT26	0x04000000
+#define BIT25	0x02000000
+#define BIT24	0x01000000
+#define BIT23	0x00800000
+#define BIT22	0x00400000
+#define BIT21	0x00200000
+#define BIT20	0x00100000
+#define BIT19	0x00080000
+#define BIT18	0x00040000
+#define BIT17	0x00020000
+#define BIT16	0x00010000
+#define BIT15	0x00008000
+#define BIT14	0x00004000
+#define BIT13	0x00002000
+#define BIT12	0x00001000
+#define BIT11	0x00000800
+#define BIT10	0x00000400
+#define BIT9	0x00000200
+#define BIT8	0x00000100
+#define BIT7	0x00000080
+#define BIT6	0x00000040
+#define BIT5	0x00000020
+#define BIT4	0x00000010
+#define BIT3	0x00000008
+#define BIT2	0x00000004
+#define BIT1	0x00000002
+#define BIT0	0x00000001
+#endif
+
+typedef struct host_task *TaskHandle_t;
+typedef struct host_queue *QueueHandle_t;
+typedef struct host_queue *SemaphoreHandle_t;
+typedef struct host_timer *TimerHandle_t;
+
+#endif /* HOST_FREERTOS_H_ */
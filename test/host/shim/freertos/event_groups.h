@@ -0,0 +1,25 @@
+/*
+ * event_groups.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in. Event groups are plain bit sets; a wait never blocks and
+ *  returns the bits as they are.
+ */
+
+#ifndef HOST_FREERTOS_EVENT_GROUPS_H_
+#define HOST_FREERTOS_EVENT_GROUPS_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+typedef struct host_event_group *EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear,
+								BaseType_t all, TickType_t wait);
+
+#endif /* HOST_FREERTOS_EVENT_GROUPS_H_ */
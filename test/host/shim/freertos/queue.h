@@ -0,0 +1,28 @@
+/*
+ * queue.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in. Queues are thread safe, so tests may use them across
+ *  pthreads; a wait is measured in real time at 10 ms per tick.
+ */
+
+#ifndef HOST_FREERTOS_QUEUE_H_
+#define HOST_FREERTOS_QUEUE_H_
+
+#include "freertos/FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t q);
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t wait);
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void *item, TickType_t wait);
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t wait);
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t wait);
+BaseType_t xQueueReset(QueueHandle_t q);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+
+#define xQueueSendToBack(q, item, wait)		xQueueSend((q), (item), (wait))
+#define xQueueSendFromISR(q, item, woken)	xQueueSend((q), (item), 0)
+
+#endif /* HOST_FREERTOS_QUEUE_H_ */
@@ -0,0 +1,25 @@
+/*
+ * semphr.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in: semaphores are counting queues without payload. A
+ *  mutex is a binary semaphore that starts given; there is no priority
+ *  inheritance or recursion.
+ */
+
+#ifndef HOST_FREERTOS_SEMPHR_H_
+#define HOST_FREERTOS_SEMPHR_H_
+
+#include "freertos/queue.h"
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s);
+
+#define xSemaphoreCreateBinary()		xSemaphoreCreateCounting(1, 0)
+#define xSemaphoreCreateMutex()			xSemaphoreCreateCounting(1, 1)
+#define vSemaphoreDelete(s)				vQueueDelete(s)
+#define xSemaphoreGiveFromISR(s, woken)	xSemaphoreGive(s)
+
+#endif /* HOST_FREERTOS_SEMPHR_H_ */
@@ -0,0 +1,29 @@
+/*
+ * timers.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in. Timers run on the simulated clock: host_advance_us()
+ *  fires them, in due order, as it moves the clock past them, and runs
+ *  the pended function calls first, as the timer service task would.
+ */
+
+#ifndef HOST_FREERTOS_TIMERS_H_
+#define HOST_FREERTOS_TIMERS_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t);
+typedef void (*PendedFunction_t)(void *, uint32_t);
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t reload,
+						   void *id, TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t t, TickType_t wait);
+BaseType_t xTimerStop(TimerHandle_t t, TickType_t wait);
+BaseType_t xTimerReset(TimerHandle_t t, TickType_t wait);
+BaseType_t xTimerChangePeriod(TimerHandle_t t, TickType_t period, TickType_t wait);
+BaseType_t xTimerIsTimerActive(TimerHandle_t t);
+void *pvTimerGetTimerID(TimerHandle_t t);
+BaseType_t xTimerPendFunctionCall(PendedFunction_t fn, void *param1, uint32_t param2, TickType_t wait);
+
+#endif /* HOST_FREERTOS_TIMERS_H_ */
@@ -0,0 +1,867 @@
+/*
+ * host_shim.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host implementations behind the headers in this directory. Only what
+ *  the firmware modules under test call is here, and only as much of the
+ *  behaviour as the tests rely on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <sched.h>
+#include <time.h>
+#include "host_shim.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
+#include "freertos/event_groups.h"
+#include "driver/gpio.h"
+#include "driver/adc.h"
+#include "esp_adc_cal.h"
+#include "driver/uart.h"
+#include "esp_vfs_fat.h"
+#include "sdmmc_cmd.h"
+
+#define HOST_UART_BUF		8192
+#define HOST_MAX_TIMERS		16
+#define HOST_MAX_PENDED		16
+
+int64_t host_time_us;
+uint32_t host_gpio_level[GPIO_NUM_MAX];
+
+/* The thread main() runs on; the simulated clock belongs to it */
+static pthread_t host_main;
+
+__attribute__((constructor)) static void host_main_init(void)
+{
+	host_main = pthread_self();
+}
+
+/*
+ * esp_err, esp_log, esp_system, esp_timer
+ */
+const char *esp_err_to_name(esp_err_t code)
+{
+	switch (code) {
+	case ESP_OK:					return "ESP_OK";
+	case ESP_FAIL:					return "ESP_FAIL";
+	case ESP_ERR_NO_MEM:			return "ESP_ERR_NO_MEM";
+	case ESP_ERR_INVALID_ARG:		return "ESP_ERR_INVALID_ARG";
+	case ESP_ERR_INVALID_STATE:		return "ESP_ERR_INVALID_STATE";
+	case ESP_ERR_INVALID_SIZE:		return "ESP_ERR_INVALID_SIZE";
+	case ESP_ERR_NOT_FOUND:			return "ESP_ERR_NOT_FOUND";
+	case ESP_ERR_TIMEOUT:			return "ESP_ERR_TIMEOUT";
+	default:						return "ESP_ERR_UNKNOWN";
+	}
+}
+
+static vprintf_like_t log_vprintf = vprintf;
+
+void host_log(char level, const char *tag, const char *format, ...)
+{
+	static int verbose = -1;
+	va_list ap;
+
+	if (verbose < 0) {
+		verbose = getenv("HOST_LOG") != NULL;
+	}
+	if (!verbose && log_vprintf == vprintf) {
+		return;
+	}
+
+	va_start(ap, format);
+	if (log_vprintf == vprintf) {
+		fprintf(stderr, "%c (%lld) %s: ", level, (long long) (host_time_us / 1000), tag);
+		vfprintf(stderr, format, ap);
+		fputc('\n', stderr);
+	}
+	else {
+		log_vprintf(format, ap);
+	}
+	va_end(ap);
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+}
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+	vprintf_like_t old = log_vprintf;
+
+	log_vprintf = func;
+	return old;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+	return host_time_us / 1000;
+}
+
+void esp_restart(void)
+{
+	fprintf(stderr, "esp_restart()\n");
+	abort();
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+	return 100000;
+}
+
+int64_t esp_timer_get_time(void)
+{
+	return host_time_us;
+}
+
+/*
+ * Tasks
+ */
+struct host_task {
+	const char *name;
+	uint32_t notified;
+	TaskFunction_t fn;
+	void *param;
+};
+
+/* The task host_task_run() is in, and where it leaves when it would block */
+static TaskHandle_t host_current;
+static jmp_buf host_blocked;
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *param,
+					   UBaseType_t prio, TaskHandle_t *handle)
+{
+	TaskHandle_t t = calloc(1, sizeof(*t));
+
+	if (t == NULL) {
+		return pdFAIL;
+	}
+	t->name = name;
+	t->fn = fn;
+	t->param = param;
+	if (handle != NULL) {
+		*handle = t;
+	}
+	return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *param,
+								   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+	return xTaskCreate(fn, name, stack, param, prio, handle);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+	// Stress test threads only give the others a turn
+	if (!pthread_equal(pthread_self(), host_main)) {
+		sched_yield();
+		return;
+	}
+	host_advance_us((int64_t) ticks * portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelayUntil(TickType_t *prev, TickType_t ticks)
+{
+	TickType_t now = xTaskGetTickCount();
+
+	*prev += ticks;
+	if ((int32_t) (*prev - now) > 0) {
+		vTaskDelay(*prev - now);
+	}
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return (TickType_t) (host_time_us / (portTICK_PERIOD_MS * 1000));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return host_current;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+	return 0;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+	if (task == NULL) {
+		return pdFAIL;
+	}
+	switch (action) {
+	case eSetBits:
+		task->notified |= value;
+		break;
+	case eIncrement:
+		task->notified++;
+		break;
+	case eSetValueWithOverwrite:
+	case eSetValueWithoutOverwrite:
+		task->notified = value;
+		break;
+	default:
+		break;
+	}
+	return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t wait)
+{
+	TaskHandle_t t = host_current;
+
+	if (value != NULL) {
+		*value = 0;
+	}
+	if (t == NULL) {
+		return pdFALSE;
+	}
+	if (t->notified == 0) {
+		if (wait > 0) {
+			longjmp(host_blocked, 1);
+		}
+		return pdFALSE;
+	}
+	if (value != NULL) {
+		*value = t->notified;
+	}
+	t->notified &= ~clear_on_exit;
+	return pdTRUE;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+	return xTaskNotify(task, 0, eIncrement);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+	TaskHandle_t t = host_current;
+	uint32_t v;
+
+	if (t == NULL) {
+		return 0;
+	}
+	if (t->notified == 0 && wait > 0) {
+		longjmp(host_blocked, 1);
+	}
+	v = t->notified;
+	t->notified = clear ? 0 : (v ? v - 1 : 0);
+	return v;
+}
+
+void host_task_run(TaskHandle_t task)
+{
+	host_current = task;
+	if (setjmp(host_blocked) == 0) {
+		task->fn(task->param);
+	}
+	host_current = NULL;
+}
+
+uint32_t host_task_notified(TaskHandle_t task)
+{
+	uint32_t v = task->notified;
+
+	task->notified = 0;
+	return v;
+}
+
+/*
+ * Queues and semaphores
+ */
+struct host_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	uint8_t *buf;
+	size_t item_size;
+	UBaseType_t len;
+	UBaseType_t head;
+	UBaseType_t count;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size)
+{
+	QueueHandle_t q = calloc(1, sizeof(*q));
+
+	if (q == NULL) {
+		return NULL;
+	}
+	q->buf = calloc(len, item_size ? item_size : 1);
+	if (q->buf == NULL) {
+		free(q);
+		return NULL;
+	}
+	q->item_size = item_size;
+	q->len = len;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->changed, NULL);
+	return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->changed);
+	free(q->buf);
+	free(q);
+}
+
+/*
+ * Wait on q->changed until ready() or the ticks run out, in real time.
+ * Called and returns with q->lock held.
+ */
+static bool queue_wait(QueueHandle_t q, bool (*ready)(QueueHandle_t), TickType_t wait)
+{
+	struct timespec until;
+	int64_t ns;
+
+	if (wait != portMAX_DELAY) {
+		clock_gettime(CLOCK_REALTIME, &until);
+		ns = until.tv_nsec + (int64_t) wait * portTICK_PERIOD_MS * 1000000;
+		until.tv_sec += ns / 1000000000;
+		until.tv_nsec = ns % 1000000000;
+	}
+	while (!ready(q)) {
+		if (wait == 0) {
+			return false;
+		}
+		if (wait == portMAX_DELAY) {
+			pthread_cond_wait(&q->changed, &q->lock);
+		}
+		else if (pthread_cond_timedwait(&q->changed, &q->lock, &until) == ETIMEDOUT) {
+			return ready(q);
+		}
+	}
+	return true;
+}
+
+static bool queue_has_room(QueueHandle_t q)
+{
+	return q->count < q->len;
+}
+
+static bool queue_has_item(QueueHandle_t q)
+{
+	return q->count > 0;
+}
+
+static BaseType_t queue_put(QueueHandle_t q, const void *item, TickType_t wait, bool front)
+{
+	UBaseType_t at;
+
+	pthread_mutex_lock(&q->lock);
+	if (!queue_wait(q, queue_has_room, wait)) {
+		pthread_mutex_unlock(&q->lock);
+		return pdFAIL;
+	}
+	if (front) {
+		q->head = (q->head + q->len - 1) % q->len;
+		at = q->head;
+	}
+	else {
+		at = (q->head + q->count) % q->len;
+	}
+	if (q->item_size > 0) {
+		memcpy(q->buf + at * q->item_size, item, q->item_size);
+	}
+	q->count++;
+	pthread_cond_broadcast(&q->changed);
+	pthread_mutex_unlock(&q->lock);
+	return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t wait)
+{
+	return queue_put(q, item, wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void *item, TickType_t wait)
+{
+	return queue_put(q, item, wait, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void *item)
+{
+	xQueueReset(q);
+	return queue_put(q, item, 0, false);
+}
+
+static BaseType_t queue_get(QueueHandle_t q, void *item, TickType_t wait, bool remove)
+{
+	pthread_mutex_lock(&q->lock);
+	if (!queue_wait(q, queue_has_item, wait)) {
+		pthread_mutex_unlock(&q->lock);
+		return pdFAIL;
+	}
+	if (q->item_size > 0 && item != NULL) {
+		memcpy(item, q->buf + q->head * q->item_size, q->item_size);
+	}
+	if (remove) {
+		q->head = (q->head + 1) % q->len;
+		q->count--;
+		pthread_cond_broadcast(&q->changed);
+	}
+	pthread_mutex_unlock(&q->lock);
+	return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t wait)
+{
+	return queue_get(q, item, wait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t wait)
+{
+	return queue_get(q, item, wait, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t q)
+{
+	pthread_mutex_lock(&q->lock);
+	q->head = 0;
+	q->count = 0;
+	pthread_cond_broadcast(&q->changed);
+	pthread_mutex_unlock(&q->lock);
+	return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+	UBaseType_t n;
+
+	pthread_mutex_lock(&q->lock);
+	n = q->count;
+	pthread_mutex_unlock(&q->lock);
+	return n;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+	SemaphoreHandle_t s = xQueueCreate(max, 0);
+
+	if (s != NULL) {
+		s->count = initial;
+	}
+	return s;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait)
+{
+	return queue_get(s, NULL, wait, true);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+	return queue_put(s, NULL, 0, false);
+}
+
+/*
+ * Event groups
+ */
+struct host_event_group {
+	EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+	return calloc(1, sizeof(struct host_event_group));
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+	return group->bits |= bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+	EventBits_t was = group->bits;
+
+	group->bits &= ~bits;
+	return was;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+	return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear,
+								BaseType_t all, TickType_t wait)
+{
+	EventBits_t was = group->bits;
+	bool met = all ? (was & bits) == bits : (was & bits) != 0;
+
+	if (met && clear) {
+		group->bits &= ~bits;
+	}
+	return was;
+}
+
+/*
+ * Software timers on the simulated clock
+ */
+struct host_timer {
+	TickType_t period;
+	bool reload;
+	bool active;
+	int64_t due_us;
+	void *id;
+	TimerCallbackFunction_t callback;
+};
+
+typedef struct {
+	PendedFunction_t fn;
+	void *param1;
+	uint32_t param2;
+} host_pended_t;
+
+static struct host_timer timers[HOST_MAX_TIMERS];
+static int n_timers;
+static host_pended_t pended[HOST_MAX_PENDED];
+static int n_pended;
+
+static int64_t ticks_us(TickType_t ticks)
+{
+	return (int64_t) ticks * portTICK_PERIOD_MS * 1000;
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t reload,
+						   void *id, TimerCallbackFunction_t callback)
+{
+	TimerHandle_t t;
+
+	if (n_timers == HOST_MAX_TIMERS || period == 0) {
+		return NULL;
+	}
+	t = &timers[n_timers++];
+	t->period = period;
+	t->reload = reload;
+	t->active = false;
+	t->id = id;
+	t->callback = callback;
+	return t;
+}
+
+BaseType_t xTimerStart(TimerHandle_t t, TickType_t wait)
+{
+	t->active = true;
+	t->due_us = host_time_us + ticks_us(t->period);
+	return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t t, TickType_t wait)
+{
+	t->active = false;
+	return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t t, TickType_t wait)
+{
+	return xTimerStart(t, wait);
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t t, TickType_t period, TickType_t wait)
+{
+	t->period = period;
+	return xTimerStart(t, wait);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t t)
+{
+	return t->active;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t t)
+{
+	return t->id;
+}
+
+BaseType_t xTimerPendFunctionCall(PendedFunction_t fn, void *param1, uint32_t param2, TickType_t wait)
+{
+	if (n_pended == HOST_MAX_PENDED) {
+		return pdFAIL;
+	}
+	pended[n_pended].fn = fn;
+	pended[n_pended].param1 = param1;
+	pended[n_pended].param2 = param2;
+	n_pended++;
+	return pdPASS;
+}
+
+void host_advance_us(int64_t us)
+{
+	int64_t end = host_time_us + us;
+	host_pended_t call;
+	TimerHandle_t next;
+	int i;
+
+	for (;;) {
+		while (n_pended > 0) {
+			call = pended[0];
+			memmove(pended, pended + 1, --n_pended * sizeof(pended[0]));
+			call.fn(call.param1, call.param2);
+		}
+
+		next = NULL;
+		for (i = 0; i < n_timers; i++) {
+			if (timers[i].active && timers[i].due_us <= end &&
+				(next == NULL || timers[i].due_us < next->due_us)) {
+				next = &timers[i];
+			}
+		}
+		if (next == NULL) {
+			break;
+		}
+
+		host_time_us = next->due_us;
+		if (next->reload) {
+			next->due_us += ticks_us(next->period);
+		}
+		else {
+			next->active = false;
+		}
+		next->callback(next);
+	}
+	host_time_us = end;
+}
+
+/*
+ * GPIO
+ */
+esp_err_t gpio_config(const gpio_config_t *conf)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+	if (gpio < 0 || gpio >= GPIO_NUM_MAX) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	host_gpio_level[gpio] = level;
+	return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio)
+{
+	return (gpio >= 0 && gpio < GPIO_NUM_MAX) ? host_gpio_level[gpio] : 0;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode)
+{
+	return ESP_OK;
+}
+
+void gpio_pad_select_gpio(uint8_t gpio)
+{
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio, gpio_pull_mode_t pull)
+{
+	return ESP_OK;
+}
+
+/*
+ * ADC
+ */
+int (*host_adc1_read)(adc1_channel_t channel);
+
+esp_err_t adc1_config_width(adc_bits_width_t width)
+{
+	return ESP_OK;
+}
+
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten)
+{
+	return ESP_OK;
+}
+
+int adc1_get_raw(adc1_channel_t channel)
+{
+	return (host_adc1_read != NULL) ? host_adc1_read(channel) : 0;
+}
+
+esp_err_t esp_adc_cal_check_efuse(esp_adc_cal_value_t value_type)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t adc_num, adc_atten_t atten, adc_bits_width_t bit_width,
+											 uint32_t default_vref, esp_adc_cal_characteristics_t *chars)
+{
+	chars->adc_num = adc_num;
+	chars->atten = atten;
+	chars->bit_width = bit_width;
+	chars->vref = default_vref;
+	return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t adc_reading, const esp_adc_cal_characteristics_t *chars)
+{
+	if (adc_reading > 4095) {
+		adc_reading = 4095;
+	}
+	return HOST_ADC_CAL_MIN_MV + adc_reading * (HOST_ADC_CAL_MAX_MV - HOST_ADC_CAL_MIN_MV) / 4095;
+}
+
+/*
+ * SD card
+ */
+esp_err_t esp_vfs_fat_sdmmc_mount(const char *base_path, const sdmmc_host_t *host, const void *slot_config,
+								  const esp_vfs_fat_sdmmc_mount_config_t *mount_config, sdmmc_card_t **out_card)
+{
+	static sdmmc_card_t card;
+
+	*out_card = &card;
+	return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdmmc_unmount(void)
+{
+	return ESP_OK;
+}
+
+void sdmmc_card_print_info(FILE *stream, const sdmmc_card_t *card)
+{
+}
+
+/*
+ * UART
+ */
+typedef struct {
+	uint8_t rx[HOST_UART_BUF];
+	size_t rx_head;
+	size_t rx_len;
+	char tx[HOST_UART_BUF];
+	size_t tx_len;
+} host_uart_t;
+
+static host_uart_t uarts[UART_NUM_MAX];
+
+void host_uart_feed(uart_port_t port, const uint8_t *data, size_t len)
+{
+	host_uart_t *u = &uarts[port];
+
+	if (u->rx_head > 0) {
+		memmove(u->rx, u->rx + u->rx_head, u->rx_len);
+		u->rx_head = 0;
+	}
+	if (len > sizeof(u->rx) - u->rx_len) {
+		len = sizeof(u->rx) - u->rx_len;
+	}
+	memcpy(u->rx + u->rx_len, data, len);
+	u->rx_len += len;
+}
+
+size_t host_uart_pending(uart_port_t port)
+{
+	return uarts[port].rx_len;
+}
+
+size_t host_uart_written(uart_port_t port, char *buf, size_t len)
+{
+	host_uart_t *u = &uarts[port];
+
+	if (len > u->tx_len) {
+		len = u->tx_len;
+	}
+	memcpy(buf, u->tx, len);
+	u->tx_len = 0;
+	return len;
+}
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t *conf)
+{
+	return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts)
+{
+	return ESP_OK;
+}
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_size, int tx_size, int queue_size,
+							  QueueHandle_t *queue, int flags)
+{
+	if (queue != NULL) {
+		*queue = xQueueCreate(queue_size, sizeof(uart_event_t));
+	}
+	return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t port, uint8_t *buf, uint32_t len, TickType_t wait)
+{
+	host_uart_t *u = &uarts[port];
+
+	if (len > u->rx_len) {
+		len = u->rx_len;
+	}
+	memcpy(buf, u->rx + u->rx_head, len);
+	u->rx_head += len;
+	u->rx_len -= len;
+	return len;
+}
+
+int uart_write_bytes(uart_port_t port, const char *src, size_t len)
+{
+	host_uart_t *u = &uarts[port];
+	size_t n = len;
+
+	if (n > sizeof(u->tx) - u->tx_len) {
+		n = sizeof(u->tx) - u->tx_len;
+	}
+	memcpy(u->tx + u->tx_len, src, n);
+	u->tx_len += n;
+	return len;
+}
+
+esp_err_t uart_flush(uart_port_t port)
+{
+	return uart_flush_input(port);
+}
+
+esp_err_t uart_flush_input(uart_port_t port)
+{
+	uarts[port].rx_head = 0;
+	uarts[port].rx_len = 0;
+	return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t *size)
+{
+	*size = uarts[port].rx_len;
+	return ESP_OK;
+}
+
+esp_err_t uart_enable_pattern_det_intr(uart_port_t port, char c, uint8_t num, int gap, int post, int pre)
+{
+	return ESP_OK;
+}
+
+esp_err_t uart_pattern_queue_reset(uart_port_t port, int len)
+{
+	return ESP_OK;
+}
+
+int uart_pattern_pop_pos(uart_port_t port)
+{
+	return -1;
+}
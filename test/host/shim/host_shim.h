@@ -0,0 +1,60 @@
+/*
+ * host_shim.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Controls the host tests have over the shimmed ESP-IDF and FreeRTOS:
+ *  a simulated clock that also drives the software timers, UART receive
+ *  buffers and task notification values.
+ */
+
+#ifndef HOST_SHIM_H_
+#define HOST_SHIM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/uart.h"
+
+/*
+ * esp_timer_get_time(); xTaskGetTickCount() is derived from it. Only the
+ * main thread moves it: vTaskDelay() from any other thread just yields.
+ */
+extern int64_t host_time_us;
+
+/*
+* @brief	Move the simulated clock forward by us. Pended function calls
+* 			run first, then every timer that falls due on the way fires in
+* 			due order with the clock set to its due time.
+*/
+void host_advance_us(int64_t us);
+
+/*
+* @brief	Queue bytes for uart_read_bytes() on a port
+*/
+void host_uart_feed(uart_port_t port, const uint8_t *data, size_t len);
+
+/*
+* @brief	Bytes fed to a port and not read yet
+*/
+size_t host_uart_pending(uart_port_t port);
+
+/*
+* @brief	Bytes written to a port since the last call; copies at most len
+* 			and clears the record
+*/
+size_t host_uart_written(uart_port_t port, char *buf, size_t len);
+
+/*
+* @brief	Notification value of a task; clears it
+*/
+uint32_t host_task_notified(TaskHandle_t task);
+
+/*
+* @brief	Run a task's function until it waits for a notification that
+* 			isn't there (xTaskNotifyWait() or ulTaskNotifyTake() with a
+* 			timeout), then return. Pending notifications are delivered.
+*/
+void host_task_run(TaskHandle_t task);
+
+#endif /* HOST_SHIM_H_ */
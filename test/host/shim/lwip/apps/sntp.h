@@ -0,0 +1,21 @@
+/*
+ * sntp.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in for the lwIP header of the same name.
+ */
+
+#ifndef HOST_LWIP_SNTP_H_
+#define HOST_LWIP_SNTP_H_
+
+#include <stdint.h>
+
+#define SNTP_OPMODE_POLL	0
+
+void sntp_setoperatingmode(uint8_t operating_mode);
+void sntp_setservername(uint8_t idx, const char *server);
+void sntp_init(void);
+void sntp_stop(void);
+
+#endif /* HOST_LWIP_SNTP_H_ */
@@ -0,0 +1,14 @@
+/*
+ * err.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in for the lwIP header of the same name.
+ */
+
+#ifndef HOST_LWIP_ERR_H_
+#define HOST_LWIP_ERR_H_
+
+typedef signed char err_t;
+
+#endif /* HOST_LWIP_ERR_H_ */
@@ -0,0 +1,68 @@
+/*
+ * mqtt_client.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in for the ESP-MQTT client API. There is no implementation
+ *  here: a test that links mqtt_if.c provides the client functions and so
+ *  plays the broker.
+ */
+
+#ifndef HOST_MQTT_CLIENT_H_
+#define HOST_MQTT_CLIENT_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define MQTT_BUFFER_SIZE_BYTE		1024
+#define MQTT_SSL_DEFAULT_PORT		8883
+
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef enum {
+	MQTT_EVENT_ERROR = 0,
+	MQTT_EVENT_CONNECTED,
+	MQTT_EVENT_DISCONNECTED,
+	MQTT_EVENT_SUBSCRIBED,
+	MQTT_EVENT_UNSUBSCRIBED,
+	MQTT_EVENT_PUBLISHED,
+	MQTT_EVENT_DATA,
+} esp_mqtt_event_id_t;
+
+typedef enum {
+	MQTT_TRANSPORT_UNKNOWN = 0,
+	MQTT_TRANSPORT_OVER_TCP,
+	MQTT_TRANSPORT_OVER_SSL,
+} esp_mqtt_transport_t;
+
+typedef struct {
+	esp_mqtt_event_id_t event_id;
+	esp_mqtt_client_handle_t client;
+	char *data;
+	int data_len;
+	char *topic;
+	int topic_len;
+	int msg_id;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+typedef esp_err_t (*mqtt_event_callback_t)(esp_mqtt_event_handle_t event);
+
+typedef struct {
+	mqtt_event_callback_t event_handle;
+	const char *host;
+	uint32_t port;
+	const char *username;
+	const char *password;
+	const char *cert_pem;
+	esp_mqtt_transport_t transport;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data,
+							int len, int qos, int retain);
+
+#endif /* HOST_MQTT_CLIENT_H_ */
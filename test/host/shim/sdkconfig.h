@@ -0,0 +1,68 @@
+/*
+ * sdkconfig.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host build configuration: the Kconfig.projbuild defaults. A test that
+ *  needs another value #undefs and redefines it before including the
+ *  module under test.
+ */
+
+#ifndef HOST_SDKCONFIG_H_
+#define HOST_SDKCONFIG_H_
+
+#define CONFIG_MQTT_HOST "example.host.com"
+#define CONFIG_MQTT_USERNAME "username"
+#define CONFIG_MQTT_PASSWORD "password"
+#define CONFIG_INFLUX_MEASUREMENT_NAME "airQuality"
+#define CONFIG_INFLUX_TIMESTAMP_MS 1
+#define CONFIG_INFLUX_STATS 1
+#define CONFIG_MQTT_ROOT_TOPIC "airu"
+#define CONFIG_MQTT_DATA_PUB_TOPIC "influx"
+#define CONFIG_MQTT_SUB_ALL_TOPIC "all/v2"
+#define CONFIG_MQTT_DATA_QOS 2
+#define CONFIG_MQTT_ACK_QOS 2
+#define CONFIG_MQTT_SUB_QOS 2
+#define CONFIG_MQTT_BATCH_MAX_RECORDS 1
+#define CONFIG_MQTT_BATCH_MAX_BYTES 2048
+#define CONFIG_MQTT_BATCH_MAX_AGE 300
+#define CONFIG_DATA_UPLOAD_PERIOD 60
+#define CONFIG_DATA_SAMPLE_PERIOD 60
+#define CONFIG_GPS_AVG_WINDOW 60
+#define CONFIG_GPS_MAX_HDOP 50
+#define CONFIG_GPS_GEOHASH_PRECISION 7
+#define CONFIG_GPS_FIX_INTERVAL_MS 1000
+#define CONFIG_GPS_DUTY_CYCLE 1
+#define CONFIG_GPS_STILL_RADIUS_M 15
+#define CONFIG_GPS_WAKE_INTERVAL_S 3600
+#define CONFIG_GPS_WAKE_TIMEOUT_S 120
+#define CONFIG_TIME_HOLDOVER_S 3900
+#define CONFIG_HDC1080_PERIOD_S 10
+#define CONFIG_HDC1080_RES_14 1
+#define CONFIG_MICS_SUPPLY_MV 3300
+#define CONFIG_MICS_RED_LOAD_OHMS 47000
+#define CONFIG_MICS_OX_LOAD_OHMS 22000
+#define CONFIG_MICS_PREHEAT_S 60
+#define CONFIG_MICS_DUTY_CYCLE 1
+#define CONFIG_MICS_CYCLE_S 300
+#define CONFIG_MICS_SAMPLE_S 20
+#define CONFIG_PM_DUTY_CYCLE 1
+#define CONFIG_PM_CYCLE_S 60
+#define CONFIG_PM_SPINUP_S 30
+#define CONFIG_PM_MEASURE_S 10
+#define CONFIG_PM_STUCK_S 14400
+#define CONFIG_USE_SD 1
+#define CONFIG_SD_DATA_STORE 1
+#define CONFIG_SD_BIN_INDEX_INTERVAL 60
+#define CONFIG_SD_WRITE_BUFFER_SIZE 2048
+#define CONFIG_SD_WRITE_FLUSH_PERIOD 300
+#define CONFIG_OUTBOX_ENABLE 1
+#define CONFIG_OUTBOX_MAX_SIZE_KB 4096
+#define CONFIG_OUTBOX_REPLAY_RECORDS 10
+#define CONFIG_OUTBOX_REPLAY_INTERVAL_MS 2000
+#define CONFIG_SD_LOG_RING_SIZE 8192
+#define CONFIG_SD_LOG_FILE_COUNT 16
+#define CONFIG_SD_LOG_FILE_SIZE_KB 1024
+#define CONFIG_SD_LOG_FLUSH_PERIOD_MS 1000
+
+#endif /* HOST_SDKCONFIG_H_ */
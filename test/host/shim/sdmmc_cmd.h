@@ -0,0 +1,17 @@
+/*
+ * sdmmc_cmd.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in for the ESP-IDF header of the same name.
+ */
+
+#ifndef HOST_SDMMC_CMD_H_
+#define HOST_SDMMC_CMD_H_
+
+#include <stdio.h>
+#include "driver/sdmmc_host.h"
+
+void sdmmc_card_print_info(FILE *stream, const sdmmc_card_t *card);
+
+#endif /* HOST_SDMMC_CMD_H_ */
@@ -0,0 +1,24 @@
+/*
+ * tcpip_adapter.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host stand-in: just the types wifi_manager.h names.
+ */
+
+#ifndef HOST_TCPIP_ADAPTER_H_
+#define HOST_TCPIP_ADAPTER_H_
+
+#include <stdint.h>
+
+typedef struct {
+	uint32_t addr;
+} ip4_addr_t;
+
+typedef struct {
+	ip4_addr_t ip;
+	ip4_addr_t netmask;
+	ip4_addr_t gw;
+} tcpip_adapter_ip_info_t;
+
+#endif /* HOST_TCPIP_ADAPTER_H_ */
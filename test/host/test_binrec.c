@@ -0,0 +1,308 @@
+/*
+ * test_binrec.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Binary SD data files (binrec_if.c, sd_write_bin() in sd_if.c) and
+ *  tools/bin2csv.py, with the card being a directory under build/:
+ *
+ *    - 20000 random records, nan and -1 failure values included, through
+ *      sd_write_bin() and through ENC_Encode() for the CSV row. A day with
+ *      GPS time and a day without. bin2csv.py must give the CSV files
+ *      byte for byte.
+ *    - the index: an entry every CONFIG_SD_BIN_INDEX_INTERVAL records,
+ *      each pointing at its record with the record's key
+ *    - time range queries through the index against the same range cut
+ *      out of the CSV, also after the data file lost its tail and with
+ *      garbage between records
+ *    - bytes per record, CSV against binary
+ *
+ *  Needs python3 for bin2csv.py; without it only the C side is checked.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "host_test.h"
+#include "host_shim.h"
+
+#define CONFIG_SD_DATA_BINARY	1
+#define SD_MOUNT_POINT			"build/binrec"
+#include "sd_if.c"
+
+#include "binrec_if.h"
+#include "encoder_if.h"
+
+#define BIN2CSV			"python3 ../../tools/bin2csv.py"
+#define DIR				SD_MOUNT_POINT
+#define RECORDS			20000
+#define DAY_GPS			17			/* records with GPS date and time */
+#define DAY_NOGPS		18			/* uptime only */
+#define PERIOD_S		4
+#define QUERIES			12
+
+#define MAC				"A1B2C3D4E5F6"
+#define TOPIC			"airu/influx"
+
+static char *ref_rows[RECORDS];		/* CSV rows of the GPS day, in order */
+static uint32_t ref_keys[RECORDS];
+static int n_ref;
+
+/*
+ * A value that rounds the same in float and at its print resolution
+ */
+static float rnd_field(double lo, double hi, int decimals)
+{
+	double v = lo + (hi - lo) * rand() / RAND_MAX, scale = pow(10, decimals);
+
+	return (float) (round(v * scale) / scale);
+}
+
+static void rnd_record(airu_sample_t *s, int i, bool gps)
+{
+	int tod = i * PERIOD_S + rand() % PERIOD_S;
+
+	memset(s, 0, sizeof(*s));
+	s->ts_us = 120000000LL + (int64_t) i * PERIOD_S * 1000000 + rand() % 1000000;
+	s->utc_ms = -1;
+	s->valid = AIRU_FIELD_POS | AIRU_FIELD_PM | AIRU_FIELD_TEMP | AIRU_FIELD_HUM | AIRU_FIELD_CO | AIRU_FIELD_NOX;
+	if (gps) {
+		s->valid |= AIRU_FIELD_DATE | AIRU_FIELD_TIME;
+		s->year = 26;
+		s->month = 10;
+		s->day = DAY_GPS;
+		s->hour = tod / 3600;
+		s->min = tod / 60 % 60;
+		s->sec = tod % 60;
+	}
+	s->alt = rnd_field(-100, 4000, 2);
+	s->lat = rnd_field(-90, 90, 4);
+	s->lon = rnd_field(-180, 180, 4);
+	s->pm1 = (i % 11 == 0) ? -1 : rnd_field(0, 500, 2);
+	s->pm2_5 = rnd_field(0, 1000, 2);
+	s->pm10 = rnd_field(0, 2000, 2);
+	s->temp = (i % 997 == 3) ? NAN : rnd_field(-40, 125, 2);
+	s->hum = (i % 991 == 5) ? NAN : rnd_field(0, 100, 2);
+	s->co = rand() % 5000 - 1;
+	s->nox = (i % 13 == 0) ? -1 : rand() % 5000;
+}
+
+static char *file_read(const char *path, long *len)
+{
+	FILE *f = fopen(path, "rb");
+	char *buf;
+
+	if (f == NULL) {
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	*len = ftell(f);
+	rewind(f);
+	buf = malloc(*len + 1);
+	*len = fread(buf, 1, *len, f);
+	buf[*len] = '\0';
+	fclose(f);
+	return buf;
+}
+
+static bool same_file(const char *a, const char *b)
+{
+	long la, lb;
+	char *x = file_read(a, &la), *y = file_read(b, &lb);
+	bool same = x != NULL && y != NULL && la == lb && memcmp(x, y, la) == 0;
+
+	free(x);
+	free(y);
+	return same;
+}
+
+static int run(const char *fmt, ...)
+{
+	char cmd[512];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(cmd, sizeof(cmd), fmt, ap);
+	va_end(ap);
+	return system(cmd);
+}
+
+/*
+ * Write both days. Returns the CSV bytes of all rows.
+ */
+static long write_days(void)
+{
+	char csv[ENC_CSV_LEN], path[64];
+	airu_sample_t s;
+	binrec_t rec;
+	FILE *ref[2];
+	long csv_bytes = 0;
+	int i, d;
+
+	CHECK_EQ(run("rm -rf " DIR " && mkdir -p " DIR), 0);
+	CHECK_EQ(ENC_Initialize("airQuality", MAC, "1.0", TOPIC), ESP_OK);
+	CHECK_EQ(BINREC_Initialize(MAC, TOPIC), ESP_OK);
+	for (d = 0; d < 2; d++) {
+		snprintf(path, sizeof(path), DIR "/ref-%d.csv", d ? DAY_NOGPS : DAY_GPS);
+		ref[d] = fopen(path, "w");
+		fputs(SD_HDR, ref[d]);
+	}
+
+	srand(8);
+	for (i = 0; i < RECORDS; i++) {
+		d = i >= RECORDS / 2;
+		rnd_record(&s, d ? i - RECORDS / 2 : i, !d);
+		CHECK_EQ(ENC_Encode(&s, NULL, 0, csv, sizeof(csv)), ESP_OK);
+		BINREC_Encode(&s, &rec);
+		CHECK_EQ(sd_write_bin(&rec, 26, 10, d ? DAY_NOGPS : DAY_GPS), ESP_OK);
+		fputs(csv, ref[d]);
+		csv_bytes += strlen(csv);
+		if (!d) {
+			ref_rows[n_ref] = strdup(csv);
+			ref_keys[n_ref++] = BINREC_Key(&rec);
+		}
+		host_advance_us(PERIOD_S * 1000000LL);
+		sd_flush_data(false);
+	}
+	sd_flush_data(true);
+	sd_writer_close(&bin_writer);
+	sd_writer_close(&idx_writer);
+	bin_writer_ready = false;
+	fclose(ref[0]);
+	fclose(ref[1]);
+	return csv_bytes;
+}
+
+static void test_index(void)
+{
+	long len, bin_len, k;
+	size_t hdr_len;
+	char *idx = file_read(DIR "/26-10-17.idx", &len);
+	char *bin = file_read(DIR "/26-10-17.bin", &bin_len);
+	const binrec_idx_hdr_t *ih = (const binrec_idx_hdr_t *) idx;
+	const binrec_file_hdr_t *fh = (const binrec_file_hdr_t *) bin;
+	const binrec_idx_t *e;
+	const binrec_t *r;
+	int bad = 0;
+
+	CHECK_EQ(sizeof(binrec_t), 48);
+	CHECK(idx != NULL && bin != NULL);
+	if (idx == NULL || bin == NULL) {
+		return;
+	}
+	BINREC_Header(&hdr_len);
+	CHECK(fh->magic == BINREC_MAGIC && fh->version == BINREC_VERSION && fh->hdr_len == hdr_len);
+	CHECK(fh->rec_len == sizeof(binrec_t) && fh->index_interval == CONFIG_SD_BIN_INDEX_INTERVAL);
+	CHECK(strcmp(bin + sizeof(*fh), MAC) == 0 && strcmp(bin + sizeof(*fh) + strlen(MAC) + 1, TOPIC) == 0);
+	CHECK_EQ(bin_len, (long) hdr_len + (long) sizeof(binrec_t) * RECORDS / 2);
+
+	CHECK(ih->magic == BINREC_IDX_MAGIC && ih->entry_len == sizeof(binrec_idx_t));
+	CHECK_EQ(len, (long) sizeof(*ih) + (long) sizeof(binrec_idx_t) *
+			 ((RECORDS / 2 + CONFIG_SD_BIN_INDEX_INTERVAL - 1) / CONFIG_SD_BIN_INDEX_INTERVAL));
+	for (k = 0; sizeof(*ih) + (k + 1) * sizeof(*e) <= (size_t) len; k++) {
+		e = (const binrec_idx_t *) (idx + sizeof(*ih)) + k;
+		r = (const binrec_t *) (bin + e->offset);
+		bad += e->offset != hdr_len + k * CONFIG_SD_BIN_INDEX_INTERVAL * sizeof(binrec_t);
+		bad += r->sync != BINREC_SYNC || BINREC_Key(r) != e->key || e->key != ref_keys[k * CONFIG_SD_BIN_INDEX_INTERVAL];
+	}
+	CHECK_EQ(bad, 0);
+	free(idx);
+	free(bin);
+}
+
+/*
+ * bin2csv.py --start --end against the same rows cut from the CSV
+ */
+static int query(const char *bin, uint32_t start, uint32_t end, int upto)
+{
+	FILE *f = fopen(DIR "/want.csv", "w");
+	int i;
+
+	for (i = 0; i < upto; i++) {
+		if (ref_keys[i] >= start && ref_keys[i] <= end) {
+			fputs(ref_rows[i], f);
+		}
+	}
+	fclose(f);
+	run(BIN2CSV " %s --no-header --start %02u:%02u:%02u --end %02u:%02u:%02u > " DIR "/got.csv",
+		bin, start / 3600, start / 60 % 60, start % 60, end / 3600, end / 60 % 60, end % 60);
+	return same_file(DIR "/want.csv", DIR "/got.csv");
+}
+
+/*
+ * Copy of the GPS day's data file: the header and the first n records,
+ * then torn bytes of the next one, then junk and the records from n to
+ * upto.
+ */
+static bool splice(const char *path, int n, size_t torn, const char *junk, int upto)
+{
+	size_t hdr_len, rec_len = sizeof(binrec_t);
+	long len;
+	char *bin = file_read(DIR "/26-10-17.bin", &len);
+	FILE *f = fopen(path, "wb");
+
+	BINREC_Header(&hdr_len);
+	if (bin == NULL || f == NULL) {
+		return false;
+	}
+	fwrite(bin, 1, hdr_len + n * rec_len + torn, f);
+	if (junk != NULL) {
+		fputs(junk, f);
+		fwrite(bin + hdr_len + n * rec_len, 1, (upto - n) * rec_len, f);
+	}
+	fclose(f);
+	free(bin);
+	return true;
+}
+
+static void test_decode(void)
+{
+	uint32_t start, end;
+	int i, good = 0, kept;
+
+	CHECK_EQ(run(BIN2CSV " " DIR "/26-10-17.bin > " DIR "/out-17.csv"), 0);
+	CHECK_EQ(run(BIN2CSV " " DIR "/26-10-18.bin > " DIR "/out-18.csv"), 0);
+	CHECK(same_file(DIR "/ref-17.csv", DIR "/out-17.csv"));
+	CHECK(same_file(DIR "/ref-18.csv", DIR "/out-18.csv"));
+
+	srand(80);
+	for (i = 0; i < QUERIES; i++) {
+		start = rand() % (RECORDS / 2 * PERIOD_S);
+		end = start + rand() % 7200;
+		good += query(DIR "/26-10-17.bin", start, end, n_ref);
+	}
+	good += query(DIR "/26-10-17.bin", 0, 0, n_ref);
+	good += query(DIR "/26-10-17.bin", ref_keys[n_ref - 1], 86399, n_ref);
+	CHECK_EQ(good, QUERIES + 2);
+
+	// Power lost with the index ahead of the data: the tail is gone and
+	// the last record is torn
+	kept = n_ref - 3 * CONFIG_SD_BIN_INDEX_INTERVAL - 7;
+	CHECK_EQ(run("cp " DIR "/26-10-17.idx " DIR "/cut.idx"), 0);
+	CHECK(splice(DIR "/cut.bin", kept, sizeof(binrec_t) / 2, NULL, 0));
+	CHECK(query(DIR "/cut.bin", ref_keys[kept - 100], 86399, kept));
+	CHECK(query(DIR "/cut.bin", 0, 86399, kept));
+
+	// Garbage in the middle: index entries after it no longer land on a
+	// record and are skipped, the decoder finds the next record
+	CHECK_EQ(run("cp " DIR "/26-10-17.idx " DIR "/junk.idx"), 0);
+	CHECK(splice(DIR "/junk.bin", n_ref / 2 + 3, 0, "junk!!!", n_ref));
+	CHECK(query(DIR "/junk.bin", ref_keys[n_ref / 2 + 50], ref_keys[n_ref / 2 + 500], n_ref));
+	CHECK(query(DIR "/junk.bin", 0, 86399, n_ref));
+}
+
+int main(void)
+{
+	long csv_bytes = write_days();
+
+	test_index();
+	if (run("python3 --version > /dev/null 2>&1") != 0) {
+		printf("python3 not found, bin2csv.py not checked\n");
+	}
+	else {
+		test_decode();
+	}
+	printf("size: %.1f bytes a CSV row, %zu a binary record, %.2fx\n",
+		   (double) csv_bytes / RECORDS, sizeof(binrec_t), (double) csv_bytes / RECORDS / sizeof(binrec_t));
+	return host_test_done("test_binrec");
+}
@@ -0,0 +1,288 @@
+/*
+ * test_encoder.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Influx/CSV encoder (encoder_if.c):
+ *
+ *    - golden lines and rows for hand built records: tags, geohash,
+ *      atmospheric PM, particle counts, window statistics, timestamp and
+ *      both CSV time columns
+ *    - tag escaping, truncation and rounding of exact ties
+ *    - random records against the MQTT_PKT/SD_PKT sprintf templates the
+ *      encoder replaced, byte for byte
+ *    - ns/record of both
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "encoder_if.h"
+
+#define RANDOM_RECORDS		200000
+#define BENCH_RECORDS		200000
+
+#define STARTS(s, lit)		(strncmp((s), (lit), sizeof(lit) - 1) == 0)
+
+#define MEAS		"airQ"
+#define MAC			"A1B2C3D4E5F6"
+#define VER			"1.0"
+#define TOPIC		"airu/influx"
+
+/* The templates and formatting the encoder replaced */
+#define OLD_MQTT_PKT MEAS ",ID=%s,SensorModel=H2+%s SecActive=%llu,"\
+					 "Altitude=%.2f,Latitude=%.4f,Longitude=%.4f,PM1=%.2f,"\
+					 "PM2.5=%.2f,PM10=%.2f,Temperature=%.2f,Humidity=%.2f,CO=%d,NO=%d"
+#define OLD_SD_PKT "%s,%s,%s,%llu,%.2f,%.4f,%.4f,%.2f,%.2f,%.2f,%.2f,%.2f,%d,%d\n"
+
+static void old_serialize(const airu_sample_t *s, char *line, size_t line_size, char *csv, size_t csv_size)
+{
+	unsigned long long uptime = s->ts_us / 1000000;
+	char time_buf[16];
+
+	snprintf(line, line_size, OLD_MQTT_PKT, MAC, VER, uptime,
+			 s->alt, s->lat, s->lon, s->pm1, s->pm2_5, s->pm10,
+			 s->temp, s->hum, s->co, s->nox);
+
+	if (s->year <= 18 || s->year >= 80) {
+		snprintf(time_buf, sizeof(time_buf), "%llu:%02d:%02d",
+				 uptime / 3600, (int)(uptime % 3600 / 60), (int)(uptime % 60));
+	}
+	else {
+		snprintf(time_buf, sizeof(time_buf), "%02d:%02d:%02d", s->hour, s->min, s->sec);
+	}
+	snprintf(csv, csv_size, OLD_SD_PKT, time_buf, MAC, TOPIC, uptime,
+			 s->alt, s->lat, s->lon, s->pm1, s->pm2_5, s->pm10,
+			 s->temp, s->hum, s->co, s->nox);
+}
+
+static void test_golden(void)
+{
+	char line[1024], csv[ENC_CSV_LEN];
+	airu_sample_t s;
+	int i;
+
+	CHECK_EQ(ENC_Initialize(MEAS, MAC, VER, TOPIC), ESP_OK);
+
+	// Everything valid, a fix and the clock set
+	memset(&s, 0, sizeof(s));
+	s.ts_us = 3723LL * 1000000 + 999999;
+	s.utc_ms = 1792225496123LL;
+	s.valid = AIRU_FIELD_POS | AIRU_FIELD_DATE | AIRU_FIELD_TIME | AIRU_FIELD_PM |
+			  AIRU_FIELD_TEMP | AIRU_FIELD_HUM | AIRU_FIELD_CO | AIRU_FIELD_NOX;
+	s.year = 26; s.month = 10; s.day = 17;
+	s.hour = 7; s.min = 4; s.sec = 56;
+	strcpy(s.geohash, "9x0qq");
+	s.alt = 1288.5f; s.lat = 40.75f; s.lon = -111.875f;
+	s.pm1 = 3.25f; s.pm2_5 = 5.5f; s.pm10 = 7.75f;
+	s.pm1_atm = 3; s.pm2_5_atm = 5; s.pm10_atm = 7;
+	s.temp = 21.375; s.hum = 45;
+	s.co = 312; s.nox = -1;
+
+	CHECK_EQ(ENC_Encode(&s, line, sizeof(line), csv, sizeof(csv)), ESP_OK);
+	CHECK(strcmp(line, "airQ,ID=A1B2C3D4E5F6,SensorModel=H2+1.0,Geohash=9x0qq "
+				 "SecActive=3723,Altitude=1288.50,Latitude=40.7500,Longitude=-111.8750,"
+				 "PM1=3.25,PM2.5=5.50,PM10=7.75,Temperature=21.38,Humidity=45.00,CO=312,NO=-1,"
+				 "PM1_atm=3.00,PM2.5_atm=5.00,PM10_atm=7.00 1792225496123") == 0);
+	CHECK(strcmp(csv, "07:04:56,A1B2C3D4E5F6,airu/influx,3723,1288.50,40.7500,-111.8750,"
+				 "3.25,5.50,7.75,21.38,45.00,312,-1\n") == 0);
+
+	// No fix, no clock, particle counts and a closed window
+	memset(&s, 0, sizeof(s));
+	s.ts_us = 45 * 1000000;
+	s.utc_ms = -1;
+	s.valid = AIRU_FIELD_PM | AIRU_FIELD_PN | AIRU_FIELD_STATS;
+	strcpy(s.geohash, "9x0qq");
+	s.lat = 40.75f;
+	s.pm2_5 = 0.004f;
+	s.pm10 = -0.004f;
+	for (i = 0; i < AIRU_PN_BINS; i++) {
+		s.pn[i] = 1000.0f / (i + 1);
+	}
+	s.stats[AIRU_STAT_PM2_5] = (stats_summary_t) { 10, 5, 1.25f, 2, 14, 5.5f, 13 };
+	s.stats[AIRU_STAT_TEMP]  = (stats_summary_t) { 1, 20, 0, 20, 20, 20, 20 };
+	s.stats[AIRU_STAT_CO]    = (stats_summary_t) { 5, 310, 2.5f, 300, 320, 310, 319.5f };
+
+	CHECK_EQ(ENC_Encode(&s, line, sizeof(line), csv, sizeof(csv)), ESP_OK);
+	CHECK(strcmp(line, "airQ,ID=A1B2C3D4E5F6,SensorModel=H2+1.0 "
+				 "SecActive=45,Altitude=0.00,Latitude=40.7500,Longitude=0.0000,"
+				 "PM1=0.00,PM2.5=0.00,PM10=0.00,Temperature=0.00,Humidity=0.00,CO=0,NO=0,"
+				 "PM1_atm=0.00,PM2.5_atm=0.00,PM10_atm=0.00,"
+				 "PN0.3=1000.0,PN0.5=500.0,PN1=333.3,PN2.5=250.0,PN5=200.0,PN10=166.7,"
+				 "PM2.5_sd=1.25,PM2.5_min=2.00,PM2.5_max=14.00,PM2.5_p50=5.50,PM2.5_p95=13.00,"
+				 "CO_sd=2.5,CO_min=300.0,CO_max=320.0,CO_p50=310.0,CO_p95=319.5") == 0);
+	CHECK(strcmp(csv, "0:00:45,A1B2C3D4E5F6,airu/influx,45,0.00,40.7500,0.0000,"
+				 "0.00,0.00,0.00,0.00,0.00,0,0\n") == 0);
+
+	// Uptime past a day keeps counting hours; either output may be NULL
+	s.ts_us = (100LL * 3600 + 59 * 60 + 9) * 1000000;
+	CHECK_EQ(ENC_Encode(&s, NULL, 0, csv, sizeof(csv)), ESP_OK);
+	CHECK(STARTS(csv, "100:59:09,"));
+	CHECK_EQ(ENC_Encode(&s, line, sizeof(line), NULL, 0), ESP_OK);
+	CHECK(STARTS(line, "airQ,"));
+}
+
+static void test_edges(void)
+{
+	char line[1024], csv[ENC_CSV_LEN], big[ENC_TAGS_LEN + 8];
+	char num[32];
+	airu_sample_t s;
+
+	// Measurement: commas and spaces; tag values: commas, equals, spaces
+	CHECK_EQ(ENC_Initialize("air q,x", "A=B,C D", "1 0", TOPIC), ESP_OK);
+	memset(&s, 0, sizeof(s));
+	s.utc_ms = -1;
+	CHECK_EQ(ENC_Encode(&s, line, sizeof(line), csv, sizeof(csv)), ESP_OK);
+	CHECK(STARTS(line, "air\\ q\\,x,ID=A\\=B\\,C\\ D,SensorModel=H2+1\\ 0 SecActive=0,"));
+	CHECK(STARTS(csv, "0:00:00,A=B,C D,airu/influx,0,"));
+
+	memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	CHECK_EQ(ENC_Initialize(MEAS, big, VER, TOPIC), ESP_ERR_INVALID_SIZE);
+	CHECK_EQ(ENC_Initialize(MEAS, MAC, VER, TOPIC), ESP_OK);
+
+	// Truncated outputs are reported and still terminated
+	memset(line, '#', sizeof(line));
+	CHECK_EQ(ENC_Encode(&s, line, 20, csv, sizeof(csv)), ESP_ERR_INVALID_SIZE);
+	CHECK_EQ(strlen(line), 19);
+	CHECK_EQ(line[20], '#');
+	CHECK_EQ(ENC_Encode(&s, line, sizeof(line), csv, 8), ESP_ERR_INVALID_SIZE);
+	CHECK_EQ(strlen(csv), 7);
+
+	// Exact ties round away from zero, negative zero loses its sign
+	CHECK_EQ(enc_fmt_fixed(num, 0.125, 2), 4);
+	CHECK(strncmp(num, "0.13", 4) == 0);
+	CHECK_EQ(enc_fmt_fixed(num, -0.125, 2), 5);
+	CHECK(strncmp(num, "-0.13", 5) == 0);
+	CHECK_EQ(enc_fmt_fixed(num, 2.5, 0), 1);
+	CHECK(strncmp(num, "3", 1) == 0);
+	CHECK_EQ(enc_fmt_fixed(num, -0.001, 2), 4);
+	CHECK(strncmp(num, "0.00", 4) == 0);
+	CHECK_EQ(enc_fmt_fixed(num, 1.5, 9), 8);
+	CHECK(strncmp(num, "1.500000", 8) == 0);
+
+	// Out of the fixed point range falls back to the C library, in
+	// exponent form past the number buffer
+	num[enc_fmt_fixed(num, 9.5e16, 2)] = '\0';
+	CHECK(strcmp(num, "95000000000000000.00") == 0);
+	num[enc_fmt_fixed(num, -3.4e38, 2)] = '\0';
+	CHECK(strcmp(num, "-3.40e+38") == 0);
+	num[enc_fmt_fixed(num, NAN, 2)] = '\0';
+	CHECK(strstr(num, "nan") != NULL);
+	num[enc_fmt_fixed(num, INFINITY, 2)] = '\0';
+	CHECK(strcmp(num, "inf") == 0);
+
+	// A huge value in a record stays inside its field
+	memset(&s, 0, sizeof(s));
+	s.utc_ms = -1;
+	s.pm10 = 3.4e38f;
+	CHECK_EQ(ENC_Encode(&s, line, sizeof(line), csv, sizeof(csv)), ESP_OK);
+	CHECK(strstr(line, ",PM10=3.40e+38,Temperature=0.00,") != NULL);
+	CHECK(strstr(csv, ",3.40e+38,0.00,") != NULL);
+}
+
+static double rnd(double lo, double hi)
+{
+	return lo + (hi - lo) * (rand() / (double) RAND_MAX);
+}
+
+/*
+ * A random float that isn't an exact tie at 'decimals' and doesn't round
+ * to a negative zero. printf rounds ties to even and keeps the sign of
+ * zero, the encoder rounds away from zero and drops it (test_edges).
+ */
+static float rnd_field(double lo, double hi, int decimals)
+{
+	double x;
+	float v;
+
+	do {
+		v = rnd(lo, hi);
+		x = fabs(v) * pow(10, decimals);
+	} while (x - floor(x) == 0.5 || (v < 0 && x < 0.5));
+	return v;
+}
+
+static void rnd_record(airu_sample_t *s, int i)
+{
+	memset(s, 0, sizeof(*s));
+	s->ts_us = (int64_t) i * 4300000 + rand() % 1000000;
+	s->utc_ms = -1;
+	s->valid = AIRU_FIELD_TEMP | AIRU_FIELD_HUM | AIRU_FIELD_CO | AIRU_FIELD_NOX;
+	if (rand() % 2) {
+		s->valid |= AIRU_FIELD_DATE | AIRU_FIELD_TIME;
+		s->year = 26;
+		s->hour = rand() % 24;
+		s->min = rand() % 60;
+		s->sec = rand() % 60;
+	}
+	s->alt = rnd_field(-100, 4000, 2);
+	s->lat = rnd_field(-90, 90, 4);
+	s->lon = rnd_field(-180, 180, 4);
+	s->pm1 = rnd_field(-1, 500, 2);
+	s->pm2_5 = rnd_field(0, 1000, 2);
+	s->pm10 = (i % 7 == 0) ? -1 : rnd_field(0, 2000, 2);
+	s->temp = rnd_field(-40, 125, 2);
+	s->hum = rnd_field(0, 100, 2);
+	s->co = rand() % 5000 - 1;
+	s->nox = rand() % 5000;
+	if (i % 1000 == 3) {
+		s->temp = NAN;
+	}
+}
+
+static void test_against_sprintf(void)
+{
+	static airu_sample_t rec[BENCH_RECORDS];
+	char line[1024], csv[ENC_CSV_LEN], ref_line[1024], ref_csv[ENC_CSV_LEN];
+	int i, line_diff = 0, csv_diff = 0;
+	size_t bytes = 0;
+	double t0, t_enc, t_old;
+
+	CHECK_EQ(ENC_Initialize(MEAS, MAC, VER, TOPIC), ESP_OK);
+	srand(4);
+
+	for (i = 0; i < RANDOM_RECORDS; i++) {
+		rnd_record(&rec[i % BENCH_RECORDS], i);
+		CHECK_EQ(ENC_Encode(&rec[i % BENCH_RECORDS], line, sizeof(line), csv, sizeof(csv)), ESP_OK);
+		old_serialize(&rec[i % BENCH_RECORDS], ref_line, sizeof(ref_line), ref_csv, sizeof(ref_csv));
+		if (strcmp(line, ref_line) != 0) {
+			if (line_diff++ == 0) {
+				fprintf(stderr, "line: %s\n  ref: %s\n", line, ref_line);
+			}
+		}
+		if (strcmp(csv, ref_csv) != 0) {
+			if (csv_diff++ == 0) {
+				fprintf(stderr, "csv: %s  ref: %s", csv, ref_csv);
+			}
+		}
+		bytes += strlen(line) + strlen(csv);
+	}
+	CHECK_EQ(line_diff, 0);
+	CHECK_EQ(csv_diff, 0);
+
+	t0 = host_seconds();
+	for (i = 0; i < BENCH_RECORDS; i++) {
+		ENC_Encode(&rec[i], line, sizeof(line), csv, sizeof(csv));
+	}
+	t_enc = host_seconds() - t0;
+
+	t0 = host_seconds();
+	for (i = 0; i < BENCH_RECORDS; i++) {
+		old_serialize(&rec[i], line, sizeof(line), csv, sizeof(csv));
+	}
+	t_old = host_seconds() - t0;
+
+	printf("sprintf: %d records, %.1f bytes/record, all identical\n",
+		   RANDOM_RECORDS, (double) bytes / RANDOM_RECORDS);
+	printf("bench: encoder %.0f ns/record, sprintf %.0f ns/record, %.1fx\n",
+		   t_enc / BENCH_RECORDS * 1e9, t_old / BENCH_RECORDS * 1e9, t_old / t_enc);
+}
+
+int main(void)
+{
+	test_golden();
+	test_edges();
+	test_against_sprintf();
+	return host_test_done("test_encoder");
+}
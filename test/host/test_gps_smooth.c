@@ -0,0 +1,249 @@
+/*
+ * test_gps_smooth.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  GPS position averaging and geohash tag (gps_if.c), fed GGA sentences
+ *  through parse():
+ *
+ *    - GPS_Geohash() on published vectors, the corners of the range, and
+ *      a double precision reference over 100k random positions, every
+ *      character that isn't within a few 1e-7 degree of a cell edge
+ *    - the window mean: fixes without a solution or with a poor HDOP left
+ *      out, the last CONFIG_GPS_AVG_WINDOW good ones averaged exactly as
+ *      the 1e-7 degree sums say
+ *    - the tag: kept while the mean wanders up to a quarter cell past its
+ *      edge, moved once it goes further, and kept again on the way back
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+
+/* Averaging and the tag only; the standby logic has its own task */
+#undef CONFIG_GPS_DUTY_CYCLE
+
+#include "gps_if.c"
+
+void LED_SetEventBit(led_events_t bit) { }
+void TIME_Discipline(int64_t utc_ms, int64_t mono_us, time_src_t src) { }
+int64_t TIME_EpochMs(uint16_t year, uint8_t month, uint8_t day,
+					 uint8_t hour, uint8_t min, uint8_t sec, uint16_t ms) { return -1; }
+
+#define REF_POINTS		100000
+#define REF_MARGIN		64			/* 1e-7 degree; integer mids drift one a level */
+#define FIXES			600
+
+static uint32_t seed = 12;
+
+static uint32_t rnd(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) & 0xFFFFFF) % n;
+}
+
+static int32_t rnd_e7(int64_t max)
+{
+	return (int32_t) (((int64_t) rnd(1 << 24) << 24 | rnd(1 << 24)) % (2 * max + 1) - max);
+}
+
+/*
+ * Geohash in double precision. margin gets, per character, how close
+ * the position came to a bisection point, in 1e-7 degree.
+ */
+static void ref_geohash(int32_t lat_e7, int32_t lon_e7, int len, char *out, double *margin)
+{
+	static const char base32[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+	double lat = lat_e7 / 1e7, lon = lon_e7 / 1e7;
+	double la[2] = { -90, 90 }, lo[2] = { -180, 180 }, mid;
+	int i, b, ch, even = 1;
+
+	for (i = 0; i < len; i++) {
+		ch = 0;
+		margin[i] = 1e12;
+		for (b = 0; b < 5; b++, even = !even) {
+			double *r = even ? lo : la, x = even ? lon : lat;
+
+			mid = (r[0] + r[1]) / 2;
+			margin[i] = fmin(margin[i], fabs(x - mid) * 1e7);
+			ch = ch << 1 | (x >= mid);
+			r[x >= mid ? 0 : 1] = mid;
+		}
+		out[i] = base32[ch];
+	}
+	out[len] = '\0';
+}
+
+static void test_geohash(void)
+{
+	char h[GPS_GEOHASH_MAX_LEN + 1], ref[GPS_GEOHASH_MAX_LEN + 1];
+	double margin[GPS_GEOHASH_MAX_LEN];
+	int32_t lat, lon;
+	uint32_t compared = 0, total = 0, bad = 0;
+	int i, c;
+
+	GPS_Geohash(576491100, 104074400, 11, h);
+	CHECK(strcmp(h, "u4pruydqqvj") == 0);
+	GPS_Geohash(426000000, -56000000, 5, h);
+	CHECK(strcmp(h, "ezs42") == 0);
+	GPS_Geohash(0, 0, 8, h);
+	CHECK(strcmp(h, "s0000000") == 0);
+	GPS_Geohash(-LAT_E7_MAX, -LON_E7_MAX, 6, h);
+	CHECK(strcmp(h, "000000") == 0);
+	GPS_Geohash(LAT_E7_MAX, LON_E7_MAX, 6, h);
+	CHECK(strcmp(h, "zzzzzz") == 0);
+	GPS_Geohash(0, 0, GPS_GEOHASH_MAX_LEN + 5, h);
+	CHECK_EQ(strlen(h), GPS_GEOHASH_MAX_LEN);
+
+	for (i = 0; i < REF_POINTS; i++) {
+		lat = rnd_e7(LAT_E7_MAX);
+		lon = rnd_e7(LON_E7_MAX);
+		GPS_Geohash(lat, lon, GPS_GEOHASH_MAX_LEN, h);
+		ref_geohash(lat, lon, GPS_GEOHASH_MAX_LEN, ref, margin);
+		for (c = 0; c < GPS_GEOHASH_MAX_LEN && margin[c] >= REF_MARGIN; c++) {
+			bad += h[c] != ref[c];
+			compared++;
+		}
+		total += GPS_GEOHASH_MAX_LEN;
+	}
+	CHECK_EQ(bad, 0);
+	CHECK(compared > REF_POINTS * 7);
+	printf("geohash: %d positions, %u of %u characters clear of a cell edge, all as the reference\n",
+		   REF_POINTS, compared, total);
+}
+
+/* Append "*hh\r\n" and parse */
+static esp_err_t feed(char *s)
+{
+	uint8_t sum = 0;
+	char *p = s + 1;
+
+	while (*p != '\0') {
+		sum ^= *p++;
+	}
+	return parse(s, (p - s) + sprintf(p, "*%02X\r\n", sum));
+}
+
+static esp_err_t gga(int32_t lat_e7, int32_t lon_e7, int quality, int hdop_x100, int32_t alt_mm)
+{
+	char s[128];
+	uint32_t la = llabs(lat_e7), lo = llabs(lon_e7);
+	uint32_t la_min = la % 10000000 * 6 / 100, lo_min = lo % 10000000 * 6 / 100;
+
+	sprintf(s, "$GPGGA,120000.000,%02u%02u.%04u,%c,%03u%02u.%04u,%c,%d,08,%d.%02d,%d.%03d,M,-17.0,M,,",
+			la / 10000000, la_min / 10000, la_min % 10000, lat_e7 < 0 ? 'S' : 'N',
+			lo / 10000000, lo_min / 10000, lo_min % 10000, lon_e7 < 0 ? 'W' : 'E',
+			quality, hdop_x100 / 100, hdop_x100 % 100, alt_mm / 1000, alt_mm % 1000);
+	return feed(s);
+}
+
+static void smooth_reset(void)
+{
+	memset(&gps_win, 0, sizeof(gps_win));
+	memset(&esp_gps.smooth, 0, sizeof(esp_gps.smooth));
+	tag_lat_lo = tag_lat_hi = tag_lon_lo = tag_lon_hi = 0;
+}
+
+static void test_window(void)
+{
+	static int32_t lat[FIXES], lon[FIXES], alt[FIXES];
+	int64_t s_lat, s_lon, s_alt;
+	int i, k, n = 0, from, good = 0, bad = 0;
+	int32_t a;
+	int quality, hdop;
+
+	smooth_reset();
+	CHECK_EQ(gga(407600000, -1118900000, 0, 90, 1300000), ESP_OK);
+	CHECK_EQ(esp_gps.smooth.n, 0);
+	CHECK_EQ(esp_gps.smooth.geohash[0], '\0');
+
+	for (i = 0; i < FIXES; i++) {
+		quality = (i % 7 == 3) ? 0 : 1 + (i % 2);
+		hdop = (i % 11 == 5) ? CONFIG_GPS_MAX_HDOP * 100 + 10 : 60 + (i % 13) * 20;
+		a = 1300000 + rnd_e7(20000);
+		CHECK_EQ(gga(407600000 + rnd_e7(3000), -1118900000 + rnd_e7(3000), quality, hdop, a), ESP_OK);
+		if (quality == 0 || hdop > CONFIG_GPS_MAX_HDOP * 100) {
+			continue;
+		}
+		lat[n] = esp_gps.lat_e7;
+		lon[n] = esp_gps.lon_e7;
+		alt[n] = a;
+		n++;
+		good++;
+
+		from = (n > CONFIG_GPS_AVG_WINDOW) ? n - CONFIG_GPS_AVG_WINDOW : 0;
+		for (s_lat = s_lon = s_alt = 0, k = from; k < n; k++) {
+			s_lat += lat[k];
+			s_lon += lon[k];
+			s_alt += alt[k];
+		}
+		bad += esp_gps.smooth.n != n - from;
+		bad += esp_gps.smooth.lat != (int32_t) (s_lat / (n - from)) / 1e7f;
+		bad += esp_gps.smooth.lon != (int32_t) (s_lon / (n - from)) / 1e7f;
+		bad += fabsf(esp_gps.smooth.alt - (int32_t) (s_alt / (n - from)) / 1e3f) > 1e-3f;
+		bad += strlen(esp_gps.smooth.geohash) != CONFIG_GPS_GEOHASH_PRECISION;
+	}
+	CHECK_EQ(bad, 0);
+	CHECK(good > FIXES * 3 / 4 && good < FIXES - FIXES / 11);
+	printf("window: %d of %d fixes good, tag %s\n", good, FIXES, esp_gps.smooth.geohash);
+}
+
+/* A full window at one position */
+static void hold(int32_t lat_e7, int32_t lon_e7)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_GPS_AVG_WINDOW; i++) {
+		gga(lat_e7, lon_e7, 1, 90, 1300000);
+	}
+}
+
+static void test_hysteresis(void)
+{
+	char tag[GPS_GEOHASH_MAX_LEN + 1], next[GPS_GEOHASH_MAX_LEN + 1];
+	int64_t lat_lo, lat_hi, lon_lo, lon_hi, q;
+	int32_t inside, lon;
+	int i, changes = 0;
+
+	// Near the north edge of a cell, in its middle east to west
+	geohash(407600000, -1118900000, CONFIG_GPS_GEOHASH_PRECISION, tag, &lat_lo, &lat_hi, &lon_lo, &lon_hi);
+	q = (lat_hi - lat_lo) / 4;
+	lon = (lon_lo + lon_hi) / 2;
+	inside = lat_hi - 200;
+
+	smooth_reset();
+	hold(inside, lon);
+	CHECK(strcmp(esp_gps.smooth.geohash, tag) == 0);
+
+	// Back and forth over the edge, never more than a quarter cell out
+	for (i = 0; i < 20; i++) {
+		hold(lat_hi + q / 2, lon);
+		changes += strcmp(esp_gps.smooth.geohash, tag) != 0;
+		hold(inside, lon);
+		changes += strcmp(esp_gps.smooth.geohash, tag) != 0;
+	}
+	CHECK_EQ(changes, 0);
+
+	// Further out: the cell to the north
+	hold(lat_hi + q + 200, lon);
+	GPS_Geohash(lat_hi + q + 200, lon, CONFIG_GPS_GEOHASH_PRECISION, next);
+	CHECK(strcmp(next, tag) != 0);
+	CHECK(strcmp(esp_gps.smooth.geohash, next) == 0);
+
+	// Which keeps it on the way back, until a quarter cell past its edge
+	hold(inside, lon);
+	CHECK(strcmp(esp_gps.smooth.geohash, next) == 0);
+	hold(lat_hi - q - 200, lon);
+	CHECK(strcmp(esp_gps.smooth.geohash, tag) == 0);
+	printf("hysteresis: %s kept over 40 crossings within %lld of its edge, %s past it\n",
+		   tag, (long long) q, next);
+}
+
+int main(void)
+{
+	test_geohash();
+	test_window();
+	test_hysteresis();
+	return host_test_done("test_gps_smooth");
+}
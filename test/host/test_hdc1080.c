@@ -0,0 +1,211 @@
+/*
+ * test_hdc1080.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  HDC1080 driver (hdc1080_if.c) on a simulated bus:
+ *
+ *    - HDC1080_Convert() for every one of the 65536 codes: exact against
+ *      the datasheet formula rounded to nearest, monotonic, within 0.005
+ *      of the double math it replaced
+ *    - the background measurement: the timer callbacks only notify, the
+ *      bus is touched by hdc_task alone, the read comes a conversion time
+ *      after the start, and HDC1080_Poll() reports no result, the bus
+ *      error, the value and a stale result as the clock moves on
+ *    - a read and a start due together: the read goes first
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+
+#include "hdc1080_if.c"
+
+/*
+ * The bus: every transfer is logged, reads return rd_data
+ */
+#define XFER_LOG	16
+
+static struct i2cbus_dev {
+	uint8_t addr;
+} bus_dev;
+
+static struct {
+	uint8_t wr[4];
+	size_t wr_len, rd_len;
+	int64_t us;
+} xfers[XFER_LOG];
+static uint32_t n_xfers;
+static esp_err_t bus_err;
+static uint8_t rd_data[4];
+
+esp_err_t I2CBUS_Initialize(void)
+{
+	return ESP_OK;
+}
+
+i2cbus_dev_t *I2CBUS_AddDevice(uint8_t addr, const char *name, i2cbus_prio_t prio, uint32_t timeout_ms)
+{
+	bus_dev.addr = addr;
+	return &bus_dev;
+}
+
+esp_err_t I2CBUS_Transfer(i2cbus_dev_t *dev, const uint8_t *wr, size_t wr_len, uint8_t *rd, size_t rd_len)
+{
+	uint32_t i = n_xfers++ % XFER_LOG;
+
+	CHECK(dev == &bus_dev && wr_len <= sizeof(xfers[0].wr));
+	memcpy(xfers[i].wr, wr, wr_len);
+	xfers[i].wr_len = wr_len;
+	xfers[i].rd_len = rd_len;
+	xfers[i].us = host_time_us;
+	if (bus_err == ESP_OK && rd_len > 0) {
+		CHECK(rd_len <= sizeof(rd_data));
+		memcpy(rd, rd_data, rd_len);
+	}
+	return bus_err;
+}
+
+void I2CBUS_GetStats(const i2cbus_dev_t *dev, i2cbus_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}
+
+static void test_convert(void)
+{
+	int16_t t, t_prev = INT16_MIN;
+	uint16_t h, h_prev = 0;
+	double err_t = 0, err_h = 0, d;
+	uint32_t raw, bad = 0;
+
+	for (raw = 0; raw <= 0xFFFF; raw++) {
+		HDC1080_Convert(raw, raw, &t, &h);
+		// floor(x + 0.5) of the datasheet formula, in hundredths
+		if (t != (int32_t) ((raw * 16500 * 2 + 0x10000) / 0x20000) - 4000 ||
+			h != (raw * 10000 * 2 + 0x10000) / 0x20000) {
+			bad++;
+		}
+		if (t < t_prev || h < h_prev) {
+			bad++;
+		}
+		t_prev = t;
+		h_prev = h;
+
+		d = fabs(t / 100.0 - ((double) raw / 0x10000 * 165 - 40));
+		err_t = (d > err_t) ? d : err_t;
+		d = fabs(h / 100.0 - ((double) raw / 0x10000 * 100));
+		err_h = (d > err_h) ? d : err_h;
+	}
+	CHECK_EQ(bad, 0);
+	CHECK(err_t <= 0.005 + 1e-9);
+	CHECK(err_h <= 0.005 + 1e-9);
+
+	HDC1080_Convert(0, 0, &t, &h);
+	CHECK_EQ(t, -4000);
+	CHECK_EQ(h, 0);
+	HDC1080_Convert(0xFFFF, 0xFFFF, &t, &h);
+	CHECK_EQ(t, 12500);
+	CHECK_EQ(h, 10000);
+	printf("convert: 65536 codes, largest difference from the double math %.4f degC, %.4f %%RH\n", err_t, err_h);
+}
+
+static void set_raw(uint16_t raw_t, uint16_t raw_h)
+{
+	rd_data[0] = raw_t >> 8;
+	rd_data[1] = raw_t & 0xFF;
+	rd_data[2] = raw_h >> 8;
+	rd_data[3] = raw_h & 0xFF;
+}
+
+#define PERIOD_US	(CONFIG_HDC1080_PERIOD_S * 1000000LL)
+#define READ_US		((pdMS_TO_TICKS(HDC1080_CONV_US / 1000) + 1) * portTICK_PERIOD_MS * 1000LL)
+
+static void test_measure(void)
+{
+	double temp, hum;
+	int16_t t;
+	uint16_t h;
+	int64_t t0;
+	uint32_t n;
+
+	CHECK(READ_US >= HDC1080_CONV_US);
+	CHECK_EQ(HDC1080_Initialize(), ESP_OK);
+	CHECK_EQ(n_xfers, 1);
+	CHECK_EQ(xfers[0].wr_len, 3);
+	CHECK(xfers[0].wr[0] == HDC1080_CONF_ADDR && xfers[0].wr[1] == 0x10 && xfers[0].wr[2] == 0x00);
+	CHECK_EQ(bus_dev.addr, HDC1080_DEV_ADDR);
+	CHECK_EQ(HDC1080_Poll(&temp, &hum), ESP_ERR_NOT_FOUND);
+
+	// The period elapses: the callback only notifies, the task starts it
+	t0 = host_time_us;
+	host_advance_us(PERIOD_US);
+	CHECK_EQ(n_xfers, 1);
+	CHECK_EQ(host_task_notified(hdc_task_handle), HDC_START_BIT);
+	xTaskNotify(hdc_task_handle, HDC_START_BIT, eSetBits);
+	host_task_run(hdc_task_handle);
+	CHECK_EQ(n_xfers, 2);
+	CHECK(xfers[1].wr_len == 1 && xfers[1].wr[0] == HDC1080_TEMP_REG && xfers[1].rd_len == 0);
+
+	// The read a conversion time later, no earlier
+	set_raw(0x6000, 0x8000);
+	host_advance_us(READ_US - 1);
+	CHECK_EQ(host_task_notified(hdc_task_handle), 0);
+	host_advance_us(1);
+	host_task_run(hdc_task_handle);
+	CHECK_EQ(n_xfers, 3);
+	CHECK(xfers[2].wr_len == 0 && xfers[2].rd_len == 4);
+	CHECK_EQ(xfers[2].us - xfers[1].us, READ_US);
+	CHECK_EQ(HDC1080_Poll(&temp, &hum), ESP_OK);
+	HDC1080_Convert(0x6000, 0x8000, &t, &h);
+	CHECK_NEAR(temp, t / 100.0, 1e-9);
+	CHECK_NEAR(hum, h / 100.0, 1e-9);
+	CHECK_NEAR(temp, 21.88, 1e-9);
+	CHECK_NEAR(hum, 50.0, 1e-9);
+
+	// The bus fails from now on: the last good value holds until stale
+	bus_err = ESP_ERR_TIMEOUT;
+	n = n_xfers;
+	while (host_time_us - xfers[2].us <= HDC1080_STALE_PERIODS * PERIOD_US) {
+		CHECK_EQ(HDC1080_Poll(&temp, &hum), ESP_OK);
+		host_advance_us(PERIOD_US / 2);
+		host_task_run(hdc_task_handle);
+	}
+	CHECK(n_xfers > n);
+	CHECK(hdc_last.errors > 0);
+	CHECK_EQ(HDC1080_Poll(&temp, &hum), ESP_ERR_TIMEOUT);
+	CHECK(host_time_us - t0 > HDC1080_STALE_PERIODS * PERIOD_US);
+}
+
+static void test_order(void)
+{
+	double temp, hum;
+	uint32_t n;
+
+	// Never a good reading: Poll reports the bus error
+	memset(&hdc_last, 0, sizeof(hdc_last));
+	seqlock_write(&hdc_snap, &hdc_last);
+	hdc_publish(ESP_ERR_TIMEOUT);
+	CHECK_EQ(HDC1080_Poll(&temp, &hum), ESP_ERR_TIMEOUT);
+
+	// Read and start due together: the pending read goes first
+	bus_err = ESP_OK;
+	set_raw(0x0000, 0xFFFF);
+	n = n_xfers;
+	xTaskNotify(hdc_task_handle, HDC_START_BIT | HDC_READ_BIT, eSetBits);
+	host_task_run(hdc_task_handle);
+	CHECK_EQ(n_xfers, n + 2);
+	CHECK(xfers[n % XFER_LOG].rd_len == 4 && xfers[n % XFER_LOG].wr_len == 0);
+	CHECK(xfers[(n + 1) % XFER_LOG].wr_len == 1 && xfers[(n + 1) % XFER_LOG].rd_len == 0);
+	CHECK_EQ(HDC1080_Poll(&temp, &hum), ESP_OK);
+	CHECK_NEAR(temp, -40.0, 1e-9);
+	CHECK_NEAR(hum, 100.0, 1e-9);
+}
+
+int main(void)
+{
+	test_convert();
+	test_measure();
+	test_order();
+	return host_test_done("test_hdc1080");
+}
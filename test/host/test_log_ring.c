@@ -0,0 +1,252 @@
+/*
+ * test_log_ring.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  SD log ring (log_ring.c) and the log hook that feeds it (sd_if.c):
+ *
+ *    - init arguments, a full ring, records that don't fit at the end of
+ *      the buffer, drains stopping at an uncommitted record and at a full
+ *      destination
+ *    - the hook: lines too long are cut and keep their newline, a full
+ *      ring counts the line as dropped and doesn't block
+ *    - several producer threads logging through the hook while one thread
+ *      drains, as sd_log_task does. Every line carries its producer, a
+ *      sequence number and a body derived from both, so a torn or mixed
+ *      line shows. Each producer's lines must arrive whole and in order,
+ *      and every line is either drained or counted as dropped. Everyone
+ *      yields now and then so this also runs on a single core.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <sched.h>
+#include "host_test.h"
+
+#define CONFIG_SD_CARD_DEBUG	1
+#define SD_MOUNT_POINT			"build/sdlog"
+#include "sd_if.c"
+
+#define STRESS_PRODUCERS	4
+#define STRESS_LINES		200000
+
+static int hook(const char *format, ...)
+{
+	va_list ap;
+	int len;
+
+	va_start(ap, format);
+	len = esp_sd_log_write(format, ap);
+	va_end(ap);
+	return len;
+}
+
+static void test_ring(void)
+{
+	static uint64_t storage[256 / 8];
+	static char dst[512];
+	log_ring_slot_t a, b, c;
+	log_ring_t r;
+	int i;
+
+	CHECK_EQ(log_ring_init(&r, storage, 48), ESP_ERR_INVALID_ARG);
+	CHECK_EQ(log_ring_init(&r, storage, 96), ESP_ERR_INVALID_ARG);
+	CHECK_EQ(log_ring_init(&r, (uint8_t *) storage + 4, 128), ESP_ERR_INVALID_ARG);
+	CHECK_EQ(log_ring_init(NULL, storage, 256), ESP_ERR_INVALID_ARG);
+	CHECK_EQ(log_ring_init(&r, storage, 256), ESP_OK);
+	CHECK_EQ(log_ring_drain(&r, dst, sizeof(dst)), 0);
+
+	// Reserved but not committed: the drain waits, later records too
+	CHECK(log_ring_reserve(&r, 10, &a));
+	CHECK(log_ring_reserve(&r, 10, &b));
+	memcpy(b.data, "bbbbbbbbbb", 10);
+	log_ring_commit(&r, &b, 10);
+	CHECK_EQ(log_ring_drain(&r, dst, sizeof(dst)), 0);
+	memcpy(a.data, "aaaaaaaaaa", 10);
+	log_ring_commit(&r, &a, 4);
+	CHECK_EQ(log_ring_drain(&r, dst, sizeof(dst)), 14);
+	CHECK(memcmp(dst, "aaaabbbbbbbbbb", 14) == 0);
+
+	// Full: refused and counted, nothing blocks
+	for (i = 0; log_ring_reserve(&r, 24, &a); i++) {
+		memset(a.data, '0' + i, 24);
+		log_ring_commit(&r, &a, 24);
+	}
+	CHECK_EQ(r.dropped, 1);
+	CHECK(i > 0 && i * 32 <= 256);
+
+	// A full destination stops the drain at a record boundary
+	CHECK_EQ(log_ring_drain(&r, dst, 30), 24);
+	CHECK_EQ(log_ring_drain(&r, dst, sizeof(dst)), 24 * (i - 1));
+	CHECK_EQ(dst[0], '1');
+
+	// Around the end of the buffer many times: records never straddle it
+	for (i = 0; i < 1000; i++) {
+		size_t len = 1 + (i * 37) % 100;
+
+		CHECK(log_ring_reserve(&r, len, &c));
+		CHECK((uint8_t *) c.data + len <= (uint8_t *) storage + sizeof(storage));
+		memset(c.data, 'a' + i % 26, len);
+		log_ring_commit(&r, &c, len);
+		CHECK_EQ(log_ring_drain(&r, dst, sizeof(dst)), len);
+		CHECK(dst[0] == 'a' + i % 26 && dst[len - 1] == 'a' + i % 26);
+	}
+	CHECK_EQ(r.dropped, 1);
+}
+
+static void test_hook(void)
+{
+	static char dst[CONFIG_SD_LOG_RING_SIZE];
+	char longer[MAX_LOG_PKG_LENGTH * 2];
+	uint32_t dropped;
+	size_t n;
+
+	CHECK_EQ(log_ring_init(&log_ring, log_ring_storage, sizeof(log_ring_storage)), ESP_OK);
+
+	CHECK_EQ(hook("I (%d) %s: %s\n", 1234, "gps", "fix"), 18);
+	CHECK_EQ(log_ring_drain(&log_ring, dst, sizeof(dst)), 18);
+	CHECK(memcmp(dst, "I (1234) gps: fix\n", 18) == 0);
+
+	// Cut lines end in a newline so the next one starts on its own
+	memset(longer, 'x', sizeof(longer) - 1);
+	longer[sizeof(longer) - 1] = '\0';
+	CHECK_EQ(hook("%s\n", longer), MAX_LOG_PKG_LENGTH);
+	CHECK_EQ(hook("next\n"), 5);
+	n = log_ring_drain(&log_ring, dst, sizeof(dst));
+	CHECK_EQ(n, MAX_LOG_PKG_LENGTH + 5);
+	CHECK(dst[MAX_LOG_PKG_LENGTH - 2] == 'x' && dst[MAX_LOG_PKG_LENGTH - 1] == '\n');
+	CHECK(memcmp(dst + MAX_LOG_PKG_LENGTH, "next\n", 5) == 0);
+	CHECK_EQ(hook("%s", ""), 0);
+
+	// Full ring: the line is dropped, the caller goes on
+	dropped = log_ring.dropped;
+	while (hook("%s\n", longer) > 0) {
+	}
+	CHECK_EQ(log_ring.dropped, dropped + 1);
+	while (hook("x\n") > 0) {
+	}
+	CHECK_EQ(hook("x\n"), 0);
+	CHECK_EQ(log_ring.dropped, dropped + 3);
+	while (log_ring_drain(&log_ring, dst, sizeof(dst)) > 0) {
+	}
+	CHECK_EQ(hook("x\n"), 2);
+}
+
+/*
+ * Stress: producers log numbered lines through the hook, the consumer
+ * drains them as sd_log_task does
+ */
+static uint32_t produced_dropped[STRESS_PRODUCERS];
+static volatile int producers_done;
+
+static void line_body(char *body, int p, uint32_t seq)
+{
+	int len = (seq * 7 + p * 13) % 60, i;
+
+	for (i = 0; i < len; i++) {
+		body[i] = 'a' + (seq + p + i) % 26;
+	}
+	body[len] = '\0';
+}
+
+static void *producer(void *arg)
+{
+	int p = (int) (intptr_t) arg;
+	char body[64];
+	uint32_t seq;
+
+	for (seq = 0; seq < STRESS_LINES; seq++) {
+		line_body(body, p, seq);
+		if (hook("P%d %u %s\n", p, seq, body) == 0) {
+			produced_dropped[p]++;
+		}
+		if (seq % 8 == 0) {
+			sched_yield();
+		}
+	}
+	__atomic_fetch_add(&producers_done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void test_stress(void *storage, uint32_t size)
+{
+	static char block[SD_LOG_BLOCK_SIZE];
+	char line[128], body[64], expect[64];
+	int64_t next[STRESS_PRODUCERS];
+	uint32_t got = 0, torn = 0, disorder = 0, dropped = 0, lost = 0;
+	pthread_t t[STRESS_PRODUCERS];
+	size_t n, k, ll = 0;
+	unsigned seq;
+	double t0;
+	int p, finished = 0;
+
+	CHECK_EQ(log_ring_init(&log_ring, storage, size), ESP_OK);
+	memset(produced_dropped, 0, sizeof(produced_dropped));
+	producers_done = 0;
+	memset(next, 0, sizeof(next));
+	t0 = host_seconds();
+	for (p = 0; p < STRESS_PRODUCERS; p++) {
+		pthread_create(&t[p], NULL, producer, (void *) (intptr_t) p);
+	}
+
+	for (;;) {
+		n = log_ring_drain(&log_ring, block, sizeof(block));
+		for (k = 0; k < n; k++) {
+			if (ll < sizeof(line) - 1) {
+				line[ll++] = block[k];
+			}
+			if (block[k] != '\n') {
+				continue;
+			}
+			line[ll - 1] = '\0';
+			ll = 0;
+			got++;
+			body[0] = '\0';
+			if (sscanf(line, "P%d %u %63s", &p, &seq, body) < 2 || p < 0 || p >= STRESS_PRODUCERS) {
+				torn++;
+				continue;
+			}
+			line_body(expect, p, seq);
+			if (strcmp(body, expect) != 0) {
+				torn++;
+			}
+			if ((int64_t) seq < next[p]) {
+				disorder++;
+			}
+			next[p] = seq + 1;
+		}
+		if (n == 0) {
+			if (finished) {
+				break;
+			}
+			// One more pass after the last producer is done
+			finished = __atomic_load_n(&producers_done, __ATOMIC_ACQUIRE) == STRESS_PRODUCERS;
+			sched_yield();
+		}
+	}
+	for (p = 0; p < STRESS_PRODUCERS; p++) {
+		pthread_join(t[p], NULL);
+		dropped += produced_dropped[p];
+	}
+	lost = STRESS_PRODUCERS * STRESS_LINES - got - dropped;
+
+	CHECK_EQ(torn, 0);
+	CHECK_EQ(disorder, 0);
+	CHECK_EQ(ll, 0);
+	CHECK_EQ(lost, 0);
+	CHECK_EQ(dropped, log_ring.dropped);
+	printf("stress: %5u byte ring, %d producers, %u lines in %.2f s, %u drained, %u dropped, %u torn, %u out of order, %u lost\n",
+		   size, STRESS_PRODUCERS, STRESS_PRODUCERS * STRESS_LINES, host_seconds() - t0, got, dropped, torn, disorder, lost);
+}
+
+int main(void)
+{
+	test_ring();
+	test_hook();
+	test_stress(log_ring_storage, sizeof(log_ring_storage));
+	// Small enough that producers keep finding it full
+	test_stress(log_ring_storage, 512);
+	return host_test_done("test_log_ring");
+}
@@ -0,0 +1,275 @@
+/*
+ * test_log_rotate.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Rotating SD log files (log_rotate.c), with the card being a directory
+ *  under build/:
+ *
+ *    - init arguments, rotating when a write would pass max_size, writes
+ *      bigger than max_size, the current slot's size measured at init
+ *    - pointer copies: the newest valid one wins, a torn or out of range
+ *      copy falls back to the other one
+ *    - a long run of numbered log lines in blocks, as sd_log_task writes
+ *      them, with power losses after flushes and now and then in the middle
+ *      of a pointer update. After every power loss the slots read oldest
+ *      to newest must hold one unbroken run of lines ending with the last
+ *      one flushed, and the directory must stay within
+ *      count * (max_size + largest write) plus the pointer file.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "host_test.h"
+#include "log_rotate.h"
+
+#define LOG_DIR			"build/logrot"
+#define LOG_FMT			LOG_DIR "/LOGGING-%02d.log"
+#define LOG_PTR			LOG_DIR "/LOGGING.ptr"
+
+#define RUN_COUNT		8
+#define RUN_MAX_SIZE	8192
+#define RUN_BLOCK		4096		/* SD_LOG_BLOCK_SIZE */
+#define RUN_BLOCKS		50000
+#define RUN_FLUSH		8			/* blocks between flushes */
+
+static void dir_wipe(void)
+{
+	CHECK_EQ(system("rm -rf " LOG_DIR " && mkdir -p " LOG_DIR), 0);
+}
+
+static long dir_usage(void)
+{
+	DIR *d = opendir(LOG_DIR);
+	struct dirent *e;
+	struct stat st;
+	char path[300];
+	long total = 0;
+
+	while ((e = readdir(d)) != NULL) {
+		if (e->d_name[0] == '.') {
+			continue;
+		}
+		snprintf(path, sizeof(path), LOG_DIR "/%s", e->d_name);
+		if (stat(path, &st) == 0) {
+			total += st.st_size;
+		}
+	}
+	closedir(d);
+	return total;
+}
+
+static long file_size(const char *path)
+{
+	struct stat st;
+
+	return (stat(path, &st) == 0) ? st.st_size : -1;
+}
+
+static void test_basic(void)
+{
+	static char big[3 * 1000];
+	log_rotate_t lr;
+	char name[LOG_ROTATE_NAME_LEN];
+
+	dir_wipe();
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, 1, 1000), ESP_ERR_INVALID_ARG);
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, 101, 1000), ESP_ERR_INVALID_ARG);
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, 3, 0), ESP_ERR_INVALID_ARG);
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, 3, 1000), ESP_OK);
+	CHECK_EQ(lr.slot, 0);
+	CHECK_EQ(lr.size, 0);
+
+	// Up to max_size in one file, then the next
+	memset(big, 'x', sizeof(big));
+	CHECK_EQ(log_rotate_write(&lr, big, 600), ESP_OK);
+	CHECK_EQ(log_rotate_write(&lr, big, 400), ESP_OK);
+	CHECK_EQ(lr.slot, 0);
+	CHECK_EQ(log_rotate_write(&lr, big, 1), ESP_OK);
+	CHECK_EQ(lr.slot, 1);
+	CHECK_EQ(lr.rotations, 1);
+
+	// Bigger than max_size: one file of its own
+	CHECK_EQ(log_rotate_write(&lr, big, sizeof(big)), ESP_OK);
+	CHECK_EQ(lr.slot, 2);
+	CHECK_EQ(lr.size, sizeof(big));
+	CHECK_EQ(log_rotate_write(&lr, big, 10), ESP_OK);
+	CHECK_EQ(lr.slot, 0);
+	log_rotate_close(&lr);
+	CHECK_EQ(file_size(LOG_DIR "/LOGGING-00.log"), 10);
+	CHECK_EQ(file_size(LOG_DIR "/LOGGING-01.log"), 1);
+	CHECK_EQ(file_size(LOG_DIR "/LOGGING-02.log"), sizeof(big));
+
+	// Reboot: same slot, size measured
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, 3, 1000), ESP_OK);
+	CHECK_EQ(lr.slot, 0);
+	CHECK_EQ(lr.size, 10);
+	snprintf(name, sizeof(name), LOG_FMT, 0);
+	CHECK(strcmp(lr.name, name) == 0);
+	CHECK_EQ(lr.rotations, 0);
+}
+
+static void ptr_corrupt(long at)
+{
+	FILE *f = fopen(LOG_PTR, "r+");
+
+	CHECK(f != NULL);
+	fseek(f, at, SEEK_SET);
+	fputc(0xA5 ^ at, f);
+	fclose(f);
+}
+
+static void test_pointer(void)
+{
+	log_rotate_t lr;
+
+	dir_wipe();
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, 5, 1000), ESP_OK);
+	CHECK_EQ(log_rotate_next(&lr), ESP_OK);
+	CHECK_EQ(log_rotate_next(&lr), ESP_OK);
+	CHECK_EQ(log_rotate_next(&lr), ESP_OK);
+	CHECK_EQ(lr.slot, 3);
+	CHECK_EQ(lr.seq, 3);
+	CHECK_EQ(file_size(LOG_PTR), 32);
+
+	// The copy written last is torn: back to the one before
+	ptr_corrupt((lr.seq & 1) * 16 + 9);
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, 5, 1000), ESP_OK);
+	CHECK_EQ(lr.slot, 2);
+	CHECK_EQ(lr.seq, 2);
+
+	// The next update goes over the torn copy
+	CHECK_EQ(log_rotate_next(&lr), ESP_OK);
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, 5, 1000), ESP_OK);
+	CHECK_EQ(lr.slot, 3);
+
+	// Fewer slots than the pointer names (the count was lowered)
+	CHECK_EQ(log_rotate_next(&lr), ESP_OK);
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, 4, 1000), ESP_OK);
+	CHECK_EQ(lr.slot, 3);
+
+	// Both torn, or no pointer file: slot 0
+	ptr_corrupt(2);
+	ptr_corrupt(18);
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, 5, 1000), ESP_OK);
+	CHECK_EQ(lr.slot, 0);
+	remove(LOG_PTR);
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, 5, 1000), ESP_OK);
+	CHECK_EQ(lr.slot, 0);
+}
+
+/*
+ * Read the slots oldest to newest and check they hold lines first..last
+ * without a gap. Returns the number of lines, -1 on a gap or bad line.
+ */
+static long run_verify(const log_rotate_t *lr, uint32_t last, uint32_t *first)
+{
+	static char line[RUN_BLOCK];
+	char name[LOG_ROTATE_NAME_LEN];
+	long lines = 0;
+	uint32_t seq, prev = 0;
+	int i;
+	FILE *f;
+
+	for (i = 1; i <= lr->count; i++) {
+		snprintf(name, sizeof(name), LOG_FMT, (lr->slot + i) % lr->count);
+		if ((f = fopen(name, "r")) == NULL) {
+			continue;
+		}
+		while (fgets(line, sizeof(line), f) != NULL) {
+			if (sscanf(line, "L%u ", &seq) != 1 || line[strlen(line) - 1] != '\n' ||
+				(lines > 0 && seq != prev + 1)) {
+				fclose(f);
+				return -1;
+			}
+			if (lines++ == 0) {
+				*first = seq;
+			}
+			prev = seq;
+		}
+		fclose(f);
+	}
+	return (lines == 0 || prev == last) ? lines : -1;
+}
+
+static void test_run(void)
+{
+	static char block[RUN_BLOCK];
+	log_rotate_t lr;
+	uint32_t seq = 0, first = 0, rotations = 0, crashes = 0, torn = 0, bad = 0;
+	long bound, usage, max_usage = 0, lines, min_kept = -1;
+	int i, len, n;
+
+	dir_wipe();
+	srand(10);
+	CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, RUN_COUNT, RUN_MAX_SIZE), ESP_OK);
+	bound = (long) RUN_COUNT * (RUN_MAX_SIZE + RUN_BLOCK) + 2 * 16;
+
+	for (i = 0; i < RUN_BLOCKS; i++) {
+		// A block of whole lines, up to 300 bytes each
+		len = 0;
+		for (n = 1 + rand() % 30; n > 0; n--) {
+			int body = 8 + rand() % 280;
+
+			if (len + body + 12 > RUN_BLOCK) {
+				break;
+			}
+			len += sprintf(block + len, "L%08u %.*s\n", ++seq, body,
+						   "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz"
+						   "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz"
+						   "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz"
+						   "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz");
+		}
+		CHECK_EQ(log_rotate_write(&lr, block, len), ESP_OK);
+		if (i % RUN_FLUSH != 0) {
+			continue;
+		}
+		log_rotate_flush(&lr);
+
+		if (i % (8 * RUN_FLUSH) == 0) {
+			usage = dir_usage();
+			max_usage = (usage > max_usage) ? usage : max_usage;
+		}
+
+		if (rand() % (2000 / RUN_FLUSH) == 0) {
+			// Power loss, sometimes in the middle of moving the pointer: the
+			// next slot is already empty, the new pointer copy half written
+			if (rand() % 3 == 0) {
+				CHECK_EQ(log_rotate_next(&lr), ESP_OK);
+				ptr_corrupt((lr.seq & 1) * 16 + rand() % 16);
+				torn++;
+			}
+			rotations += lr.rotations;
+			log_rotate_close(&lr);
+			crashes++;
+			CHECK_EQ(log_rotate_init(&lr, LOG_FMT, LOG_PTR, RUN_COUNT, RUN_MAX_SIZE), ESP_OK);
+
+			lines = run_verify(&lr, seq, &first);
+			bad += lines < 0;
+			if (lines > 0 && crashes > RUN_COUNT && (min_kept < 0 || seq - first + 1 < min_kept)) {
+				min_kept = seq - first + 1;
+			}
+		}
+	}
+	rotations += lr.rotations;
+	log_rotate_close(&lr);
+	lines = run_verify(&lr, seq, &first);
+
+	CHECK(lines > 0);
+	CHECK_EQ(bad, 0);
+	CHECK(max_usage <= bound);
+	printf("run: %u lines in %d blocks, %u rotations, %u power losses (%u while moving the pointer), %u broken runs\n",
+		   seq, RUN_BLOCKS, rotations, crashes, torn, bad);
+	printf("run: disk use up to %ld of %ld bytes allowed, %ld lines kept at the end, at least %ld after a power loss\n",
+		   max_usage, bound, lines, min_kept);
+}
+
+int main(void)
+{
+	test_basic();
+	test_pointer();
+	test_run();
+	return host_test_done("test_log_rotate");
+}
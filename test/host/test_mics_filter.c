@@ -0,0 +1,197 @@
+/*
+ * test_mics_filter.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  MICS-4514 sampling and filter (mics4514_if.c), on a simulated ADC:
+ *
+ *    - the decimating boxcar keeps fractions of a code; the low pass
+ *      primes on its first value, closes a step by 1/8 per update and
+ *      settles within half a code of its input from either side
+ *    - mV interpolated between neighbouring codes and clamped at full
+ *      scale; sensing resistance from the divider, and its two ends
+ *    - mics_task with the heater on for good and a noisy input on both
+ *      channels for a minute of simulated time: 400 reads/s, an update
+ *      every 500 ms, the result on the calibrated value of the mean and
+ *      far quieter than a single read. Read() reports no result before
+ *      the first update and a stale one once the sampler stops.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "host_test.h"
+#include "host_shim.h"
+
+#include "mics4514_if.c"
+
+#define Q(raw)			((int32_t) (raw) << MICS_FRAC_BITS)
+
+static void test_filter(void)
+{
+	mics_filter_t f = { 0 };
+	int32_t x, y, prev, gap, bias, max_bias = 0;
+	uint32_t acc;
+	int k, from;
+
+	// 100 reads averaging 1000.5: the fraction survives decimation
+	f.acc = 50 * 1000 + 50 * 1001;
+	CHECK_EQ(mics_filter_step(&f), Q(1000) + Q(1) / 2);
+	CHECK_EQ(f.acc, 0);
+	CHECK(f.primed);
+
+	// A step: monotonic, 1/8 of the gap an update, about e^-1 after 4 s
+	f.acc = 3000 * MICS_BURST * MICS_DECIMATE;
+	prev = mics_filter_step(&f);
+	for (k = 1; k < 8; k++) {
+		f.acc = 3000 * MICS_BURST * MICS_DECIMATE;
+		y = mics_filter_step(&f);
+		CHECK(y > prev && y < Q(3000));
+		prev = y;
+	}
+	// Each update truncates by less than one fraction step
+	gap = Q(3000) - prev;
+	CHECK(fabs(gap - (Q(3000) - Q(1000) - Q(1) / 2) * pow(7.0 / 8, 8)) <= 8);
+
+	// Settled, from below and from above, for every sub-code input
+	for (acc = 2000 * MICS_BURST * MICS_DECIMATE; acc < 2002 * MICS_BURST * MICS_DECIMATE; acc++) {
+		x = ((int64_t) acc << MICS_FRAC_BITS) / (MICS_BURST * MICS_DECIMATE);
+		for (from = -1; from <= 1; from += 2) {
+			f.y = x + from * Q(100);
+			for (k = 0; k < 200; k++) {
+				f.acc = acc;
+				mics_filter_step(&f);
+			}
+			bias = abs(f.y - x);
+			max_bias = (bias > max_bias) ? bias : max_bias;
+		}
+	}
+	CHECK(max_bias < Q(1) / 2);
+	printf("filter: 1/8 per update, %.3f of a step left after 8 updates, settles within %.3f of a code\n",
+		   (double) gap / (Q(3000) - Q(1000) - Q(1) / 2), (double) max_bias / Q(1));
+}
+
+static void test_convert(void)
+{
+	uint32_t raw, lo, hi, mv, prev = 0;
+	int32_t q;
+
+	for (raw = 0; raw < MICS_ADC_MAX; raw++) {
+		lo = esp_adc_cal_raw_to_voltage(raw, adc_chars);
+		hi = esp_adc_cal_raw_to_voltage(raw + 1, adc_chars);
+		for (q = Q(raw); q < Q(raw + 1); q++) {
+			mv = mics_to_mv(q);
+			if (mv < lo || mv > hi || mv < prev) {
+				CHECK(mv >= lo && mv <= hi && mv >= prev);
+			}
+			prev = mv;
+		}
+		CHECK_EQ(mics_to_mv(Q(raw)), lo);
+	}
+	CHECK_EQ(mics_to_mv(Q(MICS_ADC_MAX)), HOST_ADC_CAL_MAX_MV);
+	CHECK_EQ(mics_to_mv(Q(MICS_ADC_MAX) + Q(1) / 2), HOST_ADC_CAL_MAX_MV);
+
+	// Rs 10k on the 22k load: 2268.75 mV across the load
+	CHECK_EQ(mics_to_ohms(2268, 22000), 22000ULL * (3300 - 2268) / 2268);
+	CHECK(abs((int) mics_to_ohms(2268, 22000) - 10000) < 20);
+	CHECK_EQ(mics_to_ohms(0, 22000), UINT32_MAX);
+	CHECK_EQ(mics_to_ohms(CONFIG_MICS_SUPPLY_MV, 22000), 0);
+	CHECK_EQ(mics_to_ohms(CONFIG_MICS_SUPPLY_MV + 100, 22000), 0);
+}
+
+/*
+ * The simulated channels: a level plus uniform noise. The sampler never
+ * returns by itself; the ADC leaves it through adc_escape at adc_stop_us.
+ */
+#define OX_RAW		1500
+#define RED_RAW		2500
+#define NOISE		40			/* +- codes */
+#define RUN_S		60
+
+static jmp_buf adc_escape;
+static int64_t adc_stop_us;
+static uint32_t adc_reads, adc_seed = 20;
+static uint32_t seen_updates;
+static double mv_sum, mv_sq;
+static uint32_t mv_n;
+static int64_t run_start_us;
+
+static int adc_read(adc1_channel_t ch)
+{
+	mics4514_data_t d;
+
+	if (host_time_us >= adc_stop_us) {
+		longjmp(adc_escape, 1);
+	}
+	// Filtered OX values in the second half of the run
+	seqlock_read(&mics_snap, &d);
+	if (d.updates != seen_updates) {
+		seen_updates = d.updates;
+		if (d.ts_us - run_start_us > RUN_S * 1000000LL / 2) {
+			mv_sum += d.ox_mv;
+			mv_sq += (double) d.ox_mv * d.ox_mv;
+			mv_n++;
+		}
+	}
+	adc_reads++;
+	adc_seed = adc_seed * 1103515245 + 12345;
+	return ((ch == (adc1_channel_t) MICS_CH_OX) ? OX_RAW : RED_RAW) + (int) ((adc_seed >> 16) % (2 * NOISE + 1)) - NOISE;
+}
+
+static void test_task(void)
+{
+	mics4514_data_t d;
+	double mean, sd, mv_raw;
+	int64_t t;
+
+	CHECK_EQ(MICS4514_Read(&d), ESP_ERR_NOT_FOUND);
+
+	// Heater on for good, sampling from the start
+	memset(&mics_profile, 0, sizeof(mics_profile));
+	mics_stale_us = MICS_STALE_US;
+	host_adc1_read = adc_read;
+	run_start_us = host_time_us;
+	adc_stop_us = host_time_us + RUN_S * 1000000LL;
+	if (setjmp(adc_escape) == 0) {
+		mics_task(NULL);
+	}
+	host_adc1_read = NULL;
+
+	CHECK_EQ(gpio_get_level(GPIO_MICS_HEATER), 1);
+	CHECK_EQ(gpio_get_level(GPIO_MICS_ENABLE), 0);
+	CHECK(abs((int) adc_reads - 2 * MICS_BURST * (1000 / MICS_PERIOD_MS) * RUN_S) <= 2 * MICS_BURST);
+
+	CHECK_EQ(MICS4514_Read(&d), ESP_OK);
+	CHECK(abs((int) d.updates - RUN_S * 1000 / (MICS_PERIOD_MS * MICS_DECIMATE)) <= 1);
+	CHECK_EQ(d.window, 1);
+	CHECK_EQ(d.phase, MICS_PHASE_SAMPLE);
+	CHECK(abs((int) d.ox_mv - (int) esp_adc_cal_raw_to_voltage(OX_RAW, adc_chars)) <= 3);
+	CHECK(abs((int) d.red_mv - (int) esp_adc_cal_raw_to_voltage(RED_RAW, adc_chars)) <= 3);
+	CHECK_EQ(d.ox_ohms, mics_to_ohms(d.ox_mv, CONFIG_MICS_OX_LOAD_OHMS));
+	CHECK_EQ(d.red_ohms, mics_to_ohms(d.red_mv, CONFIG_MICS_RED_LOAD_OHMS));
+
+	// Quieter than one read by far: uniform noise has sd NOISE / sqrt(3)
+	mean = mv_sum / mv_n;
+	sd = sqrt(mv_sq / mv_n - mean * mean);
+	mv_raw = NOISE / sqrt(3) * (HOST_ADC_CAL_MAX_MV - HOST_ADC_CAL_MIN_MV) / 4095.0;
+	CHECK(mv_n > 50);
+	CHECK(sd * 10 < mv_raw);
+	printf("task: %u reads in %d s, %u updates, OX %u mV (sd %.2f mV over %u updates, %.1f mV a read), RED %u mV\n",
+		   adc_reads, RUN_S, d.updates, d.ox_mv, sd, mv_n, mv_raw, d.red_mv);
+
+	// The sampler has stopped: stale after MICS_STALE_US
+	t = d.ts_us + MICS_STALE_US - host_time_us;
+	host_advance_us(t);
+	CHECK_EQ(MICS4514_Read(&d), ESP_OK);
+	host_advance_us(1);
+	CHECK_EQ(MICS4514_Read(&d), ESP_ERR_TIMEOUT);
+}
+
+int main(void)
+{
+	MICS4514_Initialize();
+	test_filter();
+	test_convert();
+	test_task();
+	return host_test_done("test_mics_filter");
+}
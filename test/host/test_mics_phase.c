@@ -0,0 +1,193 @@
+/*
+ * test_mics_phase.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  MICS-4514 heater schedule (mics4514_if.c):
+ *
+ *    - MICS4514_Phase() stepped through ten cycles: phase boundaries, the
+ *      next change always ahead and the phase steady until it, the heater
+ *      and sampling duty, the schedule without duty cycling
+ *    - mics_task on the Kconfig schedule for three cycles of simulated
+ *      time. A timer looks in every second: supply and heater follow the
+ *      phase, Read() has nothing before the first window and holds the
+ *      last window's values, without going stale, until the next one.
+ *      The ADC is only read inside a window, with the heater on, and each
+ *      window's readings start afresh from a level the previous window
+ *      never saw.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "freertos/timers.h"
+
+#include "mics4514_if.c"
+
+#define S(s)		((s) * 1000000LL)
+
+static void test_phase(void)
+{
+	const mics4514_profile_t p = { 300, 60, 20 }, on = { 0, 60, 0 };
+	uint32_t steps = 0, heated = 0, sampled = 0, bad = 0;
+	mics4514_phase_t k;
+	int64_t t, next, n2;
+
+	CHECK_EQ(MICS4514_Phase(&p, 0, &next), MICS_PHASE_PREHEAT);
+	CHECK_EQ(next, S(60));
+	CHECK_EQ(MICS4514_Phase(&p, S(60) - 1, &next), MICS_PHASE_PREHEAT);
+	CHECK_EQ(next, S(60));
+	CHECK_EQ(MICS4514_Phase(&p, S(60), &next), MICS_PHASE_SAMPLE);
+	CHECK_EQ(next, S(80));
+	CHECK_EQ(MICS4514_Phase(&p, S(80), &next), MICS_PHASE_OFF);
+	CHECK_EQ(next, S(300));
+	CHECK_EQ(MICS4514_Phase(&p, S(300), &next), MICS_PHASE_PREHEAT);
+	CHECK_EQ(next, S(360));
+	CHECK_EQ(MICS4514_Phase(&p, S(2 * 300 + 70), &next), MICS_PHASE_SAMPLE);
+	CHECK_EQ(next, S(2 * 300 + 80));
+	CHECK_EQ(MICS4514_Phase(&p, -S(5), &next), MICS_PHASE_PREHEAT);
+	CHECK_EQ(next, S(60));
+
+	for (t = 0; t < S(10 * 300); t += 100000) {
+		k = MICS4514_Phase(&p, t, &next);
+		steps++;
+		heated += k != MICS_PHASE_OFF;
+		sampled += k == MICS_PHASE_SAMPLE;
+		if (next <= t || MICS4514_Phase(&p, next - 1, &n2) != k || n2 != next ||
+			MICS4514_Phase(&p, next, &n2) == k) {
+			bad++;
+		}
+	}
+	CHECK_EQ(bad, 0);
+	CHECK_EQ(heated * 300, steps * 80);
+	CHECK_EQ(sampled * 300, steps * 20);
+
+	// No duty cycle: one preheat, then sampling for good
+	CHECK_EQ(MICS4514_Phase(&on, 1, &next), MICS_PHASE_PREHEAT);
+	CHECK_EQ(next, S(60));
+	CHECK_EQ(MICS4514_Phase(&on, S(60), &next), MICS_PHASE_SAMPLE);
+	CHECK_EQ(next, INT64_MAX);
+	CHECK_EQ(MICS4514_Phase(&on, 1LL << 40, &next), MICS_PHASE_SAMPLE);
+	CHECK_EQ(next, INT64_MAX);
+	printf("phase: heater on %.1f%%, sampling %.1f%% of ten %us cycles\n",
+		   100.0 * heated / steps, 100.0 * sampled / steps, p.period_s);
+}
+
+/*
+ * The run. The sampler never returns by itself; the ADC leaves it through
+ * adc_escape at the first read of window RUN_CYCLES + 1.
+ */
+#define RUN_CYCLES		3
+#define LEVEL(w)		(((w) % 2) ? 1000 : 3000)
+
+static jmp_buf adc_escape;
+static int64_t run_start_us;
+static uint32_t reads[RUN_CYCLES + 2], bad_reads, bad_updates, seen_updates, seen_window;
+static uint32_t looks, looks_off, looks_held, bad_looks;
+
+static mics4514_phase_t phase_now(int64_t dt_us)
+{
+	int64_t next;
+
+	return MICS4514_Phase(&mics_profile, host_time_us - run_start_us + dt_us, &next);
+}
+
+static int adc_read(adc1_channel_t ch)
+{
+	mics4514_data_t d;
+
+	seqlock_read(&mics_snap, &d);
+	if (d.window > RUN_CYCLES) {
+		longjmp(adc_escape, 1);
+	}
+	reads[d.window]++;
+	if (phase_now(0) != MICS_PHASE_SAMPLE || d.phase != MICS_PHASE_SAMPLE ||
+		gpio_get_level(GPIO_MICS_HEATER) != 1 || gpio_get_level(GPIO_MICS_ENABLE) != 0) {
+		bad_reads++;
+	}
+
+	// Every update of a window is on that window's level, from the first.
+	// One seen only now may be from the window before.
+	if (d.updates != seen_updates) {
+		seen_updates = d.updates;
+		if (d.ox_mv != esp_adc_cal_raw_to_voltage(LEVEL(seen_window), adc_chars)) {
+			bad_updates++;
+		}
+	}
+	seen_window = d.window;
+	return LEVEL(d.window);
+}
+
+static void look(TimerHandle_t t)
+{
+	mics4514_phase_t k = phase_now(0);
+	mics4514_data_t d;
+	esp_err_t err = MICS4514_Read(&d);
+
+	// The task wakes a tick after a phase change; skip the moments between
+	if (k != phase_now(-portTICK_PERIOD_MS * 1000)) {
+		return;
+	}
+	looks++;
+	if (d.phase != k ||
+		gpio_get_level(GPIO_MICS_HEATER) != (k != MICS_PHASE_OFF) ||
+		gpio_get_level(GPIO_MICS_ENABLE) != (k == MICS_PHASE_OFF)) {
+		bad_looks++;
+	}
+	if (d.window == 0) {
+		bad_looks += err != ESP_ERR_NOT_FOUND;
+	}
+	else if (k != MICS_PHASE_SAMPLE) {
+		// Held from the last window
+		looks_held++;
+		looks_off += k == MICS_PHASE_OFF;
+		bad_looks += err != ESP_OK || d.ox_mv != esp_adc_cal_raw_to_voltage(LEVEL(d.window), adc_chars);
+	}
+}
+
+static void test_task(void)
+{
+	TimerHandle_t looker;
+	uint32_t per_window = 2 * MICS_BURST * (1000 / MICS_PERIOD_MS) * CONFIG_MICS_SAMPLE_S;
+	int64_t secs;
+	int w;
+
+	CHECK_EQ(mics_profile.period_s, CONFIG_MICS_CYCLE_S);
+	CHECK_EQ(mics_profile.preheat_s, CONFIG_MICS_PREHEAT_S);
+	CHECK_EQ(mics_profile.sample_s, CONFIG_MICS_SAMPLE_S);
+
+	host_adc1_read = adc_read;
+	looker = xTimerCreate("look", pdMS_TO_TICKS(1000), pdTRUE, NULL, look);
+	xTimerStart(looker, 0);
+	run_start_us = host_time_us;
+	if (setjmp(adc_escape) == 0) {
+		mics_task(NULL);
+	}
+	xTimerStop(looker, 0);
+	host_adc1_read = NULL;
+	secs = (host_time_us - run_start_us) / 1000000;
+
+	CHECK_EQ(secs, RUN_CYCLES * CONFIG_MICS_CYCLE_S + CONFIG_MICS_PREHEAT_S);
+	CHECK_EQ(reads[0], 0);
+	for (w = 1; w <= RUN_CYCLES; w++) {
+		CHECK(abs((int) reads[w] - (int) per_window) <= 2 * MICS_BURST);
+	}
+	CHECK_EQ(bad_reads, 0);
+	CHECK_EQ(bad_updates, 0);
+	CHECK(seen_updates >= RUN_CYCLES * (CONFIG_MICS_SAMPLE_S * 2 - 1));
+	CHECK(looks > secs * 9 / 10);
+	CHECK(looks_off > (RUN_CYCLES - 1) * (CONFIG_MICS_CYCLE_S - 100));
+	CHECK_EQ(bad_looks, 0);
+	printf("task: %lld s, %d windows of %u reads, %u updates, heater off for %u of %u looks, values held for %u\n",
+		   (long long) secs, RUN_CYCLES, reads[1], seen_updates, looks_off, looks, looks_held);
+}
+
+int main(void)
+{
+	MICS4514_Initialize();
+	test_phase();
+	test_task();
+	return host_test_done("test_mics_phase");
+}
@@ -0,0 +1,237 @@
+/*
+ * test_mqtt_batch.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  MQTT data batching and series grouping (mqtt_if.c), with the test
+ *  playing the broker:
+ *
+ *    - flushes on record count, age and size, and a failed publish going
+ *      to the outbox
+ *    - series interleaved within a batch come out grouped by series in
+ *      order of first appearance, time order kept inside each; escaped
+ *      spaces and commas in the tag set are part of the series key
+ *    - random batches against a reference grouping: every record exactly
+ *      once, grouped, in order
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+
+#undef CONFIG_MQTT_BATCH_MAX_RECORDS
+#define CONFIG_MQTT_BATCH_MAX_RECORDS	16
+
+struct netconn;
+#include "mqtt_if.c"
+
+#define RANDOM_BATCHES		20000
+
+/* Broker stand-in: the last data publish */
+static char published[CONFIG_MQTT_BATCH_MAX_BYTES];
+static int publishes;
+static char stored[CONFIG_MQTT_BATCH_MAX_BYTES];
+static int stores;
+
+const uint8_t ca_pem[] asm("_binary_ca_tetrad_pem_start") = "";
+char DEVICE_MAC[13] = "A1B2C3D4E5F6";
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t c, const char *topic, const char *data,
+							int len, int qos, int retain)
+{
+	CHECK(strcmp(topic, MQTT_DATA_PUB_TOPIC) == 0);
+	snprintf(published, sizeof(published), "%s", data);
+	return ++publishes;
+}
+
+esp_err_t OUTBOX_Append(const char *records, size_t len)
+{
+	CHECK(len < sizeof(stored));
+	memcpy(stored, records, len);
+	stored[len] = '\0';
+	stores++;
+	return ESP_OK;
+}
+
+/* The rest of what mqtt_if.c links against; none of it runs here */
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config) { return NULL; }
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t c) { return ESP_OK; }
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t c) { return ESP_OK; }
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t c, const char *topic, int qos) { return 0; }
+esp_err_t http_get_isp_info(char *json_buf, size_t len) { return ESP_OK; }
+void ota_set_filename(char *fn) { }
+void ota_trigger(void) { }
+void wifi_manager_check_connection_async(void) { }
+EventBits_t wifi_manager_wait_internet_access(void) { return 0; }
+EventBits_t wifi_manager_wait_disconnect(void) { return 0; }
+
+static void batch_reset(void)
+{
+	client_connected = true;
+	batch_len = 0;
+	batch_records = 0;
+	batch_grouped = true;
+	batch_buf[0] = '\0';
+	publishes = 0;
+	stores = 0;
+	published[0] = '\0';
+}
+
+static void test_flush(void)
+{
+	char line[CONFIG_MQTT_BATCH_MAX_BYTES / 10];
+	int i;
+
+	batch_reset();
+
+	// Count: the sixteenth record sends the batch
+	for (i = 0; i < CONFIG_MQTT_BATCH_MAX_RECORDS - 1; i++) {
+		snprintf(line, sizeof(line), "m,ID=a v=%d", i);
+		CHECK_EQ(MQTT_Batch_Add(line), 0);
+	}
+	CHECK_EQ(publishes, 0);
+	CHECK(MQTT_Batch_Add("m,ID=a v=15") > 0);
+	CHECK_EQ(publishes, 1);
+	CHECK(strncmp(published, "m,ID=a v=0\nm,ID=a v=1\n", 22) == 0);
+	CHECK(strcmp(published + strlen(published) - 12, "\nm,ID=a v=15") == 0);
+	CHECK_EQ(batch_records, 0);
+	CHECK_EQ(MQTT_Batch_Flush(), 0);
+
+	// Age: a trickle still goes out
+	CHECK_EQ(MQTT_Batch_Add("m,ID=a v=1"), 0);
+	host_advance_us(CONFIG_MQTT_BATCH_MAX_AGE * 1000000LL - 1);
+	CHECK_EQ(MQTT_Batch_Poll(), 0);
+	host_advance_us(1);
+	CHECK(MQTT_Batch_Poll() > 0);
+	CHECK(strcmp(published, "m,ID=a v=1") == 0);
+
+	// Size: a record that doesn't fit sends what's there first
+	memset(line, 'x', sizeof(line) - 1);
+	line[sizeof(line) - 1] = '\0';
+	for (i = 0; batch_len + sizeof(line) < sizeof(batch_buf); i++) {
+		CHECK_EQ(MQTT_Batch_Add(line), 0);
+	}
+	CHECK(MQTT_Batch_Add(line) > 0);
+	CHECK_EQ(strlen(published), i * sizeof(line) - 1);
+	CHECK_EQ(batch_records, 1);
+
+	// Too big for any batch
+	{
+		static char huge[CONFIG_MQTT_BATCH_MAX_BYTES + 1];
+
+		memset(huge, 'x', sizeof(huge) - 1);
+		CHECK_EQ(MQTT_Batch_Add(huge), ESP_FAIL);
+		CHECK_EQ(batch_records, 1);
+	}
+
+	// Disconnected: the batch goes to the outbox, grouped
+	batch_reset();
+	client_connected = false;
+	MQTT_Batch_Add("m,ID=a v=1");
+	MQTT_Batch_Add("m,ID=b v=2");
+	MQTT_Batch_Add("m,ID=a v=3");
+	CHECK_EQ(MQTT_Batch_Flush(), ESP_FAIL);
+	CHECK_EQ(stores, 1);
+	CHECK(strcmp(stored, "m,ID=a v=1\nm,ID=a v=3\nm,ID=b v=2") == 0);
+	CHECK_EQ(batch_records, 0);
+	CHECK_EQ(batch_len, 0);
+}
+
+static void test_grouping(void)
+{
+	batch_reset();
+
+	// Runs of one series leave the batch alone
+	MQTT_Batch_Add("m,ID=a v=1 1000");
+	MQTT_Batch_Add("m,ID=a v=2 2000");
+	MQTT_Batch_Add("m,ID=b v=3 3000");
+	MQTT_Batch_Add("m,ID=b v=4 4000");
+	CHECK(batch_grouped);
+	MQTT_Batch_Flush();
+	CHECK(strcmp(published, "m,ID=a v=1 1000\nm,ID=a v=2 2000\nm,ID=b v=3 3000\nm,ID=b v=4 4000") == 0);
+
+	// A series coming back is moved up behind its earlier records
+	MQTT_Batch_Add("m,ID=a v=1 1000");
+	MQTT_Batch_Add("m,ID=b v=2 2000");
+	MQTT_Batch_Add("m,ID=c v=3 3000");
+	MQTT_Batch_Add("m,ID=b v=4 4000");
+	CHECK(!batch_grouped);
+	MQTT_Batch_Add("m,ID=a v=5 5000");
+	MQTT_Batch_Flush();
+	CHECK(strcmp(published, "m,ID=a v=1 1000\nm,ID=a v=5 5000\nm,ID=b v=2 2000\n"
+				 "m,ID=b v=4 4000\nm,ID=c v=3 3000") == 0);
+	CHECK(batch_grouped);
+
+	// Geohash flipping; an escaped space or comma belongs to the key
+	MQTT_Batch_Add("m,ID=a,Geohash=9x0q v=1");
+	MQTT_Batch_Add("m,ID=a v=2");
+	MQTT_Batch_Add("m,ID=a\\ b v=3");
+	MQTT_Batch_Add("m,ID=a\\,Geohash=9x0q v=4");
+	MQTT_Batch_Add("m,ID=a,Geohash=9x0q v=5");
+	MQTT_Batch_Add("m,ID=a\\ b v=6");
+	MQTT_Batch_Flush();
+	CHECK(strcmp(published, "m,ID=a,Geohash=9x0q v=1\nm,ID=a,Geohash=9x0q v=5\nm,ID=a v=2\n"
+				 "m,ID=a\\ b v=3\nm,ID=a\\ b v=6\nm,ID=a\\,Geohash=9x0q v=4") == 0);
+}
+
+static void test_random(void)
+{
+	static const char *series[] = {
+		"airQuality,ID=A1B2C3D4E5F6,SensorModel=H2+1.0",
+		"airQuality,ID=A1B2C3D4E5F6,SensorModel=H2+1.0,Geohash=9x0qq",
+		"airQuality,ID=A1B2C3D4E5F6,SensorModel=H2+1.0,Geohash=9x0qr",
+		"airQuality,ID=A1B2C3D4E5F6,SensorModel=H2+1.0,Geohash=9x0qq\\ x",
+	};
+	char line[CONFIG_MQTT_BATCH_MAX_RECORDS][128], expect[CONFIG_MQTT_BATCH_MAX_BYTES];
+	int sid[CONFIG_MQTT_BATCH_MAX_RECORDS];
+	bool seen[4];
+	int b, i, k, n, len, s, ok = 0, regrouped = 0;
+
+	srand(17);
+	for (b = 0; b < RANDOM_BATCHES; b++) {
+		batch_reset();
+
+		// A batch in time order, the series changing now and then
+		n = 1 + rand() % CONFIG_MQTT_BATCH_MAX_RECORDS;
+		s = rand() % 4;
+		for (i = 0; i < n; i++) {
+			if (rand() % 3 == 0) {
+				s = rand() % 4;
+			}
+			sid[i] = s;
+			snprintf(line[i], sizeof(line[i]), "%s PM2.5=%d.%02d %d000",
+					 series[s], rand() % 100, rand() % 100, b * 100 + i);
+			CHECK(MQTT_Batch_Add(line[i]) >= 0);
+		}
+		regrouped += !batch_grouped;
+		MQTT_Batch_Flush();
+
+		// Reference: series by first appearance, time order inside each
+		memset(seen, 0, sizeof(seen));
+		len = 0;
+		for (i = 0; i < n; i++) {
+			if (seen[sid[i]]) {
+				continue;
+			}
+			seen[sid[i]] = true;
+			for (k = i; k < n; k++) {
+				if (sid[k] == sid[i]) {
+					len += snprintf(expect + len, sizeof(expect) - len, "%s%s", len ? "\n" : "", line[k]);
+				}
+			}
+		}
+		ok += strcmp(published, expect) == 0;
+	}
+	CHECK_EQ(publishes, 1);
+	CHECK_EQ(ok, RANDOM_BATCHES);
+	printf("random: %d batches, %d needed regrouping, %d as expected\n", RANDOM_BATCHES, regrouped, ok);
+}
+
+int main(void)
+{
+	test_flush();
+	test_grouping();
+	test_random();
+	return host_test_done("test_mqtt_batch");
+}
@@ -0,0 +1,527 @@
+/*
+ * test_nmea.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  NMEA tokenizer and field parsers (nmea.c) and the GPS sentence parser
+ *  on top of them (gps_if.c):
+ *
+ *    - tokenizer: checksums, missing or short checksums, stray CR, LF and
+ *      '$', the field limit, talker IDs; field parsers on edge cases
+ *    - generated GGA and RMC sentences through parse() and through the
+ *      Adafruit derived parser it replaced (old_parse() below). lat_e7 /
+ *      lon_e7, altitude, date and return codes must match exactly, float
+ *      lat/lon within a few ulp. The old parser put the time through a
+ *      float, which rounds hhmmss.999 up a second; those are told apart.
+ *      Reports sentences/s for both.
+ *    - mutated sentences through parse(): every field slice must stay in
+ *      the sentence. test_nmea_asan is this test built with ASan and UBSan,
+ *      minus the timing.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "host_test.h"
+#include "host_shim.h"
+
+#include "gps_if.c"
+
+#define CORPUS_SENTENCES	200000
+#define FUZZ_CASES			1000000
+#define BENCH_ROUNDS		5
+
+static int disciplined;
+
+void LED_SetEventBit(led_events_t bit) { }
+int64_t TIME_EpochMs(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec, uint16_t ms) { return 1; }
+void TIME_Discipline(int64_t utc_ms, int64_t mono_us, time_src_t src) { disciplined++; }
+
+/*
+ * parse() before the tokenizer, cut down to the fields compared
+ */
+typedef struct {
+	float lat, lon, alt;
+	int32_t lat_e7, lon_e7;
+	uint8_t year, month, day, hour, min, sec;
+} old_fix_t;
+
+static old_fix_t old_gps;
+
+static void old_coord(char **pp, int deg_digits, int32_t *fixed, float *degrees)
+{
+	char degreebuff[10], *p = *pp;
+	int32_t degree;
+	long minutes;
+	float v;
+
+	strncpy(degreebuff, p, deg_digits);
+	p += deg_digits;
+	degreebuff[deg_digits] = '\0';
+	degree = atol(degreebuff) * 10000000;
+	strncpy(degreebuff, p, 2); // minutes
+	p += 3; // skip decimal point
+	strncpy(degreebuff + 2, p, 4);
+	degreebuff[6] = '\0';
+	minutes = 50 * atol(degreebuff) / 3;
+	*fixed = degree + minutes;
+	v = degree / 100000 + minutes * 0.000006F;
+	*degrees = (v - 100 * (int) (v / 100)) / 60.0;
+	*degrees += (int) (v / 100);
+	*pp = p;
+}
+
+static void old_time(char **pp, uint8_t *hour, uint8_t *minute, uint8_t *seconds)
+{
+	float timef = atof(*pp);
+	uint32_t time = timef;
+
+	*hour = time / 10000;
+	*minute = (time % 10000) / 100;
+	*seconds = (time % 100);
+}
+
+static esp_err_t old_parse(char *nmea)
+{
+	int32_t latitude_fixed = 0, longitude_fixed = 0;
+	float latitudeDegrees = 0, longitudeDegrees = 0, altitude = 0;
+	uint8_t hour, minute, seconds, year = 0, month = 0, day = 0;
+	char lat = 0, lon = 0;
+	bool rmc;
+	char *p = nmea;
+
+	if (strstr(nmea, "$GPGGA")) {
+		rmc = false;
+	}
+	else if (strstr(nmea, "$GPRMC")) {
+		rmc = true;
+	}
+	else {
+		return ESP_FAIL;
+	}
+
+	p = strchr(p, ',') + 1;
+	old_time(&p, &hour, &minute, &seconds);
+
+	if (rmc) {
+		p = strchr(p, ',') + 1;
+		if (p[0] != 'A' && p[0] != 'V') return ESP_FAIL;
+	}
+
+	p = strchr(p, ',') + 1;
+	if (',' != *p) old_coord(&p, 2, &latitude_fixed, &latitudeDegrees);
+	p = strchr(p, ',') + 1;
+	if (',' != *p) {
+		if (p[0] == 'S') latitudeDegrees *= -1.0;
+		if (p[0] == 'N') lat = 'N';
+		else if (p[0] == 'S') lat = 'S';
+		else return ESP_FAIL;
+	}
+
+	p = strchr(p, ',') + 1;
+	if (',' != *p) old_coord(&p, 3, &longitude_fixed, &longitudeDegrees);
+	p = strchr(p, ',') + 1;
+	if (',' != *p) {
+		if (p[0] == 'W') longitudeDegrees *= -1.0;
+		if (p[0] == 'W') lon = 'W';
+		else if (p[0] == 'E') lon = 'E';
+		else return ESP_FAIL;
+	}
+
+	if (!rmc) {
+		p = strchr(p, ',') + 1;		// fix quality
+		p = strchr(p, ',') + 1;		// satellites
+		p = strchr(p, ',') + 1;		// HDOP
+		p = strchr(p, ',') + 1;
+		if (',' != *p) altitude = atof(p);
+
+		old_gps.lat_e7 = (lat == 'S') ? -latitude_fixed : latitude_fixed;
+		old_gps.lon_e7 = (lon == 'W') ? -longitude_fixed : longitude_fixed;
+		old_gps.alt = altitude;
+		old_gps.lat = latitudeDegrees;
+		old_gps.lon = longitudeDegrees;
+	}
+	else {
+		p = strchr(p, ',') + 1;		// speed
+		p = strchr(p, ',') + 1;		// angle
+		p = strchr(p, ',') + 1;
+		if (',' != *p) {
+			uint32_t fulldate = atof(p);
+			day = fulldate / 10000;
+			month = (fulldate % 10000) / 100;
+			year = (fulldate % 100);
+		}
+		old_gps.day = day;
+		old_gps.month = month;
+		old_gps.year = year;
+	}
+	old_gps.hour = hour;
+	old_gps.min = minute;
+	old_gps.sec = seconds;
+	return ESP_OK;
+}
+
+/* Append "*hh\r\n" to a sentence */
+static size_t checksum(char *s)
+{
+	uint8_t sum = 0;
+	char *p = s + 1;
+
+	while (*p != '\0' && *p != '*') {
+		sum ^= *p++;
+	}
+	return (p - s) + sprintf(p, "*%02X\r\n", sum);
+}
+
+static int parse_str(const char *s)
+{
+	return parse(s, strlen(s));
+}
+
+static void test_tokenizer(void)
+{
+	char s[160];
+	nmea_sentence_t t;
+	int i, len;
+
+	strcpy(s, "$GPGGA,064951.000,2307.1256,N,12016.4438,E,1,8,0.95,39.9,M,17.8,M,,");
+	len = checksum(s);
+	CHECK_EQ(nmea_tokenize(s, len, &t), ESP_OK);
+	CHECK_EQ(t.n, 15);
+	CHECK(t.f[0].len == 5 && memcmp(t.f[0].p, "GPGGA", 5) == 0);
+	CHECK(t.f[9].len == 4 && memcmp(t.f[9].p, "39.9", 4) == 0);
+	CHECK_EQ(t.f[13].len, 0);
+	CHECK_EQ(t.f[14].len, 0);
+	CHECK_EQ(nmea_field(&t, 15)->len, 0);
+	CHECK(nmea_is(&t, "GGA") && !nmea_is(&t, "RMC"));
+
+	// Trailing CR LF optional, hex case either way
+	CHECK_EQ(nmea_tokenize(s, len - 2, &t), ESP_OK);
+	s[len - 3] = tolower(s[len - 3]);
+	s[len - 4] = tolower(s[len - 4]);
+	CHECK_EQ(nmea_tokenize(s, len, &t), ESP_OK);
+
+	// Checksum wrong, short, missing
+	s[len - 3] = (s[len - 3] == '0') ? '1' : '0';
+	CHECK_EQ(nmea_tokenize(s, len, &t), ESP_ERR_INVALID_CRC);
+	CHECK_EQ(nmea_tokenize(s, len - 3, &t), ESP_FAIL);
+	CHECK_EQ(nmea_tokenize(s, len - 5, &t), ESP_FAIL);
+	s[len - 3] = 'G';
+	CHECK_EQ(nmea_tokenize(s, len, &t), ESP_FAIL);
+
+	// A second sentence run into the first, or a line break inside one
+	strcpy(s, "$GPGGA,0649$GPRMC,064951.000,A");
+	CHECK_EQ(nmea_tokenize(s, checksum(s), &t), ESP_FAIL);
+	strcpy(s, "$GPGGA,0649\r\n51.000");
+	CHECK_EQ(nmea_tokenize(s, checksum(s), &t), ESP_FAIL);
+	CHECK_EQ(nmea_tokenize("GPGGA,1*00", 10, &t), ESP_FAIL);
+	CHECK_EQ(nmea_tokenize("$*00", 4, &t), ESP_FAIL);
+
+	// Field limit, address included
+	strcpy(s, "$GPXXX");
+	for (i = 1; i < NMEA_MAX_FIELDS; i++) {
+		strcat(s, ",1");
+	}
+	CHECK_EQ(nmea_tokenize(s, checksum(s), &t), ESP_OK);
+	CHECK_EQ(t.n, NMEA_MAX_FIELDS);
+	strcpy(s + strcspn(s, "*"), ",1");
+	CHECK_EQ(nmea_tokenize(s, checksum(s), &t), ESP_FAIL);
+
+	// Any talker
+	strcpy(s, "$GNRMC,064951.000,A,2307.1256,N,12016.4438,E,0.03,165.48,260406,3.05,W,A");
+	CHECK_EQ(nmea_tokenize(s, checksum(s), &t), ESP_OK);
+	CHECK(nmea_is(&t, "RMC"));
+}
+
+static esp_err_t coord(const char *v, const char *h, uint8_t deg_digits, int32_t *e7)
+{
+	nmea_field_t fv = { v, strlen(v) }, fh = { h, strlen(h) };
+
+	return nmea_parse_coord(&fv, &fh, deg_digits, e7);
+}
+
+static esp_err_t fixed(const char *v, uint8_t decimals, int32_t *out)
+{
+	nmea_field_t f = { v, strlen(v) };
+
+	return nmea_parse_fixed(&f, decimals, out);
+}
+
+static void test_fields(void)
+{
+	nmea_field_t f;
+	uint8_t a, b, c;
+	uint16_t ms;
+	int32_t v;
+
+	CHECK_EQ(coord("4807.0380", "N", 2, &v), ESP_OK);
+	CHECK_EQ(v, 481173000);
+	CHECK_EQ(coord("4807.038", "S", 2, &v), ESP_OK);
+	CHECK_EQ(v, -481173000);
+	CHECK_EQ(coord("4807.03809", "", 2, &v), ESP_OK);
+	CHECK_EQ(v, 481173000);
+	CHECK_EQ(coord("4807", "N", 2, &v), ESP_OK);
+	CHECK_EQ(v, 481166666);
+	CHECK_EQ(coord("01131.0000", "W", 3, &v), ESP_OK);
+	CHECK_EQ(v, -115166666);
+	CHECK_EQ(coord("", "N", 2, &v), ESP_ERR_NOT_FOUND);
+
+	// Out of range or malformed
+	CHECK_EQ(coord("9000.0000", "N", 2, &v), ESP_OK);
+	CHECK_EQ(v, 900000000);
+	CHECK_EQ(coord("9000.0001", "N", 2, &v), ESP_FAIL);
+	CHECK_EQ(coord("9059.0000", "N", 2, &v), ESP_FAIL);
+	CHECK_EQ(coord("9100.0000", "N", 2, &v), ESP_FAIL);
+	CHECK_EQ(coord("18000.0000", "E", 3, &v), ESP_OK);
+	CHECK_EQ(coord("18001.0000", "E", 3, &v), ESP_FAIL);
+	CHECK_EQ(coord("4860.0000", "N", 2, &v), ESP_FAIL);
+	CHECK_EQ(coord("480", "N", 2, &v), ESP_FAIL);
+	CHECK_EQ(coord("4807,0380", "N", 2, &v), ESP_FAIL);
+	CHECK_EQ(coord("4807.0x80", "N", 2, &v), ESP_FAIL);
+	CHECK_EQ(coord("4807.0380", "X", 2, &v), ESP_FAIL);
+
+	f.p = "235959.999";
+	f.len = 10;
+	CHECK_EQ(nmea_parse_time(&f, &a, &b, &c, &ms), ESP_OK);
+	CHECK(a == 23 && b == 59 && c == 59 && ms == 999);
+	f.len = 8;
+	CHECK_EQ(nmea_parse_time(&f, &a, &b, &c, &ms), ESP_OK);
+	CHECK_EQ(ms, 900);
+	f.len = 6;
+	CHECK_EQ(nmea_parse_time(&f, &a, &b, &c, &ms), ESP_OK);
+	CHECK_EQ(ms, 0);
+	f.len = 5;
+	CHECK_EQ(nmea_parse_time(&f, &a, &b, &c, &ms), ESP_FAIL);
+
+	f.p = "260406";
+	f.len = 6;
+	CHECK_EQ(nmea_parse_date(&f, &a, &b, &c), ESP_OK);
+	CHECK(a == 26 && b == 4 && c == 6);
+	f.len = 5;
+	CHECK_EQ(nmea_parse_date(&f, &a, &b, &c), ESP_FAIL);
+
+	CHECK_EQ(fixed("-17.0", 1, &v), ESP_OK);
+	CHECK_EQ(v, -170);
+	CHECK_EQ(fixed("0.95", 2, &v), ESP_OK);
+	CHECK_EQ(v, 95);
+	CHECK_EQ(fixed("1.2389", 2, &v), ESP_OK);
+	CHECK_EQ(v, 123);
+	CHECK_EQ(fixed("+39", 3, &v), ESP_OK);
+	CHECK_EQ(v, 39000);
+	CHECK_EQ(fixed(".5", 1, &v), ESP_OK);
+	CHECK_EQ(v, 5);
+	CHECK_EQ(fixed("", 0, &v), ESP_ERR_NOT_FOUND);
+	CHECK_EQ(fixed("-", 0, &v), ESP_FAIL);
+	CHECK_EQ(fixed("1.2.3", 2, &v), ESP_FAIL);
+	CHECK_EQ(fixed("12a", 0, &v), ESP_FAIL);
+	CHECK_EQ(fixed("2147483647", 0, &v), ESP_OK);
+	CHECK_EQ(fixed("2147483648", 0, &v), ESP_FAIL);
+	CHECK_EQ(v, INT32_MAX);
+	CHECK_EQ(fixed("-2147483647", 0, &v), ESP_OK);
+	CHECK_EQ(fixed("2147483.6", 3, &v), ESP_OK);
+	CHECK_EQ(v, 2147483600);
+	CHECK_EQ(fixed("2147484.0", 3, &v), ESP_FAIL);
+}
+
+static int ulp(float a, float b)
+{
+	int32_t x, y;
+
+	memcpy(&x, &a, 4);
+	memcpy(&y, &b, 4);
+	return abs(x - y);
+}
+
+static char **corpus_make(int n)
+{
+	char **corpus = malloc(n * sizeof(char *)), s[160];
+	int i, alt;
+
+	srand(11);
+	for (i = 0; i < n; i++) {
+		int h = rand() % 24, m = rand() % 60, sec = rand() % 60, ms = rand() % 1000;
+		int latd = rand() % 90, latm = rand() % 60, latf = rand() % 10000;
+		int lond = rand() % 180, lonm = rand() % 60, lonf = rand() % 10000;
+		char ns = "NS"[rand() % 2], ew = "EW"[rand() % 2];
+
+		alt = rand() % 90000 - 5000;
+		if (i % 2 == 0) {
+			sprintf(s, "$GPGGA,%02d%02d%02d.%03d,%02d%02d.%04d,%c,%03d%02d.%04d,%c,1,%02d,0.9,%s%d.%d,M,-17.0,M,,",
+					h, m, sec, ms, latd, latm, latf, ns, lond, lonm, lonf, ew, rand() % 12,
+					alt < 0 ? "-" : "", abs(alt / 10), abs(alt % 10));
+		}
+		else {
+			sprintf(s, "$GPRMC,%02d%02d%02d.%03d,%c,%02d%02d.%04d,%c,%03d%02d.%04d,%c,0.%02d,%d.%02d,%02d%02d%02d,,,A",
+					h, m, sec, ms, "AV"[rand() % 2], latd, latm, latf, ns, lond, lonm, lonf, ew,
+					rand() % 100, rand() % 360, rand() % 99, 1 + rand() % 28, 1 + rand() % 12, rand() % 100);
+		}
+		checksum(s);
+		corpus[i] = strdup(s);
+	}
+	return corpus;
+}
+
+/*
+ * Sentences per second through both parsers
+ */
+static void bench(char **corpus)
+{
+	double t0, t_old, t_new;
+	int i, r;
+
+	t0 = host_seconds();
+	for (r = 0; r < BENCH_ROUNDS; r++) {
+		for (i = 0; i < CORPUS_SENTENCES; i++) {
+			old_parse(corpus[i]);
+		}
+	}
+	t_old = host_seconds() - t0;
+
+	t0 = host_seconds();
+	for (r = 0; r < BENCH_ROUNDS; r++) {
+		for (i = 0; i < CORPUS_SENTENCES; i++) {
+			parse_str(corpus[i]);
+		}
+	}
+	t_new = host_seconds() - t0;
+
+	printf("bench: old %.0f sentences/s, new %.0f sentences/s, %.1fx\n",
+		   BENCH_ROUNDS * CORPUS_SENTENCES / t_old, BENCH_ROUNDS * CORPUS_SENTENCES / t_new, t_old / t_new);
+}
+
+static void test_compare(void)
+{
+	char **corpus = corpus_make(CORPUS_SENTENCES);
+	uint32_t ret_diff = 0, fixed_diff = 0, alt_diff = 0, date_diff = 0, time_diff = 0, time_rounded = 0;
+	int i, a, b, max_ulp = 0, u;
+	uint32_t whole;
+
+	for (i = 0; i < CORPUS_SENTENCES; i++) {
+		memset(&old_gps, 0, sizeof(old_gps));
+		memset(&esp_gps, 0, sizeof(esp_gps));
+		a = old_parse(corpus[i]);
+		b = parse_str(corpus[i]);
+		if (a != b) {
+			ret_diff++;
+			continue;
+		}
+
+		if (corpus[i][3] == 'G') {
+			fixed_diff += old_gps.lat_e7 != esp_gps.lat_e7 || old_gps.lon_e7 != esp_gps.lon_e7;
+			alt_diff += old_gps.alt != esp_gps.alt;
+			u = ulp(old_gps.lat, esp_gps.lat);
+			max_ulp = (u > max_ulp) ? u : max_ulp;
+			u = ulp(old_gps.lon, esp_gps.lon);
+			max_ulp = (u > max_ulp) ? u : max_ulp;
+		}
+		else {
+			date_diff += old_gps.day != esp_gps.day || old_gps.month != esp_gps.month ||
+						 old_gps.year != esp_gps.year;
+		}
+
+		if (old_gps.hour != esp_gps.hour || old_gps.min != esp_gps.min || old_gps.sec != esp_gps.sec) {
+			// Expected only where the float time lands on the next second
+			whole = atol(corpus[i] + 7);
+			if ((uint32_t) (float) atof(corpus[i] + 7) != whole &&
+				esp_gps.hour == whole / 10000 && esp_gps.min == whole / 100 % 100 && esp_gps.sec == whole % 100) {
+				time_rounded++;
+			}
+			else {
+				time_diff++;
+			}
+		}
+	}
+	CHECK_EQ(ret_diff, 0);
+	CHECK_EQ(fixed_diff, 0);
+	CHECK_EQ(alt_diff, 0);
+	CHECK_EQ(date_diff, 0);
+	CHECK_EQ(time_diff, 0);
+	CHECK(max_ulp <= 3);
+	CHECK(disciplined > 0);
+
+	printf("compare: %d sentences, %u return, %u lat_e7/lon_e7, %u altitude, %u date, %u time differences\n",
+		   CORPUS_SENTENCES, ret_diff, fixed_diff, alt_diff, date_diff, time_diff);
+	printf("compare: float lat/lon within %d ulp, %u times the old parser rounded up a second\n",
+		   max_ulp, time_rounded);
+#ifndef __SANITIZE_ADDRESS__
+	bench(corpus);
+#endif
+
+	for (i = 0; i < CORPUS_SENTENCES; i++) {
+		free(corpus[i]);
+	}
+	free(corpus);
+}
+
+static void test_fuzz(void)
+{
+	static const char *seed[] = {
+		"$GPGGA,064951.000,2307.1256,N,12016.4438,E,1,8,0.95,39.9,M,17.8,M,,",
+		"$GPRMC,064951.000,A,2307.1256,N,12016.4438,E,0.03,165.48,260406,3.05,W,A",
+		"$GNGGA,,,,,,0,00,99.99,,,,,,",
+		"$GPRMC,,V,,,,,,,,,,N",
+		"$PMTK001,220,3",
+	};
+	static const char noise[] = " ,.-+0123456789NSEWAV*$\r\nxyz";
+	char s[300], *h;
+	nmea_sentence_t t;
+	uint32_t ok = 0, outside = 0;
+	int i, k, op, p, len, j;
+
+	srand(7);
+	for (i = 0; i < FUZZ_CASES; i++) {
+		strcpy(s, seed[rand() % 5]);
+		len = strlen(s);
+		for (k = rand() % 6; k > 0; k--) {
+			op = rand() % 3;
+			p = rand() % len;
+			if (op == 0) {
+				s[p] = noise[rand() % (sizeof(noise) - 1)];
+			}
+			else if (op == 1 && len > 1) {
+				memmove(s + p, s + p + 1, len - p);
+				len--;
+			}
+			else if (len < 250) {
+				memmove(s + p + 1, s + p, len - p + 1);
+				s[p] = "0123456789,."[rand() % 12];
+				len++;
+			}
+		}
+		s[len] = '\0';
+		if (rand() % 4 != 0) {
+			len = checksum(s);
+		}
+
+		// Exactly len bytes on the heap, so ASan sees any read past them
+		h = malloc(len);
+		memcpy(h, s, len);
+		ok += parse(h, len) == ESP_OK;
+		if (nmea_tokenize(h, len, &t) != ESP_FAIL) {
+			for (j = 0; j < t.n; j++) {
+				outside += t.f[j].p < h || t.f[j].p + t.f[j].len > h + len;
+			}
+		}
+		free(h);
+	}
+	CHECK_EQ(outside, 0);
+	printf("fuzz: %d mutated sentences, %u parsed, %u fields outside the sentence\n", FUZZ_CASES, ok, outside);
+}
+
+int main(void)
+{
+	// What GPS_Initialize() sets up for parse(); the tasks never run
+	gps_ack_queue = xQueueCreate(GPS_ACK_QUEUE_LEN, sizeof(pmtk_ack_t));
+	xTaskCreate(gps_cfg_task, "gps_cfg_task", 2560, NULL, 5, &gps_cfg_task_handle);
+
+	test_tokenizer();
+	test_fields();
+	test_compare();
+	test_fuzz();
+#ifdef __SANITIZE_ADDRESS__
+	return host_test_done("test_nmea_asan");
+#else
+	return host_test_done("test_nmea");
+#endif
+}
@@ -0,0 +1,353 @@
+/*
+ * test_outbox.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  SD outbox (outbox_if.c) against a broker stand-in, with the SD card
+ *  being a directory under build/:
+ *
+ *    - no card: OUTBOX_Initialize() fails and appends are refused
+ *    - cursor slots: the newest valid one wins, a torn slot falls back
+ *    - the size limit, judged under the lock: an append waiting on the
+ *      replay task sees the size the replay left behind
+ *    - many disconnect / reconnect cycles with failing publishes, reboots
+ *      and appends cut short by a power loss. Live batches go straight to
+ *      the broker when they can and to the outbox when they can't, as in
+ *      MQTT_Batch_Flush(). At the end every record must have reached the
+ *      broker exactly once, replayed records in the order they were
+ *      stored. Only a record cut short on the card may be missing.
+ *
+ *  outbox_task() never returns; the test runs it a given number of loop
+ *  passes at a time and leaves it at the top of its loop, where it holds
+ *  no lock.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "outbox_if.h"
+
+#define OUTBOX_DIR			"build/outbox"
+#undef OUTBOX_DATA_FILE
+#undef OUTBOX_CURSOR_FILE
+#define OUTBOX_DATA_FILE	OUTBOX_DIR "/outbox.txt"
+#define OUTBOX_CURSOR_FILE	OUTBOX_DIR "/outbox.cur"
+
+#include "outbox_if.c"
+
+#define SIM_MINUTES			20000
+#define SIM_RECORDS_MAX		(SIM_MINUTES * 3)
+#define RECORD_FMT			"airQuality,ID=A1B2C3D4E5F6,SensorModel=H2+1.0 Seq=%u,Check=%u"
+
+/* Broker stand-in */
+static bool broker_up;
+static int broker_fail_pct;
+static int broker_msg_id;
+static uint8_t received[SIM_RECORDS_MAX];
+static int32_t last_replayed = -1;
+static uint32_t bad_lines, replay_disorder, empty_publishes;
+static bool replaying;
+
+static jmp_buf task_exit;
+static int task_passes;
+
+/*
+ * Firmware the outbox calls
+ */
+EventBits_t wifi_manager_wait_internet_access(void)
+{
+	if (task_passes-- == 0) {
+		longjmp(task_exit, 1);
+	}
+	return 0;
+}
+
+bool MQTT_Is_Connected(void)
+{
+	return broker_up;
+}
+
+int MQTT_Publish_Data(const char *msg)
+{
+	const char *p = msg, *nl;
+	unsigned seq, check;
+	char line[256];
+	size_t len;
+
+	if (!broker_up || rand() % 100 < broker_fail_pct) {
+		return -1;
+	}
+	if (*msg == '\0') {
+		empty_publishes++;
+	}
+
+	for (; *p != '\0'; p = nl + 1) {
+		nl = strchr(p, '\n');
+		if (nl == NULL) {
+			nl = p + strlen(p);
+		}
+		len = nl - p;
+		if (len >= sizeof(line)) {
+			len = sizeof(line) - 1;
+		}
+		memcpy(line, p, len);
+		line[len] = '\0';
+
+		if (sscanf(line, RECORD_FMT, &seq, &check) != 2 || check != ~seq ||
+			seq >= SIM_RECORDS_MAX) {
+			bad_lines++;
+		}
+		else {
+			received[seq]++;
+			if (replaying) {
+				if ((int32_t) seq <= last_replayed) {
+					replay_disorder++;
+				}
+				last_replayed = seq;
+			}
+		}
+		if (*nl == '\0') {
+			break;
+		}
+	}
+	return broker_msg_id++;
+}
+
+/*
+ * Run outbox_task() for n passes of its loop
+ */
+static void outbox_step(int n)
+{
+	task_passes = n;
+	replaying = true;
+	if (setjmp(task_exit) == 0) {
+		outbox_task(NULL);
+	}
+	replaying = false;
+}
+
+/*
+ * Power cycle: forget everything but the card
+ */
+static void reboot(void)
+{
+	memset(&stats, 0, sizeof(stats));
+	cursor_seq = 0;
+	tail_dirty = false;
+	CHECK_EQ(OUTBOX_Initialize(), ESP_OK);
+}
+
+static void card_wipe(void)
+{
+	mkdir("build", 0755);
+	mkdir(OUTBOX_DIR, 0755);
+	remove(OUTBOX_DATA_FILE);
+	remove(OUTBOX_CURSOR_FILE);
+}
+
+static void test_no_card(void)
+{
+	remove(OUTBOX_DATA_FILE);
+	remove(OUTBOX_CURSOR_FILE);
+	rmdir(OUTBOX_DIR);
+	CHECK_EQ(OUTBOX_Initialize(), ESP_FAIL);
+	CHECK(outbox_mutex == NULL);
+	CHECK_EQ(OUTBOX_Append("a", 1), ESP_FAIL);
+	CHECK_EQ(stats.appended + stats.rejected, 0);
+}
+
+static void test_cursor(void)
+{
+	outbox_cursor_t slot[2];
+	FILE *f;
+
+	card_wipe();
+	reboot();
+	CHECK_EQ(stats.cursor, 0);
+
+	CHECK_EQ(cursor_store(100), ESP_OK);
+	CHECK_EQ(cursor_store(200), ESP_OK);
+	CHECK_EQ(cursor_store(300), ESP_OK);
+	CHECK_EQ(cursor_load(), 300);
+	CHECK_EQ(cursor_seq, 3);
+
+	// Tear the newest slot: the one before it is still good
+	f = fopen(OUTBOX_CURSOR_FILE, "r+");
+	CHECK(f != NULL);
+	CHECK_EQ(fread(slot, sizeof(outbox_cursor_t), 2, f), 2);
+	slot[cursor_seq & 1].offset ^= 0x40;
+	fseek(f, 0, SEEK_SET);
+	fwrite(slot, sizeof(outbox_cursor_t), 2, f);
+	fclose(f);
+	CHECK_EQ(cursor_load(), 200);
+	CHECK_EQ(cursor_seq, 2);
+
+	// And the next store goes over the torn one
+	CHECK_EQ(cursor_store(400), ESP_OK);
+	CHECK_EQ(cursor_load(), 400);
+
+	// A cursor past the data (the file went, the reset didn't) restarts
+	reboot();
+	CHECK_EQ(stats.size, 0);
+	CHECK_EQ(stats.cursor, 0);
+	CHECK_EQ(cursor_load(), 0);
+}
+
+static esp_err_t append_err;
+
+static void *append_thread(void *arg)
+{
+	append_err = OUTBOX_Append("d\ne", 3);
+	return NULL;
+}
+
+static void test_limits(void)
+{
+	pthread_t th;
+
+	card_wipe();
+	reboot();
+
+	stats.size = CONFIG_OUTBOX_MAX_SIZE_KB * 1024 - 5;
+	CHECK_EQ(OUTBOX_Append("a\nb\nc", 5), ESP_ERR_NO_MEM);
+	CHECK_EQ(stats.rejected, 3);
+	CHECK_EQ(stats.appended, 0);
+	CHECK_EQ(OUTBOX_Append("abc", 0), ESP_FAIL);
+
+	stats.size = 0;
+	CHECK_EQ(OUTBOX_Append("a\nb\nc", 5), ESP_OK);
+	CHECK_EQ(stats.appended, 3);
+	CHECK_EQ(stats.size, 6);
+
+	// Full while the replay task holds the lock, drained when it lets go:
+	// the waiting append goes in
+	CHECK_EQ(xSemaphoreTake(outbox_mutex, 0), pdTRUE);
+	stats.size = CONFIG_OUTBOX_MAX_SIZE_KB * 1024;
+	CHECK_EQ(pthread_create(&th, NULL, append_thread, NULL), 0);
+	usleep(100000);
+	remove(OUTBOX_DATA_FILE);
+	stats.size = 0;
+	xSemaphoreGive(outbox_mutex);
+	pthread_join(th, NULL);
+	CHECK_EQ(append_err, ESP_OK);
+	CHECK_EQ(stats.rejected, 3);
+	CHECK_EQ(stats.appended, 5);
+	CHECK_EQ(stats.size, 4);
+}
+
+/*
+ * Cut the last record short, as a power loss in the middle of an append
+ * would. Returns whether the record lost more than its newline.
+ */
+static bool card_tear(void)
+{
+	struct stat st;
+	int cut;
+
+	if (stat(OUTBOX_DATA_FILE, &st) != 0 || st.st_size < 2) {
+		return false;
+	}
+	cut = 1 + rand() % 20;
+	CHECK_EQ(truncate(OUTBOX_DATA_FILE, st.st_size - cut), 0);
+	return cut > 1;
+}
+
+static void test_cycles(void)
+{
+	static bool torn[SIM_RECORDS_MAX];
+	char batch[CONFIG_MQTT_BATCH_MAX_BYTES];
+	uint32_t seq = 0, first, i, missing = 0, dup = 0, n_torn = 0;
+	uint32_t outages = 0, reboots = 0, stored = 0, max_backlog = 0;
+	int minute, phase_left = 0, n, len;
+	struct stat st;
+
+	card_wipe();
+	reboot();
+	srand(6);
+
+	for (minute = 0; minute < SIM_MINUTES; minute++) {
+		// Alternate outages and connected spells of random length
+		if (phase_left-- <= 0) {
+			broker_up = !broker_up;
+			phase_left = broker_up ? 1 + rand() % 120 : 1 + rand() % 90;
+			outages += !broker_up;
+		}
+		broker_fail_pct = broker_up ? 5 : 100;
+
+		// A live batch of one to three records
+		first = seq;
+		len = 0;
+		for (n = 1 + rand() % 3; n > 0; n--, seq++) {
+			len += snprintf(batch + len, sizeof(batch) - len, "%s" RECORD_FMT,
+							len ? "\n" : "", seq, ~seq);
+		}
+		if (MQTT_Publish_Data(batch) < 0) {
+			CHECK_EQ(OUTBOX_Append(batch, len), ESP_OK);
+			stored += seq - first;
+
+			// Now and then the power goes while the card is written
+			if (rand() % 200 == 0) {
+				if (card_tear()) {
+					torn[seq - 1] = true;
+					n_torn++;
+				}
+				reboots++;
+				reboot();
+			}
+		}
+
+		// The replay task gets the rest of the minute
+		outbox_step(60 * 1000 / CONFIG_OUTBOX_REPLAY_INTERVAL_MS);
+
+		if (stats.size - stats.cursor > max_backlog) {
+			max_backlog = stats.size - stats.cursor;
+		}
+		if (rand() % 500 == 0) {
+			reboots++;
+			reboot();
+		}
+	}
+
+	// Connected for good: the outbox drains and goes away
+	broker_up = true;
+	broker_fail_pct = 0;
+	for (i = 0; i < 100000 && stats.size != 0; i++) {
+		outbox_step(1);
+	}
+	CHECK_EQ(stats.size, 0);
+	CHECK_EQ(stats.cursor, 0);
+	CHECK(stat(OUTBOX_DATA_FILE, &st) != 0);
+
+	for (i = 0; i < seq; i++) {
+		if (received[i] == 0 && !torn[i]) {
+			missing++;
+		}
+		if (received[i] > 1) {
+			dup++;
+		}
+	}
+	CHECK_EQ(missing, 0);
+	CHECK_EQ(dup, 0);
+	CHECK_EQ(replay_disorder, 0);
+	CHECK_EQ(empty_publishes, 0);
+	CHECK(bad_lines <= n_torn);
+
+	printf("cycles: %u records, %u outages, %u reboots, %u stored, %u torn by power loss\n",
+		   seq, outages, reboots, stored, n_torn);
+	printf("cycles: %u missing, %u duplicated, %u replayed out of order, %u bad lines, backlog up to %u bytes\n",
+		   missing, dup, replay_disorder, bad_lines, max_backlog);
+}
+
+int main(void)
+{
+	test_no_card();
+	test_cursor();
+	test_limits();
+	test_cycles();
+	return host_test_done("test_outbox");
+}
@@ -0,0 +1,284 @@
+/*
+ * test_pm_channels.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  PM channels past the parser: synthetic PMS5003 and PMS3003 frames fed
+ *  through pm_parse_stream() and PMS_Poll() (pm_if.c), then into the
+ *  aggregator (pipeline_if.c) the way main.c hands them over:
+ *
+ *    - CF=1 and atmospheric PM averaged over every frame, particle counts
+ *      only over the frames that carry them, -1 where there were none
+ *    - no frames, a gap longer than the stale limit, a stale accumulator
+ *    - publish windows of both models: PM weighted by frames, counts by
+ *      counted frames, AIRU_FIELD_PN dropped from a window without any
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "esp_ota_ops.h"
+#include "pipeline_if.h"
+#include "pm_if.c"
+
+/* What pipeline_if.c links against besides the aggregator */
+char DEVICE_MAC[13] = "A1B2C3D4E5F6";
+time_t last_publish;
+
+int MQTT_Batch_Add(const char *line) { return 0; }
+int MQTT_Batch_Poll(void) { return 0; }
+esp_err_t sd_write_data(char *pkt, uint8_t year, uint8_t month, uint8_t day) { return ESP_OK; }
+esp_err_t sd_flush_data(bool force) { return ESP_OK; }
+void wifi_manager_check_connection_async(void) { }
+const esp_app_desc_t *esp_ota_get_app_description(void)
+{
+	static const esp_app_desc_t desc = { "host", "airu" };
+
+	return &desc;
+}
+
+#define TOL		1e-3
+
+typedef struct {
+	uint16_t pm[3];				/* CF=1 */
+	uint16_t atm[3];
+	uint16_t pn[PM_PN_BINS];
+} frame_t;
+
+/* Running sums of the frames sent, for the expected means */
+static struct {
+	double pm[3], atm[3], pn[PM_PN_BINS];
+	uint32_t n, n_pn;
+} sent;
+
+/*
+ * One frame of len bytes, a second after the last, in its own UART event
+ */
+static void send(const frame_t *f, int len)
+{
+	uint8_t out[PM_FRAME_MAX_LEN];
+	uint16_t sum = 0;
+	int i;
+
+	memset(out, 0, sizeof(out));
+	out[0] = 'B';
+	out[1] = 'M';
+	out[2] = (len - PM_HDR_LEN) >> 8;
+	out[3] = (len - PM_HDR_LEN) & 0xff;
+	for (i = 0; i < 3; i++) {
+		out[4 + 2 * i] = f->pm[i] >> 8;
+		out[5 + 2 * i] = f->pm[i] & 0xff;
+		out[10 + 2 * i] = f->atm[i] >> 8;
+		out[11 + 2 * i] = f->atm[i] & 0xff;
+		sent.pm[i] += f->pm[i];
+		sent.atm[i] += f->atm[i];
+	}
+	// A PMS3003 has reserved words where the counts would be; fill them
+	// anyway, they must not be read
+	for (i = 0; i < PM_PN_BINS; i++) {
+		out[16 + 2 * i] = f->pn[i] >> 8;
+		out[17 + 2 * i] = f->pn[i] & 0xff;
+		if (len == PM_PKT_LEN_5003) {
+			sent.pn[i] += f->pn[i];
+		}
+	}
+	sent.n++;
+	sent.n_pn += len == PM_PKT_LEN_5003;
+	for (i = 0; i < len - 2; i++) {
+		sum += out[i];
+	}
+	out[len - 2] = sum >> 8;
+	out[len - 1] = sum & 0xff;
+
+	host_advance_us(1000000);
+	host_uart_feed(PM_UART_CH, out, len);
+	pm_ring_fill(len);
+	pm_parse_stream();
+}
+
+/*
+ * n frames of steady air with a little wobble, so the filter keeps them
+ */
+static void send_many(int n, int len, uint16_t base)
+{
+	static uint32_t k;
+	frame_t f;
+	int i, b;
+
+	for (i = 0; i < n; i++, k++) {
+		for (b = 0; b < 3; b++) {
+			f.pm[b] = base * (b + 2) / 2 + k % 5;
+			f.atm[b] = base * (b + 2) / 3 + k % 7;
+		}
+		for (b = 0; b < PM_PN_BINS; b++) {
+			f.pn[b] = (base * 200 >> b) + k % 11;
+		}
+		send(&f, len);
+	}
+}
+
+static void sent_reset(void)
+{
+	memset(&sent, 0, sizeof(sent));
+}
+
+static void pm_reset(void)
+{
+	pm_data_t d;
+
+	PMS_FilterInit(&pm_filter, 0);
+	pm_power = PM_POWER_ON;
+	PMS_Poll(&d);
+	sent_reset();
+}
+
+static void check_poll(const pm_data_t *d)
+{
+	int i;
+
+	CHECK_EQ(d->sample_count, sent.n);
+	CHECK_NEAR(d->pm1, sent.pm[0] / sent.n, TOL);
+	CHECK_NEAR(d->pm2_5, sent.pm[1] / sent.n, TOL);
+	CHECK_NEAR(d->pm10, sent.pm[2] / sent.n, TOL);
+	CHECK_NEAR(d->pm1_atm, sent.atm[0] / sent.n, TOL);
+	CHECK_NEAR(d->pm2_5_atm, sent.atm[1] / sent.n, TOL);
+	CHECK_NEAR(d->pm10_atm, sent.atm[2] / sent.n, TOL);
+	CHECK_EQ(d->pn_count, sent.n_pn);
+	for (i = 0; i < PM_PN_BINS; i++) {
+		CHECK_NEAR(d->pn[i], sent.n_pn ? sent.pn[i] / sent.n_pn : -1, TOL);
+	}
+}
+
+static void test_poll(void)
+{
+	pm_data_t d;
+	int i;
+
+	// PMS5003: every channel over every frame
+	pm_reset();
+	send_many(10, PM_PKT_LEN_5003, 20);
+	CHECK_EQ(PMS_Poll(&d), ESP_OK);
+	CHECK_EQ(PMS_Model(), PM_MODEL_PMS5003);
+	check_poll(&d);
+
+	// PMS3003: no counts
+	pm_reset();
+	send_many(12, PM_PKT_LEN, 30);
+	CHECK_EQ(PMS_Poll(&d), ESP_OK);
+	CHECK_EQ(PMS_Model(), PM_MODEL_PMS3003);
+	check_poll(&d);
+	CHECK_EQ(d.pn_count, 0);
+
+	// Both in one poll: the counts over the 5003 frames only
+	pm_reset();
+	send_many(6, PM_PKT_LEN, 25);
+	send_many(4, PM_PKT_LEN_5003, 25);
+	CHECK_EQ(PMS_Poll(&d), ESP_OK);
+	check_poll(&d);
+	CHECK_EQ(d.pn_count, 4);
+
+	// Nothing since the last poll
+	CHECK_EQ(PMS_Poll(&d), ESP_FAIL);
+	CHECK(d.sample_count == 0 && d.pn_count == 0);
+	CHECK(d.pm1 == -1 && d.pm2_5 == -1 && d.pm10 == -1);
+	CHECK(d.pm1_atm == -1 && d.pm2_5_atm == -1 && d.pm10_atm == -1);
+	for (i = 0; i < PM_PN_BINS; i++) {
+		CHECK_EQ(d.pn[i], 0);
+	}
+
+	// A gap longer than the stale limit: only the frames after it
+	send_many(5, PM_PKT_LEN_5003, 20);
+	host_advance_us(pm_stale_us);
+	sent_reset();
+	send_many(3, PM_PKT_LEN_5003, 20);
+	CHECK_EQ(PMS_Poll(&d), ESP_OK);
+	check_poll(&d);
+
+	// Polled too late: nothing fresh
+	send_many(5, PM_PKT_LEN_5003, 20);
+	host_advance_us(pm_stale_us + 1);
+	CHECK_EQ(PMS_Poll(&d), ESP_FAIL);
+}
+
+/*
+ * One acquisition, filled in from PMS_Poll() as main.c does
+ */
+static void acquire(airu_sample_t *s)
+{
+	pm_data_t d;
+
+	memset(s, 0, sizeof(*s));
+	s->ts_us = host_time_us;
+	if (PMS_Poll(&d) == ESP_OK) {
+		s->valid |= AIRU_FIELD_PM;
+	}
+	s->pm_count = d.sample_count;
+	s->pm1 = d.pm1;
+	s->pm2_5 = d.pm2_5;
+	s->pm10 = d.pm10;
+	s->pm1_atm = d.pm1_atm;
+	s->pm2_5_atm = d.pm2_5_atm;
+	s->pm10_atm = d.pm10_atm;
+	if (d.pn_count > 0) {
+		s->valid |= AIRU_FIELD_PN;
+	}
+	s->pn_count = d.pn_count;
+	memcpy(s->pn, d.pn, sizeof(s->pn));
+}
+
+static void test_aggregate(void)
+{
+	static const struct { int frames, len; uint16_t base; } polls[] = {
+		{ 10, PM_PKT_LEN_5003, 20 },
+		{ 0, 0, 0 },
+		{ 25, PM_PKT_LEN, 22 },
+		{ 7, PM_PKT_LEN_5003, 18 },
+	};
+	pipeline_agg_t agg;
+	airu_sample_t s, out;
+	int p, i;
+
+	// A window with both models and an empty poll
+	pm_reset();
+	pipeline_agg_reset(&agg);
+	for (p = 0; p < (int) (sizeof(polls) / sizeof(polls[0])); p++) {
+		send_many(polls[p].frames, polls[p].len, polls[p].base);
+		acquire(&s);
+		pipeline_agg_add(&agg, &s);
+	}
+	pipeline_agg_result(&agg, &out);
+	CHECK(out.valid & AIRU_FIELD_PM);
+	CHECK(out.valid & AIRU_FIELD_PN);
+	CHECK_EQ(out.pm_count, 42);
+	CHECK_EQ(out.pn_count, 17);
+	CHECK_NEAR(out.pm1, sent.pm[0] / sent.n, TOL);
+	CHECK_NEAR(out.pm10, sent.pm[2] / sent.n, TOL);
+	CHECK_NEAR(out.pm2_5_atm, sent.atm[1] / sent.n, TOL);
+	CHECK_NEAR(out.pm10_atm, sent.atm[2] / sent.n, TOL);
+	for (i = 0; i < AIRU_PN_BINS; i++) {
+		CHECK_NEAR(out.pn[i], sent.pn[i] / sent.n_pn, TOL);
+	}
+
+	// PMS3003 only: PM, but no counts
+	pm_reset();
+	pipeline_agg_reset(&agg);
+	for (p = 0; p < 3; p++) {
+		send_many(8, PM_PKT_LEN, 40);
+		acquire(&s);
+		pipeline_agg_add(&agg, &s);
+	}
+	pipeline_agg_result(&agg, &out);
+	CHECK(out.valid & AIRU_FIELD_PM);
+	CHECK(!(out.valid & AIRU_FIELD_PN));
+	CHECK_EQ(out.pm_count, 24);
+	CHECK_EQ(out.pn_count, 0);
+	CHECK_NEAR(out.pm1_atm, sent.atm[0] / sent.n, TOL);
+}
+
+int main(void)
+{
+	test_poll();
+	test_aggregate();
+	return host_test_done("test_pm_channels");
+}
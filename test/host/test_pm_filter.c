@@ -0,0 +1,216 @@
+/*
+ * test_pm_filter.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  PMS frame filter (PMS_FilterFrame() in pm_if.c):
+ *
+ *    - the Hampel limit: the floor in clean air, 3 * 1.4826 * MAD in a
+ *      noisy window, any one channel rejects the frame, and nothing is
+ *      judged until the window is full
+ *    - a real step is rejected for exactly the frames it takes to fill
+ *      half the window, then accepted
+ *    - the stuck check: not at the limit, right after it, cleared by any
+ *      change, never with a limit of 0. Clean air at 0 or 1 ug/m3 is not
+ *      stuck, nor is PM at 0/0/0 with the particle counts moving; the
+ *      same with the counts frozen is.
+ *    - a synthetic 20000 frame trace at one frame a second: clean air, a
+ *      plume, a wobbling moderate level, high-byte bit flips that passed
+ *      the checksum, and a sensor stuck for the last 5000 s. Every flip
+ *      rejected, no other rejections but at the two step edges, the stuck
+ *      run flagged one second past the limit.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "pm_if.h"
+
+#define S(s)			((s) * 1000000LL)
+#define TRACE_FRAMES	20000
+#define TRACE_STUCK_AT	15000
+#define TRACE_STUCK_S	3600
+
+static pm_verdict_t frame(pm_filter_t *f, int64_t t_s, int pm1, int pm2_5, int pm10)
+{
+	pm_sample_t s;
+
+	memset(&s, 0, sizeof(s));
+	s.ts_us = S(t_s);
+	s.pm1 = pm1;
+	s.pm2_5 = pm2_5;
+	s.pm10 = pm10;
+	return PMS_FilterFrame(f, &s);
+}
+
+/* A PMS5003 frame: PM and particle counts */
+static pm_verdict_t frame_pn(pm_filter_t *f, int64_t t_s, int pm, int pn)
+{
+	pm_sample_t s;
+	int i;
+
+	memset(&s, 0, sizeof(s));
+	s.ts_us = S(t_s);
+	s.pm1 = s.pm2_5 = s.pm10 = pm;
+	s.has_pn = true;
+	for (i = 0; i < PM_PN_BINS; i++) {
+		s.pn[i] = pn >> i;
+	}
+	return PMS_FilterFrame(f, &s);
+}
+
+static void test_hampel(void)
+{
+	static const int noisy[PM_HAMPEL_WIN] = { 80, 90, 90, 100, 100, 100, 110, 110, 120 };
+	pm_filter_t f;
+	int64_t t = 1;
+	int i, rejected;
+
+	// Clean air, no spread: the floor is 10 + 5 / 4 = 11. Anything goes
+	// while the window fills.
+	PMS_FilterInit(&f, 0);
+	CHECK_EQ(frame(&f, t++, 5, 500, 5), PM_FRAME_OK);
+	for (i = 1; i < PM_HAMPEL_WIN; i++) {
+		CHECK_EQ(frame(&f, t++, 5, 5, 5), PM_FRAME_OK);
+	}
+	CHECK_EQ(frame(&f, t++, 5, 16, 5), PM_FRAME_OK);
+	CHECK_EQ(frame(&f, t++, 5, 17, 5), PM_FRAME_OUTLIER);
+	CHECK_EQ(frame(&f, t++, 17, 5, 5), PM_FRAME_OUTLIER);
+	CHECK_EQ(frame(&f, t++, 5, 5, 0), PM_FRAME_OK);
+
+	// Median 100, MAD 10: the limit is 44, above the floor of 35
+	PMS_FilterInit(&f, 0);
+	for (i = 0; i < PM_HAMPEL_WIN; i++) {
+		CHECK_EQ(frame(&f, t++, 10, noisy[i], 10), PM_FRAME_OK);
+	}
+	CHECK_EQ(frame(&f, t++, 10, 144, 10), PM_FRAME_OK);
+	PMS_FilterInit(&f, 0);
+	for (i = 0; i < PM_HAMPEL_WIN; i++) {
+		frame(&f, t++, 10, noisy[i], 10);
+	}
+	CHECK_EQ(frame(&f, t++, 10, 145, 10), PM_FRAME_OUTLIER);
+	CHECK_EQ(frame(&f, t++, 10, 56, 10), PM_FRAME_OK);
+	CHECK_EQ(frame(&f, t++, 10, 50, 10), PM_FRAME_OUTLIER);
+
+	// A step: rejected until it is half the window
+	PMS_FilterInit(&f, 0);
+	for (i = 0; i < PM_HAMPEL_WIN; i++) {
+		frame(&f, t++, 3, 5, 7);
+	}
+	for (i = 0, rejected = 0; i < PM_HAMPEL_WIN; i++) {
+		if (frame(&f, t++, 40, 60, 90) == PM_FRAME_OUTLIER) {
+			CHECK_EQ(i, rejected);
+			rejected++;
+		}
+	}
+	CHECK_EQ(rejected, PM_HAMPEL_WIN / 2 + 1);
+}
+
+static void test_stuck(void)
+{
+	pm_filter_t f;
+	int64_t t;
+
+	PMS_FilterInit(&f, S(100));
+	for (t = 1; t <= 101; t++) {
+		CHECK_EQ(frame(&f, t, 4, 6, 8), PM_FRAME_OK);
+	}
+	CHECK_EQ(frame(&f, 102, 4, 6, 8), PM_FRAME_STUCK);
+	CHECK_EQ(frame(&f, 5000, 4, 6, 8), PM_FRAME_STUCK);
+	CHECK(f.stuck);
+
+	// One value moves: going again, and the new run starts there
+	CHECK_EQ(frame(&f, 5001, 4, 6, 9), PM_FRAME_OK);
+	CHECK(!f.stuck);
+	CHECK_EQ(frame(&f, 5101, 4, 6, 9), PM_FRAME_OK);
+	CHECK_EQ(frame(&f, 5102, 4, 6, 9), PM_FRAME_STUCK);
+
+	PMS_FilterInit(&f, 0);
+	for (t = 1; t < 100000; t += 100) {
+		CHECK_EQ(frame(&f, t, 4, 6, 8), PM_FRAME_OK);
+	}
+
+	// Clean air without counts: 0/0/0 or 1/1/1 for hours
+	PMS_FilterInit(&f, S(100));
+	for (t = 1; t < 20000; t++) {
+		CHECK_EQ(frame(&f, t, (t < 10000) ? 0 : 1, (t < 10000) ? 0 : 1, (t < 10000) ? 0 : 1), PM_FRAME_OK);
+	}
+	CHECK(!f.stuck);
+
+	// Clean air with counts: PM at 0 but the counts move
+	PMS_FilterInit(&f, S(100));
+	for (t = 1; t < 20000; t++) {
+		CHECK_EQ(frame_pn(&f, t, 0, 150 + t % 37), PM_FRAME_OK);
+	}
+	CHECK(!f.stuck);
+
+	// The counts freeze too: stuck
+	for (t = 20000; t <= 20100; t++) {
+		CHECK_EQ(frame_pn(&f, t, 0, 170), PM_FRAME_OK);
+	}
+	CHECK_EQ(frame_pn(&f, 20101, 0, 170), PM_FRAME_STUCK);
+	CHECK_EQ(frame_pn(&f, 20102, 0, 171), PM_FRAME_OK);
+}
+
+static void test_trace(void)
+{
+	pm_filter_t f;
+	pm_verdict_t v;
+	uint32_t seed = 7;
+	int i, base, pm, flip;
+	int flips = 0, missed = 0, outliers = 0, false_edge = 0, false_other = 0, stuck = 0, first_stuck = -1;
+
+	PMS_FilterInit(&f, S(TRACE_STUCK_S));
+	for (i = 0; i < TRACE_FRAMES; i++) {
+		// Clean air, a plume, then a moderate level wobbling by 3
+		base = (i < 8000) ? 5 : (i < 12000) ? 60 : 20;
+		seed = seed * 1103515245 + 12345;
+		pm = base + (int) ((seed >> 16) % 5) - 2;
+		if (i >= 12000) {
+			pm += (i % 50 < 25) ? 3 : -3;
+		}
+		flip = i < TRACE_STUCK_AT && i % 997 == 500;
+		flips += flip;
+
+		if (i >= TRACE_STUCK_AT) {
+			v = frame(&f, i, 13, 20, 30);
+		}
+		else {
+			v = frame(&f, i, pm * 2 / 3, flip ? pm ^ 0x0100 : pm, pm * 3 / 2);
+		}
+
+		if (v == PM_FRAME_STUCK) {
+			stuck++;
+			first_stuck = (first_stuck < 0) ? i : first_stuck;
+		}
+		if (v == PM_FRAME_OUTLIER) {
+			outliers++;
+			if (!flip) {
+				if ((i >= 8000 && i < 8000 + PM_HAMPEL_WIN) || (i >= 12000 && i < 12000 + PM_HAMPEL_WIN)) {
+					false_edge++;
+				}
+				else {
+					false_other++;
+				}
+			}
+		}
+		missed += flip && v == PM_FRAME_OK;
+	}
+
+	CHECK(flips >= 15);
+	CHECK_EQ(missed, 0);
+	CHECK_EQ(false_other, 0);
+	CHECK(false_edge <= 2 * (PM_HAMPEL_WIN / 2 + 1));
+	CHECK_EQ(first_stuck, TRACE_STUCK_AT + TRACE_STUCK_S + 1);
+	CHECK_EQ(stuck, TRACE_FRAMES - first_stuck);
+	printf("trace: %d frames, %d bit flips (%d missed), %d outliers (%d at step edges, %d elsewhere), stuck from frame %d\n",
+		   TRACE_FRAMES, flips, missed, outliers, false_edge, false_other, first_stuck);
+}
+
+int main(void)
+{
+	test_hampel();
+	test_stuck();
+	test_trace();
+	return host_test_done("test_pm_filter");
+}
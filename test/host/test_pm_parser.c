@@ -0,0 +1,392 @@
+/*
+ * test_pm_parser.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  PMS UART parser (pm_if.c) fed through the UART shim the way
+ *  uart_pm_event_mgr() feeds it: one pm_ring_fill() and pm_parse_stream()
+ *  per UART_DATA event.
+ *
+ *    - both frame sizes, split at every offset and coalesced
+ *    - corrupt checksums, bogus lengths and fake headers
+ *    - a long fuzzed stream (flipped, inserted and deleted bytes, cut
+ *      frames) in random event sizes: every intact frame must come out,
+ *      in order, with its values; reports frames/s and the fraction of
+ *      frames recovered
+ *
+ *  Replay a raw capture of the sensor's UART instead:
+ *    ./build/test_pm_parser capture.bin
+ */
+
+#include <stdlib.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "pm_if.c"
+
+#define FUZZ_FRAMES		200000
+
+typedef struct {
+	uint16_t w[13];		/* data words after the length field */
+	int len;			/* PM_PKT_LEN or PM_PKT_LEN_5003 */
+} frame_t;
+
+/*
+ * Serialize f with a valid checksum; returns the frame length
+ */
+static int frame_bytes(const frame_t *f, uint8_t *out)
+{
+	int words = (f->len - PM_HDR_LEN - 2) / 2, i;
+	uint16_t sum = 0;
+
+	out[0] = 'B';
+	out[1] = 'M';
+	out[2] = (f->len - PM_HDR_LEN) >> 8;
+	out[3] = (f->len - PM_HDR_LEN) & 0xff;
+	for (i = 0; i < words; i++) {
+		out[4 + 2 * i] = f->w[i] >> 8;
+		out[5 + 2 * i] = f->w[i] & 0xff;
+	}
+	for (i = 0; i < f->len - 2; i++) {
+		sum += out[i];
+	}
+	out[f->len - 2] = sum >> 8;
+	out[f->len - 1] = sum & 0xff;
+	return f->len;
+}
+
+/*
+ * A frame from a slowly wandering air quality, so the outlier filter has
+ * no reason to reject any of them. The atmospheric words, which the
+ * filter doesn't look at, carry a serial number so every frame is unique.
+ */
+static void frame_next(frame_t *f, int len)
+{
+	static int pm = 20;
+	static uint32_t serial;
+	int i;
+
+	pm += rand() % 3 - 1;
+	if (pm < 5) pm = 5;
+	if (pm > 60) pm = 60;
+
+	memset(f, 0, sizeof(*f));
+	f->len = len;
+	f->w[0] = pm * 2 / 3;
+	f->w[1] = pm;
+	f->w[2] = pm * 3 / 2;
+	f->w[3] = serial & 0xffff;
+	f->w[4] = serial >> 16;
+	f->w[5] = pm * 3 / 2 + 1;
+	serial++;
+	if (len == PM_PKT_LEN_5003) {
+		for (i = 0; i < PM_PN_BINS; i++) {
+			f->w[6 + i] = (3000 >> i) + rand() % 16;
+		}
+	}
+}
+
+static void parser_reset(void)
+{
+	memset(&pm_stats, 0, sizeof(pm_stats));
+	pm_ring_head = pm_ring_tail = 0;
+	uart_flush_input(PM_UART_CH);
+	while (spsc_ring_pop(&pm_sample_ring, NULL));
+	PMS_FilterInit(&pm_filter, 0);
+	pm_power = PM_POWER_ON;
+}
+
+/*
+ * One UART_DATA event of len bytes
+ */
+static void uart_event(const uint8_t *data, size_t len)
+{
+	host_uart_feed(PM_UART_CH, data, len);
+	pm_ring_fill(len);
+	pm_parse_stream();
+}
+
+/*
+ * Events for whatever the driver still holds, as more data would bring
+ */
+static void uart_drain(void)
+{
+	size_t left;
+
+	while ((left = host_uart_pending(PM_UART_CH)) > 0) {
+		if (pm_ring_fill(left) == 0) {
+			break;
+		}
+		pm_parse_stream();
+	}
+}
+
+static bool sample_is(const pm_sample_t *s, const frame_t *f)
+{
+	int i;
+
+	if (s->pm1 != f->w[0] || s->pm2_5 != f->w[1] || s->pm10 != f->w[2] ||
+		s->pm1_atm != f->w[3] || s->pm2_5_atm != f->w[4] || s->pm10_atm != f->w[5]) {
+		return false;
+	}
+	if (s->has_pn != (f->len == PM_PKT_LEN_5003)) {
+		return false;
+	}
+	for (i = 0; i < PM_PN_BINS && s->has_pn; i++) {
+		if (s->pn[i] != f->w[6 + i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_decode(void)
+{
+	const int lens[2] = { PM_PKT_LEN, PM_PKT_LEN_5003 };
+	uint8_t buf[PM_FRAME_MAX_LEN];
+	pm_sample_t s;
+	frame_t f;
+	int k;
+
+	for (k = 0; k < 2; k++) {
+		parser_reset();
+		frame_next(&f, lens[k]);
+		uart_event(buf, frame_bytes(&f, buf));
+		CHECK_EQ(pm_stats.frames_ok, 1);
+		CHECK(spsc_ring_pop(&pm_sample_ring, &s));
+		CHECK(sample_is(&s, &f));
+		CHECK_EQ(PMS_Model(), lens[k] == PM_PKT_LEN ? PM_MODEL_PMS3003 : PM_MODEL_PMS5003);
+	}
+}
+
+static void test_split_everywhere(void)
+{
+	uint8_t buf[3 * PM_FRAME_MAX_LEN];
+	pm_sample_t s;
+	frame_t f[3];
+	int n = 0, cut1, cut2, i, got;
+
+	frame_next(&f[0], PM_PKT_LEN);
+	frame_next(&f[1], PM_PKT_LEN_5003);
+	frame_next(&f[2], PM_PKT_LEN);
+	for (i = 0; i < 3; i++) {
+		n += frame_bytes(&f[i], buf + n);
+	}
+
+	// Three events, cut at every pair of points
+	for (cut1 = 0; cut1 <= n; cut1++) {
+		for (cut2 = cut1; cut2 <= n; cut2++) {
+			parser_reset();
+			uart_event(buf, cut1);
+			uart_event(buf + cut1, cut2 - cut1);
+			uart_event(buf + cut2, n - cut2);
+			for (got = 0; spsc_ring_pop(&pm_sample_ring, &s); got++) {
+				CHECK(got < 3 && sample_is(&s, &f[got]));
+			}
+			CHECK_EQ(got, 3);
+			CHECK_EQ(pm_stats.bytes_dropped, 0);
+		}
+	}
+}
+
+static void test_bad_frames(void)
+{
+	uint8_t buf[4 * PM_FRAME_MAX_LEN];
+	pm_sample_t s;
+	frame_t f;
+	int n;
+
+	// Bad checksum, then a good frame right behind it
+	parser_reset();
+	frame_next(&f, PM_PKT_LEN);
+	n = frame_bytes(&f, buf);
+	buf[7] ^= 0x40;
+	n += frame_bytes(&f, buf + n);
+	uart_event(buf, n);
+	CHECK_EQ(pm_stats.frames_bad, 1);
+	CHECK_EQ(pm_stats.frames_ok, 1);
+	CHECK(spsc_ring_pop(&pm_sample_ring, &s) && sample_is(&s, &f));
+
+	// A header with an impossible length must not stall the stream
+	parser_reset();
+	memcpy(buf, "BM\xff\xff", 4);
+	n = 4 + frame_bytes(&f, buf + 4);
+	uart_event(buf, n);
+	CHECK_EQ(pm_stats.frames_ok, 1);
+	CHECK_EQ(pm_stats.bytes_dropped, 4);
+
+	// A plausible fake header swallows the real frame's start; the real
+	// frame is still found once the fake one fails its checksum
+	parser_reset();
+	memcpy(buf, "BM\x00\x14", 4);
+	n = 4 + frame_bytes(&f, buf + 4);
+	uart_event(buf, n);
+	CHECK_EQ(pm_stats.frames_ok, 1);
+	CHECK_EQ(pm_stats.frames_bad, 1);
+
+	// More than the ring holds in one event: the rest waits in the driver
+	parser_reset();
+	for (n = 0; n + PM_PKT_LEN <= (int) sizeof(buf); ) {
+		n += frame_bytes(&f, buf + n);
+	}
+	host_uart_feed(PM_UART_CH, buf, n);
+	host_uart_feed(PM_UART_CH, buf, n);
+	host_uart_feed(PM_UART_CH, buf, n);
+	host_uart_feed(PM_UART_CH, buf, n);
+	host_uart_feed(PM_UART_CH, buf, n);
+	pm_ring_fill(5 * n);
+	pm_parse_stream();
+	uart_drain();
+	CHECK_EQ(pm_stats.frames_ok, 5 * (n / PM_PKT_LEN));
+	CHECK_EQ(pm_stats.bytes_dropped, 0);
+}
+
+/*
+ * Fuzzed stream. Each frame may be damaged or have garbage put in front
+ * of it; the frames left alone are the ones that must come out.
+ */
+static void test_fuzz(void)
+{
+	static frame_t sent[FUZZ_FRAMES];
+	static bool intact[FUZZ_FRAMES];
+	static uint8_t stream[FUZZ_FRAMES * (PM_FRAME_MAX_LEN + 48)];
+	uint8_t buf[PM_FRAME_MAX_LEN];
+	size_t len = 0, pos, ev;
+	int i, j, n, next = 0, n_intact = 0, found = 0, missed = 0, phantom = 0;
+	pm_sample_t s;
+	double t0, dt;
+
+	parser_reset();
+	srand(1);
+
+	for (i = 0; i < FUZZ_FRAMES; i++) {
+		frame_next(&sent[i], (rand() % 4) ? PM_PKT_LEN_5003 : PM_PKT_LEN);
+		n = frame_bytes(&sent[i], buf);
+		intact[i] = true;
+
+		// Line noise in front, sometimes with a header in it
+		if (rand() % 10 == 0) {
+			for (j = rand() % 40; j > 0; j--) {
+				stream[len++] = rand();
+			}
+			if (rand() % 2) {
+				memcpy(stream + len, (rand() % 2) ? "BM\x00\x1c" : "BM\x00\x14", 4);
+				len += 4;
+			}
+		}
+
+		switch (rand() % 20) {
+		case 0:		// flipped bits
+			buf[rand() % n] ^= 1 << (rand() % 8);
+			intact[i] = false;
+			break;
+		case 1:		// lost byte
+			j = rand() % n;
+			memmove(buf + j, buf + j + 1, n - j - 1);
+			n--;
+			intact[i] = false;
+			break;
+		case 2:		// cut short
+			n = rand() % n;
+			intact[i] = false;
+			break;
+		default:
+			break;
+		}
+		memcpy(stream + len, buf, n);
+		len += n;
+		n_intact += intact[i];
+	}
+
+	t0 = host_seconds();
+	for (pos = 0; pos < len; pos += ev) {
+		// The driver's receive buffer is BUF_SIZE, events are never larger
+		ev = 1 + rand() % ((rand() % 8) ? 48 : BUF_SIZE);
+		if (ev > len - pos) {
+			ev = len - pos;
+		}
+		uart_event(stream + pos, ev);
+
+		while (spsc_ring_pop(&pm_sample_ring, &s)) {
+			// Match against the frames in order; a match skips the frames
+			// before it, anything else is a phantom. The additive checksum
+			// passes the odd damaged frame, which can cost the frame after.
+			for (j = next; j < FUZZ_FRAMES && j < next + 64 && !sample_is(&s, &sent[j]); j++);
+			if (j < FUZZ_FRAMES && j < next + 64) {
+				for (; next < j; next++) {
+					missed += intact[next];
+				}
+				found += intact[next];
+				phantom += !intact[next];
+				next++;
+			}
+			else {
+				phantom++;
+			}
+		}
+	}
+	uart_drain();
+	dt = host_seconds() - t0;
+
+	CHECK(missed <= n_intact / 10000);
+	CHECK(found + missed >= n_intact - n_intact / 10000);
+	CHECK(phantom <= FUZZ_FRAMES / 10000);
+	CHECK_EQ(pm_stats.frames_outlier, 0);
+	CHECK_EQ(pm_sample_ring.dropped, 0);
+
+	printf("fuzz: %d frames, %d intact, %d recovered (%.2f%% of intact, %.2f%% of all), %d phantom\n",
+		   FUZZ_FRAMES, n_intact, found, 100.0 * found / n_intact, 100.0 * found / FUZZ_FRAMES, phantom);
+	printf("fuzz: %.0f frames/s, %.1f MB/s of stream\n", FUZZ_FRAMES / dt, len / dt / 1e6);
+}
+
+/*
+ * Replay a raw capture in random event sizes and report what the parser
+ * made of it
+ */
+static int replay(const char *path)
+{
+	static uint8_t data[1 << 24];
+	FILE *f = fopen(path, "rb");
+	size_t len, pos, ev;
+	double t0, dt;
+
+	if (f == NULL) {
+		perror(path);
+		return 1;
+	}
+	len = fread(data, 1, sizeof(data), f);
+	fclose(f);
+
+	parser_reset();
+	t0 = host_seconds();
+	for (pos = 0; pos < len; pos += ev) {
+		ev = 1 + rand() % BUF_SIZE;
+		if (ev > len - pos) {
+			ev = len - pos;
+		}
+		uart_event(data + pos, ev);
+		while (spsc_ring_pop(&pm_sample_ring, NULL));
+	}
+	uart_drain();
+	dt = host_seconds() - t0;
+
+	printf("%s: %zu bytes, %u frames ok, %u bad, %u outliers, %u bytes skipped, %s\n",
+		   path, len, pm_stats.frames_ok, pm_stats.frames_bad, pm_stats.frames_outlier,
+		   pm_stats.bytes_dropped, pm_model == PM_MODEL_PMS5003 ? "PMS5003/7003" : "PMS3003");
+	printf("%s: %.1f%% of frame candidates good, %.0f frames/s\n", path,
+		   100.0 * pm_stats.frames_ok / (pm_stats.frames_ok + pm_stats.frames_bad + 1e-9),
+		   pm_stats.frames_ok / dt);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1) {
+		return replay(argv[1]);
+	}
+
+	test_decode();
+	test_split_everywhere();
+	test_bad_frames();
+	test_fuzz();
+	return host_test_done("test_pm_parser");
+}
@@ -0,0 +1,213 @@
+/*
+ * test_pm_power.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  PM sensor duty cycle (pm_if.c) on the simulated timers, with the
+ *  Kconfig defaults: 30 s spin-up, 10 s measuring, 20 s asleep.
+ *
+ *    - five cycles from PMS_Initialize(): the state sequence, SET low
+ *      exactly while asleep, every state lasting its period, 40 s awake
+ *      in 60. The sensor sends a frame a second while awake: spin-up and
+ *      in-flight frames are counted and dropped, measuring frames reach
+ *      PMS_Poll(), and a poll late in the next spin-up still reports the
+ *      last window.
+ *    - PMS_Measure(): refused while awake, wakes a sleeping sensor for a
+ *      full spin-up and restarts the cycle from there. Two requests, or
+ *      one that the timer's own wake overtakes, don't shorten it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "pm_if.c"
+
+#define S(s)		((s) * 1000000LL)
+#define CYCLES		5
+#define SLEEP_S		(CONFIG_PM_CYCLE_S - CONFIG_PM_SPINUP_S - CONFIG_PM_MEASURE_S)
+
+static uint32_t frames_sent;
+
+/*
+ * One PMS5003 frame of steady air, in its own UART event
+ */
+static void send_frame(void)
+{
+	uint8_t out[PM_PKT_LEN_5003];
+	uint16_t sum = 0;
+	int i;
+
+	memset(out, 0, sizeof(out));
+	out[0] = 'B';
+	out[1] = 'M';
+	out[3] = PM_PKT_LEN_5003 - PM_HDR_LEN;
+	for (i = 0; i < 6; i++) {
+		out[5 + 2 * i] = 10 + frames_sent % 3;
+	}
+	for (i = 0; i < PM_PKT_LEN_5003 - 2; i++) {
+		sum += out[i];
+	}
+	out[PM_PKT_LEN_5003 - 2] = sum >> 8;
+	out[PM_PKT_LEN_5003 - 1] = sum & 0xff;
+	frames_sent++;
+
+	host_uart_feed(PM_UART_CH, out, sizeof(out));
+	pm_ring_fill(sizeof(out));
+	pm_parse_stream();
+}
+
+static pm_power_t expected(int64_t since_wake_us)
+{
+	int64_t u = since_wake_us % S(CONFIG_PM_CYCLE_S);
+
+	return (u < S(CONFIG_PM_SPINUP_S)) ? PM_POWER_SPINUP :
+		   (u < S(CONFIG_PM_SPINUP_S + CONFIG_PM_MEASURE_S)) ? PM_POWER_MEASURE : PM_POWER_SLEEP;
+}
+
+static void test_cycle(void)
+{
+	pm_parse_stats_t st;
+	pm_data_t d;
+	pm_power_t prev, now;
+	int64_t t0, t, changed, len[4] = { 0 };
+	uint32_t awake = 0, steps = 0, bad = 0, bad_len = 0, changes = 0, spinup_frames = 0, polls_ok = 0;
+	char json[256];
+
+	t0 = host_time_us;
+	CHECK_EQ(PMS_Initialize(), ESP_OK);
+	CHECK(pm_power_timer != NULL);
+	CHECK_EQ(PMS_PowerState(), PM_POWER_SPINUP);
+	CHECK_EQ(gpio_get_level(GPIO_PM_SET), 1);
+	CHECK_EQ(gpio_get_level(GPIO_PM_RESET), 1);
+	CHECK_EQ(pm_stale_us, PM_STALE_TIMEOUT_US + S(CONFIG_PM_CYCLE_S - CONFIG_PM_MEASURE_S));
+
+	prev = PM_POWER_SPINUP;
+	changed = t0;
+	for (t = t0 + S(1); t <= t0 + S(CYCLES * CONFIG_PM_CYCLE_S); t += S(1)) {
+		host_advance_us(t - host_time_us);
+		now = PMS_PowerState();
+		steps++;
+		bad += now != expected(t - t0);
+		bad += gpio_get_level(GPIO_PM_SET) != (now != PM_POWER_SLEEP);
+		if (now != prev) {
+			// Whole periods only: the state before lasted exactly its length
+			changes++;
+			if (changes > 1) {
+				len[prev] = t - changed;
+				bad_len += len[prev] != S((prev == PM_POWER_SPINUP) ? CONFIG_PM_SPINUP_S :
+										  (prev == PM_POWER_MEASURE) ? CONFIG_PM_MEASURE_S : SLEEP_S);
+			}
+			changed = t;
+		}
+
+		// A frame a second while awake, and the one in flight as it slept
+		if (now != PM_POWER_SLEEP || prev != PM_POWER_SLEEP) {
+			spinup_frames += now != PM_POWER_MEASURE;
+			send_frame();
+		}
+		awake += now != PM_POWER_SLEEP;
+		prev = now;
+
+		// Polled at the end of each spin-up: the last window, a sleep ago
+		if ((t - t0) % S(CONFIG_PM_CYCLE_S) == S(CONFIG_PM_SPINUP_S - 1) && t - t0 > S(CONFIG_PM_CYCLE_S)) {
+			polls_ok += PMS_Poll(&d) == ESP_OK && d.sample_count == CONFIG_PM_MEASURE_S;
+		}
+		if (t - t0 == S(CONFIG_PM_CYCLE_S - 1)) {
+			PMS_StatusJson(json, sizeof(json));
+			CHECK(strstr(json, "\"power\":\"sleep\"") != NULL);
+		}
+	}
+	CHECK_EQ(bad, 0);
+	CHECK_EQ(bad_len, 0);
+	CHECK_EQ(changes, CYCLES * 3);
+	CHECK_EQ(awake * CONFIG_PM_CYCLE_S, steps * (CONFIG_PM_SPINUP_S + CONFIG_PM_MEASURE_S));
+	CHECK_EQ(polls_ok, CYCLES - 1);
+
+	PMS_GetParseStats(&st);
+	CHECK_EQ(st.frames_ok, frames_sent);
+	CHECK_EQ(st.frames_outlier + st.frames_stuck, 0);
+	CHECK_EQ(st.frames_spinup, spinup_frames);
+	CHECK_EQ(frames_sent - st.frames_spinup, CYCLES * CONFIG_PM_MEASURE_S);
+	printf("cycle: %d cycles, awake %u of %u s, spin-up %lld s, measure %lld s, sleep %lld s, %u frames, %u dropped in spin-up or flight\n",
+		   CYCLES, awake, steps, (long long) len[PM_POWER_SPINUP] / 1000000, (long long) len[PM_POWER_MEASURE] / 1000000,
+		   (long long) len[PM_POWER_SLEEP] / 1000000, frames_sent, st.frames_spinup);
+}
+
+/*
+ * Advance to the next state change; returns how long it took
+ */
+static int64_t until_change(void)
+{
+	pm_power_t k = PMS_PowerState();
+	int64_t t0 = host_time_us;
+
+	while (PMS_PowerState() == k && host_time_us - t0 < S(CONFIG_PM_CYCLE_S)) {
+		host_advance_us(100000);
+	}
+	return host_time_us - t0;
+}
+
+/*
+ * On to the next sleep, then s seconds into it
+ */
+static void into_sleep(int64_t s)
+{
+	while (PMS_PowerState() != PM_POWER_SLEEP) {
+		until_change();
+	}
+	host_advance_us(S(s));
+}
+
+static void test_measure(void)
+{
+	// Awake: nothing to do
+	while (PMS_PowerState() == PM_POWER_SLEEP) {
+		until_change();
+	}
+	CHECK_EQ(PMS_PowerState(), PM_POWER_SPINUP);
+	CHECK_EQ(PMS_Measure(), ESP_ERR_INVALID_STATE);
+	until_change();
+	CHECK_EQ(PMS_PowerState(), PM_POWER_MEASURE);
+	CHECK_EQ(PMS_Measure(), ESP_ERR_INVALID_STATE);
+
+	// Asleep: woken by the timer task, a full cycle from there
+	into_sleep(5);
+	CHECK_EQ(PMS_Measure(), ESP_OK);
+	CHECK_EQ(PMS_PowerState(), PM_POWER_SLEEP);
+	host_advance_us(0);
+	CHECK_EQ(PMS_PowerState(), PM_POWER_SPINUP);
+	CHECK_EQ(gpio_get_level(GPIO_PM_SET), 1);
+	CHECK_EQ(until_change(), S(CONFIG_PM_SPINUP_S));
+	CHECK_EQ(PMS_PowerState(), PM_POWER_MEASURE);
+	CHECK_EQ(until_change(), S(CONFIG_PM_MEASURE_S));
+	CHECK_EQ(until_change(), S(SLEEP_S));
+	CHECK_EQ(PMS_PowerState(), PM_POWER_SPINUP);
+
+	// Two requests before the timer task runs: one wake
+	into_sleep(1);
+	CHECK_EQ(PMS_Measure(), ESP_OK);
+	CHECK_EQ(PMS_Measure(), ESP_OK);
+	host_advance_us(0);
+	CHECK_EQ(PMS_PowerState(), PM_POWER_SPINUP);
+	CHECK_EQ(until_change(), S(CONFIG_PM_SPINUP_S));
+	CHECK_EQ(PMS_PowerState(), PM_POWER_MEASURE);
+
+	// A request queued just as the sleep ends: the timer's wake runs first
+	// and the request finds the sensor awake
+	into_sleep(SLEEP_S - 1);
+	host_advance_us(S(1) - 1);
+	CHECK_EQ(PMS_Measure(), ESP_OK);
+	pm_power_step(pm_power_timer);
+	host_advance_us(0);
+	CHECK_EQ(PMS_PowerState(), PM_POWER_SPINUP);
+	CHECK_EQ(until_change(), S(CONFIG_PM_SPINUP_S));
+	CHECK_EQ(PMS_PowerState(), PM_POWER_MEASURE);
+}
+
+int main(void)
+{
+	test_cycle();
+	test_measure();
+	return host_test_done("test_pm_power");
+}
@@ -0,0 +1,303 @@
+/*
+ * test_sd_writer.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Buffered daily file writer (sd_if.c), with the card being a directory
+ *  under build/:
+ *
+ *    - header only on new files, also across a reboot; offsets match the
+ *      file; flushes on size, age and date; records too big to buffer;
+ *      buffering on while the card can't be opened
+ *    - several days of rows through sd_write_data() and through the
+ *      stat/fopen/fprintf/fclose per row it replaced: the files must be
+ *      identical. Reports records/s and file system calls per record
+ *      (stat, open, close and fsync counted here, read and write from
+ *      /proc/self/io) for both.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "host_test.h"
+#include "host_shim.h"
+
+#define SD_MOUNT_POINT		"build/sdcard"
+#define OLD_MOUNT_POINT		"build/sdcard_old"
+
+#define BENCH_DAYS			3
+#define BENCH_PERIOD_S		5		/* a row every 5 s */
+#define BENCH_ROWS			(BENCH_DAYS * 86400 / BENCH_PERIOD_S)
+
+/* File system calls, counted on their way from sd_if.c and old_write_data() */
+static struct {
+	uint32_t stat, open, close, fsync;
+} ops;
+
+#define stat(path, st)		(ops.stat++, stat(path, st))
+#define fopen(path, mode)	(ops.open++, fopen(path, mode))
+#define fclose(f)			(ops.close++, fclose(f))
+#define fsync(fd)			(ops.fsync++, fsync(fd))
+
+#include "sd_if.c"
+
+/*
+ * sd_write_data() before the buffered writer
+ */
+static esp_err_t old_write_data(char *pkt, uint8_t year, uint8_t month, uint8_t day)
+{
+	struct stat st;
+	char filename[64];
+	bool exists;
+	FILE *f;
+
+	sprintf(filename, OLD_MOUNT_POINT "/%02d-%02d-%02d.csv", year, month, day);
+	exists = stat(filename, &st) == 0;
+
+	f = fopen(filename, "a");
+	if (f == NULL) {
+		return ESP_FAIL;
+	}
+	if (!exists) {
+		fprintf(f, "%s", SD_HDR);
+	}
+	fprintf(f, "%s", pkt);
+	fclose(f);
+	return ESP_OK;
+}
+
+/* read and write system calls so far */
+static uint64_t io_syscalls(void)
+{
+	unsigned long long v, n = 0;
+	char key[32];
+	FILE *f = (fopen)("/proc/self/io", "r");
+
+	if (f == NULL) {
+		return 0;
+	}
+	while (fscanf(f, "%31[^:]: %llu\n", key, &v) == 2) {
+		if (strcmp(key, "syscr") == 0 || strcmp(key, "syscw") == 0) {
+			n += v;
+		}
+	}
+	(fclose)(f);
+	return n;
+}
+
+static long file_size(const char *path)
+{
+	struct stat st;
+
+	return ((stat)(path, &st) == 0) ? st.st_size : -1;
+}
+
+static char *file_read(const char *path, long *len)
+{
+	FILE *f = (fopen)(path, "rb");
+	char *buf;
+
+	*len = file_size(path);
+	if (f == NULL || *len < 0) {
+		return NULL;
+	}
+	buf = malloc(*len + 1);
+	*len = fread(buf, 1, *len, f);
+	buf[*len] = '\0';
+	(fclose)(f);
+	return buf;
+}
+
+static void card_wipe(const char *dir)
+{
+	char cmd[128];
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s && mkdir -p %s", dir, dir);
+	CHECK_EQ(system(cmd), 0);
+}
+
+static void test_writer(void)
+{
+	static sd_writer_t w;
+	static const char hdr[] = "hdr\n";
+	char rec[64], big[CONFIG_SD_WRITE_BUFFER_SIZE + 100], *data;
+	const char *name = SD_MOUNT_POINT "/26-10-17.log";
+	long len;
+	int i;
+
+	card_wipe(SD_MOUNT_POINT);
+	sd_writer_init(&w, "log", hdr, 4);
+
+	// New file: header, then nothing reaches the card until a flush
+	CHECK_EQ(sd_writer_append(&w, "a\n", 2, 26, 10, 17), ESP_OK);
+	CHECK_EQ(w.offset, 6);
+	CHECK_EQ(file_size(name), 0);
+	host_advance_us(CONFIG_SD_WRITE_FLUSH_PERIOD * 1000000LL - 1);
+	CHECK_EQ(sd_writer_poll(&w), ESP_OK);
+	CHECK_EQ(file_size(name), 0);
+	host_advance_us(1);
+	CHECK_EQ(sd_writer_poll(&w), ESP_OK);
+	CHECK_EQ(file_size(name), 6);
+	CHECK_EQ(w.writes, 1);
+
+	// Size: the buffer goes out when the next record wouldn't fit
+	for (i = 0; w.len + 16 <= sizeof(w.buf); i++) {
+		snprintf(rec, sizeof(rec), "row %10d\n", i);
+		CHECK_EQ(sd_writer_append(&w, rec, 16, 26, 10, 17), ESP_OK);
+	}
+	CHECK_EQ(w.writes, 1);
+	CHECK_EQ(sd_writer_append(&w, "b\n", 2, 26, 10, 17), ESP_OK);
+	CHECK_EQ(w.writes, 2);
+	CHECK_EQ(file_size(name), 6 + 16 * i);
+
+	// Too big to buffer: what's buffered goes first, order is kept
+	memset(big, 'x', sizeof(big));
+	big[sizeof(big) - 1] = '\n';
+	CHECK_EQ(sd_writer_append(&w, big, sizeof(big), 26, 10, 17), ESP_OK);
+	CHECK_EQ(file_size(name), 6 + 16 * i + 2 + (long) sizeof(big));
+	CHECK_EQ(w.offset, file_size(name));
+
+	// Reboot: the file exists, no second header, offsets carry on
+	sd_writer_close(&w);
+	sd_writer_init(&w, "log", hdr, 4);
+	CHECK_EQ(sd_writer_append(&w, "c\n", 2, 26, 10, 17), ESP_OK);
+	CHECK_EQ(w.offset, 6 + 16 * i + 2 + (long) sizeof(big) + 2);
+
+	// Date change: the old day is finished and the new one starts
+	CHECK_EQ(sd_writer_append(&w, "d\n", 2, 26, 10, 18), ESP_OK);
+	CHECK_EQ(w.offset, 6);
+	CHECK_EQ(file_size(name), 6 + 16 * i + 2 + (long) sizeof(big) + 2);
+	data = file_read(name, &len);
+	CHECK(data != NULL && strncmp(data, "hdr\na\nrow          0\n", 21) == 0);
+	CHECK(data != NULL && strcmp(data + len - 3, "\nc\n") == 0);
+	CHECK(data != NULL && strstr(data + 4, "hdr") == NULL);
+	free(data);
+
+	// No card: rows stay buffered and the flush retries the open
+	sd_writer_close(&w);
+	card_wipe(SD_MOUNT_POINT);
+	rmdir(SD_MOUNT_POINT);
+	CHECK_EQ(sd_writer_append(&w, "e\n", 2, 26, 10, 19), ESP_FAIL);
+	CHECK_EQ(sd_writer_append(&w, "f\n", 2, 26, 10, 19), ESP_OK);
+	CHECK_EQ(sd_writer_flush(&w), ESP_FAIL);
+	CHECK_EQ(w.len, 4);
+	CHECK_EQ(sd_writer_append(&w, "g\n", 2, 26, 10, 19), ESP_OK);
+	card_wipe(SD_MOUNT_POINT);
+	CHECK_EQ(sd_writer_flush(&w), ESP_OK);
+	data = file_read(SD_MOUNT_POINT "/26-10-19.log", &len);
+	CHECK(data != NULL && strcmp(data, "hdr\ne\nf\ng\n") == 0);
+	CHECK_EQ(w.offset, 10);
+	free(data);
+
+	// A card gone for longer than the buffer lasts: the oldest rows go,
+	// nothing overruns the buffer and the offsets stay right
+	sd_writer_close(&w);
+	card_wipe(SD_MOUNT_POINT);
+	rmdir(SD_MOUNT_POINT);
+	for (i = 0; i < 3 * (int) sizeof(w.buf) / 16; i++) {
+		snprintf(rec, sizeof(rec), "row %10d\n", i);
+		sd_writer_append(&w, rec, 16, 26, 10, 20);
+		CHECK(w.len <= sizeof(w.buf));
+	}
+	card_wipe(SD_MOUNT_POINT);
+	CHECK_EQ(sd_writer_flush(&w), ESP_OK);
+	CHECK_EQ(w.offset, file_size(SD_MOUNT_POINT "/26-10-20.log"));
+	data = file_read(SD_MOUNT_POINT "/26-10-20.log", &len);
+	snprintf(rec, sizeof(rec), "row %10d\n", i - 1);
+	CHECK(data != NULL && strcmp(data + len - 16, rec) == 0);
+	free(data);
+	sd_writer_close(&w);
+}
+
+/*
+ * One CSV row a sample, as pipeline_serialize() makes them
+ */
+static int bench_row(char *row, size_t size, int i)
+{
+	int up = i * BENCH_PERIOD_S;
+
+	return snprintf(row, size, "%02d:%02d:%02d,A1B2C3D4E5F6,airu/influx,%d,%.2f,%.4f,%.4f,%.2f,%.2f,%.2f,%.2f,%.2f,%d,%d\n",
+					up / 3600 % 24, up / 60 % 60, up % 60, up, 1288.5 + i % 7, 40.7608, -111.891,
+					3.0 + i % 13, 5.0 + i % 17, 7.0 + i % 19, 21.0 + (i % 50) / 10.0, 40.0 + i % 11, 300 + i % 40, i % 30);
+}
+
+typedef struct {
+	double rate;
+	double calls;
+	uint32_t stat, open, close, fsync;
+	uint64_t io;
+} bench_t;
+
+static void bench_run(bench_t *b, esp_err_t (*write)(char *, uint8_t, uint8_t, uint8_t), bool buffered)
+{
+	char row[256];
+	uint64_t io0;
+	double t0;
+	int i;
+
+	memset(&ops, 0, sizeof(ops));
+	io0 = io_syscalls();
+	t0 = host_seconds();
+
+	for (i = 0; i < BENCH_ROWS; i++) {
+		bench_row(row, sizeof(row), i);
+		CHECK_EQ(write(row, 26, 10, 17 + i / (86400 / BENCH_PERIOD_S)), ESP_OK);
+		host_time_us += BENCH_PERIOD_S * 1000000LL;
+		if (buffered) {
+			// The SD sink polls at least once a row
+			sd_flush_data(false);
+		}
+	}
+	if (buffered) {
+		sd_flush_data(true);
+		sd_writer_close(&csv_writer);
+		csv_writer_ready = false;
+	}
+
+	b->rate = BENCH_ROWS / (host_seconds() - t0);
+	b->io = io_syscalls() - io0;
+	b->stat = ops.stat;
+	b->open = ops.open;
+	b->close = ops.close;
+	b->fsync = ops.fsync;
+	b->calls = (double) (b->io + b->stat + b->open + b->close + b->fsync) / BENCH_ROWS;
+}
+
+static void test_bench(void)
+{
+	char name[64], old[64], *a, *b;
+	bench_t n, o;
+	long la, lb;
+	int d;
+
+	card_wipe(SD_MOUNT_POINT);
+	card_wipe(OLD_MOUNT_POINT);
+
+	bench_run(&n, sd_write_data, true);
+	bench_run(&o, old_write_data, false);
+
+	for (d = 0; d < BENCH_DAYS; d++) {
+		snprintf(name, sizeof(name), SD_MOUNT_POINT "/26-10-%02d.csv", 17 + d);
+		snprintf(old, sizeof(old), OLD_MOUNT_POINT "/26-10-%02d.csv", 17 + d);
+		a = file_read(name, &la);
+		b = file_read(old, &lb);
+		CHECK(a != NULL && b != NULL && la == lb && memcmp(a, b, la) == 0);
+		free(a);
+		free(b);
+	}
+
+	CHECK(n.calls * 10 < o.calls);
+	printf("bench: %d rows over %d days\n", BENCH_ROWS, BENCH_DAYS);
+	printf("bench: buffered %9.0f rows/s, %.3f calls/row (%u stat, %u open, %u close, %u fsync, %llu read/write)\n",
+		   n.rate, n.calls, n.stat, n.open, n.close, n.fsync, (unsigned long long) n.io);
+	printf("bench: per row  %9.0f rows/s, %.3f calls/row (%u stat, %u open, %u close, %u fsync, %llu read/write)\n",
+		   o.rate, o.calls, o.stat, o.open, o.close, o.fsync, (unsigned long long) o.io);
+}
+
+int main(void)
+{
+	test_writer();
+	test_bench();
+	return host_test_done("test_sd_writer");
+}
@@ -0,0 +1,197 @@
+/*
+ * test_seqlock.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Sequence lock (seqlock.c):
+ *
+ *    - a stable record reads without retries, the version counts writes
+ *    - a reader that finds a write in progress spins SEQLOCK_SPINS times,
+ *      then sleeps a tick at a time until the writer is done
+ *    - one writer thread and three reader threads on a record the size of
+ *      esp_gps_t, for a second. Every word of a record is derived from its
+ *      serial number, so a copy that mixes two writes shows. No reader may
+ *      see a torn record or go back to an older one. The writer never
+ *      yields, so on a single core it is preempted mid-write now and then
+ *      and readers have to retry. A fourth reader copies without the lock
+ *      to show the torn-record check works. Reports reads/s and retries.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "seqlock.h"
+#include "gps_if.h"
+
+#define STRESS_SECONDS		1.0
+#define STRESS_READERS		3
+/* As big as a GPS fix, the largest record behind a seqlock */
+#define REC_WORDS			((sizeof(esp_gps_t) + 3) / 4)
+
+typedef struct {
+	uint32_t serial;
+	uint32_t w[REC_WORDS];		/* w[k] = serial * (2k + 1) */
+} rec_t;
+
+SEQLOCK_DEFINE(rec_snap, rec_t);
+
+static void rec_make(rec_t *r, uint32_t serial)
+{
+	uint32_t k;
+
+	r->serial = serial;
+	for (k = 0; k < REC_WORDS; k++) {
+		r->w[k] = serial * (2 * k + 1);
+	}
+}
+
+static bool rec_whole(const rec_t *r)
+{
+	uint32_t k;
+
+	for (k = 0; k < REC_WORDS; k++) {
+		if (r->w[k] != r->serial * (2 * k + 1)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Finishes a write the main thread's reader is waiting on */
+static volatile uint32_t finish_after_us;
+
+static void *finisher(void *arg)
+{
+	// The reader's sleeps move the simulated clock; wait for enough of them
+	while (__atomic_load_n(&host_time_us, __ATOMIC_ACQUIRE) < finish_after_us) {
+		sched_yield();
+	}
+	memcpy(rec_snap.data, arg, sizeof(rec_t));
+	__atomic_store_n(&rec_snap.seq, rec_snap.seq + 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void test_basic(void)
+{
+	rec_t in, out;
+	pthread_t t;
+	uint32_t retries;
+	int64_t t0;
+
+	CHECK_EQ(seqlock_version(&rec_snap), 0);
+	rec_make(&in, 7);
+	seqlock_write(&rec_snap, &in);
+	seqlock_write(&rec_snap, &in);
+	CHECK_EQ(seqlock_version(&rec_snap), 2);
+	CHECK_EQ(seqlock_read(&rec_snap, &out), 0);
+	CHECK(memcmp(&in, &out, sizeof(in)) == 0);
+
+	// A write in progress (odd count) holds the reader until it completes
+	rec_make(&in, 8);
+	rec_snap.seq++;
+	t0 = host_time_us;
+	finish_after_us = t0 + 5 * portTICK_PERIOD_MS * 1000;
+	pthread_create(&t, NULL, finisher, &in);
+	retries = seqlock_read(&rec_snap, &out);
+	pthread_join(t, NULL);
+	CHECK_EQ(out.serial, 8);
+	CHECK(rec_whole(&out));
+	CHECK(retries >= 5 * SEQLOCK_SPINS);
+	CHECK_EQ((host_time_us - t0) / (portTICK_PERIOD_MS * 1000), retries / SEQLOCK_SPINS);
+	CHECK_EQ(seqlock_version(&rec_snap), 3);
+}
+
+static volatile int writer_done;
+static uint32_t unlocked_reads, unlocked_torn;
+
+typedef struct {
+	uint32_t reads, retries, torn, backwards;
+} reader_stats_t;
+
+static uint32_t writes;
+
+static void *writer(void *arg)
+{
+	double end = host_seconds() + STRESS_SECONDS;
+	rec_t r;
+
+	while (writes % 1024 != 0 || host_seconds() < end) {
+		rec_make(&r, ++writes);
+		seqlock_write(&rec_snap, &r);
+	}
+	__atomic_store_n(&writer_done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void *reader(void *arg)
+{
+	reader_stats_t *st = arg;
+	uint32_t last = 0;
+	rec_t r;
+
+	while (!__atomic_load_n(&writer_done, __ATOMIC_ACQUIRE)) {
+		if (st == NULL) {
+			// The control: no lock at all
+			memcpy(&r, rec_snap.data, sizeof(r));
+			unlocked_reads++;
+			unlocked_torn += !rec_whole(&r);
+			continue;
+		}
+		st->retries += seqlock_read(&rec_snap, &r);
+		st->reads++;
+		if (!rec_whole(&r)) {
+			st->torn++;
+		}
+		if (r.serial < last) {
+			st->backwards++;
+		}
+		last = r.serial;
+	}
+	return NULL;
+}
+
+static void test_stress(void)
+{
+	static reader_stats_t st[STRESS_READERS];
+	pthread_t w, rd[STRESS_READERS], control;
+	uint32_t reads = 0, retries = 0, torn = 0, backwards = 0;
+	double t0, secs;
+	rec_t zero;
+	int i;
+
+	rec_make(&zero, 0);
+	seqlock_write(&rec_snap, &zero);
+	t0 = host_seconds();
+	for (i = 0; i < STRESS_READERS; i++) {
+		pthread_create(&rd[i], NULL, reader, &st[i]);
+	}
+	pthread_create(&control, NULL, reader, NULL);
+	pthread_create(&w, NULL, writer, NULL);
+	pthread_join(w, NULL);
+	pthread_join(control, NULL);
+	for (i = 0; i < STRESS_READERS; i++) {
+		pthread_join(rd[i], NULL);
+		reads += st[i].reads;
+		retries += st[i].retries;
+		torn += st[i].torn;
+		backwards += st[i].backwards;
+	}
+	secs = host_seconds() - t0;
+
+	CHECK(reads > 0);
+	CHECK_EQ(torn, 0);
+	CHECK_EQ(backwards, 0);
+	printf("stress: %u writes, %d readers, %u reads in %.2f s (%.0f reads/s), %u retries, %u torn, %u went back\n",
+		   writes, STRESS_READERS, reads, secs, reads / secs, retries, torn, backwards);
+	printf("stress: without the lock %u of %u copies were torn\n", unlocked_torn, unlocked_reads);
+}
+
+int main(void)
+{
+	test_basic();
+	test_stress();
+	return host_test_done("test_seqlock");
+}
@@ -0,0 +1,186 @@
+/*
+ * test_spsc_ring.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  SPSC ring (spsc_ring.c):
+ *
+ *    - init arguments, full and empty rings, count and dropped
+ *    - a producer and a consumer on separate pthreads passing numbered
+ *      items through small rings. Every word of an item is derived from
+ *      its number, so a consumer that copies a slot the producer is still
+ *      writing sees a torn item. Reports items/s and the torn, lost and
+ *      out of order counts, all of which must be zero. Both sides yield
+ *      when they can't proceed so this also runs on a single core.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "host_test.h"
+#include "spsc_ring.h"
+
+#define STRESS_ITEMS	8000000u
+
+typedef struct {
+	uint32_t seq;
+	uint32_t w[7];		/* w[i] = seq * (2i + 3), checked on the way out */
+} item_t;
+
+static void item_make(item_t *it, uint32_t seq)
+{
+	int i;
+
+	it->seq = seq;
+	for (i = 0; i < 7; i++) {
+		it->w[i] = seq * (2 * i + 3);
+	}
+}
+
+static bool item_whole(const item_t *it)
+{
+	int i;
+
+	for (i = 0; i < 7; i++) {
+		if (it->w[i] != it->seq * (2 * i + 3)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_basic(void)
+{
+	static item_t storage[8];
+	spsc_ring_t r;
+	item_t it;
+	uint32_t i;
+
+	CHECK_EQ(spsc_ring_init(&r, storage, sizeof(item_t), 6), ESP_ERR_INVALID_ARG);
+	CHECK_EQ(spsc_ring_init(&r, storage, sizeof(item_t), 0), ESP_ERR_INVALID_ARG);
+	CHECK_EQ(spsc_ring_init(&r, NULL, sizeof(item_t), 8), ESP_ERR_INVALID_ARG);
+	CHECK_EQ(spsc_ring_init(&r, storage, 0, 8), ESP_ERR_INVALID_ARG);
+	CHECK_EQ(spsc_ring_init(&r, storage, sizeof(item_t), 8), ESP_OK);
+
+	CHECK(!spsc_ring_pop(&r, &it));
+	for (i = 0; i < 8; i++) {
+		item_make(&it, i);
+		CHECK(spsc_ring_push(&r, &it));
+	}
+	CHECK_EQ(spsc_ring_count(&r), 8);
+	CHECK(!spsc_ring_push(&r, &it));
+	CHECK_EQ(r.dropped, 1);
+
+	// Oldest first, and a NULL pop discards
+	CHECK(spsc_ring_pop(&r, &it));
+	CHECK_EQ(it.seq, 0);
+	CHECK(spsc_ring_pop(&r, NULL));
+	CHECK(spsc_ring_pop(&r, &it));
+	CHECK_EQ(it.seq, 2);
+	CHECK_EQ(spsc_ring_count(&r), 5);
+
+	// Indexes run freely across the 32 bit wrap
+	r.head = r.tail = UINT32_MAX - 2;
+	for (i = 0; i < 6; i++) {
+		item_make(&it, 100 + i);
+		CHECK(spsc_ring_push(&r, &it));
+	}
+	CHECK_EQ(spsc_ring_count(&r), 6);
+	for (i = 0; i < 6; i++) {
+		CHECK(spsc_ring_pop(&r, &it));
+		CHECK_EQ(it.seq, 100 + i);
+	}
+	CHECK(!spsc_ring_pop(&r, &it));
+}
+
+typedef struct {
+	spsc_ring_t ring;
+	uint32_t items;
+	uint32_t full;			/* producer retries on a full ring */
+	uint32_t torn;
+	uint32_t lost;
+	uint32_t disorder;
+} stress_t;
+
+static void *producer(void *arg)
+{
+	stress_t *st = arg;
+	item_t it;
+	uint32_t seq;
+
+	for (seq = 0; seq < st->items; seq++) {
+		item_make(&it, seq);
+		while (!spsc_ring_push(&st->ring, &it)) {
+			st->full++;
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void *consumer(void *arg)
+{
+	stress_t *st = arg;
+	item_t it;
+	uint32_t expect = 0;
+
+	while (expect < st->items) {
+		if (!spsc_ring_pop(&st->ring, &it)) {
+			sched_yield();
+			continue;
+		}
+		if (!item_whole(&it)) {
+			st->torn++;
+		}
+		if (it.seq > expect) {
+			st->lost += it.seq - expect;
+			expect = it.seq + 1;
+		}
+		else if (it.seq < expect) {
+			st->disorder++;
+		}
+		else {
+			expect++;
+		}
+	}
+	return NULL;
+}
+
+static void test_stress(uint32_t capacity)
+{
+	static item_t storage[1024];
+	stress_t st;
+	pthread_t p, c;
+	double t0, dt;
+
+	memset(&st, 0, sizeof(st));
+	st.items = STRESS_ITEMS;
+	CHECK_EQ(spsc_ring_init(&st.ring, storage, sizeof(item_t), capacity), ESP_OK);
+
+	t0 = host_seconds();
+	pthread_create(&c, NULL, consumer, &st);
+	pthread_create(&p, NULL, producer, &st);
+	pthread_join(p, NULL);
+	pthread_join(c, NULL);
+	dt = host_seconds() - t0;
+
+	CHECK_EQ(st.torn, 0);
+	CHECK_EQ(st.lost, 0);
+	CHECK_EQ(st.disorder, 0);
+	CHECK_EQ(spsc_ring_count(&st.ring), 0);
+	CHECK_EQ(st.ring.dropped, st.full);
+
+	printf("stress: capacity %4u, %u items of %u bytes, %.1f M items/s, %u full, %u torn, %u lost, %u out of order\n",
+		   capacity, st.items, (unsigned) sizeof(item_t), st.items / dt / 1e6,
+		   st.full, st.torn, st.lost, st.disorder);
+}
+
+int main(void)
+{
+	test_basic();
+	test_stress(2);
+	test_stress(16);
+	test_stress(1024);
+	return host_test_done("test_spsc_ring");
+}
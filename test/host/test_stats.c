@@ -0,0 +1,245 @@
+/*
+ * test_stats.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Window statistics (stats.c) against a reference that keeps every value
+ *  and sorts them:
+ *
+ *    - an empty window, one value, a constant window
+ *    - up to STATS_EXACT values: median and 95th percentile exact
+ *    - windows of 17 to 100000 values from uniform, exponential, normal,
+ *      ascending, descending and two-level data. Count, min and max
+ *      exact, mean and sd to float precision. The P-square markers stay
+ *      in order after every value, and the estimates are judged by rank:
+ *      the share of the window below them. stats_get() leaves the window
+ *      as it was.
+ *    - ns per stats_add(), and the fixed size of a window
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "host_test.h"
+#include "stats.h"
+
+#define MAX_N		100000
+#define BENCH_ADDS	10000000
+
+typedef enum {
+	DIST_UNIFORM = 0,
+	DIST_EXP,
+	DIST_NORMAL,
+	DIST_ASC,
+	DIST_DESC,
+	DIST_TWO,
+	DIST_COUNT
+} dist_t;
+
+static const char *dist_name[DIST_COUNT] = { "uniform", "exp", "normal", "ascending", "descending", "two-level" };
+
+static uint32_t seed = 22;
+
+static double unit(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) + 0.5) / (1 << 24);
+}
+
+static float draw(dist_t dist, int i, int n)
+{
+	switch (dist) {
+	case DIST_UNIFORM:
+		return 100 * unit();
+	case DIST_EXP:
+		return -10 * log(unit());
+	case DIST_NORMAL:
+		return 50 + 8 * sqrt(-2 * log(unit())) * cos(2 * M_PI * unit());
+	case DIST_ASC:
+		return i;
+	case DIST_DESC:
+		return n - i;
+	default:
+		return (unit() < 0.7) ? 12 : 35;
+	}
+}
+
+static int cmp(const void *a, const void *b)
+{
+	float x = *(const float *) a, y = *(const float *) b;
+
+	return (x < y) ? -1 : (x > y);
+}
+
+/* Quantile p of the n sorted values, interpolating as stats.c does */
+static double ref_quantile(const float *v, int n, double p)
+{
+	double r = p * (n - 1);
+	int i = (int) r;
+
+	return (i + 1 >= n) ? v[n - 1] : v[i] + (r - i) * (v[i + 1] - v[i]);
+}
+
+/* Share of the sorted values below x, counting ties as half */
+static double ref_rank(const float *v, int n, float x)
+{
+	int lo = 0, hi = 0, i;
+
+	for (i = 0; i < n; i++) {
+		lo += v[i] < x;
+		hi += v[i] <= x;
+	}
+	return (lo + hi) / 2.0 / n;
+}
+
+static bool markers_ordered(const stats_p2_t *e)
+{
+	int i;
+
+	for (i = 1; i < STATS_P2_MARKERS; i++) {
+		if (e->q[i] < e->q[i - 1] || e->pos[i] <= e->pos[i - 1]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_small(void)
+{
+	static float v[STATS_EXACT];
+	stats_summary_t o;
+	stats_t s;
+	double m, m2;
+	int n, i, bad = 0;
+
+	stats_reset(&s);
+	stats_get(&s, &o);
+	CHECK(o.n == 0 && o.mean == 0 && o.sd == 0 && o.min == 0 && o.max == 0 && o.p50 == 0 && o.p95 == 0);
+
+	stats_add(&s, -3.5f);
+	stats_get(&s, &o);
+	CHECK(o.n == 1 && o.mean == -3.5f && o.sd == 0 && o.min == -3.5f && o.max == -3.5f);
+	CHECK(o.p50 == -3.5f && o.p95 == -3.5f);
+
+	// Exact up to STATS_EXACT values
+	for (n = 2; n <= STATS_EXACT; n++) {
+		stats_reset(&s);
+		for (i = 0; i < n; i++) {
+			v[i] = draw(DIST_EXP, i, n);
+			stats_add(&s, v[i]);
+		}
+		stats_get(&s, &o);
+		qsort(v, n, sizeof(v[0]), cmp);
+		for (m = 0, i = 0; i < n; i++) {
+			m += v[i];
+		}
+		m /= n;
+		for (m2 = 0, i = 0; i < n; i++) {
+			m2 += (v[i] - m) * (v[i] - m);
+		}
+		bad += o.n != n || o.min != v[0] || o.max != v[n - 1];
+		bad += fabs(o.mean - m) > 1e-5 * (fabs(m) + 1);
+		bad += fabs(o.sd - sqrt(m2 / (n - 1))) > 1e-4 * (sqrt(m2 / (n - 1)) + 1);
+		bad += fabs(o.p50 - ref_quantile(v, n, 0.50)) > 1e-5 * v[n - 1];
+		bad += fabs(o.p95 - ref_quantile(v, n, 0.95)) > 1e-5 * v[n - 1];
+	}
+	CHECK_EQ(bad, 0);
+
+	// Constant: no spread, every estimate on the value
+	stats_reset(&s);
+	for (i = 0; i < 1000; i++) {
+		stats_add(&s, 21.25f);
+	}
+	stats_get(&s, &o);
+	CHECK(o.n == 1000 && o.mean == 21.25f && o.sd == 0 && o.min == 21.25f && o.max == 21.25f);
+	CHECK(o.p50 == 21.25f && o.p95 == 21.25f);
+}
+
+static void test_windows(void)
+{
+	static const int sizes[] = { 17, 30, 60, 300, 1000, 100000 };
+	static float v[MAX_N];
+	stats_summary_t o;
+	stats_t s, copy;
+	double m, m2, sd, r50, r95, worst50 = 0, worst95 = 0, lim;
+	int d, z, n, i, order_bad = 0, bad = 0;
+
+	printf("%-10s %6s %9s %9s %9s %9s\n", "windows", "n", "p50", "rank", "p95", "rank");
+	for (d = 0; d < DIST_COUNT; d++) {
+		for (z = 0; z < (int) (sizeof(sizes) / sizeof(sizes[0])); z++) {
+			n = sizes[z];
+			stats_reset(&s);
+			for (i = 0; i < n; i++) {
+				v[i] = draw(d, i, n);
+				stats_add(&s, v[i]);
+				if (s.n > STATS_EXACT && (!markers_ordered(&s.p50) || !markers_ordered(&s.p95))) {
+					order_bad++;
+				}
+			}
+			copy = s;
+			stats_get(&s, &o);
+			CHECK(memcmp(&copy, &s, sizeof(s)) == 0);
+
+			qsort(v, n, sizeof(v[0]), cmp);
+			for (m = 0, i = 0; i < n; i++) {
+				m += v[i];
+			}
+			m /= n;
+			for (m2 = 0, i = 0; i < n; i++) {
+				m2 += (v[i] - m) * (v[i] - m);
+			}
+			sd = sqrt(m2 / (n - 1));
+			bad += o.n != n || o.min != v[0] || o.max != v[n - 1];
+			bad += fabs(o.mean - m) > 1e-4 * (fabs(m) + sd);
+			bad += fabs(o.sd - sd) > 1e-3 * (sd + 1e-3);
+
+			// By rank: within three places of a short window, 3% of a long one
+			r50 = ref_rank(v, n, o.p50);
+			r95 = ref_rank(v, n, o.p95);
+			lim = fmax(0.03, 3.0 / n);
+			if (d != DIST_TWO) {
+				bad += fabs(r50 - 0.50) > lim || fabs(r95 - 0.95) > lim;
+				if (n >= 100) {
+					worst50 = fmax(worst50, fabs(r50 - 0.50));
+					worst95 = fmax(worst95, fabs(r95 - 0.95));
+				}
+			}
+			else {
+				// Two levels: the estimates are somewhere between them
+				bad += o.p50 < 12 || o.p50 > 35 || o.p95 < 12 || o.p95 > 35;
+			}
+			printf("%-10s %6d %9.3f %9.3f %9.3f %9.3f\n", dist_name[d], n, o.p50, r50, o.p95, r95);
+		}
+	}
+	CHECK_EQ(order_bad, 0);
+	CHECK_EQ(bad, 0);
+	printf("windows: from 300 values on, ranks within %.3f of 0.50 and %.3f of 0.95\n", worst50, worst95);
+}
+
+static void test_bench(void)
+{
+	stats_summary_t o;
+	stats_t s;
+	double t0, ns;
+	int i;
+
+	stats_reset(&s);
+	t0 = host_seconds();
+	for (i = 0; i < BENCH_ADDS; i++) {
+		stats_add(&s, (float) (i % 977));
+	}
+	ns = (host_seconds() - t0) * 1e9 / BENCH_ADDS;
+	stats_get(&s, &o);
+	CHECK_EQ(o.n, BENCH_ADDS);
+	CHECK(fabs(o.p50 - 488) < 30);
+	printf("bench: %.1f ns per stats_add(), %zu bytes a window, %zu a summary\n",
+		   ns, sizeof(stats_t), sizeof(stats_summary_t));
+}
+
+int main(void)
+{
+	test_small();
+	test_windows();
+	test_bench();
+	return host_test_done("test_stats");
+}
@@ -0,0 +1,293 @@
+/*
+ * test_time.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Device clock (time_if.c):
+ *
+ *    - TIME_EpochMs() against timegm() over 200k random dates, and every
+ *      out of range field
+ *    - 48 h of GPS references on an esp_timer running 30 ppm fast, with
+ *      10 ms of noise and a 5 s backward jolt at 24 h. The clock never
+ *      runs backwards, across a correction or between seconds; it tracks
+ *      the references, slews the jolt out and steps back to true time.
+ *      Then 34 h of holdover on the drift estimate, LOCKED turning to
+ *      HOLDOVER after CONFIG_TIME_HOLDOVER_S.
+ *    - the SNTP poll on a simulated system time: set from the GPS-set
+ *      clock, SNTP updates ignored while GPS is fresh and taken once it
+ *      isn't, and a busy clock never waited for in the timer service task
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "host_test.h"
+#include "host_shim.h"
+
+/* The system time: esp_timer plus an offset settimeofday() moves */
+static int64_t host_sys_off_us;
+static uint32_t host_sys_sets;
+
+static int host_gettimeofday(struct timeval *tv)
+{
+	int64_t us = host_time_us + host_sys_off_us;
+
+	tv->tv_sec = us / 1000000;
+	tv->tv_usec = us % 1000000;
+	return 0;
+}
+
+static int host_settimeofday(const struct timeval *tv)
+{
+	host_sys_off_us = (int64_t) tv->tv_sec * 1000000 + tv->tv_usec - host_time_us;
+	host_sys_sets++;
+	return 0;
+}
+
+#define gettimeofday(tv, tz)	host_gettimeofday(tv)
+#define settimeofday(tv, tz)	host_settimeofday(tv)
+
+#include "time_if.c"
+
+void sntp_setoperatingmode(uint8_t operating_mode) { }
+void sntp_setservername(uint8_t idx, const char *server) { }
+void sntp_init(void) { }
+void sntp_stop(void) { }
+EventBits_t wifi_manager_wait_internet_access(void) { return 0; }
+
+#define S(s)			((s) * 1000000LL)
+#define H(h)			S((h) * 3600LL)
+#define EPOCH_DATES		200000
+#define DRIFT_PPM		30
+#define NOISE_MS		10
+#define JOLT_AT			H(24)
+#define JOLT_MS			5000
+#define LOCKED_H		48
+#define HOLDOVER_H		34
+
+static uint32_t seed = 16;
+
+static uint32_t rnd(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) & 0xFFFFFF) % n;
+}
+
+static int64_t ref_epoch_ms(int year, int month, int day, int hour, int min, int sec, int ms)
+{
+	struct tm tm;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = year - 1900;
+	tm.tm_mon = month - 1;
+	tm.tm_mday = day;
+	tm.tm_hour = hour;
+	tm.tm_min = min;
+	tm.tm_sec = sec;
+	return (int64_t) timegm(&tm) * 1000 + ms;
+}
+
+static void test_epoch(void)
+{
+	static const uint8_t mdays[12] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	int i, y, mo, d, h, mi, s, ms, bad = 0;
+
+	for (i = 0; i < EPOCH_DATES; i++) {
+		y = 1970 + rnd(430);
+		mo = 1 + rnd(12);
+		d = 1 + rnd(mdays[mo - 1]);
+		if (mo == 2 && d == 29 && (y % 4 != 0 || (y % 100 == 0 && y % 400 != 0))) {
+			d = 28;
+		}
+		h = rnd(24);
+		mi = rnd(60);
+		s = rnd(61);
+		ms = rnd(1000);
+		bad += TIME_EpochMs(y, mo, d, h, mi, s, ms) != ref_epoch_ms(y, mo, d, h, mi, s, ms);
+	}
+	CHECK_EQ(bad, 0);
+
+	CHECK_EQ(TIME_EpochMs(1970, 1, 1, 0, 0, 0, 0), 0);
+	CHECK_EQ(TIME_EpochMs(2000, 2, 29, 23, 59, 59, 999), 951868799999LL);
+	CHECK_EQ(TIME_EpochMs(2038, 1, 19, 3, 14, 8, 0), 2147483648000LL);
+	CHECK_EQ(TIME_EpochMs(2100, 3, 1, 0, 0, 0, 0), ref_epoch_ms(2100, 3, 1, 0, 0, 0, 0));
+
+	CHECK_EQ(TIME_EpochMs(1969, 12, 31, 23, 59, 59, 999), -1);
+	CHECK_EQ(TIME_EpochMs(2026, 0, 1, 0, 0, 0, 0), -1);
+	CHECK_EQ(TIME_EpochMs(2026, 13, 1, 0, 0, 0, 0), -1);
+	CHECK_EQ(TIME_EpochMs(2026, 1, 0, 0, 0, 0, 0), -1);
+	CHECK_EQ(TIME_EpochMs(2026, 1, 32, 0, 0, 0, 0), -1);
+	CHECK_EQ(TIME_EpochMs(2026, 1, 1, 24, 0, 0, 0), -1);
+	CHECK_EQ(TIME_EpochMs(2026, 1, 1, 0, 60, 0, 0), -1);
+	CHECK_EQ(TIME_EpochMs(2026, 1, 1, 0, 0, 61, 0), -1);
+	CHECK_EQ(TIME_EpochMs(2026, 1, 1, 0, 0, 0, 1000), -1);
+}
+
+/*
+ * The simulation. esp_timer runs DRIFT_PPM fast: true UTC moves
+ * 1 / (1 + DRIFT_PPM) as far as it does.
+ */
+static int64_t t0_us, t0_ms;
+
+static int64_t true_ms(int64_t mono_us)
+{
+	return t0_ms + (mono_us - t0_us) * 1000000 / (1000000 + DRIFT_PPM) / 1000;
+}
+
+static void test_discipline(void)
+{
+	time_status_t st;
+	int64_t mono, ms, prev = -1, before, after, err, ref, end_locked;
+	int64_t worst_locked = 0, worst_jolt = 0, err_holdover;
+	int32_t drift_ppb;
+	uint32_t backwards = 0, steps_back = 0, not_locked = 0, not_holdover = 0;
+	bool jolt;
+
+	memset(&clk, 0, sizeof(clk));
+	t0_us = host_time_us;
+	t0_ms = TIME_EpochMs(2026, 10, 17, 0, 0, 0, 0);
+
+	CHECK_EQ(TIME_FromMono(host_time_us), -1);
+	TIME_Status(&st);
+	CHECK_EQ(st.state, TIME_UNSET);
+
+	// A GPS fix every second; the clock takes one a minute
+	end_locked = t0_us + H(LOCKED_H);
+	while (host_time_us < end_locked) {
+		host_advance_us(S(1));
+		mono = host_time_us;
+		jolt = mono >= t0_us + JOLT_AT && mono < t0_us + JOLT_AT + S(60);
+		ref = true_ms(mono) + (int) rnd(2 * NOISE_MS + 1) - NOISE_MS - (jolt ? JOLT_MS : 0);
+
+		before = TIME_FromMono(mono);
+		TIME_Discipline(ref, mono, TIME_SRC_GPS);
+		after = TIME_FromMono(mono);
+		backwards += after < before || after < prev;
+		steps_back += clk.st.last_err_ms < -TIME_STEP_BACK_MS;
+		prev = after;
+
+		// Off by the noise and a minute of drift; after the jolt by no more
+		// than a minute of slewing, until the next reference puts it right
+		err = llabs(after - true_ms(mono));
+		if (mono >= t0_us + JOLT_AT && mono < t0_us + JOLT_AT + S(120)) {
+			worst_jolt = (err > worst_jolt) ? err : worst_jolt;
+		}
+		else if (mono > t0_us + S(1)) {
+			worst_locked = (err > worst_locked) ? err : worst_locked;
+		}
+		TIME_Status(&st);
+		not_locked += st.state != TIME_LOCKED;
+	}
+	CHECK_EQ(backwards, 0);
+	CHECK_EQ(steps_back, 0);
+	CHECK_EQ(not_locked, 0);
+	CHECK(worst_locked <= 2 * NOISE_MS + 5);
+	CHECK(worst_jolt <= 60 * TIME_SLEW_PPM / 1000 + 2 * NOISE_MS + 5);
+	TIME_Status(&st);
+	CHECK_EQ(st.src, TIME_SRC_GPS);
+	CHECK_EQ(st.syncs, LOCKED_H * 60);
+	drift_ppb = st.drift_ppb;
+	CHECK(abs(drift_ppb + DRIFT_PPM * 1000) < DRIFT_PPM * 1000 / 3);
+
+	// Holdover: the drift estimate carries it, LOCKED until the limit
+	while (host_time_us < end_locked + H(HOLDOVER_H)) {
+		host_advance_us(S(1));
+		ms = TIME_FromMono(host_time_us);
+		backwards += ms < prev;
+		prev = ms;
+		TIME_Status(&st);
+		if (host_time_us - clk.st.last_sync_us < TIME_HOLDOVER_US) {
+			not_locked += st.state != TIME_LOCKED;
+		}
+		else {
+			not_holdover += st.state != TIME_HOLDOVER;
+		}
+	}
+	CHECK_EQ(backwards, 0);
+	CHECK_EQ(not_locked, 0);
+	CHECK_EQ(not_holdover, 0);
+	err_holdover = prev - true_ms(host_time_us);
+
+	// What is left is the error of the estimate, a third of the free run
+	// at most
+	CHECK(llabs(err_holdover) < DRIFT_PPM * 3600LL * HOLDOVER_H / 1000 / 3);
+	CHECK(llabs(err_holdover - (int64_t) (drift_ppb + DRIFT_PPM * 1000) * 3600 * HOLDOVER_H / 1000000) < 2 * NOISE_MS + 5);
+	printf("discipline: %d h locked within %lld ms, %lld ms at the jolt, drift %.1f ppm, %lld ms off after %d h holdover (%lld ms free running)\n",
+		   LOCKED_H, (long long) worst_locked, (long long) worst_jolt, -drift_ppb / 1000.0,
+		   (long long) err_holdover, HOLDOVER_H, (long long) DRIFT_PPM * 3600 * HOLDOVER_H / 1000);
+}
+
+static void test_sntp(void)
+{
+	time_status_t st;
+	int64_t ms, t;
+	uint32_t syncs, sets;
+
+	memset(&clk, 0, sizeof(clk));
+	sys_off_us = 0;
+	host_sys_off_us = 0;
+	host_sys_sets = 0;
+	t0_us = host_time_us;
+	t0_ms = TIME_EpochMs(2026, 10, 17, 12, 0, 0, 0);
+
+	// Nothing to set the system time from yet
+	host_advance_us(S(TIME_SNTP_POLL_MS / 1000));
+	CHECK_EQ(host_sys_sets, 0);
+
+	// GPS sets the clock, the next poll the system time from it
+	TIME_Discipline(true_ms(host_time_us), host_time_us, TIME_SRC_GPS);
+	host_advance_us(S(TIME_SNTP_POLL_MS / 1000));
+	CHECK_EQ(host_sys_sets, 1);
+	CHECK(llabs((host_time_us + host_sys_off_us) / 1000 - TIME_NowMs()) <= 1);
+
+	// SNTP corrects the system time by 3 s: GPS is fresh, the clock stays
+	host_sys_off_us += S(3);
+	syncs = clk.st.syncs;
+	ms = TIME_NowMs();
+	host_advance_us(S(TIME_SNTP_POLL_MS / 1000));
+	TIME_Status(&st);
+	CHECK_EQ(st.syncs, syncs);
+	CHECK_EQ(st.src, TIME_SRC_GPS);
+	CHECK(llabs(TIME_NowMs() - ms - TIME_SNTP_POLL_MS) <= 1);
+
+	// GPS gone past the holdover limit; SNTP corrects again and is taken
+	host_advance_us(TIME_HOLDOVER_US);
+	TIME_Status(&st);
+	CHECK_EQ(st.state, TIME_HOLDOVER);
+	// SNTP 250 ms ahead of true at the poll
+	t = host_time_us + S(TIME_SNTP_POLL_MS / 1000);
+	host_sys_off_us = true_ms(t) * 1000 + 250000 - t;
+	host_advance_us(S(TIME_SNTP_POLL_MS / 1000));
+	TIME_Status(&st);
+	CHECK_EQ(st.syncs, syncs + 1);
+	CHECK_EQ(st.src, TIME_SRC_SNTP);
+	CHECK_EQ(st.state, TIME_LOCKED);
+	CHECK_EQ(st.last_sync_us, t);
+	CHECK(llabs(TIME_FromMono(t) - (true_ms(t) + 250)) <= 1);
+
+	// The clock is busy at the next update: the poll passes it by rather
+	// than wait (here it would wait for good), and takes it a poll later
+	host_sys_off_us += 80000;
+	xSemaphoreTake(clk_mutex, portMAX_DELAY);
+	sets = host_sys_sets;
+	host_advance_us(S(TIME_SNTP_POLL_MS / 1000));
+	xSemaphoreGive(clk_mutex);
+	TIME_Status(&st);
+	CHECK_EQ(st.syncs, syncs + 1);
+	host_advance_us(S(TIME_SNTP_POLL_MS / 1000));
+	TIME_Status(&st);
+	CHECK_EQ(st.syncs, syncs + 2);
+	CHECK(abs(st.last_err_ms - 80) <= 1);
+	CHECK_EQ(host_sys_sets, sets);
+	printf("sntp: system time set from GPS, SNTP taken %d s after the last fix, a busy clock retried on the next poll\n",
+		   CONFIG_TIME_HOLDOVER_S + TIME_SNTP_POLL_MS / 1000);
+}
+
+int main(void)
+{
+	test_epoch();
+	TIME_Initialize();
+	test_discipline();
+	test_sntp();
+	return host_test_done("test_time");
+}
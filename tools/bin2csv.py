@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""
+bin2csv.py
+
+Convert AirU binary data files (YY-MM-DD.bin, see main/include/binrec_if.h)
+back to the SD card CSV layout (SD_HDR in main/include/sd_if.h).
+
+    bin2csv.py 26-10-17.bin > 26-10-17.csv
+    bin2csv.py 26-10-17.bin --start 08:00:00 --end 09:30:00
+
+With --start, the sidecar .idx file (if present) is binary searched for the
+first record to read, so only the requested part of the day is scanned.
+"""
+
+import argparse
+import bisect
+import os
+import struct
+import sys
+
+BINREC_MAGIC = 0x42524941
+BINREC_IDX_MAGIC = 0x49524941
+BINREC_VERSION = 1
+BINREC_SYNC = 0xA55A
+BINREC_TOD_NONE = 0xFFFFFFFF
+BINREC_NAN = -2**31
+BINREC_NAN16 = -2**15
+
+SD_HDR = "time,ID,topic,SecActive,Altitude,Latitude,Longitude,PM1,PM2.5,PM10,Temperature,Humidity,CO,NO\n"
+
+FILE_HDR = struct.Struct("<IHHHH")
+RECORD = struct.Struct("<HHIIiiiiiihhii")
+IDX_HDR = struct.Struct("<IHH")
+IDX_ENTRY = struct.Struct("<II")
+
+
+def fixed(v, decimals, nan=BINREC_NAN):
+    """Print a scaled integer the way enc_fmt_fixed() prints the float"""
+    if v == nan:
+        return "nan"
+    scale = 10 ** decimals
+    sign = "-" if v < 0 else ""
+    v = abs(v)
+    return "%s%d.%0*d" % (sign, v // scale, decimals, v % scale)
+
+
+def clock(rec):
+    if rec["tod"] != BINREC_TOD_NONE:
+        t = rec["tod"]
+        return "%02d:%02d:%02d" % (t // 3600, (t // 60) % 60, t % 60)
+    t = rec["uptime"]
+    return "%d:%02d:%02d" % (t // 3600, (t // 60) % 60, t % 60)
+
+
+def key(rec):
+    return rec["tod"] if rec["tod"] != BINREC_TOD_NONE else rec["uptime"]
+
+
+def parse_time(s):
+    h, m, sec = (int(x) for x in s.split(":"))
+    return h * 3600 + m * 60 + sec
+
+
+def read_header(f):
+    raw = f.read(FILE_HDR.size)
+    if len(raw) < FILE_HDR.size:
+        raise ValueError("file too short")
+    magic, version, hdr_len, rec_len, interval = FILE_HDR.unpack(raw)
+    if magic != BINREC_MAGIC:
+        raise ValueError("not an AirU binary data file")
+    if version != BINREC_VERSION or rec_len != RECORD.size:
+        raise ValueError("unsupported version %d (record %d bytes)" % (version, rec_len))
+    strings = f.read(hdr_len - FILE_HDR.size).split(b"\0")
+    return hdr_len, strings[0].decode(), strings[1].decode()
+
+
+def index_offset(idx_path, hdr_len, size, start):
+    """Offset of the last indexed record with a key < start"""
+    try:
+        with open(idx_path, "rb") as f:
+            raw = f.read()
+    except OSError:
+        return hdr_len
+
+    magic, version, entry_len = IDX_HDR.unpack_from(raw)
+    if magic != BINREC_IDX_MAGIC or entry_len != IDX_ENTRY.size:
+        return hdr_len
+
+    entries = []
+    for pos in range(IDX_HDR.size, len(raw) - entry_len + 1, entry_len):
+        k, off = IDX_ENTRY.unpack_from(raw, pos)
+        # The index can run ahead of the data, or point at a torn record
+        if off < size and (off - hdr_len) % RECORD.size == 0:
+            entries.append((k, off))
+
+    i = bisect.bisect_left([k for k, _ in entries], start) - 1
+    return entries[i][1] if i >= 0 else hdr_len
+
+
+def records(f, offset):
+    """Yield decoded records from offset, skipping over damaged bytes"""
+    f.seek(offset)
+    buf = f.read()
+    pos = 0
+    while pos + RECORD.size <= len(buf):
+        fields = RECORD.unpack_from(buf, pos)
+        if fields[0] != BINREC_SYNC:
+            pos += 1
+            continue
+        pos += RECORD.size
+        yield dict(zip(("sync", "valid", "uptime", "tod", "alt", "lat", "lon",
+                        "pm1", "pm2_5", "pm10", "temp", "hum", "co", "nox"), fields))
+
+
+def to_csv(rec, dev_id, topic):
+    return ",".join([
+        clock(rec), dev_id, topic,
+        str(rec["uptime"]),
+        fixed(rec["alt"], 2),
+        fixed(rec["lat"], 4),
+        fixed(rec["lon"], 4),
+        fixed(rec["pm1"], 2),
+        fixed(rec["pm2_5"], 2),
+        fixed(rec["pm10"], 2),
+        fixed(rec["temp"], 2, BINREC_NAN16),
+        fixed(rec["hum"], 2, BINREC_NAN16),
+        str(rec["co"]),
+        str(rec["nox"]),
+    ]) + "\n"
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("file", help="YY-MM-DD.bin")
+    ap.add_argument("--start", help="first time to output, HH:MM:SS")
+    ap.add_argument("--end", help="last time to output, HH:MM:SS")
+    ap.add_argument("--no-header", action="store_true", help="don't print the CSV header")
+    args = ap.parse_args()
+
+    start = parse_time(args.start) if args.start else None
+    end = parse_time(args.end) if args.end else None
+    out = sys.stdout
+
+    with open(args.file, "rb") as f:
+        hdr_len, dev_id, topic = read_header(f)
+        offset = hdr_len
+        if start is not None:
+            size = os.fstat(f.fileno()).st_size
+            offset = index_offset(os.path.splitext(args.file)[0] + ".idx", hdr_len, size, start)
+
+        if not args.no_header:
+            out.write(SD_HDR)
+        for rec in records(f, offset):
+            k = key(rec)
+            if start is not None and k < start:
+                continue
+            if end is not None and k > end:
+                # Time of day only grows within a file, uptime restarts on reboot
+                if rec["tod"] != BINREC_TOD_NONE:
+                    break
+                continue
+            out.write(to_csv(rec, dev_id, topic))
+
+
+if __name__ == "__main__":
+    main()